@@ -38,6 +38,8 @@ init_tarantool_cfg(tarantool_cfg *c) {
 	c->slab_alloc_arena = 0;
 	c->slab_alloc_minimal = 0;
 	c->slab_alloc_factor = 0;
+	c->slab_alloc_huge_pages = false;
+	c->slab_alloc_adaptive = false;
 	c->work_dir = NULL;
 	c->snap_dir = NULL;
 	c->wal_dir = NULL;
@@ -48,8 +50,12 @@ init_tarantool_cfg(tarantool_cfg *c) {
 	c->io_collect_interval = 0;
 	c->backlog = 0;
 	c->readahead = 0;
+	c->iproto_net_threads = 0;
 	c->snap_io_rate_limit = 0;
+	c->snap_fork = false;
+	c->snap_segments = 0;
 	c->rows_per_wal = 0;
+	c->wal_prealloc_size = 0;
 	c->wal_writer_inbox_size = 0;
 	c->wal_mode = NULL;
 	c->wal_fsync_delay = 0;
@@ -66,6 +72,11 @@ init_tarantool_cfg(tarantool_cfg *c) {
 	c->memcached_expire_per_loop = 0;
 	c->memcached_expire_full_sweep = 0;
 	c->replication_source = NULL;
+	c->tree_index_engine = NULL;
+	c->background_index_build = false;
+	c->hash_index_engine = NULL;
+	c->slab_defrag_threshold = 0;
+	c->slab_defrag_slice = 0;
 	c->space = NULL;
 }
 
@@ -84,6 +95,8 @@ fill_default_tarantool_cfg(tarantool_cfg *c) {
 	c->slab_alloc_arena = 1;
 	c->slab_alloc_minimal = 64;
 	c->slab_alloc_factor = 2;
+	c->slab_alloc_huge_pages = false;
+	c->slab_alloc_adaptive = false;
 	c->work_dir = NULL;
 	c->snap_dir = strdup(".");
 	if (c->snap_dir == NULL) return CNF_NOMEMORY;
@@ -98,8 +111,12 @@ fill_default_tarantool_cfg(tarantool_cfg *c) {
 	c->io_collect_interval = 0;
 	c->backlog = 1024;
 	c->readahead = 16320;
+	c->iproto_net_threads = 0;
 	c->snap_io_rate_limit = 0;
+	c->snap_fork = true;
+	c->snap_segments = 1;
 	c->rows_per_wal = 500000;
+	c->wal_prealloc_size = 0;
 	c->wal_writer_inbox_size = 16384;
 	c->wal_mode = strdup("fsync_delay");
 	if (c->wal_mode == NULL) return CNF_NOMEMORY;
@@ -117,6 +134,13 @@ fill_default_tarantool_cfg(tarantool_cfg *c) {
 	c->memcached_expire_per_loop = 1024;
 	c->memcached_expire_full_sweep = 3600;
 	c->replication_source = NULL;
+	c->tree_index_engine = strdup("sptree");
+	if (c->tree_index_engine == NULL) return CNF_NOMEMORY;
+	c->background_index_build = false;
+	c->hash_index_engine = strdup("mhash");
+	if (c->hash_index_engine == NULL) return CNF_NOMEMORY;
+	c->slab_defrag_threshold = 0;
+	c->slab_defrag_slice = 100;
 	c->space = NULL;
 	return 0;
 }
@@ -133,6 +157,7 @@ acceptDefault_name__space(tarantool_cfg_space *c) {
 	c->enabled = -1;
 	c->cardinality = -1;
 	c->estimated_rows = 0;
+	c->field_map = 0;
 	c->index = NULL;
 	return 0;
 }
@@ -184,6 +209,12 @@ static NameAtom _name__slab_alloc_minimal[] = {
 static NameAtom _name__slab_alloc_factor[] = {
 	{ "slab_alloc_factor", -1, NULL }
 };
+static NameAtom _name__slab_alloc_huge_pages[] = {
+	{ "slab_alloc_huge_pages", -1, NULL }
+};
+static NameAtom _name__slab_alloc_adaptive[] = {
+	{ "slab_alloc_adaptive", -1, NULL }
+};
 static NameAtom _name__work_dir[] = {
 	{ "work_dir", -1, NULL }
 };
@@ -214,12 +245,24 @@ static NameAtom _name__backlog[] = {
 static NameAtom _name__readahead[] = {
 	{ "readahead", -1, NULL }
 };
+static NameAtom _name__iproto_net_threads[] = {
+	{ "iproto_net_threads", -1, NULL }
+};
 static NameAtom _name__snap_io_rate_limit[] = {
 	{ "snap_io_rate_limit", -1, NULL }
 };
+static NameAtom _name__snap_fork[] = {
+	{ "snap_fork", -1, NULL }
+};
+static NameAtom _name__snap_segments[] = {
+	{ "snap_segments", -1, NULL }
+};
 static NameAtom _name__rows_per_wal[] = {
 	{ "rows_per_wal", -1, NULL }
 };
+static NameAtom _name__wal_prealloc_size[] = {
+	{ "wal_prealloc_size", -1, NULL }
+};
 static NameAtom _name__wal_writer_inbox_size[] = {
 	{ "wal_writer_inbox_size", -1, NULL }
 };
@@ -268,6 +311,21 @@ static NameAtom _name__memcached_expire_full_sweep[] = {
 static NameAtom _name__replication_source[] = {
 	{ "replication_source", -1, NULL }
 };
+static NameAtom _name__tree_index_engine[] = {
+	{ "tree_index_engine", -1, NULL }
+};
+static NameAtom _name__background_index_build[] = {
+	{ "background_index_build", -1, NULL }
+};
+static NameAtom _name__hash_index_engine[] = {
+	{ "hash_index_engine", -1, NULL }
+};
+static NameAtom _name__slab_defrag_threshold[] = {
+	{ "slab_defrag_threshold", -1, NULL }
+};
+static NameAtom _name__slab_defrag_slice[] = {
+	{ "slab_defrag_slice", -1, NULL }
+};
 static NameAtom _name__space[] = {
 	{ "space", -1, NULL }
 };
@@ -283,6 +341,10 @@ static NameAtom _name__space__estimated_rows[] = {
 	{ "space", -1, _name__space__estimated_rows + 1 },
 	{ "estimated_rows", -1, NULL }
 };
+static NameAtom _name__space__field_map[] = {
+	{ "space", -1, _name__space__field_map + 1 },
+	{ "field_map", -1, NULL }
+};
 static NameAtom _name__space__index[] = {
 	{ "space", -1, _name__space__index + 1 },
 	{ "index", -1, NULL }
@@ -498,6 +560,56 @@ acceptValue(tarantool_cfg* c, OptDef* opt, int check_rdonly) {
 			return CNF_RDONLY;
 		c->slab_alloc_factor = dbl;
 	}
+	else if ( cmpNameAtoms( opt->name, _name__slab_alloc_huge_pages) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		bool bln;
+
+		if (strcasecmp(opt->paramValue.scalarval, "true") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "yes") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "enable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "on") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "1") == 0 )
+			bln = true;
+		else if (strcasecmp(opt->paramValue.scalarval, "false") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "no") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "disable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "off") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "0") == 0 )
+			bln = false;
+		else
+			return CNF_WRONGRANGE;
+		if (check_rdonly && c->slab_alloc_huge_pages != bln)
+			return CNF_RDONLY;
+		c->slab_alloc_huge_pages = bln;
+	}
+	else if ( cmpNameAtoms( opt->name, _name__slab_alloc_adaptive) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		bool bln;
+
+		if (strcasecmp(opt->paramValue.scalarval, "true") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "yes") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "enable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "on") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "1") == 0 )
+			bln = true;
+		else if (strcasecmp(opt->paramValue.scalarval, "false") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "no") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "disable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "off") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "0") == 0 )
+			bln = false;
+		else
+			return CNF_WRONGRANGE;
+		if (check_rdonly && c->slab_alloc_adaptive != bln)
+			return CNF_RDONLY;
+		c->slab_alloc_adaptive = bln;
+	}
 	else if ( cmpNameAtoms( opt->name, _name__work_dir) ) {
 		if (opt->paramType != scalarType )
 			return CNF_WRONGTYPE;
@@ -631,6 +743,20 @@ acceptValue(tarantool_cfg* c, OptDef* opt, int check_rdonly) {
 			return CNF_WRONGRANGE;
 		c->readahead = i32;
 	}
+	else if ( cmpNameAtoms( opt->name, _name__iproto_net_threads) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		long int i32 = strtol(opt->paramValue.scalarval, NULL, 10);
+		if (i32 == 0 && errno == EINVAL)
+			return CNF_WRONGINT;
+		if ( (i32 == LONG_MIN || i32 == LONG_MAX) && errno == ERANGE)
+			return CNF_WRONGRANGE;
+		if (check_rdonly && c->iproto_net_threads != i32)
+			return CNF_RDONLY;
+		c->iproto_net_threads = i32;
+	}
 	else if ( cmpNameAtoms( opt->name, _name__snap_io_rate_limit) ) {
 		if (opt->paramType != scalarType )
 			return CNF_WRONGTYPE;
@@ -641,6 +767,41 @@ acceptValue(tarantool_cfg* c, OptDef* opt, int check_rdonly) {
 			return CNF_WRONGRANGE;
 		c->snap_io_rate_limit = dbl;
 	}
+	else if ( cmpNameAtoms( opt->name, _name__snap_fork) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		bool bln;
+
+		if (strcasecmp(opt->paramValue.scalarval, "true") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "yes") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "enable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "on") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "1") == 0 )
+			bln = true;
+		else if (strcasecmp(opt->paramValue.scalarval, "false") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "no") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "disable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "off") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "0") == 0 )
+			bln = false;
+		else
+			return CNF_WRONGRANGE;
+		c->snap_fork = bln;
+	}
+	else if ( cmpNameAtoms( opt->name, _name__snap_segments) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		long int i32 = strtol(opt->paramValue.scalarval, NULL, 10);
+		if (i32 == 0 && errno == EINVAL)
+			return CNF_WRONGINT;
+		if ( (i32 == LONG_MIN || i32 == LONG_MAX) && errno == ERANGE)
+			return CNF_WRONGRANGE;
+		c->snap_segments = i32;
+	}
 	else if ( cmpNameAtoms( opt->name, _name__rows_per_wal) ) {
 		if (opt->paramType != scalarType )
 			return CNF_WRONGTYPE;
@@ -655,6 +816,20 @@ acceptValue(tarantool_cfg* c, OptDef* opt, int check_rdonly) {
 			return CNF_RDONLY;
 		c->rows_per_wal = i32;
 	}
+	else if ( cmpNameAtoms( opt->name, _name__wal_prealloc_size) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		long int i32 = strtol(opt->paramValue.scalarval, NULL, 10);
+		if (i32 == 0 && errno == EINVAL)
+			return CNF_WRONGINT;
+		if ( (i32 == LONG_MIN || i32 == LONG_MAX) && errno == ERANGE)
+			return CNF_WRONGRANGE;
+		if (check_rdonly && c->wal_prealloc_size != i32)
+			return CNF_RDONLY;
+		c->wal_prealloc_size = i32;
+	}
 	else if ( cmpNameAtoms( opt->name, _name__wal_writer_inbox_size) ) {
 		if (opt->paramType != scalarType )
 			return CNF_WRONGTYPE;
@@ -886,6 +1061,77 @@ acceptValue(tarantool_cfg* c, OptDef* opt, int check_rdonly) {
 		if (opt->paramValue.scalarval && c->replication_source == NULL)
 			return CNF_NOMEMORY;
 	}
+	else if ( cmpNameAtoms( opt->name, _name__tree_index_engine) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		if (check_rdonly && ( (opt->paramValue.scalarval == NULL && c->tree_index_engine == NULL) || strcmp(opt->paramValue.scalarval, c->tree_index_engine) != 0))
+			return CNF_RDONLY;
+		 if (c->tree_index_engine) free(c->tree_index_engine);
+		c->tree_index_engine = (opt->paramValue.scalarval) ? strdup(opt->paramValue.scalarval) : NULL;
+		if (opt->paramValue.scalarval && c->tree_index_engine == NULL)
+			return CNF_NOMEMORY;
+	}
+	else if ( cmpNameAtoms( opt->name, _name__background_index_build) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		bool bln;
+
+		if (strcasecmp(opt->paramValue.scalarval, "true") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "yes") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "enable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "on") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "1") == 0 )
+			bln = true;
+		else if (strcasecmp(opt->paramValue.scalarval, "false") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "no") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "disable") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "off") == 0 ||
+				strcasecmp(opt->paramValue.scalarval, "0") == 0 )
+			bln = false;
+		else
+			return CNF_WRONGRANGE;
+		if (check_rdonly && c->background_index_build != bln)
+			return CNF_RDONLY;
+		c->background_index_build = bln;
+	}
+	else if ( cmpNameAtoms( opt->name, _name__hash_index_engine) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		if (check_rdonly && ( (opt->paramValue.scalarval == NULL && c->hash_index_engine == NULL) || strcmp(opt->paramValue.scalarval, c->hash_index_engine) != 0))
+			return CNF_RDONLY;
+		 if (c->hash_index_engine) free(c->hash_index_engine);
+		c->hash_index_engine = (opt->paramValue.scalarval) ? strdup(opt->paramValue.scalarval) : NULL;
+		if (opt->paramValue.scalarval && c->hash_index_engine == NULL)
+			return CNF_NOMEMORY;
+	}
+	else if ( cmpNameAtoms( opt->name, _name__slab_defrag_threshold) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		double dbl = strtod(opt->paramValue.scalarval, NULL);
+		if ( (dbl == 0 || dbl == -HUGE_VAL || dbl == HUGE_VAL) && errno == ERANGE)
+			return CNF_WRONGRANGE;
+		c->slab_defrag_threshold = dbl;
+	}
+	else if ( cmpNameAtoms( opt->name, _name__slab_defrag_slice) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		c->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		long int i32 = strtol(opt->paramValue.scalarval, NULL, 10);
+		if (i32 == 0 && errno == EINVAL)
+			return CNF_WRONGINT;
+		if ( (i32 == LONG_MIN || i32 == LONG_MAX) && errno == ERANGE)
+			return CNF_WRONGRANGE;
+		c->slab_defrag_slice = i32;
+	}
 	else if ( cmpNameAtoms( opt->name, _name__space) ) {
 		if (opt->paramType != arrayType )
 			return CNF_WRONGTYPE;
@@ -956,6 +1202,24 @@ acceptValue(tarantool_cfg* c, OptDef* opt, int check_rdonly) {
 			return CNF_RDONLY;
 		c->space[opt->name->index]->estimated_rows = i32;
 	}
+	else if ( cmpNameAtoms( opt->name, _name__space__field_map) ) {
+		if (opt->paramType != scalarType )
+			return CNF_WRONGTYPE;
+		ARRAYALLOC(c->space, opt->name->index + 1, _name__space, check_rdonly, CNF_FLAG_STRUCT_NEW | CNF_FLAG_STRUCT_NOTSET);
+		if (c->space[opt->name->index]->__confetti_flags & CNF_FLAG_STRUCT_NEW)
+			check_rdonly = 0;
+		c->space[opt->name->index]->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		c->space[opt->name->index]->__confetti_flags &= ~CNF_FLAG_STRUCT_NOTSET;
+		errno = 0;
+		long int i32 = strtol(opt->paramValue.scalarval, NULL, 10);
+		if (i32 == 0 && errno == EINVAL)
+			return CNF_WRONGINT;
+		if ( (i32 == LONG_MIN || i32 == LONG_MAX) && errno == ERANGE)
+			return CNF_WRONGRANGE;
+		if (check_rdonly && c->space[opt->name->index]->field_map != i32)
+			return CNF_RDONLY;
+		c->space[opt->name->index]->field_map = i32;
+	}
 	else if ( cmpNameAtoms( opt->name, _name__space__index) ) {
 		if (opt->paramType != arrayType )
 			return CNF_WRONGTYPE;
@@ -1207,6 +1471,8 @@ typedef enum IteratorState {
 	S_name__slab_alloc_arena,
 	S_name__slab_alloc_minimal,
 	S_name__slab_alloc_factor,
+	S_name__slab_alloc_huge_pages,
+	S_name__slab_alloc_adaptive,
 	S_name__work_dir,
 	S_name__snap_dir,
 	S_name__wal_dir,
@@ -1217,8 +1483,12 @@ typedef enum IteratorState {
 	S_name__io_collect_interval,
 	S_name__backlog,
 	S_name__readahead,
+	S_name__iproto_net_threads,
 	S_name__snap_io_rate_limit,
+	S_name__snap_fork,
+	S_name__snap_segments,
 	S_name__rows_per_wal,
+	S_name__wal_prealloc_size,
 	S_name__wal_writer_inbox_size,
 	S_name__wal_mode,
 	S_name__wal_fsync_delay,
@@ -1235,10 +1505,16 @@ typedef enum IteratorState {
 	S_name__memcached_expire_per_loop,
 	S_name__memcached_expire_full_sweep,
 	S_name__replication_source,
+	S_name__tree_index_engine,
+	S_name__background_index_build,
+	S_name__hash_index_engine,
+	S_name__slab_defrag_threshold,
+	S_name__slab_defrag_slice,
 	S_name__space,
 	S_name__space__enabled,
 	S_name__space__cardinality,
 	S_name__space__estimated_rows,
+	S_name__space__field_map,
 	S_name__space__index,
 	S_name__space__index__type,
 	S_name__space__index__unique,
@@ -1378,6 +1654,28 @@ again:
 			}
 			sprintf(*v, "%g", c->slab_alloc_factor);
 			snprintf(buf, PRINTBUFLEN-1, "slab_alloc_factor");
+			i->state = S_name__slab_alloc_huge_pages;
+			return buf;
+		case S_name__slab_alloc_huge_pages:
+			*v = malloc(8);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%s", c->slab_alloc_huge_pages ? "true" : "false");
+			snprintf(buf, PRINTBUFLEN-1, "slab_alloc_huge_pages");
+			i->state = S_name__slab_alloc_adaptive;
+			return buf;
+		case S_name__slab_alloc_adaptive:
+			*v = malloc(8);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%s", c->slab_alloc_adaptive ? "true" : "false");
+			snprintf(buf, PRINTBUFLEN-1, "slab_alloc_adaptive");
 			i->state = S_name__work_dir;
 			return buf;
 		case S_name__work_dir:
@@ -1482,6 +1780,17 @@ again:
 			}
 			sprintf(*v, "%"PRId32, c->readahead);
 			snprintf(buf, PRINTBUFLEN-1, "readahead");
+			i->state = S_name__iproto_net_threads;
+			return buf;
+		case S_name__iproto_net_threads:
+			*v = malloc(32);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%"PRId32, c->iproto_net_threads);
+			snprintf(buf, PRINTBUFLEN-1, "iproto_net_threads");
 			i->state = S_name__snap_io_rate_limit;
 			return buf;
 		case S_name__snap_io_rate_limit:
@@ -1493,6 +1802,28 @@ again:
 			}
 			sprintf(*v, "%g", c->snap_io_rate_limit);
 			snprintf(buf, PRINTBUFLEN-1, "snap_io_rate_limit");
+			i->state = S_name__snap_fork;
+			return buf;
+		case S_name__snap_fork:
+			*v = malloc(8);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%s", c->snap_fork ? "true" : "false");
+			snprintf(buf, PRINTBUFLEN-1, "snap_fork");
+			i->state = S_name__snap_segments;
+			return buf;
+		case S_name__snap_segments:
+			*v = malloc(32);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%"PRId32, c->snap_segments);
+			snprintf(buf, PRINTBUFLEN-1, "snap_segments");
 			i->state = S_name__rows_per_wal;
 			return buf;
 		case S_name__rows_per_wal:
@@ -1504,6 +1835,17 @@ again:
 			}
 			sprintf(*v, "%"PRId32, c->rows_per_wal);
 			snprintf(buf, PRINTBUFLEN-1, "rows_per_wal");
+			i->state = S_name__wal_prealloc_size;
+			return buf;
+		case S_name__wal_prealloc_size:
+			*v = malloc(32);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%"PRId32, c->wal_prealloc_size);
+			snprintf(buf, PRINTBUFLEN-1, "wal_prealloc_size");
 			i->state = S_name__wal_writer_inbox_size;
 			return buf;
 		case S_name__wal_writer_inbox_size:
@@ -1677,6 +2019,59 @@ again:
 				return NULL;
 			}
 			snprintf(buf, PRINTBUFLEN-1, "replication_source");
+			i->state = S_name__tree_index_engine;
+			return buf;
+		case S_name__tree_index_engine:
+			*v = (c->tree_index_engine) ? strdup(c->tree_index_engine) : NULL;
+			if (*v == NULL && c->tree_index_engine) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			snprintf(buf, PRINTBUFLEN-1, "tree_index_engine");
+			i->state = S_name__background_index_build;
+			return buf;
+		case S_name__background_index_build:
+			*v = malloc(8);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%s", c->background_index_build ? "true" : "false");
+			snprintf(buf, PRINTBUFLEN-1, "background_index_build");
+			i->state = S_name__hash_index_engine;
+			return buf;
+		case S_name__hash_index_engine:
+			*v = (c->hash_index_engine) ? strdup(c->hash_index_engine) : NULL;
+			if (*v == NULL && c->hash_index_engine) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			snprintf(buf, PRINTBUFLEN-1, "hash_index_engine");
+			i->state = S_name__slab_defrag_threshold;
+			return buf;
+		case S_name__slab_defrag_threshold:
+			*v = malloc(32);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%g", c->slab_defrag_threshold);
+			snprintf(buf, PRINTBUFLEN-1, "slab_defrag_threshold");
+			i->state = S_name__slab_defrag_slice;
+			return buf;
+		case S_name__slab_defrag_slice:
+			*v = malloc(32);
+			if (*v == NULL) {
+				free(i);
+				out_warning(CNF_NOMEMORY, "No memory to output value");
+				return NULL;
+			}
+			sprintf(*v, "%"PRId32, c->slab_defrag_slice);
+			snprintf(buf, PRINTBUFLEN-1, "slab_defrag_slice");
 			i->state = S_name__space;
 			return buf;
 		case S_name__space:
@@ -1684,6 +2079,7 @@ again:
 		case S_name__space__enabled:
 		case S_name__space__cardinality:
 		case S_name__space__estimated_rows:
+		case S_name__space__field_map:
 		case S_name__space__index:
 		case S_name__space__index__type:
 		case S_name__space__index__unique:
@@ -1724,6 +2120,17 @@ again:
 						}
 						sprintf(*v, "%"PRId32, c->space[i->idx_name__space]->estimated_rows);
 						snprintf(buf, PRINTBUFLEN-1, "space[%d].estimated_rows", i->idx_name__space);
+						i->state = S_name__space__field_map;
+						return buf;
+					case S_name__space__field_map:
+						*v = malloc(32);
+						if (*v == NULL) {
+							free(i);
+							out_warning(CNF_NOMEMORY, "No memory to output value");
+							return NULL;
+						}
+						sprintf(*v, "%"PRId32, c->space[i->idx_name__space]->field_map);
+						snprintf(buf, PRINTBUFLEN-1, "space[%d].field_map", i->idx_name__space);
 						i->state = S_name__space__index;
 						return buf;
 					case S_name__space__index:
@@ -1969,6 +2376,8 @@ dup_tarantool_cfg(tarantool_cfg* dst, tarantool_cfg* src) {
 	dst->slab_alloc_arena = src->slab_alloc_arena;
 	dst->slab_alloc_minimal = src->slab_alloc_minimal;
 	dst->slab_alloc_factor = src->slab_alloc_factor;
+	dst->slab_alloc_huge_pages = src->slab_alloc_huge_pages;
+	dst->slab_alloc_adaptive = src->slab_alloc_adaptive;
 	if (dst->work_dir) free(dst->work_dir);dst->work_dir = src->work_dir == NULL ? NULL : strdup(src->work_dir);
 	if (src->work_dir != NULL && dst->work_dir == NULL)
 		return CNF_NOMEMORY;
@@ -1991,8 +2400,12 @@ dup_tarantool_cfg(tarantool_cfg* dst, tarantool_cfg* src) {
 	dst->io_collect_interval = src->io_collect_interval;
 	dst->backlog = src->backlog;
 	dst->readahead = src->readahead;
+	dst->iproto_net_threads = src->iproto_net_threads;
 	dst->snap_io_rate_limit = src->snap_io_rate_limit;
+	dst->snap_fork = src->snap_fork;
+	dst->snap_segments = src->snap_segments;
 	dst->rows_per_wal = src->rows_per_wal;
+	dst->wal_prealloc_size = src->wal_prealloc_size;
 	dst->wal_writer_inbox_size = src->wal_writer_inbox_size;
 	if (dst->wal_mode) free(dst->wal_mode);dst->wal_mode = src->wal_mode == NULL ? NULL : strdup(src->wal_mode);
 	if (src->wal_mode != NULL && dst->wal_mode == NULL)
@@ -2015,6 +2428,15 @@ dup_tarantool_cfg(tarantool_cfg* dst, tarantool_cfg* src) {
 	if (dst->replication_source) free(dst->replication_source);dst->replication_source = src->replication_source == NULL ? NULL : strdup(src->replication_source);
 	if (src->replication_source != NULL && dst->replication_source == NULL)
 		return CNF_NOMEMORY;
+	if (dst->tree_index_engine) free(dst->tree_index_engine);dst->tree_index_engine = src->tree_index_engine == NULL ? NULL : strdup(src->tree_index_engine);
+	if (src->tree_index_engine != NULL && dst->tree_index_engine == NULL)
+		return CNF_NOMEMORY;
+	dst->background_index_build = src->background_index_build;
+	if (dst->hash_index_engine) free(dst->hash_index_engine);dst->hash_index_engine = src->hash_index_engine == NULL ? NULL : strdup(src->hash_index_engine);
+	if (src->hash_index_engine != NULL && dst->hash_index_engine == NULL)
+		return CNF_NOMEMORY;
+	dst->slab_defrag_threshold = src->slab_defrag_threshold;
+	dst->slab_defrag_slice = src->slab_defrag_slice;
 
 	dst->space = NULL;
 	if (src->space != NULL) {
@@ -2028,6 +2450,7 @@ dup_tarantool_cfg(tarantool_cfg* dst, tarantool_cfg* src) {
 			dst->space[i->idx_name__space]->enabled = src->space[i->idx_name__space]->enabled;
 			dst->space[i->idx_name__space]->cardinality = src->space[i->idx_name__space]->cardinality;
 			dst->space[i->idx_name__space]->estimated_rows = src->space[i->idx_name__space]->estimated_rows;
+			dst->space[i->idx_name__space]->field_map = src->space[i->idx_name__space]->field_map;
 
 			dst->space[i->idx_name__space]->index = NULL;
 			if (src->space[i->idx_name__space]->index != NULL) {
@@ -2100,6 +2523,10 @@ destroy_tarantool_cfg(tarantool_cfg* c) {
 		free(c->custom_proc_title);
 	if (c->replication_source != NULL)
 		free(c->replication_source);
+	if (c->tree_index_engine != NULL)
+		free(c->tree_index_engine);
+	if (c->hash_index_engine != NULL)
+		free(c->hash_index_engine);
 
 	if (c->space != NULL) {
 		i->idx_name__space = 0;
@@ -2213,6 +2640,16 @@ cmp_tarantool_cfg(tarantool_cfg* c1, tarantool_cfg* c2, int only_check_rdonly) {
 
 		return diff;
 	}
+	if (c1->slab_alloc_huge_pages != c2->slab_alloc_huge_pages) {
+		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->slab_alloc_huge_pages");
+
+		return diff;
+	}
+	if (c1->slab_alloc_adaptive != c2->slab_alloc_adaptive) {
+		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->slab_alloc_adaptive");
+
+		return diff;
+	}
 	if (confetti_strcmp(c1->work_dir, c2->work_dir) != 0) {
 		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->work_dir");
 
@@ -2267,6 +2704,11 @@ cmp_tarantool_cfg(tarantool_cfg* c1, tarantool_cfg* c2, int only_check_rdonly) {
 			return diff;
 		}
 	}
+	if (c1->iproto_net_threads != c2->iproto_net_threads) {
+		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->iproto_net_threads");
+
+		return diff;
+	}
 	if (!only_check_rdonly) {
 		if (c1->snap_io_rate_limit != c2->snap_io_rate_limit) {
 			snprintf(diff, PRINTBUFLEN - 1, "%s", "c->snap_io_rate_limit");
@@ -2274,11 +2716,30 @@ cmp_tarantool_cfg(tarantool_cfg* c1, tarantool_cfg* c2, int only_check_rdonly) {
 			return diff;
 		}
 	}
+	if (!only_check_rdonly) {
+		if (c1->snap_fork != c2->snap_fork) {
+			snprintf(diff, PRINTBUFLEN - 1, "%s", "c->snap_fork");
+
+			return diff;
+		}
+	}
+	if (!only_check_rdonly) {
+		if (c1->snap_segments != c2->snap_segments) {
+			snprintf(diff, PRINTBUFLEN - 1, "%s", "c->snap_segments");
+
+			return diff;
+		}
+	}
 	if (c1->rows_per_wal != c2->rows_per_wal) {
 		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->rows_per_wal");
 
 		return diff;
 	}
+	if (c1->wal_prealloc_size != c2->wal_prealloc_size) {
+		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->wal_prealloc_size");
+
+		return diff;
+	}
 	if (c1->wal_writer_inbox_size != c2->wal_writer_inbox_size) {
 		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->wal_writer_inbox_size");
 
@@ -2371,6 +2832,35 @@ cmp_tarantool_cfg(tarantool_cfg* c1, tarantool_cfg* c2, int only_check_rdonly) {
 			return diff;
 }
 	}
+	if (confetti_strcmp(c1->tree_index_engine, c2->tree_index_engine) != 0) {
+		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->tree_index_engine");
+
+		return diff;
+}
+	if (c1->background_index_build != c2->background_index_build) {
+		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->background_index_build");
+
+		return diff;
+	}
+	if (confetti_strcmp(c1->hash_index_engine, c2->hash_index_engine) != 0) {
+		snprintf(diff, PRINTBUFLEN - 1, "%s", "c->hash_index_engine");
+
+		return diff;
+}
+	if (!only_check_rdonly) {
+		if (c1->slab_defrag_threshold != c2->slab_defrag_threshold) {
+			snprintf(diff, PRINTBUFLEN - 1, "%s", "c->slab_defrag_threshold");
+
+			return diff;
+		}
+	}
+	if (!only_check_rdonly) {
+		if (c1->slab_defrag_slice != c2->slab_defrag_slice) {
+			snprintf(diff, PRINTBUFLEN - 1, "%s", "c->slab_defrag_slice");
+
+			return diff;
+		}
+	}
 
 	i1->idx_name__space = 0;
 	i2->idx_name__space = 0;
@@ -2390,6 +2880,11 @@ cmp_tarantool_cfg(tarantool_cfg* c1, tarantool_cfg* c2, int only_check_rdonly) {
 
 			return diff;
 		}
+		if (c1->space[i1->idx_name__space]->field_map != c2->space[i2->idx_name__space]->field_map) {
+			snprintf(diff, PRINTBUFLEN - 1, "%s", "c->space[]->field_map");
+
+			return diff;
+		}
 
 		i1->idx_name__space__index = 0;
 		i2->idx_name__space__index = 0;
@@ -34,6 +34,7 @@ typedef struct tarantool_cfg_space {
 	confetti_bool_t	enabled;
 	int32_t	cardinality;
 	int32_t	estimated_rows;
+	int32_t	field_map;
 	tarantool_cfg_space_index**	index;
 } tarantool_cfg_space;
 
@@ -85,6 +86,19 @@ typedef struct tarantool_cfg {
 	/* Growth factor, each subsequent unit size is factor * prev unit size */
 	double	slab_alloc_factor;
 
+	/*
+	 * Back the slab arena with huge pages: explicit huge pages
+	 * (MAP_HUGETLB) if enough of them are reserved in the system,
+	 * transparent huge pages otherwise.
+	 */
+	confetti_bool_t	slab_alloc_huge_pages;
+
+	/*
+	 * Add size classes for the tuple sizes which are common in the
+	 * snapshot but fit the classes above poorly, after loading it.
+	 */
+	confetti_bool_t	slab_alloc_adaptive;
+
 	/* working directory (daemon will chdir(2) to it) */
 	char*	work_dir;
 
@@ -120,12 +134,43 @@ typedef struct tarantool_cfg {
 	/* network io readahead */
 	int32_t	readahead;
 
+	/*
+	 * The number of threads which serve client sockets of the
+	 * primary and secondary ports (Linux only). 0 means the
+	 * sockets are served by the request processing thread.
+	 */
+	int32_t	iproto_net_threads;
+
 	/* Do not write into snapshot faster than snap_io_rate_limit MB/sec */
 	double	snap_io_rate_limit;
 
+	/*
+	 * Save snapshots in a forked child process. If false, save them
+	 * from a read view of the data, in a separate thread of the server
+	 * process, while the changes go on. Making the read view stalls the
+	 * requests for a walk over all primary keys, and takes 8 bytes of
+	 * memory per tuple; the log tells how long the stall is.
+	 */
+	confetti_bool_t	snap_fork;
+
+	/*
+	 * Write snapshots as this many segment files, by as many threads,
+	 * tied together by the <lsn>.snap manifest, and read them in
+	 * parallel on recovery. 1 means a single snapshot file.
+	 */
+	int32_t	snap_segments;
+
 	/* Write no more rows in WAL */
 	int32_t	rows_per_wal;
 
+	/*
+	 * Preallocate WAL files to this size, in bytes, so that writes
+	 * don't extend the files and syncs don't flush file metadata.
+	 * The next WAL file is zero-filled in advance while the WAL
+	 * writer is idle. 0 disables preallocation.
+	 */
+	int32_t	wal_prealloc_size;
+
 	/*
 	 * OBSOLETE
 	 * Starting from 1.4.5, this variable has no effect.
@@ -139,12 +184,17 @@ typedef struct tarantool_cfg {
 	 * "fsync":          fibers wait for their data, fsync(2) follows each write(2)
 	 * "fsync_delay":    fibers wait for their data, fsync every N=wal_fsync_delay seconds,
 	 * N=0.0 means no fsync (equivalent to wal_mode = "write");
+	 * "fsync_group":    fibers wait for their data, fsync(2) follows each
+	 * group of writes; the group grows under load, adding
+	 * up to N=wal_fsync_delay seconds to a commit
 	 */
 	char*	wal_mode;
 
 	/*
 	 * Fsync WAL delay, only issue fsync if last fsync was wal_fsync_delay
 	 * seconds ago.
+	 * In "fsync_group" mode, the most a write may wait for others to join
+	 * its fsync; N=0.0 means fsync(2) after each write, as in "fsync" mode.
 	 * WARNING: actually, several last requests may stall fsync for much longer
 	 */
 	double	wal_fsync_delay;
@@ -204,6 +254,40 @@ typedef struct tarantool_cfg {
 	 * only accepts reads.
 	 */
 	char*	replication_source;
+
+	/*
+	 * Implementation of TREE indexes: "sptree" (a binary AVL
+	 * tree) or "bptree" (a cache-conscious B+tree).
+	 */
+	char*	tree_index_engine;
+
+	/*
+	 * Build secondary indexes in the background after start:
+	 * the server serves primary key requests while the build is
+	 * in progress, but rejects requests to secondary indexes and
+	 * changes of spaces which have them.
+	 */
+	confetti_bool_t	background_index_build;
+
+	/*
+	 * Implementation of HASH indexes: "mhash" (open addressing
+	 * with double hashing) or "shash" (a Swiss table probing
+	 * groups of 16 slots at once). Multipart keys always use mhash.
+	 */
+	char*	hash_index_engine;
+
+	/*
+	 * Move tuples out of slabs used less than this fraction of
+	 * their capacity, so that the emptied slabs can be reused by
+	 * other size classes. 0 disables slab defragmentation.
+	 */
+	double	slab_defrag_threshold;
+
+	/*
+	 * The max number of tuples the slab defragmenter moves before
+	 * yielding to other requests.
+	 */
+	int32_t	slab_defrag_slice;
 	tarantool_cfg_space**	space;
 } tarantool_cfg;
 
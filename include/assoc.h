@@ -83,23 +83,58 @@ static inline int lstrcmp(const void *a, const void *b)
 	return memcmp(a, b, al);
 }
 #include <third_party/PMurHash.h>
+static inline u32
+lstrhash(const void *key)
+{
+	const u32 l = load_varint32(&key);
+	return PMurHash32(13, key, l);
+}
+
+/*
+ * The hash of the key is cached in the node: keys usually point
+ * into tuples, and so are not touched on resize and on probes
+ * of nodes with a different hash. Use lstrhash() to set it.
+ */
 #define mh_name _lstrptr
 struct mh_lstrptr_node_t {
 	const void *key;
 	void *val;
+	u32 hash;
 };
 
 #define mh_node_t struct mh_lstrptr_node_t
 #define mh_int_t u32
 #define mh_hash_arg_t void *
-static inline u32
-mh_strptr_hash(const mh_node_t *a, mh_hash_arg_t arg) {
-	(void) arg;
-	const void *_k = (a->key);
-	const u32 l = load_varint32(&_k);
-	return PMurHash32(13, _k, l);
-}
-#define mh_hash(a, arg) mh_strptr_hash(a, arg)
+#define mh_hash(a, arg) ((a)->hash)
 #define mh_eq_arg_t void *
-#define mh_eq(a, b, arg) (lstrcmp(a->key, b->key) == 0)
+#define mh_eq(a, b, arg) ((a)->hash == (b)->hash && \
+			  lstrcmp(a->key, b->key) == 0)
 #include <mhash.h>
+
+/*
+ * Swiss table versions of the maps above, see shash.h.
+ */
+#define sh_name _i32ptr
+#define sh_node_t struct mh_i32ptr_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((a)->key)
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->key == (b)->key)
+#include <shash.h>
+
+#define sh_name _i64ptr
+#define sh_node_t struct mh_i64ptr_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((u32)((a)->key >> 32 ^ (a)->key))
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->key == (b)->key)
+#include <shash.h>
+
+#define sh_name _lstrptr
+#define sh_node_t struct mh_lstrptr_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((a)->hash)
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->hash == (b)->hash && \
+			  lstrcmp((a)->key, (b)->key) == 0)
+#include <shash.h>
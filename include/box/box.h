@@ -81,6 +81,25 @@ int box_cat(const char *filename);
  * snapshot file.
  */
 void box_snapshot(struct log_io *, struct fio_batch *batch);
+/**
+ * Make a read view of all spaces: remember the tuples of
+ * every primary key, and keep the tuples freed from now on
+ * in memory until box_read_view_close(). Doesn't yield: the
+ * requests wait while all primary keys are walked, logs how
+ * long it took.
+ *
+ * @return 0 on success, -1 on error, with errno set.
+ */
+int box_read_view_open(void);
+/**
+ * Save a segment of the read view to the snapshot file, or
+ * all of it if segments == 1. Safe to call from threads other
+ * than the one processing requests.
+ */
+void box_read_view_snapshot(struct log_io *l, struct fio_batch *batch,
+			    int segment, int segments);
+/** Release the read view. */
+void box_read_view_close(void);
 /**
  * Spit out some basic module status (master/slave, etc.
  */
@@ -57,6 +57,15 @@
  * Defined if fdatasync(2) call is present.
  */
 #cmakedefine HAVE_FDATASYNC 1
+/*
+ * Defined if posix_fallocate(3) call is present.
+ */
+#cmakedefine HAVE_POSIX_FALLOCATE 1
+/*
+ * Defined if Linux io_uring(7) interface is known to the
+ * system headers.
+ */
+#cmakedefine HAVE_IO_URING 1
 /*
  * Defined if this platform has GNU specific memmem().
  */
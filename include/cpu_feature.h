@@ -39,6 +39,19 @@
  */
 bool sse42_enabled_cpu();
 
+/* Check whether CPU supports POPCNT (used to count bits in bitset pages).
+ *
+ * @return	true if feature is available, false if unavailable.
+ */
+bool popcnt_enabled_cpu();
+
+/* Check whether CPU supports AVX2 and OS saves YMM registers on
+ * context switch (used for bitset page operations).
+ *
+ * @return	true if feature is available, false if unavailable.
+ */
+bool avx2_enabled_cpu();
+
 
 /* Hardware-calculate CRC32 for the given data buffer.
  *
@@ -43,6 +43,9 @@ struct errinj {
 	_(ERRINJ_TESTING, false) \
 	_(ERRINJ_WAL_IO, false) \
 	_(ERRINJ_WAL_ROTATE, false) \
+	_(ERRINJ_WAL_DELAY, false) \
+	_(ERRINJ_WAL_RING_SUBMIT, false) \
+	_(ERRINJ_WAL_WRITE_PARTIAL, false) \
 	_(ERRINJ_INDEX_ALLOC, false)
 
 ENUM0(errinj_enum, ERRINJ_LIST);
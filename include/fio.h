@@ -188,5 +188,57 @@ fio_batch_add(struct fio_batch *batch, void *row, ssize_t row_len);
 int
 fio_batch_write(struct fio_batch *batch, int fd);
 
+/**
+ * An io_uring(7) instance to write batches asynchronously:
+ * a batch write, optionally followed by a linked fdatasync(),
+ * is submitted in one system call, and the caller is free
+ * to prepare the next batch while the kernel does the I/O.
+ * There is at most one batch in flight.
+ */
+struct fio_ring;
+
+/**
+ * Create a ring with room for the given number of requests.
+ *
+ * @return  NULL if io_uring is not supported by the system,
+ *          with errno set.
+ */
+struct fio_ring *
+fio_ring_new(unsigned entries);
+
+void
+fio_ring_delete(struct fio_ring *ring);
+
+/**
+ * Release the ring in a child process after fork(): unlike
+ * fio_ring_delete(), a batch may be in flight in the parent.
+ */
+void
+fio_ring_atfork(struct fio_ring *ring);
+
+/**
+ * Submit a write of all rows stacked into the batch at the
+ * given file offset. The batch must not be touched until
+ * fio_ring_wait() returns.
+ *
+ * @param sync   follow the write with fdatasync(). If the kernel
+ *               takes the write alone, fio_ring_wait() syncs.
+ *
+ * @return 0 on success, -1 if nothing was submitted.
+ */
+int
+fio_ring_submit(struct fio_ring *ring, struct fio_batch *batch,
+		int fd, off_t offset, bool sync);
+
+/**
+ * Wait for the batch submitted with fio_ring_submit().
+ * Positions the file at the end of the last fully written
+ * row, cutting off any partially written row.
+ *
+ * @return   The number of rows written.
+ */
+int
+fio_ring_wait(struct fio_ring *ring);
+
 #endif /* TARANTOOL_FIO_H_INCLUDED */
 
@@ -0,0 +1,96 @@
+#ifndef TARANTOOL_HISTOGRAM_H_INCLUDED
+#define TARANTOOL_HISTOGRAM_H_INCLUDED
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * A histogram of values, e.g. latencies in microseconds, with
+ * log-linear buckets: each power of two range is divided into
+ * HISTOGRAM_SUB equal buckets, so a percentile is estimated
+ * within 1/HISTOGRAM_SUB of the value. Collecting a value is a
+ * couple of arithmetic operations and an increment.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <lib/bit/bit.h>
+
+enum {
+	HISTOGRAM_SUB_BITS = 4,
+	HISTOGRAM_SUB = 1 << HISTOGRAM_SUB_BITS,
+	/** Values are counted up to 2^HISTOGRAM_VALUE_BITS - 1. */
+	HISTOGRAM_VALUE_BITS = 32,
+	HISTOGRAM_BUCKETS = (HISTOGRAM_VALUE_BITS - HISTOGRAM_SUB_BITS + 1) *
+		HISTOGRAM_SUB
+};
+
+struct histogram {
+	/** The number of values collected. */
+	uint64_t count;
+	/** The biggest value collected. */
+	uint64_t max;
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/** Forget all collected values. */
+void
+histogram_reset(struct histogram *hist);
+
+/** The bucket of a value. Bigger values go to the last one. */
+static inline int
+histogram_bucket(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB)
+		return value;
+	if (value >> HISTOGRAM_VALUE_BITS)
+		value = (1ULL << HISTOGRAM_VALUE_BITS) - 1;
+	int msb = 63 - bit_clz_u64(value);
+	int shift = msb - HISTOGRAM_SUB_BITS;
+	return (shift + 1) * HISTOGRAM_SUB +
+		((value >> shift) & (HISTOGRAM_SUB - 1));
+}
+
+static inline void
+histogram_collect(struct histogram *hist, uint64_t value)
+{
+	hist->buckets[histogram_bucket(value)]++;
+	hist->count++;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+/**
+ * The value not exceeded by the given fraction (0..1) of the
+ * collected values, e.g. 0.99 for the 99th percentile. The
+ * estimate is the upper bound of the bucket the percentile
+ * falls into, but never more than the max value. Returns 0 if
+ * nothing has been collected.
+ */
+uint64_t
+histogram_percentile(const struct histogram *hist, double fraction);
+
+#endif /* TARANTOOL_HISTOGRAM_H_INCLUDED */
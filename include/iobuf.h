@@ -93,7 +93,19 @@ ibuf_pos(struct ibuf *ibuf)
 
 /* {{{ Output buffer. */
 
-enum { IOBUF_IOV_MAX = 32 };
+enum {
+	IOBUF_IOV_MAX = 64,
+	/** Vectors obuf_ref() leaves for copied data. */
+	IOBUF_IOV_RESERVE = 8
+};
+
+/** Data an output buffer refers to, see obuf_ref(). */
+struct obuf_ref
+{
+	/** Called when the buffer no longer needs the data. */
+	void (*unref)(void *arg);
+	void *arg;
+};
 
 /**
  * An output buffer is an array of struct iovec vectors
@@ -103,6 +115,8 @@ enum { IOBUF_IOV_MAX = 32 };
  * the number of used buffers is unlikely to ever exceed the
  * hard limit of IOBUF_IOV_MAX. If it does, an exception is
  * raised.
+ * A vector may also point to data outside of the buffer,
+ * added with obuf_ref(). Such vectors have zero capacity.
  */
 struct obuf
 {
@@ -120,6 +134,8 @@ struct obuf
 	 * (iov_base = NULL, iov_len = 0).
 	 */
 	struct iovec iov[IOBUF_IOV_MAX];
+	/** Data referenced from the vectors of zero capacity. */
+	struct obuf_ref ref[IOBUF_IOV_MAX];
 };
 
 /** How many bytes are in the output buffer. */
@@ -169,6 +185,17 @@ obuf_book(struct obuf *obuf, size_t size);
 void
 obuf_dup(struct obuf *obuf, const void *data, size_t size);
 
+/**
+ * Append data to the output buffer without copying it. The
+ * data must stay intact until the buffer calls unref(arg),
+ * when it is reset or rolled back past the data.
+ * Returns false and does nothing if the buffer is short of
+ * vectors: the caller copies the data then.
+ */
+bool
+obuf_ref(struct obuf *obuf, const void *data, size_t size,
+	 void (*unref)(void *arg), void *arg);
+
 static inline struct obuf_svp
 obuf_create_svp(struct obuf *buf)
 {
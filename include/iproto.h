@@ -28,7 +28,11 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+/**
+ * Start iproto services. With net_threads > 0, client sockets
+ * are served by as many network threads (Linux only).
+ */
 void
 iproto_init(const char *bind_ipaddr, int primary_port,
-	    int secondary_port);
+	    int secondary_port, int net_threads);
 #endif
@@ -60,10 +60,20 @@
 #include <lib/bit/bit.h>
 
 /** @cond false */
+enum bitset_page_type {
+	/* data is a bitmap */
+	BITSET_PAGE_BITMAP = 0,
+	/* data is a sorted array of uint16_t bit offsets */
+	BITSET_PAGE_ARRAY = 1
+};
+
 struct bitset_page {
 	size_t first_pos;
 	rb_node(struct bitset_page) node;
-	size_t cardinality;
+	uint16_t cardinality;
+	/* array capacity in elements, 0 for bitmap pages */
+	uint16_t capacity;
+	uint32_t type;
 	uint8_t data[0];
 };
 
@@ -151,6 +161,12 @@ struct bitset_info {
 	size_t page_total_size;
 	/** A multiplier by which an address of page data is aligned **/
 	size_t page_data_alignment;
+	/** Number of sparse pages stored as sorted arrays */
+	size_t array_pages;
+	/** Memory used by all pages (in bytes) */
+	size_t mem_used;
+	/** Memory saved by array pages compared to bitmaps (in bytes) */
+	size_t mem_saved;
 };
 
 /**
@@ -161,6 +177,27 @@ struct bitset_info {
 void
 bitset_info(struct bitset *bitset, struct bitset_info *info);
 
+/**
+ * @brief CPU features for bitset_init_kernels()
+ */
+enum bitset_cpu_feature {
+	/** POPCNT instruction */
+	BITSET_CPU_POPCNT = 1 << 0,
+	/** AVX2 instructions and OS support for YMM registers */
+	BITSET_CPU_AVX2 = 1 << 1
+};
+
+/**
+ * @brief Select page operation kernels (AND, NAND, OR, popcount)
+ * for the host CPU. The library does not probe the CPU itself,
+ * the caller passes the features it has detected (see
+ * cpu_feature.h). Portable kernels are used until this function
+ * is called. Not thread-safe, call it once on startup.
+ * @param features a mask of \a bitset_cpu_feature flags
+ */
+void
+bitset_init_kernels(unsigned features);
+
 #if defined(DEBUG)
 void
 bitset_dump(struct bitset *bitset, int verbose, FILE *stream);
@@ -62,7 +62,6 @@ struct bitset_iterator {
 	size_t capacity;
 	struct bitset_iterator_conj *conjs;
 	struct bitset_page *page;
-	struct bitset_page *page_tmp;
 	void *(*realloc)(void *ptr, size_t size);
 	struct bit_iterator page_it;
 	/** @endcond **/
@@ -129,4 +128,16 @@ bitset_iterator_rewind(struct bitset_iterator *it);
 size_t
 bitset_iterator_next(struct bitset_iterator *it);
 
+/**
+ * @brief Count positions where the expression evaluates to true.
+ * The result pages are counted as a whole, which is much faster
+ * than calling bitset_iterator_next() for every position.
+ * The iterator is rewinded and is left exhausted.
+ * @param it bitset iterator
+ * @return the number of bits in the result set
+ * @see @link bitset_iterator_init @endlink
+ */
+size_t
+bitset_iterator_count(struct bitset_iterator *it);
+
 #endif /* TARANTOOL_LIB_BITSET_ITERATOR_H_INCLUDED */
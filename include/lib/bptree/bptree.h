@@ -0,0 +1,301 @@
+#ifndef TARANTOOL_LIB_BPTREE_BPTREE_H_INCLUDED
+#define TARANTOOL_LIB_BPTREE_BPTREE_H_INCLUDED
+
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief B+tree of fixed-size opaque elements
+ *
+ * The tree keeps elements of a size given at construction time
+ * ordered by user-supplied comparators. Elements are stored
+ * inline in wide leaf nodes which are linked into a list, so
+ * that both point lookups and range scans touch only a handful
+ * of cache lines. Every node occupies @link BPTREE_NODE_SIZE
+ * @endlink bytes (or more, if an element is too big to fit at
+ * least 4 of them into a node) and is aligned on a cache line.
+ *
+ * An inner node keeps, for each child, a copy of the maximal
+ * element of the child subtree. These copies are kept exact: an
+ * element which is deleted from the tree never stays around as a
+ * separator, so a comparator is never invoked on stale data.
+ *
+ * An inner node also keeps the number of elements in each child
+ * subtree, which makes it an order statistic tree: the rank of
+ * a key, the number of elements equal to a key and skipping
+ * over a given number of elements all take logarithmic time.
+ *
+ * The interface deliberately mirrors the one of sptree.h so
+ * that the two can be used interchangeably.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Default size of a tree node, in bytes. */
+#ifndef BPTREE_NODE_SIZE
+#define BPTREE_NODE_SIZE 512
+#endif
+
+/** Alignment of tree nodes, in bytes. */
+#define BPTREE_NODE_ALIGN 64
+
+/** Maximal tree depth. 2^32 elements fit into ~16 levels. */
+#define BPTREE_MAX_DEPTH 32
+
+/**
+ * Element comparator. The first argument is either a search key
+ * or an element, the second one is always an element of the tree.
+ */
+typedef int (*bptree_cmp_t)(const void *a, const void *b, void *arg);
+
+/** @cond false */
+struct bptree_node;
+struct bptree_leaf;
+/** @endcond */
+
+/**
+ * B+tree
+ */
+struct bptree {
+	/** @cond false */
+	struct bptree_node *root;
+	struct bptree_leaf *first;
+	struct bptree_leaf *last;
+	bptree_cmp_t key_cmp;
+	bptree_cmp_t elem_cmp;
+	void *arg;
+	size_t elem_size;
+	size_t node_size;
+	size_t size;
+	size_t leaf_count;
+	size_t inner_count;
+	uint32_t leaf_capacity;
+	uint32_t inner_capacity;
+	uint32_t depth;
+	/** Bumped on every modification, see bptree_iterator. */
+	uint32_t version;
+	/** @endcond */
+};
+
+/**
+ * @brief Construct an empty \a tree
+ * @param tree tree
+ * @param elem_size size of a tree element, in bytes
+ * @param key_cmp key to element comparator, used by lookups
+ * and iterators
+ * @param elem_cmp element to element comparator, must define
+ * a total order on the elements stored in the tree
+ * @param arg an extra argument passed to comparators
+ */
+void
+bptree_create(struct bptree *tree, size_t elem_size,
+	      bptree_cmp_t key_cmp, bptree_cmp_t elem_cmp, void *arg);
+
+/**
+ * @brief Destruct \a tree, freeing all nodes
+ * @param tree tree
+ */
+void
+bptree_destroy(struct bptree *tree);
+
+/**
+ * @brief Bulk load an empty \a tree from an array of elements
+ *
+ * The array is sorted in place with elem_cmp and then copied
+ * into the tree, the caller retains ownership of it. This is
+ * much faster than inserting the elements one by one.
+ * @param tree an empty tree
+ * @param array array of elements
+ * @param count number of elements in the array
+ * @retval 0 on success
+ * @retval -1 on memory error, the tree stays empty
+ */
+int
+bptree_build(struct bptree *tree, void *array, size_t count);
+
+/**
+ * @brief Return the number of elements in \a tree
+ */
+inline size_t
+bptree_size(const struct bptree *tree)
+{
+	return tree->size;
+}
+
+/**
+ * @brief Find the first element equal to \a key
+ * @return a pointer to the element or NULL if not found.
+ * The pointer is valid until the next modification of the tree.
+ */
+void *
+bptree_find(struct bptree *tree, const void *key);
+
+/**
+ * @brief Return the number of elements less than \a key
+ */
+size_t
+bptree_rank(struct bptree *tree, const void *key);
+
+/**
+ * @brief Return the number of elements less than \a elem
+ * by elem_cmp: the position of \a elem in the tree
+ */
+size_t
+bptree_rank_elem(struct bptree *tree, const void *elem);
+
+/**
+ * @brief Return the number of elements equal to \a key
+ */
+size_t
+bptree_count(struct bptree *tree, const void *key);
+
+/**
+ * @brief Return the minimal element or NULL if \a tree is empty
+ */
+void *
+bptree_first(struct bptree *tree);
+
+/**
+ * @brief Return the maximal element or NULL if \a tree is empty
+ */
+void *
+bptree_last(struct bptree *tree);
+
+/**
+ * @brief Insert \a elem into \a tree, replacing an element which
+ * is equal to it according to elem_cmp, if any.
+ * @param tree tree
+ * @param elem element to insert
+ * @param p_old if not NULL, *p_old must point to a buffer of
+ * elem_size bytes. The replaced element is copied into it, or
+ * *p_old is set to NULL if nothing was replaced.
+ * @retval 0 on success
+ * @retval -1 on memory error, the tree is left intact
+ */
+int
+bptree_replace(struct bptree *tree, const void *elem, void **p_old);
+
+/**
+ * @brief Delete an element equal to \a elem (by elem_cmp)
+ * @retval true if the element has been found and deleted
+ * @retval false if there is no such element
+ */
+bool
+bptree_delete(struct bptree *tree, const void *elem);
+
+/**
+ * @brief Memory used by \a tree nodes, in bytes
+ */
+size_t
+bptree_mem_used(const struct bptree *tree);
+
+/**
+ * B+tree iterator
+ *
+ * An iterator remembers the last element it has returned and
+ * the version of the tree. If the tree is modified in between
+ * two calls to next(), the iterator finds its position again by
+ * the remembered element, so it's safe to modify the tree while
+ * iterating over it. The caller must make sure that the last
+ * returned element stays comparable (for example, that the data
+ * it refers to is not freed), as well as the search key passed
+ * to the init function until the first call to next().
+ */
+struct bptree_iterator {
+	/** @cond false */
+	struct bptree *tree;
+	struct bptree_leaf *leaf;
+	uint32_t pos;
+	uint32_t version;
+	const void *key;
+	bool has_last;
+	bool reverse;
+	/** A copy of the last returned element. */
+	char last[0] __attribute__((aligned(sizeof(void *))));
+	/** @endcond */
+};
+
+/**
+ * @brief Allocate an iterator for \a tree
+ * @return a new iterator or NULL on memory error
+ */
+struct bptree_iterator *
+bptree_iterator_new(struct bptree *tree);
+
+/**
+ * @brief Free an iterator allocated with bptree_iterator_new()
+ */
+void
+bptree_iterator_delete(struct bptree_iterator *it);
+
+/**
+ * @brief Position \a it at the first element which is greater
+ * than or equal to \a key. Use bptree_iterator_next() with it.
+ */
+void
+bptree_iterator_init_set(struct bptree_iterator *it, const void *key);
+
+/**
+ * @brief Position \a it at the last element which is less than
+ * or equal to \a key. Use bptree_iterator_reverse_next() with it.
+ */
+void
+bptree_iterator_reverse_init_set(struct bptree_iterator *it,
+				 const void *key);
+
+/**
+ * @brief Return the next element in ascending order or NULL
+ * when the iteration is over.
+ */
+void *
+bptree_iterator_next(struct bptree_iterator *it);
+
+/**
+ * @brief Return the next element in descending order or NULL
+ * when the iteration is over.
+ */
+void *
+bptree_iterator_reverse_next(struct bptree_iterator *it);
+
+/**
+ * @brief Skip up to *count elements in the direction of \a it
+ * in logarithmic time.
+ * @param it iterator
+ * @param[in,out] count the number of elements to skip, set to
+ * the number of elements actually skipped
+ * @return the last skipped element, as it would have been
+ * returned by next(), or NULL if nothing has been skipped
+ */
+void *
+bptree_iterator_skip(struct bptree_iterator *it, size_t *count);
+
+#endif /* TARANTOOL_LIB_BPTREE_BPTREE_H_INCLUDED */
@@ -46,6 +46,9 @@ enum log_mode {
 
 enum log_suffix { NONE, INPROGRESS };
 
+/** The max number of segment files of a snapshot. */
+enum { LOG_SEGMENTS_MAX = 64 };
+
 struct log_dir {
 	bool panic_if_error;
 
@@ -54,6 +57,20 @@ struct log_dir {
 	const char *filetype;
 	const char *filename_ext;
 	char *dirname;
+	/**
+	 * Preallocate the files written to this size, 0 - don't.
+	 * A preallocated file ends with zeros until it's closed.
+	 */
+	size_t prealloc_size;
+	/**
+	 * A file zero-filled in advance to become the next file
+	 * written, see log_dir_prealloc(). -1 if there is none.
+	 */
+	int spare_fd;
+	/** How much of the spare file is zero-filled and synced. */
+	size_t spare_size;
+	/** How much of the spare file is written. */
+	size_t spare_written;
 };
 
 extern struct log_dir snap_dir;
@@ -63,8 +80,19 @@ i64
 greatest_lsn(struct log_dir *dir);
 char *
 format_filename(struct log_dir *dir, i64 lsn, enum log_suffix suffix);
+char *
+format_segment_filename(struct log_dir *dir, i64 lsn, int segment,
+			enum log_suffix suffix);
 i64
 find_including_file(struct log_dir *dir, i64 target_lsn);
+/**
+ * Zero-fill or sync the next chunk of the spare file, which
+ * becomes the next file written, so that writes to it overwrite
+ * allocated blocks and don't change the file size. Call when
+ * idle, while dir->spare_size < dir->prealloc_size.
+ */
+void
+log_dir_prealloc(struct log_dir *dir);
 
 struct log_io {
 	struct log_dir *dir;
@@ -76,12 +104,27 @@ struct log_io {
 	char filename[PATH_MAX + 1];
 
 	bool is_inprogress;
+	/**
+	 * A snapshot can be written as several segment files,
+	 * <lsn>.snap.0 and so on, tied together by <lsn>.snap,
+	 * the manifest. The manifest has no rows, and the number
+	 * of segments in its header. 0 in other files.
+	 */
+	int segments;
 };
 
 struct log_io *
 log_io_open_for_read(struct log_dir *dir, i64 lsn, enum log_suffix suffix);
 struct log_io *
 log_io_open_for_write(struct log_dir *dir, i64 lsn, enum log_suffix suffix);
+/** Open <lsn>.snap.inprogress, the manifest of a segmented snapshot. */
+struct log_io *
+log_io_open_manifest_for_write(struct log_dir *dir, i64 lsn, int segments);
+struct log_io *
+log_io_open_segment_for_read(struct log_dir *dir, i64 lsn, int segment);
+/** Open <lsn>.snap.<segment>.inprogress. */
+struct log_io *
+log_io_open_segment_for_write(struct log_dir *dir, i64 lsn, int segment);
 struct log_io *
 log_io_open(struct log_dir *dir, enum log_mode mode,
 	    const char *filename, enum log_suffix suffix, FILE *file);
@@ -107,6 +150,21 @@ log_io_cursor_close(struct log_io_cursor *i);
 struct tbuf *
 log_io_cursor_next(struct log_io_cursor *i);
 
+/** Give size bytes for a row read, NULL if there is no memory. */
+typedef void *(*log_io_row_alloc_f)(void *ctx, size_t size);
+/**
+ * log_io_cursor_next() which reads the row into the memory
+ * given by alloc(), rather than into the fiber pool, so that
+ * it can be called in a thread other than the main one.
+ *
+ * @return the row, the header and the body, as in a tbuf
+ * returned by log_io_cursor_next(). NULL if there are no more
+ * rows, or if alloc() failed.
+ */
+void *
+log_io_cursor_read(struct log_io_cursor *i, log_io_row_alloc_f alloc,
+		   void *ctx);
+
 typedef u32 log_magic_t;
 
 struct header_v11 {
@@ -71,7 +71,8 @@ struct remote {
 	ev_tstamp recovery_lag, recovery_last_update_tstamp;
 };
 
-enum wal_mode { WAL_NONE = 0, WAL_WRITE, WAL_FSYNC, WAL_FSYNC_DELAY, WAL_MODE_MAX };
+enum wal_mode { WAL_NONE = 0, WAL_WRITE, WAL_FSYNC, WAL_FSYNC_DELAY,
+		WAL_FSYNC_GROUP, WAL_MODE_MAX };
 
 /** String constants for the supported modes. */
 extern const char *wal_mode_STRS[];
@@ -106,6 +107,19 @@ struct recovery_state {
 
 extern struct recovery_state *recovery_state;
 
+/** WAL writer statistics, see recovery_wal_stat(). */
+struct wal_stat {
+	/** Number of times the writer committed a batch of rows. */
+	i64 batches;
+	/** Moving average of rows committed at once. */
+	double batch_size;
+	/** Number of fsyncs of a group of writes (fsync_group). */
+	i64 syncs;
+	/** Moving average and maximum of fsync time, seconds. */
+	double sync_time;
+	double sync_time_max;
+};
+
 void recovery_init(const char *snap_dirname, const char *xlog_dirname,
 		   row_handler row_handler, void *row_handler_param,
 		   int rows_per_wal, int flags);
@@ -122,6 +136,10 @@ int wal_write(struct recovery_state *r, i64 lsn, u64 cookie,
 	      u16 op, struct tbuf *data);
 
 void recovery_setup_panic(struct recovery_state *r, bool on_snap_error, bool on_wal_error);
+/** Preallocate WAL files to the size, see log_dir_prealloc(). */
+void recovery_setup_wal_prealloc(struct recovery_state *r, size_t size);
+/** Get WAL writer statistics, all zero if there is no writer. */
+void recovery_wal_stat(struct recovery_state *r, struct wal_stat *stat);
 
 void confirm_lsn(struct recovery_state *r, int64_t lsn, bool is_commit);
 int64_t next_lsn(struct recovery_state *r);
@@ -143,5 +161,31 @@ void snapshot_write_row(struct log_io *i, struct fio_batch *batch,
 			const void *data, size_t data_size);
 void snapshot_save(struct recovery_state *r,
 		   void (*loop) (struct log_io *, struct fio_batch *));
+/**
+ * Write the rows of a snapshot segment number 'segment' out
+ * of 'segments', or of the whole snapshot if it's not split.
+ */
+typedef void (*snapshot_segment_f)(struct log_io *, struct fio_batch *,
+				   int segment, int segments);
+/**
+ * Save a snapshot as several segment files and a manifest
+ * (see log_io::segments). The segments are written by as many
+ * threads, so the loop must only touch data which is not
+ * changed meanwhile, such as a read view.
+ *
+ * @return 0 on success, -1 on error, with errno set.
+ */
+int snapshot_save_segments(struct recovery_state *r, int segments,
+			   snapshot_segment_f loop);
+/**
+ * Save a snapshot without a fork: the loop is invoked in a
+ * coeio thread, or in several threads if segments > 1, and
+ * must only touch data which is not changed meanwhile, such
+ * as a read view. The calling fiber waits for it.
+ *
+ * @return 0 on success, -1 on error, with errno set.
+ */
+int snapshot_save_read_view(struct recovery_state *r, int segments,
+			    snapshot_segment_f loop);
 
 #endif /* TARANTOOL_RECOVERY_H_INCLUDED */
@@ -34,12 +34,76 @@
 
 struct tbuf;
 
-bool salloc_init(size_t size, size_t minimal, double factor);
+bool salloc_init(size_t size, size_t minimal, double factor,
+		 bool huge_pages);
 void salloc_free(void);
 void *salloc(size_t size, const char *what);
 void sfree(void *ptr);
 void slab_validate();
 
+/**
+ * Convert a pointer to an allocated item to a number which is
+ * unique among all items, and back. Numbers of items of one
+ * slab are consecutive, so they are dense enough to be stored
+ * in a bitmap.
+ */
+size_t salloc_ptr_to_index(void *ptr);
+void *salloc_ptr_from_index(size_t index);
+
+/**
+ * Incremental defragmentation: evacuate a sparse slab so that it
+ * goes back to the arena and can be reused by any size class.
+ *
+ * salloc_defrag_begin() picks a slab used less than @a threshold
+ * (a fraction of its capacity) and stops allocating from it.
+ * It returns false if there is no such slab.
+ * salloc_defrag_next() returns the next allocated item of the
+ * slab, or NULL. The caller moves the item elsewhere, i.e. copies
+ * it to a new salloc() item and sfree()s the old one, or leaves
+ * it in place. The caller may yield between the calls.
+ * salloc_defrag_end() makes the slab available for allocation
+ * again and returns true if the slab was emptied and released.
+ */
+bool salloc_defrag_begin(double threshold);
+void *salloc_defrag_next(void);
+bool salloc_defrag_end(void);
+
+/**
+ * Add size classes for the sizes which are allocated often and
+ * fit the existing classes poorly, judging by the sizes
+ * allocated so far. Existing items stay in their classes, new
+ * items of these sizes go to the new ones. Returns the number of
+ * classes added.
+ */
+int salloc_adapt(void);
+
+/**
+ * A compressed pointer to an allocated item: the offset of the
+ * item from the start of the arena in units of item alignment.
+ * salloc_init() aligns items so that every item of the arena is
+ * addressable this way. References are ordered as pointers are,
+ * and 0 stands for NULL since no item starts the arena. Index
+ * nodes use them to refer to tuples in half the space.
+ */
+extern char *salloc_ref_base;
+extern int salloc_ref_shift;
+
+static inline u32
+salloc_ptr_to_ref(const void *ptr)
+{
+	if (ptr == NULL)
+		return 0;
+	return ((const char *) ptr - salloc_ref_base) >> salloc_ref_shift;
+}
+
+static inline void *
+salloc_ptr_from_ref(u32 ref)
+{
+	if (ref == 0)
+		return NULL;
+	return salloc_ref_base + ((size_t) ref << salloc_ref_shift);
+}
+
 /** Statistics on utilization of a single slab class. */
 struct slab_cache_stats {
 	i64 item_size;
@@ -47,12 +111,24 @@ struct slab_cache_stats {
 	i64 items;
 	i64 bytes_used;
 	i64 bytes_free;
+	/** Bytes of items beyond the size asked for. */
+	i64 bytes_waste;
 };
 
+/** Pages which back the slab arena. */
+#define SLAB_ARENA_PAGES(_)						\
+	_(NORMAL, 0)        /* regular pages */				\
+	_(HUGETLB, 1)       /* explicit huge pages, MAP_HUGETLB */	\
+	_(TRANSPARENT, 2)   /* transparent huge pages, MADV_HUGEPAGE */	\
+
+ENUM(slab_arena_pages, SLAB_ARENA_PAGES);
+extern const char *slab_arena_pages_strs[];
+
 /** Statistics on utilization of the slab allocator. */
 struct slab_arena_stats {
 	size_t size;
 	size_t used;
+	enum slab_arena_pages pages;
 };
 
 typedef int (*salloc_stat_cb)(const struct slab_cache_stats *st, void *ctx);
@@ -60,4 +136,11 @@ typedef int (*salloc_stat_cb)(const struct slab_cache_stats *st, void *ctx);
 int
 salloc_stat(salloc_stat_cb cb, struct slab_arena_stats *astat, void *cb_ctx);
 
+/**
+ * The number of huge pages the arena is currently backed with.
+ * Transparent huge pages are counted in /proc/self/smaps, so
+ * this is too slow to be a part of salloc_stat().
+ */
+size_t salloc_huge_pages_used(void);
+
 #endif /* TARANTOOL_SALLOC_H_INCLUDED */
@@ -0,0 +1,414 @@
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * A Swiss table: an open addressing hash table which keeps
+ * a control byte per slot. A control byte of a used slot holds
+ * 7 bits of the slot hash, so a lookup compares 16 slots of a
+ * group at once, with SSE2 where available, and touches the
+ * nodes only on a hash match.
+ *
+ * The interface is the same as of mhash.h, so the tables are
+ * interchangeable:
+ *
+ * #define sh_name _i32ptr		// name suffix
+ * #define sh_node_t struct node	// hash table node type
+ * #define sh_hash_arg_t void *		// extra argument of sh_hash
+ * #define sh_hash(a, arg) ((a)->key)	// u32 hash of a node
+ * #define sh_eq_arg_t void *		// extra argument of sh_eq
+ * #define sh_eq(a, b, arg) ((a)->key == (b)->key)
+ * #include <shash.h>
+ *
+ * The hash doesn't have to be well-mixed, it's finalized by the
+ * table. Define SH_SOURCE before the include in a single
+ * translation unit to emit the non-inline functions.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef SH_COMMON
+#define SH_COMMON 1
+
+typedef uint32_t sh_int_t;
+
+enum {
+	/** Slots compared at once. */
+	SH_GROUP_SIZE = 16,
+	/** Control byte of a slot which was never used. */
+	SH_CTRL_EMPTY = -128,
+	/** Control byte of a slot whose node was deleted. */
+	SH_CTRL_DELETED = -2,
+};
+
+/** MurmurHash3 finalizer: the group index takes the high bits. */
+static inline uint32_t
+sh_mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/** A bit mask of group slots with the given control byte. */
+static inline uint32_t
+sh_group_match(const int8_t *ctrl, int8_t c)
+{
+#if defined(__SSE2__)
+	__m128i group = _mm_load_si128((const __m128i *) ctrl);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < SH_GROUP_SIZE; i++)
+		mask |= (uint32_t) (ctrl[i] == c) << i;
+	return mask;
+#endif
+}
+
+/** A bit mask of empty or deleted group slots. */
+static inline uint32_t
+sh_group_match_free(const int8_t *ctrl)
+{
+#if defined(__SSE2__)
+	__m128i group = _mm_load_si128((const __m128i *) ctrl);
+	return _mm_movemask_epi8(group);
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < SH_GROUP_SIZE; i++)
+		mask |= (uint32_t) (ctrl[i] < 0) << i;
+	return mask;
+#endif
+}
+
+/** The maximal number of used or deleted slots, 7/8 of all. */
+static inline sh_int_t
+sh_max_load(sh_int_t n_buckets)
+{
+	return n_buckets - n_buckets / 8;
+}
+
+#define sh_exist(h, i)		((h)->ctrl[i] >= 0)
+#define sh_size(h)		((h)->size)
+#define sh_capacity(h)		((h)->n_buckets)
+#define sh_begin(h)		(0)
+#define sh_end(h)		((h)->n_buckets)
+
+#define sh_first(h) ({						\
+	sh_int_t i;						\
+	for (i = 0; i < sh_end(h); i++) {			\
+		if (sh_exist(h, i))				\
+			break;					\
+	}							\
+	i;							\
+})
+
+#define sh_next(h, i) ({					\
+	sh_int_t n = (i) + 1;					\
+	while (n < sh_end(h) && !sh_exist(h, n))		\
+		n++;						\
+	n;							\
+})
+
+#define sh_foreach(h, i) \
+	for (i = sh_first(h); i < sh_end(h); i = sh_next(h, i))
+
+#endif /* SH_COMMON */
+
+#define sh_cat(a, b) sh##a##_##b
+#define sh_ecat(a, b) sh_cat(a, b)
+#define _sh(x) sh_ecat(sh_name, x)
+
+struct _sh(t) {
+	/** n_buckets control bytes, aligned by a group. */
+	int8_t *ctrl;
+	/** n_buckets nodes, allocated in the same block. */
+	sh_node_t *p;
+	/** The number of slots, a power of 2 >= SH_GROUP_SIZE. */
+	sh_int_t n_buckets;
+	sh_int_t size;
+	/** Empty slots which may be used before a rehash. */
+	sh_int_t growth_left;
+};
+
+struct _sh(t) *_sh(new)();
+void _sh(clear)(struct _sh(t) *h);
+void _sh(delete)(struct _sh(t) *h);
+int _sh(rehash)(struct _sh(t) *h, sh_int_t size, sh_hash_arg_t hash_arg);
+int _sh(reserve)(struct _sh(t) *h, sh_int_t size,
+		 sh_hash_arg_t hash_arg, sh_eq_arg_t eq_arg);
+
+static inline sh_node_t *
+_sh(node)(struct _sh(t) *h, sh_int_t x)
+{
+	return &h->p[x];
+}
+
+/** Find a node with the given hash, sh_end() if not found. */
+static inline sh_int_t
+_sh(find)(struct _sh(t) *h, const sh_node_t *node, uint32_t hash,
+	  sh_eq_arg_t eq_arg)
+{
+	(void) eq_arg;
+	int8_t h2 = hash & 0x7f;
+	sh_int_t mask = h->n_buckets / SH_GROUP_SIZE - 1;
+	sh_int_t g = (hash >> 7) & mask;
+	/* Triangular probing visits every group. */
+	for (sh_int_t step = 1; ; step++) {
+		const int8_t *ctrl = h->ctrl + g * SH_GROUP_SIZE;
+		uint32_t match = sh_group_match(ctrl, h2);
+		while (match != 0) {
+			sh_int_t i = g * SH_GROUP_SIZE + __builtin_ctz(match);
+			if (sh_eq(node, &h->p[i], eq_arg))
+				return i;
+			match &= match - 1;
+		}
+		/*
+		 * A group is never refilled with empty slots, so
+		 * the nodes further down the probe sequence have
+		 * been inserted when this group had no empty slots.
+		 */
+		if (sh_group_match(ctrl, SH_CTRL_EMPTY) != 0)
+			return h->n_buckets;
+		g = (g + step) & mask;
+	}
+}
+
+/** Find the first free slot in the probe sequence of a hash. */
+static inline sh_int_t
+_sh(find_free)(struct _sh(t) *h, uint32_t hash)
+{
+	sh_int_t mask = h->n_buckets / SH_GROUP_SIZE - 1;
+	sh_int_t g = (hash >> 7) & mask;
+	for (sh_int_t step = 1; ; step++) {
+		uint32_t match = sh_group_match_free(h->ctrl +
+						     g * SH_GROUP_SIZE);
+		if (match != 0)
+			return g * SH_GROUP_SIZE + __builtin_ctz(match);
+		g = (g + step) & mask;
+	}
+}
+
+/** Put a node which is known to be absent from the table. */
+static inline sh_int_t
+_sh(insert)(struct _sh(t) *h, const sh_node_t *node, uint32_t hash,
+	    sh_hash_arg_t hash_arg)
+{
+	sh_int_t x = _sh(find_free)(h, hash);
+	if (h->ctrl[x] == SH_CTRL_EMPTY && h->growth_left == 0) {
+		/* Grow, or just drop deleted slots. */
+		if (_sh(rehash)(h, h->size + 1, hash_arg) != 0)
+			return sh_end(h);
+		x = _sh(find_free)(h, hash);
+	}
+	if (h->ctrl[x] == SH_CTRL_EMPTY)
+		h->growth_left--;
+	h->ctrl[x] = hash & 0x7f;
+	memcpy(&h->p[x], node, sizeof(sh_node_t));
+	h->size++;
+	return x;
+}
+
+static inline sh_int_t
+_sh(get)(struct _sh(t) *h, const sh_node_t *node,
+	 sh_hash_arg_t hash_arg, sh_eq_arg_t eq_arg)
+{
+	(void) hash_arg;
+	return _sh(find)(h, node, sh_mix(sh_hash(node, hash_arg)), eq_arg);
+}
+
+/**
+ * Insert a node or replace an equal one. Save the old node in
+ * p_old pointer, if it is provided, or set it to NULL.
+ * @retval sh_end() on memory allocation error
+ */
+static inline sh_int_t
+_sh(replace)(struct _sh(t) *h, const sh_node_t *node, sh_node_t **p_old,
+	     sh_hash_arg_t hash_arg, sh_eq_arg_t eq_arg)
+{
+	(void) hash_arg;
+	uint32_t hash = sh_mix(sh_hash(node, hash_arg));
+	sh_int_t k = _sh(find)(h, node, hash, eq_arg);
+	if (k != sh_end(h)) {
+		if (p_old)
+			memcpy(*p_old, &h->p[k], sizeof(sh_node_t));
+		memcpy(&h->p[k], node, sizeof(sh_node_t));
+		return k;
+	}
+	if (p_old)
+		*p_old = NULL;
+	return _sh(insert)(h, node, hash, hash_arg);
+}
+
+static inline void
+_sh(del)(struct _sh(t) *h, sh_int_t x,
+	 sh_hash_arg_t hash_arg, sh_eq_arg_t eq_arg)
+{
+	(void) hash_arg;
+	(void) eq_arg;
+	if (x >= h->n_buckets || !sh_exist(h, x))
+		return;
+	/*
+	 * A slot may become empty again only if its group has
+	 * empty slots: then no probe sequence passes the group.
+	 */
+	sh_int_t g = x / SH_GROUP_SIZE * SH_GROUP_SIZE;
+	if (sh_group_match(h->ctrl + g, SH_CTRL_EMPTY) != 0) {
+		h->ctrl[x] = SH_CTRL_EMPTY;
+		h->growth_left++;
+	} else {
+		h->ctrl[x] = SH_CTRL_DELETED;
+	}
+	h->size--;
+}
+
+static inline void
+_sh(remove)(struct _sh(t) *h, const sh_node_t *node,
+	    sh_hash_arg_t hash_arg, sh_eq_arg_t eq_arg)
+{
+	sh_int_t k = _sh(get)(h, node, hash_arg, eq_arg);
+	if (k != sh_end(h))
+		_sh(del)(h, k, hash_arg, eq_arg);
+}
+
+#ifdef SH_SOURCE
+
+/** Allocate slots of a table, all empty. */
+static int
+_sh(alloc)(struct _sh(t) *h, sh_int_t n_buckets)
+{
+	void *mem;
+	size_t sz = n_buckets * (sizeof(int8_t) + sizeof(sh_node_t));
+	if (posix_memalign(&mem, SH_GROUP_SIZE, sz) != 0)
+		return -1;
+	h->ctrl = mem;
+	h->p = (sh_node_t *) (h->ctrl + n_buckets);
+	memset(h->ctrl, SH_CTRL_EMPTY, n_buckets);
+	h->n_buckets = n_buckets;
+	h->size = 0;
+	h->growth_left = sh_max_load(n_buckets);
+	return 0;
+}
+
+struct _sh(t) *
+_sh(new)()
+{
+	struct _sh(t) *h = calloc(1, sizeof(*h));
+	if (h == NULL)
+		return NULL;
+	if (_sh(alloc)(h, SH_GROUP_SIZE) != 0) {
+		free(h);
+		return NULL;
+	}
+	return h;
+}
+
+void
+_sh(clear)(struct _sh(t) *h)
+{
+	memset(h->ctrl, SH_CTRL_EMPTY, h->n_buckets);
+	h->size = 0;
+	h->growth_left = sh_max_load(h->n_buckets);
+}
+
+void
+_sh(delete)(struct _sh(t) *h)
+{
+	free(h->ctrl);
+	free(h);
+}
+
+/**
+ * Rebuild the table with room for at least size nodes. This
+ * also drops deleted slots, so the table may keep its size.
+ */
+int
+_sh(rehash)(struct _sh(t) *h, sh_int_t size, sh_hash_arg_t hash_arg)
+{
+	(void) hash_arg;
+	sh_int_t n_buckets = SH_GROUP_SIZE;
+	while (sh_max_load(n_buckets) < size) {
+		if (n_buckets > UINT32_MAX / 2)
+			return -1;
+		n_buckets *= 2;
+	}
+	/*
+	 * Don't rebuild a table full of deleted slots with the
+	 * same size over and over again.
+	 */
+	if (n_buckets == h->n_buckets && size > sh_max_load(n_buckets) / 2)
+		n_buckets *= 2;
+
+	struct _sh(t) old = *h;
+	if (_sh(alloc)(h, n_buckets) != 0) {
+		*h = old;
+		return -1;
+	}
+	for (sh_int_t i = 0; i < old.n_buckets; i++) {
+		if (old.ctrl[i] < 0)
+			continue;
+		uint32_t hash = sh_mix(sh_hash(&old.p[i], hash_arg));
+		sh_int_t x = _sh(find_free)(h, hash);
+		h->ctrl[x] = hash & 0x7f;
+		memcpy(&h->p[x], &old.p[i], sizeof(sh_node_t));
+	}
+	h->size = old.size;
+	h->growth_left -= old.size;
+	free(old.ctrl);
+	return 0;
+}
+
+int
+_sh(reserve)(struct _sh(t) *h, sh_int_t size,
+	     sh_hash_arg_t hash_arg, sh_eq_arg_t eq_arg)
+{
+	(void) eq_arg;
+	if (size <= h->size + h->growth_left)
+		return 0;
+	return _sh(rehash)(h, size, hash_arg);
+}
+
+#endif /* SH_SOURCE */
+
+#undef sh_name
+#undef sh_node_t
+#undef sh_hash_arg_t
+#undef sh_hash
+#undef sh_eq_arg_t
+#undef sh_eq
+#undef sh_cat
+#undef sh_ecat
+#undef _sh
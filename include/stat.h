@@ -29,6 +29,8 @@
  * SUCH DAMAGE.
  */
 #include <tbuf.h>
+#include <tarantool_ev.h>
+#include "histogram.h"
 
 void stat_init(void);
 void stat_free(void);
@@ -42,4 +44,25 @@ typedef int (*stat_cb)(const char *name, int rps, i64 total, void *cb_ctx);
 
 int stat_foreach(stat_cb cb, void *cb_ctx);
 
+/**
+ * Register a latency histogram, in microseconds, to show along
+ * with the other statistics. The name is copied.
+ */
+struct histogram *stat_register_latency(const char *name);
+/** Forget the latencies collected so far, e.g. during recovery. */
+void stat_cleanup_latency(void);
+
+/** Collect the time passed since start, see ev_time(). */
+static inline void
+stat_collect_latency(struct histogram *hist, ev_tstamp start)
+{
+	ev_tstamp latency = ev_time() - start;
+	histogram_collect(hist, latency > 0 ? latency * 1000000 : 0);
+}
+
+typedef int (*stat_latency_cb)(const char *name,
+			       const struct histogram *hist, void *cb_ctx);
+
+int stat_foreach_latency(stat_latency_cb cb, void *cb_ctx);
+
 #endif /* TARANTOOL_STAT_H_INCLUDED */
@@ -155,6 +155,11 @@ __pthread_cleanup_routine(struct __pthread_cleanup_frame *__frame);
 	tt_pthread_error(e);			\
 })
 
+#define tt_pthread_cond_broadcast(cond)		\
+({	int e = pthread_cond_broadcast(cond);	\
+	tt_pthread_error(e);			\
+})
+
 #define tt_pthread_cond_wait(cond, mutex)	\
 ({	int e = pthread_cond_wait(cond, mutex);\
 	tt_pthread_error(e);			\
@@ -97,12 +97,14 @@ salloc_stat_admin_cb(const struct slab_cache_stats *cstat, void *cb_ctx)
 	tbuf_printf(ctx->out,
 		    "     - { item_size: %- 5i, slabs: %- 3i, items: %- 11" PRIi64
 		    ", bytes_used: %- 12" PRIi64
-		    ", bytes_free: %- 12" PRIi64 " }" CRLF,
+		    ", bytes_free: %- 12" PRIi64
+		    ", bytes_waste: %- 12" PRIi64 " }" CRLF,
 		    (int)cstat->item_size,
 		    (int)cstat->slabs,
 		    cstat->items,
 		    cstat->bytes_used,
-		    cstat->bytes_free);
+		    cstat->bytes_free,
+		    cstat->bytes_waste);
 
 	ctx->total_used += cstat->bytes_used;
 	return 0;
@@ -125,6 +127,10 @@ show_slab(struct tbuf *out)
 		(double)cb_ctx.total_used / astat.size * 100);
 	tbuf_printf(out, "  arena_used: %.2f%%" CRLF,
 		(double)astat.used / astat.size * 100);
+	tbuf_printf(out, "  arena_pages: %s" CRLF,
+		    slab_arena_pages_strs[astat.pages]);
+	tbuf_printf(out, "  huge_pages_used: %zu" CRLF,
+		    salloc_huge_pages_used());
 }
 
 
@@ -191,11 +197,32 @@ show_stat_item(const char *name, int rps, i64 total, void *ctx)
 	return 0;
 }
 
+/** Latencies are shown in microseconds. */
+static int
+show_latency_item(const char *name, const struct histogram *hist, void *ctx)
+{
+	struct tbuf *buf = ctx;
+	int name_len = strlen(name);
+	tbuf_printf(buf,
+		    "  %s:%*s{ count: %- 12" PRIi64 ", p50: %- 8" PRIi64
+		    ", p99: %- 8" PRIi64 ", p999: %- 8" PRIi64
+		    ", max: %- 8" PRIi64 " }" CRLF,
+		    name, 1 + stat_max_name_len - name_len, " ",
+		    (i64) hist->count,
+		    (i64) histogram_percentile(hist, 0.5),
+		    (i64) histogram_percentile(hist, 0.99),
+		    (i64) histogram_percentile(hist, 0.999),
+		    (i64) hist->max);
+	return 0;
+}
+
 void
 show_stat(struct tbuf *buf)
 {
 	tbuf_printf(buf, "statistics:" CRLF);
 	stat_foreach(show_stat_item, buf);
+	tbuf_printf(buf, "latency:" CRLF);
+	stat_foreach_latency(show_latency_item, buf);
 }
 
 static int
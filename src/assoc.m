@@ -1,2 +1,3 @@
 #define MH_SOURCE 1
+#define SH_SOURCE 1
 #include <assoc.h>
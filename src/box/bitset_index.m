@@ -0,0 +1,278 @@
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "bitset_index.h"
+#include "tuple.h"
+#include "pickle.h"
+#include "exception.h"
+#include <salloc.h>
+
+static struct index_traits bitset_index_traits = {
+	.allows_partial_key = false,
+};
+
+/*
+ * Bitsets store numbers, so a tuple is stored as the number of
+ * its slab allocator item.
+ */
+static inline size_t
+tuple_to_value(struct tuple *tuple)
+{
+	return salloc_ptr_to_index(tuple);
+}
+
+static inline struct tuple *
+value_to_tuple(size_t value)
+{
+	return salloc_ptr_from_index(value);
+}
+
+/* {{{ BitsetIndex Iterators **************************************/
+
+struct bitset_index_iterator {
+	struct iterator base; /* Must be the first member. */
+	struct bitset_iterator bitset_it;
+};
+
+static void
+bitset_index_iterator_free(struct iterator *ptr)
+{
+	assert(ptr->free == bitset_index_iterator_free);
+	struct bitset_index_iterator *it = (struct bitset_index_iterator *) ptr;
+
+	bitset_iterator_destroy(&it->bitset_it);
+	free(it);
+}
+
+static struct tuple *
+bitset_index_iterator_next(struct iterator *ptr)
+{
+	assert(ptr->free == bitset_index_iterator_free);
+	struct bitset_index_iterator *it = (struct bitset_index_iterator *) ptr;
+
+	size_t value = bitset_iterator_next(&it->bitset_it);
+	if (value == SIZE_MAX)
+		return NULL;
+
+	return value_to_tuple(value);
+}
+
+/* }}} */
+
+/* {{{ BitsetIndex ************************************************/
+
+@implementation BitsetIndex
+
++ (struct index_traits *) traits
+{
+	return &bitset_index_traits;
+}
+
+- (id) init: (struct key_def *) key_def_arg :(struct space *) space_arg
+{
+	assert(!key_def_arg->is_unique);
+
+	self = [super init: key_def_arg :space_arg];
+	if (self == NULL)
+		return NULL;
+
+	if (bitset_index_create(&index, realloc) != 0)
+		panic_syserror("bitset_index_create");
+	return self;
+}
+
+- (void) free
+{
+	bitset_index_destroy(&index);
+	[super free];
+}
+
+- (void) beginBuild
+{
+}
+
+- (void) buildNext: (struct tuple *) tuple
+{
+	[self replace: NULL :tuple :DUP_INSERT];
+}
+
+- (void) endBuild
+{
+}
+
+- (void) build: (struct tuple **) tuples :(u32) n_tuples
+{
+	for (u32 i = 0; i < n_tuples; i++)
+		[self replace: NULL :tuples[i] :DUP_INSERT];
+}
+
+- (size_t) size
+{
+	return bitset_index_size(&index);
+}
+
+- (struct tuple *) min
+{
+	tnt_raise(ClientError, :ER_UNSUPPORTED, "Bitset index", "min()");
+	return NULL;
+}
+
+- (struct tuple *) max
+{
+	tnt_raise(ClientError, :ER_UNSUPPORTED, "Bitset index", "max()");
+	return NULL;
+}
+
+- (struct tuple *) findByKey: (const void *) key :(int) part_count
+{
+	(void) key;
+	(void) part_count;
+	tnt_raise(ClientError, :ER_UNSUPPORTED, "Bitset index", "findByKey()");
+	return NULL;
+}
+
+- (struct tuple *) findByTuple: (struct tuple *) tuple
+{
+	(void) tuple;
+	tnt_raise(ClientError, :ER_UNSUPPORTED, "Bitset index", "findByTuple()");
+	return NULL;
+}
+
+- (struct tuple *) replace: (struct tuple *) old_tuple
+			  :(struct tuple *) new_tuple
+			  :(enum dup_replace_mode) mode
+{
+	assert(old_tuple != NULL || new_tuple != NULL);
+	(void) mode;
+
+	struct tuple *ret = NULL;
+
+	if (old_tuple != NULL) {
+		size_t value = tuple_to_value(old_tuple);
+		if (bitset_index_contains_value(&index, value)) {
+			ret = old_tuple;
+			bitset_index_remove_value(&index, value);
+		}
+	}
+
+	if (new_tuple != NULL) {
+		const void *field = tuple_field(new_tuple,
+						key_def->parts[0].fieldno);
+		if (field == NULL)
+			tnt_raise(ClientError, :ER_NO_SUCH_FIELD,
+				  key_def->parts[0].fieldno);
+		size_t key_size = load_varint32(&field);
+
+		size_t value = tuple_to_value(new_tuple);
+		if (bitset_index_insert(&index, field, key_size, value) < 0) {
+			tnt_raise(LoggedError, :ER_MEMORY_ISSUE, 0,
+				  "bitset index", "key");
+		}
+	}
+
+	return ret;
+}
+
+- (struct iterator *) allocIterator
+{
+	struct bitset_index_iterator *it = malloc(sizeof(*it));
+	if (it) {
+		memset(it, 0, sizeof(*it));
+		it->base.next = bitset_index_iterator_next;
+		it->base.free = bitset_index_iterator_free;
+		bitset_iterator_create(&it->bitset_it, realloc);
+	}
+	return (struct iterator *) it;
+}
+
+- (void) initIterator: (struct iterator *) ptr
+			:(enum iterator_type) type
+			:(void *) key :(int) part_count
+{
+	assert(ptr->free == bitset_index_iterator_free);
+	struct bitset_index_iterator *it = (struct bitset_index_iterator *) ptr;
+
+	const void *bitset_key = NULL;
+	size_t key_size = 0;
+	if (type != ITER_ALL) {
+		check_key_parts(key_def, part_count,
+				traits->allows_partial_key);
+		bitset_key = key;
+		key_size = load_varint32(&bitset_key);
+	}
+
+	struct bitset_expr expr;
+	bitset_expr_create(&expr, realloc);
+	@try {
+		int rc = 0;
+		switch (type) {
+		case ITER_ALL:
+			rc = bitset_index_expr_all(&expr);
+			break;
+		case ITER_EQ:
+			rc = bitset_index_expr_equals(&expr, bitset_key,
+						      key_size);
+			break;
+		case ITER_BITS_ALL_SET:
+			rc = bitset_index_expr_all_set(&expr, bitset_key,
+						       key_size);
+			break;
+		case ITER_BITS_ANY_SET:
+			rc = bitset_index_expr_any_set(&expr, bitset_key,
+						       key_size);
+			break;
+		case ITER_BITS_ALL_NOT_SET:
+			rc = bitset_index_expr_all_not_set(&expr, bitset_key,
+							   key_size);
+			break;
+		default:
+			tnt_raise(ClientError, :ER_UNSUPPORTED,
+				  "Bitset index", "requested iterator type");
+		}
+		if (rc != 0 ||
+		    bitset_index_init_iterator(&index, &it->bitset_it,
+					       &expr) != 0) {
+			tnt_raise(LoggedError, :ER_MEMORY_ISSUE, 0,
+				  "bitset index", "iterator");
+		}
+	} @finally {
+		bitset_expr_destroy(&expr);
+	}
+}
+
+- (size_t) count: (void *) key :(int) part_count
+{
+	struct bitset_index_iterator *it =
+		(struct bitset_index_iterator *) position;
+	[self initIterator: position :ITER_EQ :key :part_count];
+	/* Count the result pages without visiting every tuple. */
+	return bitset_iterator_count(&it->bitset_it);
+}
+@end
+
+/* }}} */
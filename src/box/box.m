@@ -32,6 +32,7 @@
 #include <cfg/warning.h>
 #include <errcode.h>
 #include "palloc.h"
+#include <salloc.h>
 #include <recovery.h>
 #include <log_io.h>
 #include <pickle.h>
@@ -44,6 +45,8 @@
 #include "memcached.h"
 #include "box_lua.h"
 #include "space.h"
+#include "tree_index.h"
+#include "hash_index.h"
 #include "port.h"
 #include "request.h"
 #include "txn.h"
@@ -60,6 +63,8 @@ box_process_func box_process_ro = process_ro;
 static char status[64] = "unknown";
 
 static int stat_base;
+/** Request latencies by request type. */
+static struct histogram *request_latency[requests_MAX];
 
 struct box_snap_row {
 	u32 space;
@@ -86,9 +91,11 @@ static void
 process_rw(struct port *port, u32 op, struct tbuf *data)
 {
 	struct txn *txn = txn_begin();
+	struct request *request = NULL;
+	ev_tstamp start = ev_time();
 
 	@try {
-		struct request *request = request_create(op, data);
+		request = request_create(op, data);
 		stat_collect(stat_base, op, 1);
 		request_execute(request, txn, port);
 		txn_commit(txn);
@@ -98,6 +105,14 @@ process_rw(struct port *port, u32 op, struct tbuf *data)
 	} @catch (id e) {
 		txn_rollback(txn);
 		@throw;
+	} @finally {
+		/* Failed requests take their time too. */
+		if (request != NULL) {
+			stat_collect_latency(request_latency[op], start);
+			if (request->space)
+				stat_collect_latency(request->space->latency,
+						     start);
+		}
 	}
 }
 
@@ -254,11 +269,12 @@ recover_snap_row(struct tbuf *t)
 
 	struct box_snap_row *row = box_snap_row(t);
 
-	struct tuple *tuple = tuple_alloc(row->data_size);
+	struct space *space = space_find(row->space);
+	struct tuple *tuple = space_tuple_alloc(space, row->data_size);
 	memcpy(tuple->data, row->data, row->data_size);
 	tuple->field_count = row->tuple_size;
+	tuple_init_field_map(tuple);
 
-	struct space *space = space_find(row->space);
 	Index *index = space_index(space, 0);
 	/* Check to see if the tuple has a sufficient number of fields. */
 	if (unlikely(tuple->field_count < space->max_fieldno)) {
@@ -347,6 +363,17 @@ box_check_config(struct tarantool_cfg *conf)
 		return -1;
 	}
 
+	/*
+	 * a replica and a hot standby must apply all changes,
+	 * which isn't possible during a background index build
+	 */
+	if (conf->background_index_build &&
+	    (conf->replication_source != NULL || conf->local_hot_standby)) {
+		out_warning(0, "background index build can't be enabled "
+			       "on a replica or in local hot standby mode");
+		return -1;
+	}
+
 	/* check replication mode */
 	if (conf->replication_source != NULL) {
 		/* check replication port */
@@ -378,6 +405,40 @@ box_check_config(struct tarantool_cfg *conf)
 		return -1;
 	}
 
+	/* check tree index implementation */
+	if (conf->tree_index_engine == NULL) {
+		out_warning(0, "tree_index_engine is not set");
+		return -1;
+	}
+	if (STR2ENUM(tree_engine, conf->tree_index_engine) == tree_engine_MAX) {
+		out_warning(0, "tree_index_engine %s is not recognized",
+			    conf->tree_index_engine);
+		return -1;
+	}
+
+	/* check hash index implementation */
+	if (conf->hash_index_engine == NULL) {
+		out_warning(0, "hash_index_engine is not set");
+		return -1;
+	}
+	if (STR2ENUM(hash_engine, conf->hash_index_engine) == hash_engine_MAX) {
+		out_warning(0, "hash_index_engine %s is not recognized",
+			    conf->hash_index_engine);
+		return -1;
+	}
+
+	/* check slab defragmentation */
+	if (conf->slab_defrag_threshold < 0 ||
+	    conf->slab_defrag_threshold >= 1) {
+		out_warning(0, "slab_defrag_threshold must be in [0, 1)");
+		return -1;
+	}
+	if (conf->slab_defrag_slice <= 0) {
+		out_warning(0, "invalid slab_defrag_slice value: %i",
+			    conf->slab_defrag_slice);
+		return -1;
+	}
+
 	/* check if at least one space is defined */
 	if (conf->space == NULL && conf->memcached_port == 0) {
 		out_warning(0, "at least one space or memcached port must be defined");
@@ -439,6 +500,12 @@ box_init(void)
 	title("loading");
 	atexit(box_free);
 
+	for (int i = 0; i < requests_MAX; i++) {
+		if (requests_strs[i] != NULL)
+			request_latency[i] = stat_register_latency(requests_strs[i]);
+	}
+	txn_wal_latency = stat_register_latency("WAL");
+
 	/* initialization spaces */
 	space_init();
 	/* configure memcached space */
@@ -451,6 +518,7 @@ box_init(void)
 		      init_storage ? RECOVER_READONLY : 0);
 	recovery_update_io_rate_limit(recovery_state, cfg.snap_io_rate_limit);
 	recovery_setup_panic(recovery_state, cfg.panic_on_snap_error, cfg.panic_on_wal_error);
+	recovery_setup_wal_prealloc(recovery_state, cfg.wal_prealloc_size);
 
 	stat_base = stat_register(requests_strs, requests_MAX);
 
@@ -460,12 +528,21 @@ box_init(void)
 	begin_build_primary_indexes();
 	recover_snap(recovery_state);
 	end_build_primary_indexes();
+	if (cfg.slab_alloc_adaptive)
+		salloc_adapt();
 	recover_existing_wals(recovery_state);
 
 	stat_cleanup(stat_base, requests_MAX);
+	stat_cleanup_latency();
 
-	say_info("building secondary indexes");
-	build_secondary_indexes();
+	if (cfg.background_index_build) {
+		say_info("building secondary indexes in background");
+		build_secondary_indexes_in_background();
+	} else {
+		say_info("building secondary indexes");
+		build_secondary_indexes();
+	}
+	start_slab_defrag();
 	title("orphan");
 	if (cfg.local_hot_standby) {
 		say_info("starting local hot standby");
@@ -521,6 +598,119 @@ box_snapshot(struct log_io *l, struct fio_batch *batch)
 	space_foreach(snapshot_space, &ud);
 }
 
+/** A read view of a space: its tuples at the time of the view. */
+struct space_read_view {
+	u32 n;
+	struct tuple **tuples;
+	size_t count;
+};
+
+static struct {
+	struct space_read_view *spaces;
+	int count;
+	/** The number of tuples in all spaces. */
+	size_t rows;
+} read_view;
+
+static void
+read_view_count_space(struct space *sp __attribute__((unused)),
+		      void *udata)
+{
+	++*(int *) udata;
+}
+
+static void
+read_view_add_space(struct space *sp, void *udata)
+{
+	bool *is_error = udata;
+	Index *pk = space_index(sp, 0);
+	size_t size = [pk size];
+	struct space_read_view *view = &read_view.spaces[read_view.count];
+
+	view->n = space_n(sp);
+	view->count = 0;
+	view->tuples = malloc(MAX(size, 1) * sizeof(struct tuple *));
+	if (view->tuples == NULL) {
+		*is_error = true;
+		return;
+	}
+	read_view.count++;
+
+	struct iterator *it = pk->position;
+	[pk initIterator: it :ITER_ALL :NULL :0];
+	struct tuple *tuple;
+	while ((tuple = it->next(it))) {
+		assert(view->count < size);
+		view->tuples[view->count++] = tuple;
+	}
+	read_view.rows += view->count;
+}
+
+int
+box_read_view_open(void)
+{
+	assert(read_view.spaces == NULL);
+	ev_tstamp start = ev_time();
+	int count = 0;
+	/* --init-storage switch */
+	if (primary_indexes_enabled)
+		space_foreach(read_view_count_space, &count);
+
+	read_view.spaces = calloc(MAX(count, 1),
+				  sizeof(struct space_read_view));
+	if (read_view.spaces == NULL)
+		return -1;
+	read_view.count = 0;
+	read_view.rows = 0;
+	bool is_error = false;
+	if (count > 0)
+		space_foreach(read_view_add_space, &is_error);
+	tuple_read_view_open();
+	if (is_error) {
+		box_read_view_close();
+		errno = ENOMEM;
+		return -1;
+	}
+	/* Requests have been stalled for as long. */
+	say_info("made a read view of %zu rows in %.3f sec",
+		 read_view.rows, ev_time() - start);
+	return 0;
+}
+
+void
+box_read_view_snapshot(struct log_io *l, struct fio_batch *batch,
+		       int segment, int segments)
+{
+	/*
+	 * Split the rows of all spaces evenly, in primary key
+	 * order, so that a big space is split too.
+	 */
+	size_t begin = read_view.rows * segment / segments;
+	size_t end = read_view.rows * (segment + 1) / segments;
+	size_t pos = 0;
+	for (int i = 0; i < read_view.count && pos < end; i++) {
+		struct space_read_view *view = &read_view.spaces[i];
+		size_t from = MAX(begin, pos) - pos;
+		size_t to = MIN(end, pos + view->count) - pos;
+		for (size_t j = from; j < to; j++)
+			snapshot_write_tuple(l, batch, view->n,
+					     view->tuples[j]);
+		pos += view->count;
+	}
+}
+
+void
+box_read_view_close(void)
+{
+	for (int i = 0; i < read_view.count; i++)
+		free(read_view.spaces[i].tuples);
+	free(read_view.spaces);
+	read_view.spaces = NULL;
+	read_view.count = 0;
+	read_view.rows = 0;
+	tuple_read_view_close();
+}
+
 void
 box_info(struct tbuf *out)
 {
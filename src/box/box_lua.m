@@ -620,6 +620,7 @@ static int
 lbox_index_len(struct lua_State *L)
 {
 	Index *index = lua_checkindex(L, 1);
+	index_check_ready(index);
 	lua_pushinteger(L, [index size]);
 	return 1;
 }
@@ -636,6 +637,7 @@ static int
 lbox_index_min(struct lua_State *L)
 {
 	Index *index = lua_checkindex(L, 1);
+	index_check_ready(index);
 	lbox_pushtuple(L, [index min]);
 	return 1;
 }
@@ -644,6 +646,7 @@ static int
 lbox_index_max(struct lua_State *L)
 {
 	Index *index = lua_checkindex(L, 1);
+	index_check_ready(index);
 	lbox_pushtuple(L, [index max]);
 	return 1;
 }
@@ -721,6 +724,7 @@ static inline struct iterator *
 lbox_create_iterator(struct lua_State *L)
 {
 	Index *index = lua_checkindex(L, 1);
+	index_check_ready(index);
 	int argc = lua_gettop(L);
 	/* Create a new iterator. */
 	enum iterator_type type;
@@ -850,6 +854,7 @@ static int
 lbox_index_count(struct lua_State *L)
 {
 	Index *index = lua_checkindex(L, 1);
+	index_check_ready(index);
 	int argc = lua_gettop(L) - 1;
 	if (argc == 0)
 		luaL_error(L, "index.count(): one or more arguments expected");
@@ -874,17 +879,24 @@ lbox_index_count(struct lua_State *L)
 		}
 		key = data->data;
 	}
-	u32 count = 0;
-	/* preparing index iterator */
-	struct iterator *it = index->position;
-	[index initIterator: it :ITER_EQ :key :key_part_count];
-	/* iterating over the index and counting tuples */
-	struct tuple *tuple;
-	while ((tuple = it->next(it)) != NULL)
-		count++;
-
 	/* returning subtree size */
-	lua_pushnumber(L, count);
+	lua_pushnumber(L, [index count: key :key_part_count]);
+	return 1;
+}
+
+/**
+ * Lua index rank: the number of tuples preceding the given
+ * tuple in the index order, i.e. its 0-based position.
+ */
+static int
+lbox_index_rank(struct lua_State *L)
+{
+	Index *index = lua_checkindex(L, 1);
+	index_check_ready(index);
+	if (lua_gettop(L) != 2)
+		luaL_error(L, "index.rank(): bad arguments");
+	struct tuple *tuple = lua_checktuple(L, 2);
+	lua_pushnumber(L, [index rank: tuple]);
 	return 1;
 }
 
@@ -897,6 +909,7 @@ static const struct luaL_reg lbox_index_meta[] = {
 	{"next", lbox_index_next},
 	{"iterator", lbox_index_iterator},
 	{"count", lbox_index_count},
+	{"rank", lbox_index_rank},
 	{NULL, NULL}
 };
 
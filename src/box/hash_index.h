@@ -33,7 +33,20 @@
 
 @class Index;
 
-@interface HashIndex: Index
+/**
+ * Hash table implementations, selected with hash_index_engine
+ * configuration option.
+ */
+#define HASH_ENGINE(_)                                            \
+	_(MHASH, 0)       /* include/mhash.h */                   \
+	_(SHASH, 1)       /* Swiss table, include/shash.h */      \
+
+ENUM(hash_engine, HASH_ENGINE);
+extern const char *hash_engine_strs[];
+
+@interface HashIndex: Index {
+	enum hash_engine engine;
+};
 
 + (struct index_traits *) traits;
 + (HashIndex *) alloc: (struct key_def *) key_def :(struct space *) space;
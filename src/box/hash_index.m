@@ -34,28 +34,275 @@
 #include "space.h"
 #include "assoc.h"
 #include "errinj.h"
+#include <salloc.h>
+#include <cfg/tarantool_box_cfg.h>
+
+STRS(hash_engine, HASH_ENGINE);
+
+/*
+ * Maps: (i32), (i64), (char *) => (struct tuple *)
+ *
+ * Same as the maps of assoc.h, but nodes refer to tuples with
+ * compressed 32-bit pointers, see salloc_ptr_to_ref(), which
+ * makes int32 nodes half as big.
+ */
+#define MH_SOURCE 1
+#define SH_SOURCE 1
+#define mh_name _i32tuple
+struct mh_i32tuple_node_t {
+	i32 key;
+	u32 val;
+};
+
+#define mh_node_t struct mh_i32tuple_node_t
+#define mh_int_t u32
+#define mh_hash_arg_t void *
+#define mh_hash(a, arg) (a->key)
+#define mh_eq_arg_t void *
+#define mh_eq(a, b, arg) ((a->key) == (b->key))
+#include <mhash.h>
+
+#define mh_name _i64tuple
+struct mh_i64tuple_node_t {
+	i64 key;
+	u32 val;
+} __attribute__((packed));
+
+#define mh_node_t struct mh_i64tuple_node_t
+#define mh_int_t u32
+#define mh_hash_arg_t void *
+#define mh_hash(a, arg) ((u32)((a->key)>>33^(a->key)^(a->key)<<11))
+#define mh_eq_arg_t void *
+#define mh_eq(a, b, arg) ((a->key) == (b->key))
+#include <mhash.h>
+
+/* The key hash is cached in the node, see mh_lstrptr_node_t. */
+#define mh_name _lstrtuple
+struct mh_lstrtuple_node_t {
+	const void *key;
+	u32 val;
+	u32 hash;
+};
+
+#define mh_node_t struct mh_lstrtuple_node_t
+#define mh_int_t u32
+#define mh_hash_arg_t void *
+#define mh_hash(a, arg) ((a)->hash)
+#define mh_eq_arg_t void *
+#define mh_eq(a, b, arg) ((a)->hash == (b)->hash && \
+			  lstrcmp(a->key, b->key) == 0)
+#include <mhash.h>
+
+#define sh_name _i32tuple
+#define sh_node_t struct mh_i32tuple_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((a)->key)
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->key == (b)->key)
+#include <shash.h>
+
+#define sh_name _i64tuple
+#define sh_node_t struct mh_i64tuple_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((u32)((a)->key >> 32 ^ (a)->key))
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->key == (b)->key)
+#include <shash.h>
+
+#define sh_name _lstrtuple
+#define sh_node_t struct mh_lstrtuple_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((a)->hash)
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->hash == (b)->hash && \
+			  lstrcmp((a)->key, (b)->key) == 0)
+#include <shash.h>
+#undef SH_SOURCE
+
+/*
+ * Map: (multipart key) => (struct tuple *)
+ *
+ * Nodes hold just a tuple, the key parts are found in the
+ * tuple data. A node with a NULL tuple is a lookup node,
+ * the key parts of which are passed in the hash argument.
+ */
+struct multi_key {
+	struct key_def *key_def;
+	/** Parts of the looked up key, NULL when hashing tuples. */
+	const void **parts;
+};
+
+/** Find the key parts of a tuple, in the order of key_def parts. */
+static inline void
+tuple_key_parts(struct tuple *tuple, const struct key_def *key_def,
+		const void **parts)
+{
+	if (key_def->max_fieldno <= tuple->field_map_count) {
+		u32 *field_map = tuple_field_map(tuple);
+		for (int part = 0; part < key_def->part_count; part++)
+			parts[part] = tuple->data +
+				field_map[key_def->parts[part].fieldno];
+		return;
+	}
+
+	const void *field = tuple->data;
+	for (int f = 0; f < key_def->max_fieldno; f++) {
+		int part = key_def->cmp_order[f];
+		if (part != -1)
+			parts[part] = field;
+		u32 len = load_varint32(&field);
+		field += len;
+	}
+}
+
+/** Combined hash of all key parts, field sizes included. */
+static inline u32
+key_parts_hash(const void **parts, int part_count)
+{
+	u32 h = 13, carry = 0, total = 0;
+	for (int i = 0; i < part_count; i++) {
+		const void *data = parts[i];
+		u32 len = load_varint32(&data);
+		len += data - parts[i];
+		PMurHash32_Process(&h, &carry, parts[i], len);
+		total += len;
+	}
+	return PMurHash32_Result(h, carry, total);
+}
+
+static inline bool
+key_parts_eq(const void **a, const void **b, int part_count)
+{
+	for (int i = 0; i < part_count; i++) {
+		const void *data = a[i];
+		u32 len = load_varint32(&data);
+		len += data - a[i];
+		if (memcmp(a[i], b[i], len) != 0)
+			return false;
+	}
+	return true;
+}
+
+#define mh_name _multiptr
+struct mh_multiptr_node_t {
+	u32 val;
+};
+
+#define mh_node_t struct mh_multiptr_node_t
+#define mh_int_t u32
+#define mh_hash_arg_t struct multi_key *
+static inline u32
+mh_multiptr_hash(const mh_node_t *a, mh_hash_arg_t arg)
+{
+	int part_count = arg->key_def->part_count;
+	if (a->val == 0)
+		return key_parts_hash(arg->parts, part_count);
+	const void *parts[part_count];
+	tuple_key_parts(salloc_ptr_from_ref(a->val), arg->key_def, parts);
+	return key_parts_hash(parts, part_count);
+}
+#define mh_hash(a, arg) mh_multiptr_hash(a, arg)
+#define mh_eq_arg_t struct multi_key *
+static inline bool
+mh_multiptr_eq(const mh_node_t *a, const mh_node_t *b, mh_eq_arg_t arg)
+{
+	int part_count = arg->key_def->part_count;
+	const void *a_parts[part_count], *b_parts[part_count];
+	const void **pa = a_parts;
+	if (a->val == 0)
+		pa = arg->parts;
+	else
+		tuple_key_parts(salloc_ptr_from_ref(a->val), arg->key_def,
+				a_parts);
+	tuple_key_parts(salloc_ptr_from_ref(b->val), arg->key_def, b_parts);
+	return key_parts_eq(pa, b_parts, part_count);
+}
+#define mh_eq(a, b, arg) mh_multiptr_eq(a, b, arg)
+#include <mhash.h>
+#undef MH_SOURCE
 
 static struct index_traits hash_index_traits = {
 	.allows_partial_key = false,
 };
 
+/**
+ * Body of replace: of a single part hash index. Both hash
+ * engines share node types and interface, so the same code
+ * works for either of them: @a mh is the prefix of the map
+ * functions (mh or sh), @a name is the map name.
+ */
+#define HASH_REPLACE(mh, name, hash, tuple_to_node, what) do {		\
+	struct mh_##name##_node_t new_node, old_node;			\
+	uint32_t errcode;						\
+									\
+	if (new_tuple) {						\
+		struct mh_##name##_node_t *dup_node = &old_node;	\
+		new_node = tuple_to_node(new_tuple, key_def);		\
+		mh_int_t pos = mh##_##name##_replace(hash, &new_node,	\
+						     &dup_node, NULL, NULL);\
+									\
+		ERROR_INJECT(ERRINJ_INDEX_ALLOC,			\
+		{							\
+			mh##_##name##_del(hash, pos, NULL, NULL);	\
+			pos = mh##_end(hash);				\
+		});							\
+									\
+		if (pos == mh##_end(hash)) {				\
+			tnt_raise(LoggedError, :ER_MEMORY_ISSUE,	\
+				  (ssize_t) pos, what, "key");		\
+		}							\
+		struct tuple *dup_tuple = dup_node ?			\
+			salloc_ptr_from_ref(dup_node->val) : NULL;	\
+		errcode = replace_check_dup(old_tuple, dup_tuple, mode);\
+									\
+		if (errcode) {						\
+			mh##_##name##_remove(hash, &new_node, NULL, NULL);\
+			if (dup_node) {					\
+				pos = mh##_##name##_replace(hash, dup_node,\
+							NULL, NULL, NULL);\
+				if (pos == mh##_end(hash)) {		\
+					panic("Failed to allocate memory in "\
+					      "recover of " what);	\
+				}					\
+			}						\
+			tnt_raise(ClientError, :errcode, index_n(self));\
+		}							\
+		if (dup_tuple)						\
+			return dup_tuple;				\
+	}								\
+	if (old_tuple) {						\
+		old_node = tuple_to_node(old_tuple, key_def);		\
+		mh##_##name##_remove(hash, &old_node, NULL, NULL);	\
+	}								\
+	return old_tuple;						\
+} while (0)
+
 /* {{{ HashIndex Iterators ****************************************/
 
 struct hash_i32_iterator {
 	struct iterator base; /* Must be the first member. */
-	struct mh_i32ptr_t *hash;
+	struct mh_i32tuple_t *hash;
+	struct sh_i32tuple_t *sh_hash;
 	mh_int_t h_pos;
 };
 
 struct hash_i64_iterator {
 	struct iterator base;
-	struct mh_i64ptr_t *hash;
+	struct mh_i64tuple_t *hash;
+	struct sh_i64tuple_t *sh_hash;
 	mh_int_t h_pos;
 };
 
 struct hash_lstr_iterator {
 	struct iterator base;
-	struct mh_lstrptr_t *hash;
+	struct mh_lstrtuple_t *hash;
+	struct sh_lstrtuple_t *sh_hash;
+	mh_int_t h_pos;
+};
+
+struct hash_multi_iterator {
+	struct iterator base;
+	struct mh_multiptr_t *hash;
 	mh_int_t h_pos;
 };
 
@@ -72,9 +319,19 @@ hash_iterator_i32_ge(struct iterator *ptr)
 	assert(ptr->free == hash_iterator_free);
 	struct hash_i32_iterator *it = (struct hash_i32_iterator *) ptr;
 
+	if (it->sh_hash != NULL) {
+		while (it->h_pos < sh_end(it->sh_hash)) {
+			if (sh_exist(it->sh_hash, it->h_pos))
+				return salloc_ptr_from_ref(
+					sh_i32tuple_node(it->sh_hash, it->h_pos++)->val);
+			it->h_pos++;
+		}
+		return NULL;
+	}
 	while (it->h_pos < mh_end(it->hash)) {
 		if (mh_exist(it->hash, it->h_pos))
-			return mh_i32ptr_node(it->hash, it->h_pos++)->val;
+			return salloc_ptr_from_ref(
+				mh_i32tuple_node(it->hash, it->h_pos++)->val);
 		it->h_pos++;
 	}
 	return NULL;
@@ -86,9 +343,19 @@ hash_iterator_i64_ge(struct iterator *ptr)
 	assert(ptr->free == hash_iterator_free);
 	struct hash_i64_iterator *it = (struct hash_i64_iterator *) ptr;
 
+	if (it->sh_hash != NULL) {
+		while (it->h_pos < sh_end(it->sh_hash)) {
+			if (sh_exist(it->sh_hash, it->h_pos))
+				return salloc_ptr_from_ref(
+					sh_i64tuple_node(it->sh_hash, it->h_pos++)->val);
+			it->h_pos++;
+		}
+		return NULL;
+	}
 	while (it->h_pos < mh_end(it->hash)) {
 		if (mh_exist(it->hash, it->h_pos))
-			return mh_i64ptr_node(it->hash, it->h_pos++)->val;
+			return salloc_ptr_from_ref(
+				mh_i64tuple_node(it->hash, it->h_pos++)->val);
 		it->h_pos++;
 	}
 	return NULL;
@@ -100,9 +367,34 @@ hash_iterator_lstr_ge(struct iterator *ptr)
 	assert(ptr->free == hash_iterator_free);
 	struct hash_lstr_iterator *it = (struct hash_lstr_iterator *) ptr;
 
+	if (it->sh_hash != NULL) {
+		while (it->h_pos < sh_end(it->sh_hash)) {
+			if (sh_exist(it->sh_hash, it->h_pos))
+				return salloc_ptr_from_ref(
+					sh_lstrtuple_node(it->sh_hash, it->h_pos++)->val);
+			it->h_pos++;
+		}
+		return NULL;
+	}
+	while (it->h_pos < mh_end(it->hash)) {
+		if (mh_exist(it->hash, it->h_pos))
+			return salloc_ptr_from_ref(
+				mh_lstrtuple_node(it->hash, it->h_pos++)->val);
+		it->h_pos++;
+	}
+	return NULL;
+}
+
+struct tuple *
+hash_iterator_multi_ge(struct iterator *ptr)
+{
+	assert(ptr->free == hash_iterator_free);
+	struct hash_multi_iterator *it = (struct hash_multi_iterator *) ptr;
+
 	while (it->h_pos < mh_end(it->hash)) {
 		if (mh_exist(it->hash, it->h_pos))
-			return mh_lstrptr_node(it->hash, it->h_pos++)->val;
+			return salloc_ptr_from_ref(
+				mh_multiptr_node(it->hash, it->h_pos++)->val);
 		it->h_pos++;
 	}
 	return NULL;
@@ -135,26 +427,43 @@ hash_iterator_lstr_eq(struct iterator *it)
 	return hash_iterator_lstr_ge(it);
 }
 
+static struct tuple *
+hash_iterator_multi_eq(struct iterator *it)
+{
+	it->next = hash_iterator_eq_next;
+	return hash_iterator_multi_ge(it);
+}
+
 /* }}} */
 
 /* {{{ HashIndex -- base class for all hashes. ********************/
 
 @interface Hash32Index: HashIndex {
-	 struct mh_i32ptr_t *int_hash;
+	struct mh_i32tuple_t *int_hash;
+	struct sh_i32tuple_t *int_sh_hash;
 };
 
 - (id) init: (struct key_def *) key_def_arg :(struct space *) space_arg;
 @end
 
 @interface Hash64Index: HashIndex {
-	struct mh_i64ptr_t *int64_hash;
+	struct mh_i64tuple_t *int64_hash;
+	struct sh_i64tuple_t *int64_sh_hash;
 };
 
 - (id) init: (struct key_def *) key_def_arg :(struct space *) space_arg;
 @end
 
 @interface HashStrIndex: HashIndex {
-	struct mh_lstrptr_t *str_hash;
+	struct mh_lstrtuple_t *str_hash;
+	struct sh_lstrtuple_t *str_sh_hash;
+};
+
+- (id) init: (struct key_def *) key_def_arg :(struct space *) space_arg;
+@end
+
+@interface HashMultiIndex: HashIndex {
+	struct mh_multiptr_t *multi_hash;
 };
 
 - (id) init: (struct key_def *) key_def_arg :(struct space *) space_arg;
@@ -171,9 +480,10 @@ hash_iterator_lstr_eq(struct iterator *it)
 {
 	(void) space;
 
-	/*
-	 * Hash index always has a single-field key.
-	 */
+	/* A multipart key hashes all its parts at once. */
+	if (key_def->part_count > 1)
+		return [HashMultiIndex alloc];
+
 	switch (key_def->parts[0].type) {
 	case NUM:
 		return [Hash32Index alloc];  /* 32-bit integer hash */
@@ -188,6 +498,17 @@ hash_iterator_lstr_eq(struct iterator *it)
 	return NULL;
 }
 
+- (id) init: (struct key_def *) key_def_arg :(struct space *) space_arg
+{
+	self = [super init: key_def_arg :space_arg];
+	if (self == NULL)
+		return NULL;
+
+	engine = STR2ENUM(hash_engine, cfg.hash_index_engine);
+	assert(engine != hash_engine_MAX);
+	return self;
+}
+
 - (void) reserve: (u32) n_tuples
 {
 	(void) n_tuples;
@@ -207,10 +528,8 @@ hash_iterator_lstr_eq(struct iterator *it)
 {
 }
 
-- (void) build: (Index *) pk
+- (void) build: (struct tuple **) tuples :(u32) n_tuples
 {
-	u32 n_tuples = [pk size];
-
 	if (n_tuples == 0)
 		return;
 
@@ -219,12 +538,8 @@ hash_iterator_lstr_eq(struct iterator *it)
 	say_info("Adding %"PRIu32 " keys to HASH index %"
 		 PRIu32 "...", n_tuples, index_n(self));
 
-	struct iterator *it = pk->position;
-	struct tuple *tuple;
-	[pk initIterator: it :ITER_ALL :NULL :0];
-
-	while ((tuple = it->next(it)))
-	      [self replace: NULL :tuple :DUP_INSERT];
+	for (u32 i = 0; i < n_tuples; ++i)
+	      [self replace: NULL :tuples[i] :DUP_INSERT];
 }
 
 - (void) free
@@ -261,22 +576,22 @@ hash_iterator_lstr_eq(struct iterator *it)
 
 /* {{{ Hash32Index ************************************************/
 
-static inline struct mh_i32ptr_node_t
+static inline struct mh_i32tuple_node_t
 int32_key_to_node(const void *key)
 {
 	u32 key_size = load_varint32(&key);
 	if (key_size != 4)
 		tnt_raise(ClientError, :ER_KEY_FIELD_TYPE, "u32");
-	struct mh_i32ptr_node_t node = { .key = *(u32 *) key };
+	struct mh_i32tuple_node_t node = { .key = *(u32 *) key };
 	return node;
 }
 
-static inline struct mh_i32ptr_node_t
+static inline struct mh_i32tuple_node_t
 int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 {
 	void *field = tuple_field(tuple, key_def->parts[0].fieldno);
-	struct mh_i32ptr_node_t node = int32_key_to_node(field);
-	node.val = tuple;
+	struct mh_i32tuple_node_t node = int32_key_to_node(field);
+	node.val = salloc_ptr_to_ref(tuple);
 	return node;
 }
 
@@ -284,12 +599,18 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 
 - (void) reserve: (u32) n_tuples
 {
-	mh_i32ptr_reserve(int_hash, n_tuples, NULL, NULL);
+	if (engine == SHASH)
+		sh_i32tuple_reserve(int_sh_hash, n_tuples, NULL, NULL);
+	else
+		mh_i32tuple_reserve(int_hash, n_tuples, NULL, NULL);
 }
 
 - (void) free
 {
-	mh_i32ptr_delete(int_hash);
+	if (engine == SHASH)
+		sh_i32tuple_delete(int_sh_hash);
+	else
+		mh_i32tuple_delete(int_hash);
 	[super free];
 }
 
@@ -300,12 +621,20 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 	if (self == NULL)
 		return NULL;
 
-	int_hash = mh_i32ptr_new();
+	if (engine == SHASH) {
+		int_sh_hash = sh_i32tuple_new();
+		if (int_sh_hash == NULL)
+			panic("can't allocate int hash");
+	} else {
+		int_hash = mh_i32tuple_new();
+	}
 	return self;
 }
 
 - (size_t) size
 {
+	if (engine == SHASH)
+		return sh_size(int_sh_hash);
 	return mh_size(int_hash);
 }
 
@@ -317,10 +646,18 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 	(void) part_count;
 
 	struct tuple *ret = NULL;
-	struct mh_i32ptr_node_t node = int32_key_to_node(key);
-	mh_int_t k = mh_i32ptr_get(int_hash, &node, NULL, NULL);
-	if (k != mh_end(int_hash))
-		ret = mh_i32ptr_node(int_hash, k)->val;
+	struct mh_i32tuple_node_t node = int32_key_to_node(key);
+	if (engine == SHASH) {
+		sh_int_t k = sh_i32tuple_get(int_sh_hash, &node, NULL, NULL);
+		if (k != sh_end(int_sh_hash))
+			ret = salloc_ptr_from_ref(
+				sh_i32tuple_node(int_sh_hash, k)->val);
+	} else {
+		mh_int_t k = mh_i32tuple_get(int_hash, &node, NULL, NULL);
+		if (k != mh_end(int_hash))
+			ret = salloc_ptr_from_ref(
+				mh_i32tuple_node(int_hash, k)->val);
+	}
 #ifdef DEBUG
 	say_debug("Hash32Index find(self:%p, key:%i) = %p", self, node.key, ret);
 #endif
@@ -331,48 +668,11 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			  :(struct tuple *) new_tuple
 			  :(enum dup_replace_mode) mode
 {
-	struct mh_i32ptr_node_t new_node, old_node;
-	uint32_t errcode;
-
-	if (new_tuple) {
-		struct mh_i32ptr_node_t *dup_node = &old_node;
-		new_node = int32_tuple_to_node(new_tuple, key_def);
-		mh_int_t pos = mh_i32ptr_replace(int_hash, &new_node,
-						 &dup_node, NULL, NULL);
-
-		ERROR_INJECT(ERRINJ_INDEX_ALLOC,
-		{
-			mh_i32ptr_del(int_hash, pos, NULL, NULL);
-			pos = mh_end(int_hash);
-		});
-
-		if (pos == mh_end(int_hash)) {
-			tnt_raise(LoggedError, :ER_MEMORY_ISSUE, (ssize_t) pos,
-				  "int hash", "key");
-		}
-		struct tuple *dup_tuple = dup_node ? dup_node->val : NULL;
-		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
-
-		if (errcode) {
-			mh_i32ptr_remove(int_hash, &new_node, NULL, NULL);
-			if (dup_node) {
-				pos = mh_i32ptr_replace(int_hash, dup_node,
-							NULL, NULL, NULL);
-				if (pos == mh_end(int_hash)) {
-					panic("Failed to allocate memory in "
-					      "recover of int hash");
-				}
-			}
-			tnt_raise(ClientError, :errcode, index_n(self));
-		}
-		if (dup_tuple)
-			return dup_tuple;
-	}
-	if (old_tuple) {
-		old_node = int32_tuple_to_node(old_tuple, key_def);
-		mh_i32ptr_remove(int_hash, &old_node, NULL, NULL);
-	}
-	return old_tuple;
+	if (engine == SHASH)
+		HASH_REPLACE(sh, i32tuple, int_sh_hash,
+			     int32_tuple_to_node, "int hash");
+	HASH_REPLACE(mh, i32tuple, int_hash,
+		     int32_tuple_to_node, "int hash");
 }
 
 
@@ -392,7 +692,7 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 {
 	assert(ptr->free == hash_iterator_free);
 	struct hash_i32_iterator *it = (struct hash_i32_iterator *) ptr;
-	struct mh_i32ptr_node_t node;
+	struct mh_i32tuple_node_t node;
 
 	switch (type) {
 	case ITER_GE:
@@ -400,7 +700,9 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			check_key_parts(key_def, part_count,
 					traits->allows_partial_key);
 			node = int32_key_to_node(key);
-			it->h_pos = mh_i32ptr_get(int_hash, &node, NULL, NULL);
+			it->h_pos = engine == SHASH ?
+				sh_i32tuple_get(int_sh_hash, &node, NULL, NULL) :
+				mh_i32tuple_get(int_hash, &node, NULL, NULL);
 			it->base.next = hash_iterator_i32_ge;
 			break;
 		}
@@ -413,7 +715,9 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 		check_key_parts(key_def, part_count,
 				traits->allows_partial_key);
 		node = int32_key_to_node(key);
-		it->h_pos = mh_i32ptr_get(int_hash, &node, NULL, NULL);
+		it->h_pos = engine == SHASH ?
+			sh_i32tuple_get(int_sh_hash, &node, NULL, NULL) :
+			mh_i32tuple_get(int_hash, &node, NULL, NULL);
 		it->base.next = hash_iterator_i32_eq;
 		break;
 	default:
@@ -421,6 +725,7 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			  "Hash index", "requested iterator type");
 	}
 	it->hash = int_hash;
+	it->sh_hash = int_sh_hash;
 }
 @end
 
@@ -428,34 +733,40 @@ int32_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 
 /* {{{ Hash64Index ************************************************/
 
-static inline struct mh_i64ptr_node_t
+static inline struct mh_i64tuple_node_t
 int64_key_to_node(const void *key)
 {
 	u32 key_size = load_varint32(&key);
 	if (key_size != 8)
 		tnt_raise(ClientError, :ER_KEY_FIELD_TYPE, "u64");
-	struct mh_i64ptr_node_t node = { .key = *(u64 *) key };
+	struct mh_i64tuple_node_t node = { .key = *(u64 *) key };
 	return node;
 }
 
-static inline struct mh_i64ptr_node_t
+static inline struct mh_i64tuple_node_t
 int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 {
 	void *field = tuple_field(tuple, key_def->parts[0].fieldno);
-	struct mh_i64ptr_node_t node = int64_key_to_node(field);
-	node.val = tuple;
+	struct mh_i64tuple_node_t node = int64_key_to_node(field);
+	node.val = salloc_ptr_to_ref(tuple);
 	return node;
 }
 
 @implementation Hash64Index
 - (void) reserve: (u32) n_tuples
 {
-	mh_i64ptr_reserve(int64_hash, n_tuples, NULL, NULL);
+	if (engine == SHASH)
+		sh_i64tuple_reserve(int64_sh_hash, n_tuples, NULL, NULL);
+	else
+		mh_i64tuple_reserve(int64_hash, n_tuples, NULL, NULL);
 }
 
 - (void) free
 {
-	mh_i64ptr_delete(int64_hash);
+	if (engine == SHASH)
+		sh_i64tuple_delete(int64_sh_hash);
+	else
+		mh_i64tuple_delete(int64_hash);
 	[super free];
 }
 
@@ -465,12 +776,20 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 	if (self == NULL)
 		return NULL;
 
-	int64_hash = mh_i64ptr_new();
+	if (engine == SHASH) {
+		int64_sh_hash = sh_i64tuple_new();
+		if (int64_sh_hash == NULL)
+			panic("can't allocate int64 hash");
+	} else {
+		int64_hash = mh_i64tuple_new();
+	}
 	return self;
 }
 
 - (size_t) size
 {
+	if (engine == SHASH)
+		return sh_size(int64_sh_hash);
 	return mh_size(int64_hash);
 }
 
@@ -480,10 +799,18 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 	check_key_parts(key_def, part_count, false);
 
 	struct tuple *ret = NULL;
-	struct mh_i64ptr_node_t node = int64_key_to_node(key);
-	mh_int_t k = mh_i64ptr_get(int64_hash, &node, NULL, NULL);
-	if (k != mh_end(int64_hash))
-		ret = mh_i64ptr_node(int64_hash, k)->val;
+	struct mh_i64tuple_node_t node = int64_key_to_node(key);
+	if (engine == SHASH) {
+		sh_int_t k = sh_i64tuple_get(int64_sh_hash, &node, NULL, NULL);
+		if (k != sh_end(int64_sh_hash))
+			ret = salloc_ptr_from_ref(
+				sh_i64tuple_node(int64_sh_hash, k)->val);
+	} else {
+		mh_int_t k = mh_i64tuple_get(int64_hash, &node, NULL, NULL);
+		if (k != mh_end(int64_hash))
+			ret = salloc_ptr_from_ref(
+				mh_i64tuple_node(int64_hash, k)->val);
+	}
 #ifdef DEBUG
 	say_debug("Hash64Index find(self:%p, key:%"PRIu64") = %p", self, node.key, ret);
 #endif
@@ -494,47 +821,11 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			  :(struct tuple *) new_tuple
 			  :(enum dup_replace_mode) mode
 {
-	struct mh_i64ptr_node_t new_node, old_node;
-	uint32_t errcode;
-
-	if (new_tuple) {
-		struct mh_i64ptr_node_t *dup_node = &old_node;
-		new_node = int64_tuple_to_node(new_tuple, key_def);
-		mh_int_t pos = mh_i64ptr_replace(int64_hash, &new_node,
-						 &dup_node, NULL, NULL);
-
-		ERROR_INJECT(ERRINJ_INDEX_ALLOC,
-		{
-			mh_i64ptr_del(int64_hash, pos, NULL, NULL);
-			pos = mh_end(int64_hash);
-		});
-		if (pos == mh_end(int64_hash)) {
-			tnt_raise(LoggedError, :ER_MEMORY_ISSUE, (ssize_t) pos,
-				  "int64 hash", "key");
-		}
-		struct tuple *dup_tuple = dup_node ? dup_node->val : NULL;
-		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
-
-		if (errcode) {
-			mh_i64ptr_remove(int64_hash, &new_node, NULL, NULL);
-			if (dup_node) {
-				pos = mh_i64ptr_replace(int64_hash, dup_node,
-							NULL, NULL, NULL);
-				if (pos == mh_end(int64_hash)) {
-					panic("Failed to allocate memory in "
-					      "recover of int64 hash");
-				}
-			}
-			tnt_raise(ClientError, :errcode, index_n(self));
-		}
-		if (dup_tuple)
-			return dup_tuple;
-	}
-	if (old_tuple) {
-		old_node = int64_tuple_to_node(old_tuple, key_def);
-		mh_i64ptr_remove(int64_hash, &old_node, NULL, NULL);
-	}
-	return old_tuple;
+	if (engine == SHASH)
+		HASH_REPLACE(sh, i64tuple, int64_sh_hash,
+			     int64_tuple_to_node, "int64 hash");
+	HASH_REPLACE(mh, i64tuple, int64_hash,
+		     int64_tuple_to_node, "int64 hash");
 }
 
 
@@ -556,7 +847,7 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 	(void) part_count;
 	assert(ptr->free == hash_iterator_free);
 	struct hash_i64_iterator *it = (struct hash_i64_iterator *) ptr;
-	struct mh_i64ptr_node_t node;
+	struct mh_i64tuple_node_t node;
 
 	switch (type) {
 	case ITER_GE:
@@ -564,7 +855,9 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			check_key_parts(key_def, part_count,
 					traits->allows_partial_key);
 			node = int64_key_to_node(key);
-			it->h_pos = mh_i64ptr_get(int64_hash, &node, NULL, NULL);
+			it->h_pos = engine == SHASH ?
+				sh_i64tuple_get(int64_sh_hash, &node, NULL, NULL) :
+				mh_i64tuple_get(int64_hash, &node, NULL, NULL);
 			it->base.next = hash_iterator_i64_ge;
 			break;
 		}
@@ -577,7 +870,9 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 		check_key_parts(key_def, part_count,
 				traits->allows_partial_key);
 		node = int64_key_to_node(key);
-		it->h_pos = mh_i64ptr_get(int64_hash, &node, NULL, NULL);
+		it->h_pos = engine == SHASH ?
+			sh_i64tuple_get(int64_sh_hash, &node, NULL, NULL) :
+			mh_i64tuple_get(int64_hash, &node, NULL, NULL);
 		it->base.next = hash_iterator_i64_eq;
 		break;
 	default:
@@ -585,6 +880,7 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			  "Hash index", "requested iterator type");
 	}
 	it->hash = int64_hash;
+	it->sh_hash = int64_sh_hash;
 }
 @end
 
@@ -592,7 +888,7 @@ int64_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 
 /* {{{ HashStrIndex ***********************************************/
 
-static inline struct mh_lstrptr_node_t
+static inline struct mh_lstrtuple_node_t
 lstrptr_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 {
 	void *field = tuple_field(tuple, key_def->parts[0].fieldno);
@@ -600,7 +896,10 @@ lstrptr_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 		tnt_raise(ClientError, :ER_NO_SUCH_FIELD,
 			  key_def->parts[0].fieldno);
 
-	struct mh_lstrptr_node_t node = { .key = field, .val = tuple };
+	struct mh_lstrtuple_node_t node = {
+		.key = field, .val = salloc_ptr_to_ref(tuple),
+		.hash = lstrhash(field)
+	};
 	return node;
 }
 
@@ -608,12 +907,18 @@ lstrptr_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 @implementation HashStrIndex
 - (void) reserve: (u32) n_tuples
 {
-	mh_lstrptr_reserve(str_hash, n_tuples, NULL, NULL);
+	if (engine == SHASH)
+		sh_lstrtuple_reserve(str_sh_hash, n_tuples, NULL, NULL);
+	else
+		mh_lstrtuple_reserve(str_hash, n_tuples, NULL, NULL);
 }
 
 - (void) free
 {
-	mh_lstrptr_delete(str_hash);
+	if (engine == SHASH)
+		sh_lstrtuple_delete(str_sh_hash);
+	else
+		mh_lstrtuple_delete(str_hash);
 	[super free];
 }
 
@@ -623,12 +928,20 @@ lstrptr_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 	if (self == NULL)
 		return NULL;
 
-	str_hash = mh_lstrptr_new();
+	if (engine == SHASH) {
+		str_sh_hash = sh_lstrtuple_new();
+		if (str_sh_hash == NULL)
+			panic("can't allocate str hash");
+	} else {
+		str_hash = mh_lstrtuple_new();
+	}
 	return self;
 }
 
 - (size_t) size
 {
+	if (engine == SHASH)
+		return sh_size(str_sh_hash);
 	return mh_size(str_hash);
 }
 
@@ -638,10 +951,20 @@ lstrptr_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 	check_key_parts(key_def, part_count, false);
 
 	struct tuple *ret = NULL;
-	const struct mh_lstrptr_node_t node = { .key = key };
-	mh_int_t k = mh_lstrptr_get(str_hash, &node, NULL, NULL);
-	if (k != mh_end(str_hash))
-		ret = mh_lstrptr_node(str_hash, k)->val;
+	const struct mh_lstrtuple_node_t node = {
+		.key = key, .hash = lstrhash(key)
+	};
+	if (engine == SHASH) {
+		sh_int_t k = sh_lstrtuple_get(str_sh_hash, &node, NULL, NULL);
+		if (k != sh_end(str_sh_hash))
+			ret = salloc_ptr_from_ref(
+				sh_lstrtuple_node(str_sh_hash, k)->val);
+	} else {
+		mh_int_t k = mh_lstrtuple_get(str_hash, &node, NULL, NULL);
+		if (k != mh_end(str_hash))
+			ret = salloc_ptr_from_ref(
+				mh_lstrtuple_node(str_hash, k)->val);
+	}
 #ifdef DEBUG
 	u32 key_size = load_varint32((const void **) &key);
 	say_debug("HashStrIndex find(self:%p, key:(%i)'%.*s') = %p",
@@ -654,36 +977,197 @@ lstrptr_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			  :(struct tuple *) new_tuple
 			  :(enum dup_replace_mode) mode
 {
-	struct mh_lstrptr_node_t new_node, old_node;
+	if (engine == SHASH)
+		HASH_REPLACE(sh, lstrtuple, str_sh_hash,
+			     lstrptr_tuple_to_node, "str hash");
+	HASH_REPLACE(mh, lstrtuple, str_hash,
+		     lstrptr_tuple_to_node, "str hash");
+}
+
+- (struct iterator *) allocIterator
+{
+	struct hash_lstr_iterator *it = malloc(sizeof(struct hash_lstr_iterator));
+	if (it) {
+		memset(it, 0, sizeof(*it));
+		it->base.next = hash_iterator_lstr_ge;
+		it->base.free = hash_iterator_free;
+	}
+	return (struct iterator *) it;
+}
+
+
+- (void) initIterator: (struct iterator *) ptr
+			:(enum iterator_type) type
+                        :(void *) key :(int) part_count
+{
+	(void) part_count;
+
+	assert(ptr->free == hash_iterator_free);
+	struct hash_lstr_iterator *it = (struct hash_lstr_iterator *) ptr;
+	struct mh_lstrtuple_node_t node;
+
+	switch (type) {
+	case ITER_GE:
+		if (key != NULL) {
+			check_key_parts(key_def, part_count,
+					traits->allows_partial_key);
+			node.key = key;
+			node.hash = lstrhash(key);
+			it->h_pos = engine == SHASH ?
+				sh_lstrtuple_get(str_sh_hash, &node, NULL, NULL) :
+				mh_lstrtuple_get(str_hash, &node, NULL, NULL);
+			it->base.next = hash_iterator_lstr_ge;
+			break;
+		}
+		/* Fall through. */
+	case ITER_ALL:
+		it->base.next = hash_iterator_lstr_ge;
+		it->h_pos = mh_begin(str_hash);
+		break;
+	case ITER_EQ:
+		check_key_parts(key_def, part_count,
+				traits->allows_partial_key);
+		node.key = key;
+		node.hash = lstrhash(key);
+		it->h_pos = engine == SHASH ?
+			sh_lstrtuple_get(str_sh_hash, &node, NULL, NULL) :
+			mh_lstrtuple_get(str_hash, &node, NULL, NULL);
+		it->base.next = hash_iterator_lstr_eq;
+		break;
+	default:
+		tnt_raise(ClientError, :ER_UNSUPPORTED,
+			  "Hash index", "requested iterator type");
+	}
+	it->hash = str_hash;
+	it->sh_hash = str_sh_hash;
+}
+@end
+
+/* }}} */
+
+
+/* {{{ HashMultiIndex *********************************************/
+
+/**
+ * Find the parts of a multipart key and check the sizes of
+ * fixed size parts.
+ */
+static inline void
+multi_key_parts(const void *key, struct key_def *key_def,
+		const void **parts)
+{
+	for (int i = 0; i < key_def->part_count; i++) {
+		parts[i] = key;
+		u32 len = load_varint32(&key);
+		if (key_def->parts[i].type == NUM && len != sizeof(u32))
+			tnt_raise(ClientError, :ER_KEY_FIELD_TYPE, "u32");
+		if (key_def->parts[i].type == NUM64 && len != sizeof(u64))
+			tnt_raise(ClientError, :ER_KEY_FIELD_TYPE, "u64");
+		key += len;
+	}
+}
+
+@implementation HashMultiIndex
+- (void) reserve: (u32) n_tuples
+{
+	struct multi_key arg = { .key_def = key_def, .parts = NULL };
+	mh_multiptr_reserve(multi_hash, n_tuples, &arg, &arg);
+}
+
+- (void) free
+{
+	mh_multiptr_delete(multi_hash);
+	[super free];
+}
+
+- (id) init: (struct key_def *) key_def_arg :(struct space *) space_arg
+{
+	self = [super init: key_def_arg :space_arg];
+	if (self == NULL)
+		return NULL;
+
+	multi_hash = mh_multiptr_new();
+	return self;
+}
+
+- (size_t) size
+{
+	return mh_size(multi_hash);
+}
+
+- (struct tuple *) findByKey: (const void *) key :(int) part_count
+{
+	assert(key_def->is_unique);
+	check_key_parts(key_def, part_count, false);
+
+	const void *parts[key_def->part_count];
+	multi_key_parts(key, key_def, parts);
+
+	struct tuple *ret = NULL;
+	struct multi_key arg = { .key_def = key_def, .parts = parts };
+	const struct mh_multiptr_node_t node = { .val = 0 };
+	mh_int_t k = mh_multiptr_get(multi_hash, &node, &arg, &arg);
+	if (k != mh_end(multi_hash))
+		ret = salloc_ptr_from_ref(mh_multiptr_node(multi_hash, k)->val);
+#ifdef DEBUG
+	say_debug("HashMultiIndex find(self:%p, key:%p) = %p", self, key, ret);
+#endif
+	return ret;
+}
+
+- (struct tuple *) findByTuple: (struct tuple *) tuple
+{
+	assert(key_def->is_unique);
+	if (tuple->field_count < key_def->max_fieldno)
+		tnt_raise(IllegalParams, :"tuple must have all indexed fields");
+
+	struct tuple *ret = NULL;
+	struct multi_key arg = { .key_def = key_def, .parts = NULL };
+	const struct mh_multiptr_node_t node = {
+		.val = salloc_ptr_to_ref(tuple)
+	};
+	mh_int_t k = mh_multiptr_get(multi_hash, &node, &arg, &arg);
+	if (k != mh_end(multi_hash))
+		ret = salloc_ptr_from_ref(mh_multiptr_node(multi_hash, k)->val);
+	return ret;
+}
+
+- (struct tuple *) replace: (struct tuple *) old_tuple
+			  :(struct tuple *) new_tuple
+			  :(enum dup_replace_mode) mode
+{
+	struct multi_key arg = { .key_def = key_def, .parts = NULL };
+	struct mh_multiptr_node_t new_node, old_node;
 	uint32_t errcode;
 
 	if (new_tuple) {
-		struct mh_lstrptr_node_t *dup_node = &old_node;
-		new_node = lstrptr_tuple_to_node(new_tuple, key_def);
-		mh_int_t pos = mh_lstrptr_replace(str_hash, &new_node,
-						  &dup_node, NULL, NULL);
+		struct mh_multiptr_node_t *dup_node = &old_node;
+		new_node.val = salloc_ptr_to_ref(new_tuple);
+		mh_int_t pos = mh_multiptr_replace(multi_hash, &new_node,
+						   &dup_node, &arg, &arg);
 
 		ERROR_INJECT(ERRINJ_INDEX_ALLOC,
 		{
-			mh_lstrptr_del(str_hash, pos, NULL, NULL);
-			pos = mh_end(str_hash);
+			mh_multiptr_del(multi_hash, pos, &arg, &arg);
+			pos = mh_end(multi_hash);
 		});
 
-		if (pos == mh_end(str_hash)) {
+		if (pos == mh_end(multi_hash)) {
 			tnt_raise(LoggedError, :ER_MEMORY_ISSUE, (ssize_t) pos,
-				  "str hash", "key");
+				  "multipart hash", "key");
 		}
-		struct tuple *dup_tuple = dup_node ? dup_node->val : NULL;
+		struct tuple *dup_tuple = dup_node ?
+			salloc_ptr_from_ref(dup_node->val) : NULL;
 		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
 
 		if (errcode) {
-			mh_lstrptr_remove(str_hash, &new_node, NULL, NULL);
+			mh_multiptr_remove(multi_hash, &new_node, &arg, &arg);
 			if (dup_node) {
-				pos = mh_lstrptr_replace(str_hash, dup_node,
-							 NULL, NULL, NULL);
-				if (pos == mh_end(str_hash)) {
+				pos = mh_multiptr_replace(multi_hash, dup_node,
+							  NULL, &arg, &arg);
+				if (pos == mh_end(multi_hash)) {
 					panic("Failed to allocate memory in "
-					      "recover of str hash");
+					      "recover of multipart hash");
 				}
 			}
 			tnt_raise(ClientError, :errcode, index_n(self));
@@ -692,63 +1176,63 @@ lstrptr_tuple_to_node(struct tuple *tuple, struct key_def *key_def)
 			return dup_tuple;
 	}
 	if (old_tuple) {
-		old_node = lstrptr_tuple_to_node(old_tuple, key_def);
-		mh_lstrptr_remove(str_hash, &old_node, NULL, NULL);
+		old_node.val = salloc_ptr_to_ref(old_tuple);
+		mh_multiptr_remove(multi_hash, &old_node, &arg, &arg);
 	}
 	return old_tuple;
 }
 
 - (struct iterator *) allocIterator
 {
-	struct hash_lstr_iterator *it = malloc(sizeof(struct hash_lstr_iterator));
+	struct hash_multi_iterator *it =
+		malloc(sizeof(struct hash_multi_iterator));
 	if (it) {
 		memset(it, 0, sizeof(*it));
-		it->base.next = hash_iterator_lstr_ge;
+		it->base.next = hash_iterator_multi_ge;
 		it->base.free = hash_iterator_free;
 	}
 	return (struct iterator *) it;
 }
 
-
 - (void) initIterator: (struct iterator *) ptr
 			:(enum iterator_type) type
                         :(void *) key :(int) part_count
 {
-	(void) part_count;
-
 	assert(ptr->free == hash_iterator_free);
-	struct hash_lstr_iterator *it = (struct hash_lstr_iterator *) ptr;
-	struct mh_lstrptr_node_t node;
+	struct hash_multi_iterator *it = (struct hash_multi_iterator *) ptr;
+	const void *parts[key_def->part_count];
+	struct multi_key arg = { .key_def = key_def, .parts = parts };
+	const struct mh_multiptr_node_t node = { .val = 0 };
 
 	switch (type) {
 	case ITER_GE:
 		if (key != NULL) {
 			check_key_parts(key_def, part_count,
 					traits->allows_partial_key);
-			node.key = key;
-			it->h_pos = mh_lstrptr_get(str_hash, &node, NULL, NULL);
-			it->base.next = hash_iterator_lstr_ge;
+			multi_key_parts(key, key_def, parts);
+			it->h_pos = mh_multiptr_get(multi_hash, &node,
+						    &arg, &arg);
+			it->base.next = hash_iterator_multi_ge;
 			break;
 		}
 		/* Fall through. */
 	case ITER_ALL:
-		it->base.next = hash_iterator_lstr_ge;
-		it->h_pos = mh_begin(str_hash);
+		it->base.next = hash_iterator_multi_ge;
+		it->h_pos = mh_begin(multi_hash);
 		break;
 	case ITER_EQ:
 		check_key_parts(key_def, part_count,
 				traits->allows_partial_key);
-		node.key = key;
-		it->h_pos = mh_lstrptr_get(str_hash, &node, NULL, NULL);
-		it->base.next = hash_iterator_lstr_eq;
+		multi_key_parts(key, key_def, parts);
+		it->h_pos = mh_multiptr_get(multi_hash, &node, &arg, &arg);
+		it->base.next = hash_iterator_multi_eq;
 		break;
 	default:
 		tnt_raise(ClientError, :ER_UNSUPPORTED,
 			  "Hash index", "requested iterator type");
 	}
-	it->hash = str_hash;
+	it->hash = multi_hash;
 }
 @end
 
 /* }}} */
-
@@ -46,6 +46,7 @@ extern const char *field_data_type_strs[];
 #define INDEX_TYPE(_)                                             \
 	_(HASH,  0)       /* HASH Index  */                       \
 	_(TREE,  1)       /* TREE Index  */                       \
+	_(BITSET, 2)      /* BITSET Index  */                     \
 
 ENUM(index_type, INDEX_TYPE);
 extern const char *index_type_strs[];
@@ -79,6 +80,9 @@ extern const char *index_type_strs[];
 	_(ITER_LE,  4)       /* key <= x                        */   \
 	_(ITER_GE,  5)       /* key >= x                        */   \
 	_(ITER_GT,  6)       /* key >  x                        */   \
+	_(ITER_BITS_ALL_SET,     7) /* all bits from x are set in key      */ \
+	_(ITER_BITS_ANY_SET,     8) /* at least one x's bit is set         */ \
+	_(ITER_BITS_ALL_NOT_SET, 9) /* all bits are not set                */ \
 
 ENUM(iterator_type, ITERATOR_TYPE);
 extern const char *iterator_type_strs[];
@@ -197,8 +201,12 @@ enum dup_replace_mode {
 - (void) beginBuild;
 - (void) buildNext: (struct tuple *)tuple;
 - (void) endBuild;
-/** Build this index based on the contents of another index. */
-- (void) build: (Index *) pk;
+/**
+ * Build this index from the contents of the primary key.
+ * Secondary keys are built in parallel threads, so the
+ * method must not touch anything but the index itself.
+ */
+- (void) build: (struct tuple **) tuples :(u32) n_tuples;
 - (size_t) size;
 - (struct tuple *) min;
 - (struct tuple *) max;
@@ -215,6 +223,24 @@ enum dup_replace_mode {
 - (void) initIterator: (struct iterator *) iterator
 		     :(enum iterator_type) type
 		     :(void *) key :(int) part_count;
+/**
+ * Count tuples matching a key, the same ones an ITER_EQ
+ * iterator would return.
+ */
+- (size_t) count: (void *) key :(int) part_count;
+/**
+ * The number of tuples which precede a tuple of the index in
+ * the order an ITER_ALL iterator returns them.
+ */
+- (size_t) rank: (struct tuple *) tuple;
+/**
+ * Skip up to n tuples of an iterator which has just been
+ * initialized with initIterator.
+ *
+ * @return the number of skipped tuples, which is less than n
+ * only if the iterator is exhausted.
+ */
+- (u32) skip: (struct iterator *) iterator :(u32) n;
 @end
 
 void
@@ -29,6 +29,7 @@
 #include "index.h"
 #include "hash_index.h"
 #include "tree_index.h"
+#include "bitset_index.h"
 #include "tuple.h"
 #include "say.h"
 #include "exception.h"
@@ -108,6 +109,8 @@ replace_check_dup(struct tuple *old_tuple,
 		return [HashIndex alloc: key_def :space];
 	case TREE:
 		return [TreeIndex alloc: key_def :space];
+	case BITSET:
+		return [BitsetIndex alloc];
 	default:
 		assert(false);
 	}
@@ -151,9 +154,10 @@ replace_check_dup(struct tuple *old_tuple,
 	[self subclassResponsibility: _cmd];
 }
 
-- (void) build: (Index *) pk
+- (void) build: (struct tuple **) tuples :(u32) n_tuples
 {
-	(void) pk;
+	(void) tuples;
+	(void) n_tuples;
 	[self subclassResponsibility: _cmd];
 }
 
@@ -220,6 +224,35 @@ replace_check_dup(struct tuple *old_tuple,
 	[self subclassResponsibility: _cmd];
 }
 
+- (size_t) count: (void *) key :(int) part_count
+{
+	struct iterator *it = position;
+	[self initIterator: it :ITER_EQ :key :part_count];
+	size_t count = 0;
+	while (it->next(it) != NULL)
+		count++;
+	return count;
+}
+
+- (size_t) rank: (struct tuple *) tuple
+{
+	struct iterator *it = position;
+	[self initIterator: it :ITER_ALL :NULL :0];
+	size_t rank = 0;
+	struct tuple *t;
+	while ((t = it->next(it)) != NULL && t != tuple)
+		rank++;
+	return rank;
+}
+
+- (u32) skip: (struct iterator *) iterator :(u32) n
+{
+	u32 skipped = 0;
+	while (skipped < n && iterator->next(iterator) != NULL)
+		skipped++;
+	return skipped;
+}
+
 @end
 
 /* }}} */
@@ -38,6 +38,7 @@ enum {
 };
 struct txn;
 struct port;
+struct space;
 
 #define BOX_RETURN_TUPLE		0x01
 #define BOX_ADD				0x02
@@ -105,6 +106,8 @@ struct request
 	u32 type;
 	u32 flags;
 	struct tbuf *data;
+	/** The space of the request, NULL for CALL. */
+	struct space *space;
 };
 
 struct request *request_create(u32 type, struct tbuf *data);
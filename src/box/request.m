@@ -58,11 +58,13 @@ read_key(struct tbuf *data, void **key_ptr, u32 *key_part_count_ptr)
 	*key_part_count_ptr = key_part_count;
 }
 
+/** Read the space of the request, remember it for statistics. */
 static struct space *
-read_space(struct tbuf *data)
+read_space(struct request *request, struct tbuf *data)
 {
 	u32 space_no = read_u32(data);
-	return space_find(space_no);
+	request->space = space_find(space_no);
+	return request->space;
 }
 
 enum dup_replace_mode
@@ -78,7 +80,7 @@ execute_replace(struct request *request, struct txn *txn)
 {
 	struct tbuf *data = request->data;
 	txn_add_redo(txn, request->type, data);
-	struct space *sp = read_space(data);
+	struct space *sp = read_space(request, data);
 	request->flags |= read_u32(data) & BOX_ALLOWED_REQUEST_FLAGS;
 	size_t field_count = read_u32(data);
 
@@ -88,9 +90,10 @@ execute_replace(struct request *request, struct txn *txn)
 	if (data->size == 0 || data->size != valid_tuple(data, field_count))
 		tnt_raise(IllegalParams, :"incorrect tuple length");
 
-	struct tuple *new_tuple = tuple_alloc(data->size);
+	struct tuple *new_tuple = space_tuple_alloc(sp, data->size);
 	new_tuple->field_count = field_count;
 	memcpy(new_tuple->data, data->data, data->size);
+	tuple_init_field_map(new_tuple);
 
 	@try {
 		space_validate_tuple(sp, new_tuple);
@@ -690,7 +693,7 @@ execute_update(struct request *request, struct txn *txn)
 {
 	struct tbuf *data = request->data;
 	txn_add_redo(txn, request->type, data);
-	struct space *sp = read_space(data);
+	struct space *sp = read_space(request, data);
 	request->flags |= read_u32(data) & BOX_ALLOWED_REQUEST_FLAGS;
 
 	/* Parse UPDATE request. */
@@ -715,10 +718,11 @@ execute_update(struct request *request, struct txn *txn)
 					       old_tuple);
 	/* Allocate a new tuple. */
 	size_t new_tuple_len = update_calc_new_tuple_length(rope);
-	struct tuple *new_tuple = tuple_alloc(new_tuple_len);
+	struct tuple *new_tuple = space_tuple_alloc(sp, new_tuple_len);
 
 	@try {
 		do_update_ops(rope, new_tuple);
+		tuple_init_field_map(new_tuple);
 		space_validate_tuple(sp, new_tuple);
 		txn_replace(txn, sp, old_tuple, new_tuple, DUP_INSERT);
 
@@ -734,9 +738,10 @@ static void
 execute_select(struct request *request, struct port *port)
 {
 	struct tbuf *data = request->data;
-	struct space *sp = read_space(data);
+	struct space *sp = read_space(request, data);
 	u32 index_no = read_u32(data);
 	Index *index = index_find(sp, index_no);
+	index_check_ready(index);
 	u32 offset = read_u32(data);
 	u32 limit = read_u32(data);
 	u32 count = read_u32(data);
@@ -761,13 +766,14 @@ execute_select(struct request *request, struct port *port)
 		struct iterator *it = index->position;
 		[index initIterator: it :ITER_EQ :key :key_part_count];
 
-		struct tuple *tuple;
-		while ((tuple = it->next(it)) != NULL) {
-			if (offset > 0) {
-				offset--;
+		if (offset > 0) {
+			offset -= [index skip: it :offset];
+			if (offset > 0)
 				continue;
-			}
+		}
 
+		struct tuple *tuple;
+		while ((tuple = it->next(it)) != NULL) {
 			port_add_tuple(port, tuple, BOX_RETURN_TUPLE);
 
 			if (limit == ++found)
@@ -784,7 +790,7 @@ execute_delete(struct request *request, struct txn *txn)
 	struct tbuf *data = request->data;
 	u32 type = request->type;
 	txn_add_redo(txn, type, data);
-	struct space *sp = read_space(data);
+	struct space *sp = read_space(request, data);
 	if (type == DELETE)
 		request->flags |= read_u32(data) & BOX_ALLOWED_REQUEST_FLAGS;
 	/* read key */
@@ -834,6 +840,7 @@ request_create(u32 type, struct tbuf *data)
 	request->type = type;
 	request->data = data;
 	request->flags = 0;
+	request->space = NULL;
 	return request;
 }
 
@@ -29,6 +29,7 @@
  * SUCH DAMAGE.
  */
 #include "index.h"
+#include "tuple.h"
 #include <exception.h>
 
 struct tarantool_cfg;
@@ -79,9 +80,28 @@ struct space {
 
 	/** Space number. */
 	i32 no;
+
+	/**
+	 * The number of leading fields which offsets are stored
+	 * in every tuple of the space (space[n].field_map).
+	 */
+	u32 field_map_count;
+
+	/** Latencies of the requests to the space. */
+	struct histogram *latency;
 };
 
 
+/**
+ * Allocate a tuple for the space, with room for the
+ * field map if the space has one.
+ */
+static inline struct tuple *
+space_tuple_alloc(struct space *sp, size_t size)
+{
+	return tuple_alloc_mapped(size, sp->field_map_count);
+}
+
 /** Get space ordinal number. */
 static inline i32 space_n(struct space *sp) { return sp->no; }
 
@@ -278,6 +298,17 @@ i32 check_spaces(struct tarantool_cfg *conf);
 void begin_build_primary_indexes(void);
 void end_build_primary_indexes(void);
 void build_secondary_indexes(void);
+/**
+ * Start building secondary keys in a background fiber. Until
+ * the build is done, secondary keys can't be used for reads and
+ * spaces which have them are read-only.
+ */
+void build_secondary_indexes_in_background(void);
+/**
+ * Start a fiber which moves tuples out of sparse slabs, in
+ * slices of slab_defrag_slice tuples, see salloc_defrag_begin().
+ */
+void start_slab_defrag(void);
 
 
 static inline Index *
@@ -290,4 +321,23 @@ index_find(struct space *sp, int index_no)
 	return idx;
 }
 
+/** Check whether or not an index is built and can be used. */
+static inline bool
+index_is_ready(Index *index)
+{
+	return secondary_indexes_enabled || index_is_primary(index);
+}
+
+/**
+ * Raise an error if the index is a secondary key which
+ * is not built yet.
+ */
+static inline void
+index_check_ready(Index *index)
+{
+	if (!index_is_ready(index))
+		tnt_raise(ClientError, :ER_INDEX_NOT_READY, index_n(index),
+			  space_n(index->space));
+}
+
 #endif /* TARANTOOL_BOX_SPACE_H_INCLUDED */
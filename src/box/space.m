@@ -29,6 +29,7 @@
 #include "space.h"
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <cfg/tarantool_box_cfg.h>
 #include <cfg/warning.h>
 #include <tarantool.h>
@@ -37,11 +38,21 @@
 #include <pickle.h>
 #include <palloc.h>
 #include <assoc.h>
+#include <tarantool_pthread.h>
+#include <fiber.h>
+#include <coeio.h>
+#include <salloc.h>
+#include <stat.h>
 
 static struct mh_i32ptr_t *spaces;
 
 bool secondary_indexes_enabled = false;
 bool primary_indexes_enabled = false;
+/**
+ * Set while secondary keys are built in the background,
+ * see build_secondary_indexes_in_background().
+ */
+static bool secondary_indexes_building = false;
 
 struct space *
 space_create(i32 space_no, struct key_def *key_defs, int key_count, int arity)
@@ -60,6 +71,10 @@ space_create(i32 space_no, struct key_def *key_defs, int key_count, int arity)
 	space->key_defs = key_defs;
 	space->key_count = key_count;
 
+	char name[32];
+	snprintf(name, sizeof(name), "space_%d", space_no);
+	space->latency = stat_register_latency(name);
+
 	return space;
 }
 
@@ -124,6 +139,12 @@ struct tuple *
 space_replace(struct space *sp, struct tuple *old_tuple,
 	      struct tuple *new_tuple, enum dup_replace_mode mode)
 {
+	if (secondary_indexes_building) {
+		/* Keys which are being built can't be changed. */
+		for (int j = 1; j < sp->key_count; j++)
+			index_check_ready(sp->index[j]);
+	}
+
 	int i = 0;
 	@try {
 		/* Update the primary key */
@@ -191,6 +212,10 @@ space_validate_tuple(struct space *sp, struct tuple *new_tuple)
 void
 space_free(void)
 {
+	/* Index build threads may still use the spaces. */
+	if (secondary_indexes_building)
+		return;
+
 	mh_int_t i;
 
 	mh_foreach(spaces, i) {
@@ -363,6 +388,13 @@ space_config()
 		}
 		space_init_field_types(space);
 
+		if (cfg_space->field_map < 0)
+			space->field_map_count = space->max_fieldno;
+		else
+			space->field_map_count = cfg_space->field_map;
+		space->field_map_count = MIN(space->field_map_count,
+					     TUPLE_FIELD_MAP_MAX);
+
 		/* fill space indexes */
 		for (int j = 0; cfg_space->index[j] != NULL; ++j) {
 			typeof(cfg_space->index[j]) cfg_index = cfg_space->index[j];
@@ -416,34 +448,339 @@ end_build_primary_indexes(void)
 	primary_indexes_enabled = true;
 }
 
-void
-build_secondary_indexes(void)
+/** A secondary key to build, see build_secondary_indexes(). */
+struct index_build_task {
+	Index *index;
+	/** The contents of the primary key. */
+	struct tuple **tuples;
+	u32 n_tuples;
+};
+
+/** A queue of secondary keys shared by index build threads. */
+struct index_builder {
+	struct index_build_task *tasks;
+	u32 n_tasks;
+	/** The next task to take, advanced atomically. */
+	u32 next_task;
+	/** The first build error, the rest of tasks are dropped. */
+	tnt_Exception *error;
+};
+
+static void *
+index_builder_run(void *arg)
 {
-	assert(primary_indexes_enabled == true);
-	assert(secondary_indexes_enabled == false);
+	struct index_builder *builder = arg;
+	u32 i;
+	while (builder->error == nil &&
+	       (i = __sync_fetch_and_add(&builder->next_task, 1)) <
+	       builder->n_tasks) {
+		struct index_build_task *task = &builder->tasks[i];
+		@try {
+			[task->index build: task->tuples :task->n_tuples];
+		} @catch (tnt_Exception *e) {
+			/*
+			 * Exceptions are allocated per thread, so stop
+			 * here not to overwrite the error.
+			 */
+			__sync_bool_compare_and_swap(&builder->error, nil, e);
+			break;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Collect the contents of primary keys and create a build
+ * task for every secondary key.
+ */
+static void
+index_builder_create(struct index_builder *builder)
+{
+	memset(builder, 0, sizeof(*builder));
 
+	u32 n_indexes = 0;
 	mh_int_t i;
+	mh_foreach(spaces, i) {
+		struct space *space = mh_i32ptr_node(spaces, i)->val;
+		if (space->key_count > 1)
+			n_indexes += space->key_count - 1;
+	}
+	builder->tasks = calloc(n_indexes, sizeof(*builder->tasks));
+	if (n_indexes > 0 && builder->tasks == NULL) {
+		panic("calloc(): failed to allocate %"PRI_SZ" bytes",
+		      n_indexes * sizeof(*builder->tasks));
+	}
+
+	/*
+	 * Iterators aren't thread-safe, so collect the contents
+	 * of the primary keys before starting the threads.
+	 */
 	mh_foreach(spaces, i) {
 		struct space *space = mh_i32ptr_node(spaces, i)->val;
 
 		if (space->key_count <= 1)
 			continue; /* no secondary keys */
 
-		say_info("Building secondary keys in space %d...", space->no);
-
 		Index *pk = space->index[0];
+		u32 n_tuples = [pk size];
+		struct tuple **tuples = NULL;
+		if (n_tuples > 0) {
+			size_t sz = n_tuples * sizeof(*tuples);
+			tuples = malloc(sz);
+			if (tuples == NULL) {
+				panic("malloc(): failed to allocate %"PRI_SZ" bytes", sz);
+			}
+		}
+		struct iterator *it = pk->position;
+		[pk initIterator: it :ITER_ALL :NULL :0];
+		struct tuple *tuple;
+		u32 n = 0;
+		while ((tuple = it->next(it)) != NULL)
+			tuples[n++] = tuple;
+		assert(n == n_tuples);
+
 		for (int j = 1; j < space->key_count; j++) {
-			Index *index = space->index[j];
-			[index build: pk];
+			struct index_build_task *task =
+				&builder->tasks[builder->n_tasks++];
+			task->index = space->index[j];
+			task->tuples = tuples;
+			task->n_tuples = n_tuples;
 		}
+	}
+}
 
-		say_info("Space %d: done", space->no);
+/**
+ * Run the build tasks in a pool of threads, the calling
+ * thread included, and wait for all of them to finish.
+ */
+static void
+index_builder_build(struct index_builder *builder)
+{
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	u32 n_threads = MIN(MAX(n_cpus, 1), MAX(builder->n_tasks, 1));
+	say_info("Building %"PRIu32" secondary keys in %"PRIu32" threads...",
+		 builder->n_tasks, n_threads);
+
+	pthread_t threads[n_threads];
+	u32 n_started = 0;
+	while (n_started < n_threads - 1 &&
+	       tt_pthread_create(&threads[n_started], NULL,
+				 index_builder_run, builder) == 0)
+		n_started++;
+	index_builder_run(builder);
+	for (u32 t = 0; t < n_started; t++)
+		tt_pthread_join(threads[t], NULL);
+}
+
+static void
+index_builder_destroy(struct index_builder *builder)
+{
+	/* Tasks of the same space share the tuple array. */
+	for (u32 t = 0; t < builder->n_tasks; t++) {
+		if (t == 0 || builder->tasks[t].tuples !=
+			      builder->tasks[t - 1].tuples)
+			free(builder->tasks[t].tuples);
 	}
+	free(builder->tasks);
+}
+
+void
+build_secondary_indexes(void)
+{
+	assert(primary_indexes_enabled == true);
+	assert(secondary_indexes_enabled == false);
+
+	struct index_builder builder;
+	index_builder_create(&builder);
+	index_builder_build(&builder);
+	index_builder_destroy(&builder);
+
+	if (builder.error != nil)
+		@throw builder.error;
+
+	say_info("Secondary keys: done");
 
 	/* enable secondary indexes now */
 	secondary_indexes_enabled = true;
 }
 
+static ssize_t
+index_builder_build_cb(va_list ap)
+{
+	struct index_builder *builder = va_arg(ap, struct index_builder *);
+	index_builder_build(builder);
+	return 0;
+}
+
+static void
+build_secondary_indexes_f(va_list ap __attribute__((unused)))
+{
+	struct index_builder builder;
+	index_builder_create(&builder);
+	/*
+	 * The tuples collected above must stay alive until
+	 * the build is done: forbid changes of spaces which
+	 * have secondary keys.
+	 */
+	secondary_indexes_building = true;
+	if (coeio_custom(index_builder_build_cb, TIMEOUT_INFINITY,
+			 &builder) == -1) {
+		say_syserror("coeio_custom");
+		index_builder_build(&builder);
+	}
+	index_builder_destroy(&builder);
+	secondary_indexes_building = false;
+
+	if (builder.error != nil) {
+		[builder.error log];
+		panic("can't build secondary keys");
+	}
+
+	say_info("Secondary keys: done");
+
+	/* enable secondary indexes now */
+	secondary_indexes_enabled = true;
+}
+
+void
+build_secondary_indexes_in_background(void)
+{
+	assert(primary_indexes_enabled == true);
+	assert(secondary_indexes_enabled == false);
+
+	struct fiber *f = fiber_new("index_builder",
+				    build_secondary_indexes_f);
+	fiber_call(f);
+}
+
+static struct fiber *slab_defrag;
+
+/**
+ * Check if a tuple may belong to a space, without raising: it
+ * has the field map and the field count of the space tuples,
+ * and numeric fields of the right size in the primary key.
+ */
+static bool
+space_may_hold_tuple(struct space *sp, struct tuple *tuple)
+{
+	if (sp->index[0] == nil ||
+	    tuple->field_count < sp->max_fieldno ||
+	    (sp->arity > 0 && sp->arity != tuple->field_count) ||
+	    tuple->field_map_count != MIN(sp->field_map_count,
+					  tuple->field_count))
+		return false;
+
+	struct key_def *key_def = &sp->key_defs[0];
+	for (int i = 0; i < key_def->part_count; i++) {
+		struct key_part *part = &key_def->parts[i];
+		if (part->type == STRING)
+			continue;
+		const void *field = tuple_field(tuple, part->fieldno);
+		u32 len = load_varint32(&field);
+		if (len != (part->type == NUM ? sizeof(u32) : sizeof(u64)))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Find the space which stores a tuple: the primary key of the
+ * space refers to this very tuple.
+ */
+static struct space *
+tuple_space(struct tuple *tuple)
+{
+	/* Tuples of a slab usually come from the same space. */
+	static struct space *last_space = NULL;
+	if (last_space != NULL &&
+	    space_may_hold_tuple(last_space, tuple) &&
+	    [last_space->index[0] findByTuple: tuple] == tuple)
+		return last_space;
+
+	mh_int_t i;
+	mh_foreach(spaces, i) {
+		struct space *sp = mh_i32ptr_node(spaces, i)->val;
+		if (sp == last_space || !space_may_hold_tuple(sp, tuple))
+			continue;
+		if ([sp->index[0] findByTuple: tuple] == tuple)
+			return last_space = sp;
+	}
+	return NULL;
+}
+
+/**
+ * Copy a tuple to a new place and make the indexes of the
+ * space refer to the copy.
+ */
+static void
+tuple_move(struct space *sp, struct tuple *tuple)
+{
+	struct tuple *copy = tuple_alloc_mapped(tuple->bsize,
+						tuple->field_map_count);
+	memcpy(copy, tuple, sizeof(struct tuple) + tuple->bsize +
+	       tuple->field_map_count * sizeof(u32));
+	@try {
+		space_replace(sp, tuple, copy, DUP_REPLACE);
+	} @catch (tnt_Exception *e) {
+		/* Out of index memory, leave the tuple in place. */
+		copy->refs = 0;
+		tuple_free(copy);
+		return;
+	}
+	tuple_ref(tuple, -1);
+}
+
+static void
+slab_defrag_f(va_list ap __attribute__((unused)))
+{
+	for (;;) {
+		/*
+		 * Tuples can't be moved while the secondary keys
+		 * are built, since the builder refers to them.
+		 * Don't copy them while a read view keeps the
+		 * originals either.
+		 */
+		if (cfg.slab_defrag_threshold <= 0 ||
+		    !secondary_indexes_enabled ||
+		    tuple_read_view_is_open() ||
+		    !salloc_defrag_begin(cfg.slab_defrag_threshold)) {
+			fiber_sleep(1.0);
+			continue;
+		}
+		@try {
+			int slice = MAX(cfg.slab_defrag_slice, 1);
+			int visited = 0;
+			struct tuple *tuple;
+			while ((tuple = salloc_defrag_next()) != NULL) {
+				/*
+				 * Tuples referenced from elsewhere than
+				 * the indexes of their space, e.g. by a
+				 * transaction waiting for WAL, stay.
+				 */
+				struct space *sp;
+				if (tuple->refs == 1 &&
+				    (sp = tuple_space(tuple)) != NULL)
+					tuple_move(sp, tuple);
+				if (++visited % slice == 0)
+					fiber_sleep(0);
+			}
+		} @finally {
+			if (salloc_defrag_end())
+				say_debug("slab defragmentation released a slab");
+		}
+	}
+}
+
+void
+start_slab_defrag(void)
+{
+	if (slab_defrag != NULL)
+		return;
+	slab_defrag = fiber_new("slab_defrag", slab_defrag_f);
+	fiber_call(slab_defrag);
+}
+
+
 i32
 check_spaces(struct tarantool_cfg *conf)
 {
@@ -479,6 +816,15 @@ check_spaces(struct tarantool_cfg *conf)
 			return -1;
 		}
 
+		if (space->field_map < -1 ||
+		    space->field_map > TUPLE_FIELD_MAP_MAX) {
+			out_warning(0, "(space = %zu) "
+				    "field_map must be -1 (indexed fields), "
+				    "0 (none) or up to %i", i,
+				    TUPLE_FIELD_MAP_MAX);
+			return -1;
+		}
+
 		int max_key_fieldno = -1;
 
 		/* check spaces indexes */
@@ -556,12 +902,6 @@ check_spaces(struct tarantool_cfg *conf)
 			switch (index_type) {
 			case HASH:
 				/* check hash index */
-				/* hash index must has single-field key */
-				if (key_part_count != 1) {
-					out_warning(0, "(space = %zu index = %zu) "
-					            "hash index must has a single-field key", i, j);
-					return -1;
-				}
 				/* hash index must be unique */
 				if (!index->unique) {
 					out_warning(0, "(space = %zu index = %zu) "
@@ -572,6 +912,20 @@ check_spaces(struct tarantool_cfg *conf)
 			case TREE:
 				/* extra check for tree index not needed */
 				break;
+			case BITSET:
+				/* bitset index must have a single-field key */
+				if (key_part_count != 1) {
+					out_warning(0, "(space = %zu index = %zu) "
+						    "bitset index must have a single-field key", i, j);
+					return -1;
+				}
+				/* bitset index must not be unique */
+				if (index->unique) {
+					out_warning(0, "(space = %zu index = %zu) "
+						    "bitset index must be non-unique", i, j);
+					return -1;
+				}
+				break;
 			default:
 				assert(false);
 			}
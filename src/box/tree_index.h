@@ -32,6 +32,7 @@
 #include "index.h"
 
 #include <third_party/sptree.h>
+#include <lib/bptree/bptree.h>
 
 /**
  * Instantiate sptree definitions
@@ -40,9 +41,22 @@ SPTREE_DEF(index, realloc);
 
 typedef int (*tree_cmp_t)(const void *, const void *, void *);
 
+/**
+ * Tree implementations, selected with tree_index_engine
+ * configuration option.
+ */
+#define TREE_ENGINE(_)                                            \
+	_(SPTREE, 0)      /* AVL tree, third_party/sptree.h */ \
+	_(BPTREE, 1)      /* B+tree, lib/bptree */                \
+
+ENUM(tree_engine, TREE_ENGINE);
+extern const char *tree_engine_strs[];
+
 @interface TreeIndex: Index {
 @public
+	enum tree_engine engine;
 	sptree_index tree;
+	struct bptree bptree;
 };
 
 + (struct index_traits *) traits;
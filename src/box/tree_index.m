@@ -32,9 +32,13 @@
 #include "exception.h"
 #include "errinj.h"
 #include <pickle.h>
+#include <salloc.h>
+#include <cfg/tarantool_box_cfg.h>
 
 /* {{{ Utilities. *************************************************/
 
+STRS(tree_engine, TREE_ENGINE);
+
 static struct index_traits tree_index_traits = {
 	.allows_partial_key = true,
 };
@@ -57,11 +61,18 @@ u64_cmp(u64 a, u64 b)
 	return a < b ? -1 : (a > b);
 }
 
+/** A tuple referred to by a tree node. */
+static inline struct tuple *
+tuple_of_ref(u32 ref)
+{
+	return salloc_ptr_from_ref(ref);
+}
+
 /**
  * Tuple address comparison.
  */
 static inline int
-ta_cmp(struct tuple *tuple_a, struct tuple *tuple_b)
+ta_cmp(u32 tuple_a, u32 tuple_b)
 {
 	if (!tuple_a)
 		return 0;
@@ -152,26 +163,27 @@ union sparse_part {
 #define SIZEOF_SPARSE_PARTS(def) _SIZEOF_SPARSE_PARTS((def)->part_count)
 
 /**
- * Tree nodes for different tree types
+ * Tree nodes for different tree types. Nodes refer to tuples with
+ * compressed 32-bit pointers, see salloc_ptr_to_ref().
  */
 
 struct sparse_node {
-	struct tuple *tuple;
+	u32 tuple;
 	union sparse_part parts[];
 } __attribute__((packed));
 
 struct dense_node {
-	struct tuple *tuple;
+	u32 tuple;
 	u32 offset;
 } __attribute__((packed));
 
 struct num32_node {
-	struct tuple *tuple;
+	u32 tuple;
 	u32 value;
 } __attribute__((packed));
 
 struct fixed_node {
-	struct tuple *tuple;
+	u32 tuple;
 };
 
 /**
@@ -298,6 +310,45 @@ key_is_linear(struct key_def *key_def)
 	return true;
 }
 
+/**
+ * Check if offsets of all key fields are stored in the tuple
+ * field map.
+ */
+static inline bool
+key_is_mapped(struct key_def *key_def, struct tuple *tuple)
+{
+	return key_def->max_fieldno <= tuple->field_map_count;
+}
+
+/**
+ * Find the offset/value of a sparse part.
+ */
+static void
+fold_sparse_part(struct key_def *key_def, struct tuple *tuple, int part,
+		 const u8 *part_data, union sparse_part *parts)
+{
+	const u8 *data = part_data;
+	u32 len = load_varint32((const void**) &data);
+
+	if (key_def->parts[part].type == NUM) {
+		if (len != sizeof parts[part].num32) {
+			tnt_raise(IllegalParams, :"key is not u32");
+		}
+		memcpy(&parts[part].num32, data, len);
+	} else if (key_def->parts[part].type == NUM64) {
+		if (len != sizeof parts[part].num64) {
+			tnt_raise(IllegalParams, :"key is not u64");
+		}
+		memcpy(&parts[part].num64, data, len);
+	} else if (len <= sizeof(parts[part].str.data)) {
+		parts[part].str.length = len;
+		memcpy(parts[part].str.data, data, len);
+	} else {
+		parts[part].str.length = BIG_LENGTH;
+		parts[part].str.offset = (u32) (part_data - tuple->data);
+	}
+}
+
 /**
  * Find field offsets/values for a sparse node.
  */
@@ -306,10 +357,20 @@ fold_with_sparse_parts(struct key_def *key_def, struct tuple *tuple, union spars
 {
 	assert (tuple->field_count >= key_def->max_fieldno);
 
-	const u8 *part_data = tuple->data;
-
 	memset(parts, 0, sizeof(parts[0]) * key_def->part_count);
 
+	if (key_is_mapped(key_def, tuple)) {
+		u32 *field_map = tuple_field_map(tuple);
+		for (int part = 0; part < key_def->part_count; ++part) {
+			int field = key_def->parts[part].fieldno;
+			fold_sparse_part(key_def, tuple, part,
+					 tuple->data + field_map[field], parts);
+		}
+		return;
+	}
+
+	const u8 *part_data = tuple->data;
+
 	for (int field = 0; field < key_def->max_fieldno; ++field) {
 		assert(field < tuple->field_count);
 
@@ -318,23 +379,8 @@ fold_with_sparse_parts(struct key_def *key_def, struct tuple *tuple, union spars
 
 		int part = key_def->cmp_order[field];
 		if (part != -1) {
-			if (key_def->parts[part].type == NUM) {
-				if (len != sizeof parts[part].num32) {
-					tnt_raise(IllegalParams, :"key is not u32");
-				}
-				memcpy(&parts[part].num32, data, len);
-			} else if (key_def->parts[part].type == NUM64) {
-				if (len != sizeof parts[part].num64) {
-					tnt_raise(IllegalParams, :"key is not u64");
-				}
-				memcpy(&parts[part].num64, data, len);
-			} else if (len <= sizeof(parts[part].str.data)) {
-				parts[part].str.length = len;
-				memcpy(parts[part].str.data, data, len);
-			} else {
-				parts[part].str.length = BIG_LENGTH;
-				parts[part].str.offset = (u32) (part_data - tuple->data);
-			}
+			fold_sparse_part(key_def, tuple, part, part_data,
+					 parts);
 		}
 
 		part_data = data + len;
@@ -383,6 +429,14 @@ fold_with_key_parts(struct key_def *key_def, struct key_data *key_data)
 static u32
 fold_with_dense_offset(struct key_def *key_def, struct tuple *tuple)
 {
+	if (key_is_mapped(key_def, tuple)) {
+		int first_field = key_def->parts[0].fieldno;
+		for (int part = 1; part < key_def->part_count; ++part)
+			first_field = MIN(first_field,
+					  key_def->parts[part].fieldno);
+		return tuple_field_map(tuple)[first_field];
+	}
+
 	const u8 *tuple_data = tuple->data;
 
 	for (int field = 0; field < key_def->max_fieldno; ++field) {
@@ -408,6 +462,17 @@ fold_with_dense_offset(struct key_def *key_def, struct tuple *tuple)
 static u32
 fold_with_num32_value(struct key_def *key_def, struct tuple *tuple)
 {
+	if (key_is_mapped(key_def, tuple)) {
+		const u8 *data = tuple->data +
+			tuple_field_map(tuple)[key_def->parts[0].fieldno];
+		u32 len = load_varint32((const void**) &data);
+		u32 value;
+		assert(len == sizeof value);
+		(void) len;
+		memcpy(&value, data, sizeof value);
+		return value;
+	}
+
 	const u8 *tuple_data = tuple->data;
 
 	for (int field = 0; field < key_def->max_fieldno; ++field) {
@@ -543,6 +608,29 @@ dense_part_compare(enum field_data_type type,
 	}
 }
 
+/**
+ * Find offsets of part_count fields of a dense node, which
+ * start at first_field, the first of which is at offset.
+ */
+static inline void
+dense_field_offsets(struct tuple *tuple, u32 first_field, u32 offset,
+		    int part_count, u32 *off)
+{
+	if (first_field + part_count <= tuple->field_map_count) {
+		memcpy(off, tuple_field_map(tuple) + first_field,
+		       part_count * sizeof(u32));
+		return;
+	}
+
+	off[0] = offset;
+	const u8 *data = tuple->data + offset;
+	for (int i = 1; i < part_count; ++i) {
+		u32 len = load_varint32((const void**) &data);
+		data += len;
+		off[i] = data - tuple->data;
+	}
+}
+
 /**
  * Compare a key for two dense nodes.
  */
@@ -560,20 +648,8 @@ dense_node_compare(struct key_def *key_def, u32 first_field,
 	u32 *off_b = off_a + part_count;
 
 	/* Find field offsets. */
-	off_a[0] = offset_a;
-	off_b[0] = offset_b;
-	if (part_count > 1) {
-		u8 *ad = tuple_a->data + offset_a;
-		u8 *bd = tuple_b->data + offset_b;
-		for (int i = 1; i < part_count; ++i) {
-			u32 al = load_varint32((const void**) &ad);
-			u32 bl = load_varint32((const void**) &bd);
-			ad += al;
-			bd += bl;
-			off_a[i] = ad - tuple_a->data;
-			off_b[i] = bd - tuple_b->data;
-		}
-	}
+	dense_field_offsets(tuple_a, first_field, offset_a, part_count, off_a);
+	dense_field_offsets(tuple_b, first_field, offset_b, part_count, off_b);
 
 	/* Compare key parts. */
 	for (int part = 0; part < part_count; ++part) {
@@ -677,15 +753,7 @@ dense_key_node_compare(struct key_def *key_def,
 	u32 *off = alloca(part_count * sizeof(u32));
 
 	/* Find field offsets. */
-	off[0] = offset;
-	if (part_count > 1) {
-		const u8 *data = tuple->data + offset;
-		for (int i = 1; i < part_count; ++i) {
-			u32 len = load_varint32((const void**) &data);
-			data += len;
-			off[i] = data - tuple->data;
-		}
-	}
+	dense_field_offsets(tuple, first_field, offset, part_count, off);
 
 	/* Compare key parts. */
 	if (part_count > key_data->part_count)
@@ -744,6 +812,13 @@ struct tree_iterator {
 	struct iterator base;
 	TreeIndex *index;
 	struct sptree_index_iterator *iter;
+	struct bptree_iterator *bptree_iter;
+	/**
+	 * B+tree iterator uses the last visited node to find
+	 * its position if the tree is changed in between
+	 * iterations. Keep the node's tuple alive until then.
+	 */
+	struct tuple *pinned;
 	struct key_data key_data;
 };
 
@@ -757,20 +832,75 @@ tree_iterator(struct iterator *it)
 	return (struct tree_iterator *) it;
 }
 
+static void
+tree_iterator_pin(struct tree_iterator *it, struct tuple *tuple)
+{
+	if (tuple)
+		tuple_ref(tuple, 1);
+	if (it->pinned)
+		tuple_ref(it->pinned, -1);
+	it->pinned = tuple;
+}
+
 static void
 tree_iterator_free(struct iterator *iterator)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
 	if (it->iter)
 		sptree_index_iterator_free(it->iter);
+	if (it->bptree_iter)
+		bptree_iterator_delete(it->bptree_iter);
+	tree_iterator_pin(it, NULL);
 	free(it);
 }
 
+static inline void *
+tree_iterator_next_node(struct tree_iterator *it)
+{
+	if (it->index->engine == BPTREE) {
+		void *node = bptree_iterator_next(it->bptree_iter);
+		if (node)
+			tree_iterator_pin(it, [it->index unfold: node]);
+		return node;
+	}
+	return sptree_index_iterator_next(it->iter);
+}
+
+static inline void *
+tree_iterator_reverse_next_node(struct tree_iterator *it)
+{
+	if (it->index->engine == BPTREE) {
+		void *node = bptree_iterator_reverse_next(it->bptree_iter);
+		if (node)
+			tree_iterator_pin(it, [it->index unfold: node]);
+		return node;
+	}
+	return sptree_index_iterator_reverse_next(it->iter);
+}
+
+static inline int
+tree_iterator_key_cmp(struct tree_iterator *it, const void *node)
+{
+	TreeIndex *index = it->index;
+	if (index->engine == BPTREE)
+		return index->bptree.key_cmp(&it->key_data, node, index);
+	return index->tree.compare(&it->key_data, node, index);
+}
+
+static inline size_t
+tree_iterator_key_count(struct tree_iterator *it)
+{
+	TreeIndex *index = it->index;
+	if (index->engine == BPTREE)
+		return bptree_count(&index->bptree, &it->key_data);
+	return sptree_index_count(&index->tree, &it->key_data);
+}
+
 static struct tuple *
 tree_iterator_ge(struct iterator *iterator)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
-	void *node = sptree_index_iterator_next(it->iter);
+	void *node = tree_iterator_next_node(it);
 	return [it->index unfold: node];
 }
 
@@ -778,7 +908,7 @@ static struct tuple *
 tree_iterator_le(struct iterator *iterator)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
-	void *node = sptree_index_iterator_reverse_next(it->iter);
+	void *node = tree_iterator_reverse_next_node(it);
 	return [it->index unfold: node];
 }
 
@@ -787,8 +917,8 @@ tree_iterator_eq(struct iterator *iterator)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
 
-	void *node = sptree_index_iterator_next(it->iter);
-	if (node && it->index->tree.compare(&it->key_data, node, it->index) == 0)
+	void *node = tree_iterator_next_node(it);
+	if (node && tree_iterator_key_cmp(it, node) == 0)
 		return [it->index unfold: node];
 
 	return NULL;
@@ -799,11 +929,9 @@ tree_iterator_req(struct iterator *iterator)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
 
-	void *node = sptree_index_iterator_reverse_next(it->iter);
-	if (node != NULL
-	    && it->index->tree.compare(&it->key_data, node, it->index) == 0) {
+	void *node = tree_iterator_reverse_next_node(it);
+	if (node != NULL && tree_iterator_key_cmp(it, node) == 0)
 		return [it->index unfold: node];
-	}
 
 	return NULL;
 }
@@ -814,9 +942,8 @@ tree_iterator_lt(struct iterator *iterator)
 	struct tree_iterator *it = tree_iterator(iterator);
 
 	void *node ;
-	while ((node = sptree_index_iterator_reverse_next(it->iter)) != NULL) {
-		if (it->index->tree.compare(&it->key_data, node,
-					    it->index) != 0) {
+	while ((node = tree_iterator_reverse_next_node(it)) != NULL) {
+		if (tree_iterator_key_cmp(it, node) != 0) {
 			it->base.next = tree_iterator_le;
 			return [it->index unfold: node];
 		}
@@ -831,9 +958,8 @@ tree_iterator_gt(struct iterator *iterator)
 	struct tree_iterator *it = tree_iterator(iterator);
 
 	void *node;
-	while ((node = sptree_index_iterator_next(it->iter)) != NULL) {
-		if (it->index->tree.compare(&it->key_data, node,
-					    it->index) != 0) {
+	while ((node = tree_iterator_next_node(it)) != NULL) {
+		if (tree_iterator_key_cmp(it, node) != 0) {
 			it->base.next = tree_iterator_ge;
 			return [it->index unfold: node];
 		}
@@ -898,6 +1024,8 @@ tree_iterator_gt(struct iterator *iterator)
 - (void) free
 {
 	sptree_index_destroy(&tree);
+	if (engine == BPTREE)
+		bptree_destroy(&bptree);
 	[super free];
 }
 
@@ -908,23 +1036,35 @@ tree_iterator_gt(struct iterator *iterator)
 		return NULL;
 
 	memset(&tree, 0, sizeof tree);
+	engine = STR2ENUM(tree_engine, cfg.tree_index_engine);
+	assert(engine != tree_engine_MAX);
+	if (engine == BPTREE) {
+		bptree_create(&bptree, [self node_size], [self key_node_cmp],
+			      key_def->is_unique ?
+			      [self node_cmp] : [self dup_node_cmp],
+			      self);
+	}
 	return self;
 }
 
 - (size_t) size
 {
+	if (engine == BPTREE)
+		return bptree_size(&bptree);
 	return tree.size;
 }
 
 - (struct tuple *) min
 {
-	void *node = sptree_index_first(&tree);
+	void *node = engine == BPTREE ?
+		bptree_first(&bptree) : sptree_index_first(&tree);
 	return [self unfold: node];
 }
 
 - (struct tuple *) max
 {
-	void *node = sptree_index_last(&tree);
+	void *node = engine == BPTREE ?
+		bptree_last(&bptree) : sptree_index_last(&tree);
 	return [self unfold: node];
 }
 
@@ -941,7 +1081,9 @@ tree_iterator_gt(struct iterator *iterator)
 	key_data->part_count = part_count;
 	fold_with_key_parts(key_def, key_data);
 
-	void *node = sptree_index_find(&tree, key_data);
+	void *node = engine == BPTREE ?
+		bptree_find(&bptree, key_data) :
+		sptree_index_find(&tree, key_data);
 	return [self unfold: node];
 }
 
@@ -958,7 +1100,9 @@ tree_iterator_gt(struct iterator *iterator)
 	key_data->part_count = tuple->field_count;
 	fold_with_sparse_parts(key_def, tuple, key_data->parts);
 
-	void *node = sptree_index_find(&tree, key_data);
+	void *node = engine == BPTREE ?
+		bptree_find(&bptree, key_data) :
+		sptree_index_find(&tree, key_data);
 	return [self unfold: node];
 }
 
@@ -976,15 +1120,31 @@ tree_iterator_gt(struct iterator *iterator)
 		[self fold: new_node :new_tuple];
 
 		/* Try to optimistically replace the new_tuple. */
-		sptree_index_replace(&tree, new_node, &dup_node);
+		if (engine == BPTREE) {
+			if (bptree_replace(&bptree, new_node, &dup_node) != 0) {
+				tnt_raise(LoggedError, :ER_MEMORY_ISSUE,
+					  (ssize_t) bptree.node_size,
+					  "tree index", "node");
+			}
+		} else {
+			sptree_index_replace(&tree, new_node, &dup_node);
+		}
 
 		struct tuple *dup_tuple = [self unfold: dup_node];
 		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
 
 		if (errcode) {
-			sptree_index_delete(&tree, new_node);
-			if (dup_node)
-				sptree_index_replace(&tree, dup_node, NULL);
+			if (engine == BPTREE) {
+				/* Putting the duplicate back never allocates. */
+				if (dup_node)
+					bptree_replace(&bptree, dup_node, NULL);
+				else
+					bptree_delete(&bptree, new_node);
+			} else {
+				sptree_index_delete(&tree, new_node);
+				if (dup_node)
+					sptree_index_replace(&tree, dup_node, NULL);
+			}
 			tnt_raise(ClientError, :errcode, index_n(self));
 		}
 		if (dup_tuple)
@@ -992,7 +1152,10 @@ tree_iterator_gt(struct iterator *iterator)
 	}
 	if (old_tuple) {
 		[self fold: old_node :old_tuple];
-		sptree_index_delete(&tree, old_node);
+		if (engine == BPTREE)
+			bptree_delete(&bptree, old_node);
+		else
+			sptree_index_delete(&tree, old_node);
 	}
 	return old_tuple;
 }
@@ -1007,6 +1170,13 @@ tree_iterator_gt(struct iterator *iterator)
 		memset(it, 0, sizeof(struct tree_iterator));
 		it->index = self;
 		it->base.free = tree_iterator_free;
+		if (engine == BPTREE) {
+			it->bptree_iter = bptree_iterator_new(&bptree);
+			if (it->bptree_iter == NULL) {
+				free(it);
+				return NULL;
+			}
+		}
 	}
 	return (struct iterator *) it;
 }
@@ -1033,7 +1203,15 @@ tree_iterator_gt(struct iterator *iterator)
 
 	fold_with_key_parts(key_def, &it->key_data);
 
-	if (iterator_type_is_reverse(type))
+	if (engine == BPTREE) {
+		tree_iterator_pin(it, NULL);
+		if (iterator_type_is_reverse(type))
+			bptree_iterator_reverse_init_set(it->bptree_iter,
+							 &it->key_data);
+		else
+			bptree_iterator_init_set(it->bptree_iter,
+						 &it->key_data);
+	} else if (iterator_type_is_reverse(type))
 		sptree_index_iterator_reverse_init_set(&tree, &it->iter,
 						       &it->key_data);
 	else
@@ -1066,6 +1244,77 @@ tree_iterator_gt(struct iterator *iterator)
 	}
 }
 
+- (size_t) count: (void *) key :(int) part_count
+{
+	if (part_count == 0)
+		return [self size];
+
+	check_key_parts(key_def, part_count, traits->allows_partial_key);
+
+	struct key_data *key_data
+		= alloca(sizeof(struct key_data) +
+			 _SIZEOF_SPARSE_PARTS(part_count));
+
+	key_data->data = key;
+	key_data->part_count = part_count;
+	fold_with_key_parts(key_def, key_data);
+
+	if (engine == BPTREE)
+		return bptree_count(&bptree, key_data);
+	return sptree_index_count(&tree, key_data);
+}
+
+- (size_t) rank: (struct tuple *) tuple
+{
+	if (tuple->field_count < key_def->max_fieldno)
+		tnt_raise(IllegalParams, :"tuple must have all indexed fields");
+
+	void *node = alloca([self node_size]);
+	[self fold: node :tuple];
+	if (engine == BPTREE)
+		return bptree_rank_elem(&bptree, node);
+	return sptree_index_rank_elem(&tree, node);
+}
+
+- (u32) skip: (struct iterator *) iterator :(u32) n
+{
+	struct tree_iterator *it = tree_iterator(iterator);
+	size_t matching = 0;
+	size_t count = n;
+	if (it->base.next == tree_iterator_eq ||
+	    it->base.next == tree_iterator_req) {
+		/* Don't skip past the nodes matching the key. */
+		count = MIN(count, tree_iterator_key_count(it));
+	} else if (it->base.next == tree_iterator_gt ||
+		   it->base.next == tree_iterator_lt) {
+		/* Nodes matching the key are skipped on top of n. */
+		matching = tree_iterator_key_count(it);
+		count += matching;
+	}
+
+	if (engine == BPTREE) {
+		void *node = bptree_iterator_skip(it->bptree_iter, &count);
+		if (node != NULL)
+			tree_iterator_pin(it, [self unfold: node]);
+	} else {
+		spnode_t skipped = MIN(count, tree.size);
+		if (it->base.next == tree_iterator_le ||
+		    it->base.next == tree_iterator_lt ||
+		    it->base.next == tree_iterator_req)
+			sptree_index_iterator_reverse_skip(&it->iter, &skipped);
+		else
+			sptree_index_iterator_skip(&it->iter, &skipped);
+		count = skipped;
+	}
+	if (count <= matching)
+		return 0;
+	if (it->base.next == tree_iterator_gt)
+		it->base.next = tree_iterator_ge;
+	else if (it->base.next == tree_iterator_lt)
+		it->base.next = tree_iterator_le;
+	return count - matching;
+}
+
 - (void) beginBuild
 {
 	assert(index_is_primary(self));
@@ -1108,16 +1357,26 @@ tree_iterator_gt(struct iterator *iterator)
 	u32 estimated_tuples = tree.max_size;
 	void *nodes = tree.members;
 
+	if (engine == BPTREE) {
+		/* tree.members has only been used to collect nodes. */
+		memset(&tree, 0, sizeof tree);
+		if (bptree_build(&bptree, nodes, n_tuples) != 0)
+			panic("failed to build tree index %"PRIu32,
+			      index_n(self));
+		free(nodes);
+		return;
+	}
+
 	sptree_index_init(&tree,
 			  [self node_size], nodes, n_tuples, estimated_tuples,
 			  [self key_node_cmp], [self node_cmp],
 			  self);
 }
 
-- (void) build: (Index *) pk
+- (void) build: (struct tuple **) tuples :(u32) n_tuples
 {
-	u32 n_tuples = [pk size];
-	u32 estimated_tuples = n_tuples * 1.2;
+	/* B+tree copies nodes out of the array, no need to reserve. */
+	u32 estimated_tuples = engine == BPTREE ? n_tuples : n_tuples * 1.2;
 	size_t node_size = [self node_size];
 
 	void *nodes = NULL;
@@ -1134,14 +1393,9 @@ tree_iterator_gt(struct iterator *iterator)
 		}
 	}
 
-	struct iterator *it = pk->position;
-	[pk initIterator: it :ITER_ALL :NULL :0];
-
-	struct tuple *tuple;
-
-	for (u32 i = 0; (tuple = it->next(it)) != NULL; ++i) {
+	for (u32 i = 0; i < n_tuples; ++i) {
 		void *node = ((u8 *) nodes + i * node_size);
-		[self fold: node :tuple];
+		[self fold: node :tuples[i]];
 	}
 
 	if (n_tuples) {
@@ -1149,6 +1403,14 @@ tree_iterator_gt(struct iterator *iterator)
 			 index_n(self));
 	}
 
+	if (engine == BPTREE) {
+		if (bptree_build(&bptree, nodes, n_tuples) != 0)
+			panic("failed to build tree index %"PRIu32,
+			      index_n(self));
+		free(nodes);
+		return;
+	}
+
 	/* If n_tuples == 0 then estimated_tuples = 0, elem == NULL, tree is empty */
 	sptree_index_init(&tree,
 			  node_size, nodes, n_tuples, estimated_tuples,
@@ -1208,8 +1470,10 @@ sparse_node_cmp(const void *node_a, const void *node_b, void *arg)
 	const struct sparse_node *node_xa = node_a;
 	const struct sparse_node *node_xb = node_b;
 	return sparse_node_compare(index->key_def,
-				   node_xa->tuple, node_xa->parts,
-				   node_xb->tuple, node_xb->parts);
+				   tuple_of_ref(node_xa->tuple),
+				   node_xa->parts,
+				   tuple_of_ref(node_xb->tuple),
+				   node_xb->parts);
 }
 
 static int
@@ -1231,7 +1495,8 @@ sparse_key_node_cmp(const void *key, const void *node, void *arg)
 	const struct key_data *key_data = key;
 	const struct sparse_node *node_x = node;
 	return sparse_key_node_compare(index->key_def, key_data,
-				       node_x->tuple, node_x->parts);
+				       tuple_of_ref(node_x->tuple),
+				       node_x->parts);
 }
 
 @implementation SparseTreeIndex
@@ -1259,14 +1524,14 @@ sparse_key_node_cmp(const void *key, const void *node, void *arg)
 - (void) fold: (void *) node :(struct tuple *) tuple
 {
 	struct sparse_node *node_x = node;
-	node_x->tuple = tuple;
+	node_x->tuple = salloc_ptr_to_ref(tuple);
 	fold_with_sparse_parts(key_def, tuple, node_x->parts);
 }
 
 - (struct tuple *) unfold: (const void *) node
 {
 	const struct sparse_node *node_x = node;
-	return node_x ? node_x->tuple : NULL;
+	return node_x ? tuple_of_ref(node_x->tuple) : NULL;
 }
 
 @end
@@ -1282,8 +1547,10 @@ dense_node_cmp(const void *node_a, const void *node_b, void *arg)
 	const struct dense_node *node_xa = node_a;
 	const struct dense_node *node_xb = node_b;
 	return dense_node_compare(index->key_def, index->first_field,
-				  node_xa->tuple, node_xa->offset,
-				  node_xb->tuple, node_xb->offset);
+				  tuple_of_ref(node_xa->tuple),
+				  node_xa->offset,
+				  tuple_of_ref(node_xb->tuple),
+				  node_xb->offset);
 }
 
 static int
@@ -1306,7 +1573,8 @@ dense_key_node_cmp(const void *key, const void * node, void *arg)
 	const struct dense_node *node_x = node;
 	return dense_key_node_compare(index->key_def, key_data,
 				      index->first_field,
-				      node_x->tuple, node_x->offset);
+				      tuple_of_ref(node_x->tuple),
+				      node_x->offset);
 }
 
 static int
@@ -1316,8 +1584,10 @@ linear_dense_node_cmp(const void *node_a, const void *node_b, void *arg)
 	const struct dense_node *node_xa = node_a;
 	const struct dense_node *node_xb = node_b;
 	return linear_node_compare(index->key_def, index->first_field,
-				   node_xa->tuple, node_xa->offset,
-				   node_xb->tuple, node_xb->offset);
+				   tuple_of_ref(node_xa->tuple),
+				   node_xa->offset,
+				   tuple_of_ref(node_xb->tuple),
+				   node_xb->offset);
 }
 
 static int
@@ -1340,7 +1610,8 @@ linear_dense_key_node_cmp(const void *key, const void * node, void *arg)
 	const struct dense_node *node_x = node;
 	return linear_key_node_compare(index->key_def, key_data,
 				       index->first_field,
-				       node_x->tuple, node_x->offset);
+				       tuple_of_ref(node_x->tuple),
+				       node_x->offset);
 }
 
 @implementation DenseTreeIndex
@@ -1384,14 +1655,14 @@ linear_dense_key_node_cmp(const void *key, const void * node, void *arg)
 - (void) fold: (void *) node :(struct tuple *) tuple
 {
 	struct dense_node *node_x = node;
-	node_x->tuple = tuple;
+	node_x->tuple = salloc_ptr_to_ref(tuple);
 	node_x->offset = fold_with_dense_offset(key_def, tuple);
 }
 
 - (struct tuple *) unfold: (const void *) node
 {
 	const struct dense_node *node_x = node;
-	return node_x ? node_x->tuple : NULL;
+	return node_x ? tuple_of_ref(node_x->tuple) : NULL;
 }
 
 @end
@@ -1457,14 +1728,14 @@ num32_key_node_cmp(const void * key, const void * node, void *arg)
 - (void) fold: (void *) node :(struct tuple *) tuple
 {
 	struct num32_node *node_x = (struct num32_node *) node;
-	node_x->tuple = tuple;
+	node_x->tuple = salloc_ptr_to_ref(tuple);
 	node_x->value = fold_with_num32_value(key_def, tuple);
 }
 
 - (struct tuple *) unfold: (const void *) node
 {
 	const struct num32_node *node_x = node;
-	return node_x ? node_x->tuple : NULL;
+	return node_x ? tuple_of_ref(node_x->tuple) : NULL;
 }
 
 @end
@@ -1480,8 +1751,10 @@ fixed_node_cmp(const void *node_a, const void *node_b, void *arg)
 	const struct fixed_node *node_xa = node_a;
 	const struct fixed_node *node_xb = node_b;
 	return dense_node_compare(index->key_def, index->first_field,
-				  node_xa->tuple, index->first_offset,
-				  node_xb->tuple, index->first_offset);
+				  tuple_of_ref(node_xa->tuple),
+				  index->first_offset,
+				  tuple_of_ref(node_xb->tuple),
+				  index->first_offset);
 }
 
 static int
@@ -1504,7 +1777,8 @@ fixed_key_node_cmp(const void *key, const void * node, void *arg)
 	const struct fixed_node *node_x = node;
 	return dense_key_node_compare(index->key_def, key_data,
 				      index->first_field,
-				      node_x->tuple, index->first_offset);
+				      tuple_of_ref(node_x->tuple),
+				      index->first_offset);
 }
 
 static int
@@ -1514,8 +1788,10 @@ linear_fixed_node_cmp(const void *node_a, const void *node_b, void *arg)
 	const struct fixed_node *node_xa = node_a;
 	const struct fixed_node *node_xb = node_b;
 	return linear_node_compare(index->key_def, index->first_field,
-				   node_xa->tuple, index->first_offset,
-				   node_xb->tuple, index->first_offset);
+				   tuple_of_ref(node_xa->tuple),
+				   index->first_offset,
+				   tuple_of_ref(node_xb->tuple),
+				   index->first_offset);
 }
 
 static int
@@ -1538,7 +1814,8 @@ linear_fixed_key_node_cmp(const void *key, const void * node, void *arg)
 	const struct fixed_node *node_x = node;
 	return linear_key_node_compare(index->key_def, key_data,
 					 index->first_field,
-					 node_x->tuple, index->first_offset);
+					 tuple_of_ref(node_x->tuple),
+					 index->first_offset);
 }
 
 @implementation FixedTreeIndex
@@ -1583,13 +1860,13 @@ linear_fixed_key_node_cmp(const void *key, const void * node, void *arg)
 - (void) fold: (void *) node :(struct tuple *) tuple
 {
 	struct fixed_node *node_x = (struct fixed_node *) node;
-	node_x->tuple = tuple;
+	node_x->tuple = salloc_ptr_to_ref(tuple);
 }
 
 - (struct tuple *) unfold: (const void *) node
 {
 	const struct fixed_node *node_x = node;
-	return node_x ? node_x->tuple : NULL;
+	return node_x ? tuple_of_ref(node_x->tuple) : NULL;
 }
 
 @end
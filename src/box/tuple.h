@@ -41,7 +41,12 @@ struct tuple
 	/** reference counter */
 	u16 refs;
 	/* see enum tuple_flags */
-	u16 flags;
+	u8 flags;
+	/**
+	 * The number of leading fields which offsets are stored
+	 * in the field map, see tuple_field_map().
+	 */
+	u8 field_map_count;
 	/** length of the variable part of the tuple */
 	u32 bsize;
 	/** number of fields in the variable part. */
@@ -54,6 +59,11 @@ struct tuple
 	u8 data[0];
 } __attribute__((packed));
 
+enum {
+	/** The max number of fields in a tuple field map. */
+	TUPLE_FIELD_MAP_MAX = 255
+};
+
 /** Allocate a tuple
  *
  * @param size  tuple->bsize
@@ -62,6 +72,33 @@ struct tuple
 struct tuple *
 tuple_alloc(size_t size);
 
+/**
+ * Allocate a tuple with room for a field map of
+ * field_map_count offsets. The map is filled in by
+ * tuple_init_field_map() once the tuple data is in place.
+ */
+struct tuple *
+tuple_alloc_mapped(size_t size, u32 field_map_count);
+
+/**
+ * Fill in the field map of a tuple allocated by
+ * tuple_alloc_mapped(). Fields beyond tuple->field_count
+ * are not mapped.
+ */
+void
+tuple_init_field_map(struct tuple *tuple);
+
+/**
+ * Offsets of the leading fields from tuple->data.
+ * The field map is stored right after the tuple data, so that
+ * neither the tuple header nor the data change their layout.
+ */
+static inline u32 *
+tuple_field_map(struct tuple *tuple)
+{
+	return (u32 *) (tuple->data + tuple->bsize);
+}
+
 /**
  * Change tuple reference counter. If it has reached zero, free the tuple.
  *
@@ -71,7 +108,7 @@ void
 tuple_ref(struct tuple *tuple, int count);
 
 /**
- * Get a field from tuple by index.
+ * Get a field from tuple by index. O(1) for mapped fields.
  *
  * @returns field data if the field exists, or NULL
  */
@@ -93,5 +130,20 @@ static inline size_t tuple_len(struct tuple *tuple)
 }
 
 void tuple_free(struct tuple *tuple);
+
+/**
+ * Keep the tuples freed from now on in memory, since a read
+ * view of the spaces may still refer to them, and a thread
+ * may be reading them.
+ */
+void
+tuple_read_view_open(void);
+
+/** Free the tuples kept since tuple_read_view_open(). */
+void
+tuple_read_view_close(void);
+
+bool
+tuple_read_view_is_open(void);
 #endif /* TARANTOOL_BOX_TUPLE_H_INCLUDED */
 
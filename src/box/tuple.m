@@ -38,16 +38,34 @@
 struct tuple *
 tuple_alloc(size_t size)
 {
-	size_t total = sizeof(struct tuple) + size;
+	return tuple_alloc_mapped(size, 0);
+}
+
+/** Allocate a tuple with room for a field map */
+struct tuple *
+tuple_alloc_mapped(size_t size, u32 field_map_count)
+{
+	assert(field_map_count <= TUPLE_FIELD_MAP_MAX);
+	size_t total = sizeof(struct tuple) + size +
+		field_map_count * sizeof(u32);
 	struct tuple *tuple = salloc(total, "tuple");
 
 	tuple->flags = tuple->refs = 0;
+	tuple->field_map_count = field_map_count;
 	tuple->bsize = size;
 
 	say_debug("tuple_alloc(%zu) = %p", size, tuple);
 	return tuple;
 }
 
+/** Tuples freed while a read view is open. */
+static struct {
+	bool is_open;
+	struct tuple **tuples;
+	size_t count;
+	size_t capacity;
+} read_view_garbage;
+
 /**
  * Free the tuple.
  * @pre tuple->refs  == 0
@@ -57,9 +75,50 @@ tuple_free(struct tuple *tuple)
 {
 	say_debug("tuple_free(%p)", tuple);
 	assert(tuple->refs == 0);
+	if (read_view_garbage.is_open) {
+		if (read_view_garbage.count == read_view_garbage.capacity) {
+			size_t capacity = read_view_garbage.capacity * 2;
+			if (capacity == 0)
+				capacity = 1024;
+			struct tuple **tuples =
+				realloc(read_view_garbage.tuples,
+					capacity * sizeof(*tuples));
+			if (tuples == NULL)
+				panic_syserror("tuple_free");
+			read_view_garbage.tuples = tuples;
+			read_view_garbage.capacity = capacity;
+		}
+		read_view_garbage.tuples[read_view_garbage.count++] = tuple;
+		return;
+	}
 	sfree(tuple);
 }
 
+void
+tuple_read_view_open(void)
+{
+	assert(! read_view_garbage.is_open);
+	read_view_garbage.is_open = true;
+}
+
+bool
+tuple_read_view_is_open(void)
+{
+	return read_view_garbage.is_open;
+}
+
+void
+tuple_read_view_close(void)
+{
+	assert(read_view_garbage.is_open);
+	read_view_garbage.is_open = false;
+	for (size_t i = 0; i < read_view_garbage.count; i++)
+		sfree(read_view_garbage.tuples[i]);
+	free(read_view_garbage.tuples);
+	read_view_garbage.tuples = NULL;
+	read_view_garbage.count = read_view_garbage.capacity = 0;
+}
+
 /**
  * Add count to tuple's reference counter.
  * When the counter goes down to 0, the tuple is destroyed.
@@ -97,12 +156,41 @@ tuple_field(struct tuple *tuple, size_t i)
 	if (i >= tuple->field_count)
 		return NULL;
 
+	if (i < tuple->field_map_count)
+		return field + tuple_field_map(tuple)[i];
+
+	/* Start from the last mapped field, if any. */
+	if (tuple->field_map_count > 0) {
+		field += tuple_field_map(tuple)[tuple->field_map_count - 1];
+		i -= tuple->field_map_count - 1;
+	}
+
 	while (i-- > 0)
 		field = next_field(field);
 
 	return field;
 }
 
+void
+tuple_init_field_map(struct tuple *tuple)
+{
+	if (tuple->field_map_count > tuple->field_count)
+		tuple->field_map_count = tuple->field_count;
+
+	u32 *field_map = tuple_field_map(tuple);
+	const u8 *field = tuple->data;
+	const u8 *end = tuple->data + tuple->bsize;
+	for (u32 i = 0; i < tuple->field_map_count; i++) {
+		if (field >= end) {
+			/* Malformed tuple, leave it to validation. */
+			tuple->field_map_count = i;
+			break;
+		}
+		field_map[i] = field - tuple->data;
+		field = next_field(field);
+	}
+}
+
 /** print field to tbuf */
 static void
 print_field(struct tbuf *buf, const void *f)
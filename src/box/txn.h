@@ -33,6 +33,7 @@
 
 struct tuple;
 struct space;
+struct histogram;
 
 struct txn {
 	/* Undo info. */
@@ -45,6 +46,9 @@ struct txn {
 	struct tbuf req;
 };
 
+/** The time transactions wait for their WAL writes. */
+extern struct histogram *txn_wal_latency;
+
 struct txn *txn_begin();
 void txn_commit(struct txn *txn);
 void txn_finish(struct txn *txn);
@@ -34,6 +34,9 @@
 #include <recovery.h>
 #include <fiber.h>
 #include "request.h" /* for request_name */
+#include <stat.h>
+
+struct histogram *txn_wal_latency;
 
 void
 txn_add_redo(struct txn *txn, u16 op, struct tbuf *data)
@@ -63,7 +66,12 @@ txn_replace(struct txn *txn, struct space *space,
 	txn->old_tuple = space_replace(space, old_tuple, new_tuple, mode);
 	if (new_tuple) {
 		txn->new_tuple = new_tuple;
-		tuple_ref(txn->new_tuple, 1);
+		/*
+		 * One reference for the indexes and one for the
+		 * transaction: the tuple must not be moved by
+		 * slab defragmentation while it waits for WAL.
+		 */
+		tuple_ref(txn->new_tuple, 2);
 	}
 	txn->space = space;
 }
@@ -81,10 +89,11 @@ txn_commit(struct txn *txn)
 	if (txn->old_tuple || txn->new_tuple) {
 		int64_t lsn = next_lsn(recovery_state);
 
-		ev_tstamp start = ev_now(), stop;
+		ev_tstamp start = ev_time(), stop;
 		int res = wal_write(recovery_state, lsn, 0,
 				    txn->op, &txn->req);
-		stop = ev_now();
+		stop = ev_time();
+		stat_collect_latency(txn_wal_latency, start);
 
 		if (stop - start > cfg.too_long_threshold) {
 			say_warn("too long %s: %.3f sec",
@@ -104,6 +113,8 @@ txn_finish(struct txn *txn)
 {
 	if (txn->old_tuple)
 		tuple_ref(txn->old_tuple, -1);
+	if (txn->new_tuple)
+		tuple_ref(txn->new_tuple, -1);
 	TRASH(txn);
 }
 
@@ -113,7 +124,7 @@ txn_rollback(struct txn *txn)
 	if (txn->old_tuple || txn->new_tuple) {
 		space_replace(txn->space, txn->new_tuple, txn->old_tuple, DUP_INSERT);
 		if (txn->new_tuple)
-			tuple_ref(txn->new_tuple, -1);
+			tuple_ref(txn->new_tuple, -2);
 	}
 	TRASH(txn);
 }
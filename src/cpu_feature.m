@@ -106,3 +106,45 @@ sse42_enabled_cpu()
 }
 
 
+bool
+popcnt_enabled_cpu()
+{
+	unsigned int ax, bx, cx, dx;
+
+	if (__get_cpuid(1, &ax, &bx, &cx, &dx) == 0)
+		return 0;
+
+	return (cx & (1 << 23)) != 0;
+}
+
+
+bool
+avx2_enabled_cpu()
+{
+	unsigned int ax, bx, cx, dx;
+
+	if (__get_cpuid(1, &ax, &bx, &cx, &dx) == 0)
+		return 0;
+
+	/* OSXSAVE: XGETBV is available */
+	if ((cx & (1 << 27)) == 0)
+		return 0;
+
+	/* XCR0: the OS saves both XMM and YMM state */
+	unsigned int xcr0_lo, xcr0_hi;
+	__asm__ __volatile__(
+		".byte 0xf, 0x1, 0xd0" /* xgetbv */
+		:"=a"(xcr0_lo), "=d"(xcr0_hi)
+		:"c"(0)
+	);
+	if ((xcr0_lo & 0x6) != 0x6)
+		return 0;
+
+	if (__get_cpuid_max(0, 0) < 7)
+		return 0;
+
+	__cpuid_count(7, 0, ax, bx, cx, dx);
+	return (bx & (1 << 5)) != 0;
+}
+
+
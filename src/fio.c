@@ -36,8 +36,15 @@
 #include <limits.h>
 #include <stdio.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
 
 #include <say.h>
+#if defined(HAVE_IO_URING)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif /* defined(HAVE_IO_URING) */
 
 static const char *
 fio_filename(int fd)
@@ -189,6 +196,25 @@ fio_batch_add(struct fio_batch *batch, void *row, ssize_t row_len)
 	batch->bytes += row_len;
 }
 
+/**
+ * Find out how many rows of the batch fit in full into
+ * the first bytes_written bytes.
+ */
+static int
+fio_batch_good_rows(struct fio_batch *batch, ssize_t bytes_written,
+		    ssize_t *good_bytes)
+{
+	struct iovec *iov = batch->iov;
+	*good_bytes = 0;
+	while (iov < batch->iov + batch->rows) {
+		if (*good_bytes + iov->iov_len > bytes_written)
+			break;
+		*good_bytes += iov->iov_len;
+		iov++;
+	}
+	return iov - batch->iov;
+}
+
 int
 fio_batch_write(struct fio_batch *batch, int fd)
 {
@@ -204,14 +230,8 @@ fio_batch_write(struct fio_batch *batch, int fd)
 		 fio_filename(fd),
 		 (intmax_t) bytes_written, (intmax_t) batch->bytes);
 
-	ssize_t good_bytes = 0;
-	struct iovec *iov = batch->iov;
-	while (iov < batch->iov + batch->rows) {
-		if (good_bytes + iov->iov_len > bytes_written)
-			break;
-		good_bytes += iov->iov_len;
-		iov++;
-	}
+	ssize_t good_bytes;
+	int rows = fio_batch_good_rows(batch, bytes_written, &good_bytes);
 	/*
 	 * Unwind file position back to ensure we do not leave
 	 * partially written rows.
@@ -232,5 +252,314 @@ fio_batch_write(struct fio_batch *batch, int fd)
 	 */
 	if (! errno)
 		errno = EAGAIN;
-	return iov - batch->iov;
+	return rows;
+}
+
+#if defined(HAVE_IO_URING)
+
+struct fio_ring
+{
+	int fd;
+	/* Submission queue. */
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	/* Completion queue. */
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	/* Shared memory regions, to unmap them on delete. */
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+	/* The batch in flight. */
+	struct fio_batch *batch;
+	int batch_fd;
+	off_t batch_offset;
+	/** Requests submitted but not reaped yet. */
+	unsigned pending;
+	/**
+	 * The kernel took the write but not the fdatasync()
+	 * linked to it: do it in fio_ring_wait() instead.
+	 */
+	bool sync_lost;
+};
+
+static inline int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		   unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
 }
+
+struct fio_ring *
+fio_ring_new(unsigned entries)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	int fd = sys_io_uring_setup(entries, &params);
+	if (fd < 0)
+		return NULL;
+	/*
+	 * Linked requests and a stable iovec after submit
+	 * came in the same kernel release as this flag.
+	 */
+	if (! (params.features & IORING_FEAT_SUBMIT_STABLE)) {
+		close(fd);
+		errno = ENOTSUP;
+		return NULL;
+	}
+	struct fio_ring *ring = (struct fio_ring *)
+		calloc(1, sizeof(struct fio_ring));
+	if (ring == NULL) {
+		close(fd);
+		return NULL;
+	}
+	ring->fd = fd;
+	ring->sq_ring_size = params.sq_off.array +
+		params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size,
+			     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			     fd, IORING_OFF_SQ_RING);
+	ring->cq_ring = mmap(NULL, ring->cq_ring_size,
+			     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			     fd, IORING_OFF_CQ_RING);
+	ring->sqes = mmap(NULL, ring->sqes_size,
+			  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			  fd, IORING_OFF_SQES);
+	if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+	    ring->sqes == MAP_FAILED) {
+		int save_errno = errno;
+		fio_ring_delete(ring);
+		errno = save_errno;
+		return NULL;
+	}
+	char *sq = (char *) ring->sq_ring;
+	ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+	char *cq = (char *) ring->cq_ring;
+	ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+	ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+	return ring;
+}
+
+void
+fio_ring_delete(struct fio_ring *ring)
+{
+	if (ring == NULL)
+		return;
+	assert(ring->pending == 0);
+	if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	close(ring->fd);
+	free(ring);
+}
+
+void
+fio_ring_atfork(struct fio_ring *ring)
+{
+	if (ring == NULL)
+		return;
+	/* The batch in flight belongs to the parent. */
+	ring->pending = 0;
+	fio_ring_delete(ring);
+}
+
+static struct io_uring_sqe *
+fio_ring_get_sqe(struct fio_ring *ring, unsigned tail, int opcode, int fd)
+{
+	unsigned idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = opcode;
+	ring->sq_array[idx] = idx;
+	return sqe;
+}
+
+int
+fio_ring_submit(struct fio_ring *ring, struct fio_batch *batch,
+		int fd, off_t offset, bool sync)
+{
+	assert(ring->pending == 0);
+	/* Only this thread ever moves the submission queue tail. */
+	unsigned head = *ring->sq_tail;
+	unsigned tail = head;
+
+	struct io_uring_sqe *sqe;
+	sqe = fio_ring_get_sqe(ring, tail++, IORING_OP_WRITEV, fd);
+	sqe->addr = (uintptr_t) batch->iov;
+	sqe->len = batch->rows;
+	sqe->off = offset;
+	if (sync) {
+		/* fdatasync() only if the write succeeds in full. */
+		sqe->flags |= IOSQE_IO_LINK;
+		sqe = fio_ring_get_sqe(ring, tail++, IORING_OP_FSYNC, fd);
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	}
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	int rc;
+	do {
+		rc = sys_io_uring_enter(ring->fd, tail - head, 0, 0);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc <= 0) {
+		/* The kernel hasn't seen the requests, take them back. */
+		say_syserror("fio_ring_submit, [%s]", fio_filename(fd));
+		__atomic_store_n(ring->sq_tail, head, __ATOMIC_RELEASE);
+		return -1;
+	}
+	/*
+	 * A partial submit: take back the requests the kernel
+	 * hasn't seen. Resubmitting the fdatasync() wouldn't do,
+	 * since it'd lose the link and could run before the write.
+	 */
+	__atomic_store_n(ring->sq_tail, head + rc, __ATOMIC_RELEASE);
+	ring->sync_lost = (unsigned) rc < tail - head;
+	ring->pending = rc;
+	ring->batch = batch;
+	ring->batch_fd = fd;
+	ring->batch_offset = offset;
+	return 0;
+}
+
+int
+fio_ring_wait(struct fio_ring *ring)
+{
+	assert(ring->pending > 0);
+	struct fio_batch *batch = ring->batch;
+	int fd = ring->batch_fd;
+	ssize_t bytes_written = 0;
+
+	while (ring->pending > 0) {
+		unsigned head = *ring->cq_head;
+		if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+			if (sys_io_uring_enter(ring->fd, 0, 1,
+					       IORING_ENTER_GETEVENTS) < 0 &&
+			    errno != EINTR) {
+				/*
+				 * The kernel still owns the batch, and
+				 * we can't learn what it did with it.
+				 */
+				panic_syserror("fio_ring_wait, [%s]",
+					       fio_filename(fd));
+			}
+			continue;
+		}
+		struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+		if (cqe->user_data == IORING_OP_WRITEV) {
+			bytes_written = cqe->res;
+			if (cqe->res < 0) {
+				errno = -cqe->res;
+				say_syserror("fio_ring_wait, [%s]: writev",
+					     fio_filename(fd));
+			}
+		} else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+			errno = -cqe->res;
+			say_syserror("fio_ring_wait, [%s]: fdatasync",
+				     fio_filename(fd));
+		}
+		__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+		ring->pending--;
+	}
+	ring->batch = NULL;
+
+	if (ring->sync_lost) {
+		ring->sync_lost = false;
+		/* fdatasync() only if the write succeeds in full. */
+		if (bytes_written == batch->bytes && fdatasync(fd) != 0)
+			say_syserror("fio_ring_wait, [%s]: fdatasync",
+				     fio_filename(fd));
+	}
+	if (bytes_written < 0)
+		bytes_written = 0;
+	ssize_t good_bytes;
+	int rows = fio_batch_good_rows(batch, bytes_written, &good_bytes);
+	if (bytes_written != batch->bytes) {
+		if (bytes_written != 0)
+			say_warn("fio_ring_wait, [%s]: partial write,"
+				 " wrote %jd out of %jd bytes",
+				 fio_filename(fd), (intmax_t) bytes_written,
+				 (intmax_t) batch->bytes);
+		(void) fio_truncate(fd, ring->batch_offset + good_bytes);
+	}
+	/*
+	 * The write went at an explicit offset: move the file
+	 * position past it, as writev() would.
+	 */
+	(void) fio_lseek(fd, ring->batch_offset + good_bytes, SEEK_SET);
+	return rows;
+}
+
+#else /* defined(HAVE_IO_URING) */
+
+struct fio_ring *
+fio_ring_new(unsigned entries)
+{
+	(void) entries;
+	errno = ENOSYS;
+	return NULL;
+}
+
+void
+fio_ring_delete(struct fio_ring *ring)
+{
+	assert(ring == NULL);
+	(void) ring;
+}
+
+void
+fio_ring_atfork(struct fio_ring *ring)
+{
+	assert(ring == NULL);
+	(void) ring;
+}
+
+int
+fio_ring_submit(struct fio_ring *ring, struct fio_batch *batch,
+		int fd, off_t offset, bool sync)
+{
+	(void) ring;
+	(void) batch;
+	(void) fd;
+	(void) offset;
+	(void) sync;
+	assert(false);
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+fio_ring_wait(struct fio_ring *ring)
+{
+	(void) ring;
+	assert(false);
+	return 0;
+}
+
+#endif /* defined(HAVE_IO_URING) */
@@ -0,0 +1,71 @@
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "histogram.h"
+
+#include <string.h>
+
+void
+histogram_reset(struct histogram *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+}
+
+/** The biggest value which falls into the bucket. */
+static uint64_t
+histogram_bucket_max(int bucket)
+{
+	if (bucket < HISTOGRAM_SUB)
+		return bucket;
+	int shift = bucket / HISTOGRAM_SUB - 1;
+	uint64_t sub = HISTOGRAM_SUB + bucket % HISTOGRAM_SUB;
+	return ((sub + 1) << shift) - 1;
+}
+
+uint64_t
+histogram_percentile(const struct histogram *hist, double fraction)
+{
+	if (hist->count == 0)
+		return 0;
+	/* The number of values up to the percentile, at least 1. */
+	uint64_t rank = (uint64_t) (fraction * hist->count);
+	if (rank < fraction * hist->count || rank == 0)
+		rank++;
+	if (rank > hist->count)
+		rank = hist->count;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank) {
+			uint64_t value = histogram_bucket_max(i);
+			return value < hist->max ? value : hist->max;
+		}
+	}
+	return hist->max;
+}
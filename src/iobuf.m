@@ -105,7 +105,20 @@ obuf_init_pos(struct obuf *buf, size_t pos)
 static inline void
 obuf_alloc_pos(struct obuf *buf, size_t pos, size_t size)
 {
-	size_t capacity = pos > 0 ?  buf->capacity[pos-1] * 2 : cfg_readahead;
+	/* Skip the vectors which refer to data of others. */
+	size_t prev = pos;
+	while (prev > 0 && buf->capacity[prev - 1] == 0)
+		prev--;
+	size_t capacity = cfg_readahead;
+	if (prev > 0) {
+		capacity = buf->capacity[prev - 1];
+		/*
+		 * Don't grow if the previous buffer was left
+		 * mostly empty for a reference.
+		 */
+		if (buf->iov[prev - 1].iov_len * 2 >= capacity)
+			capacity *= 2;
+	}
 	while (capacity < size) {
 		capacity *=2;
 	}
@@ -127,16 +140,39 @@ obuf_create(struct obuf *buf, struct palloc_pool *pool)
 	obuf_init_pos(buf, buf->pos);
 }
 
+/**
+ * Empty the vectors starting from pos: release the referenced
+ * data and move the allocated buffers over the vectors which
+ * referred to it, so that the allocated buffers go first.
+ * @pre pos is not beyond the first unallocated empty vector.
+ */
+static void
+obuf_unref(struct obuf *buf, size_t pos)
+{
+	size_t end = pos;
+	for (size_t i = pos; i < IOBUF_IOV_MAX &&
+	     (buf->iov[i].iov_len != 0 || buf->capacity[i] != 0); i++) {
+		if (buf->capacity[i] == 0) {
+			buf->ref[i].unref(buf->ref[i].arg);
+			continue;
+		}
+		buf->iov[end].iov_base = buf->iov[i].iov_base;
+		buf->iov[end].iov_len = 0;
+		buf->capacity[end] = buf->capacity[i];
+		end++;
+	}
+	/* All vectors are allocated if end is beyond the last one. */
+	if (end < IOBUF_IOV_MAX)
+		obuf_init_pos(buf, end);
+}
+
 /** Mark an output buffer as empty. */
 static void
 obuf_reset(struct obuf *buf)
 {
 	buf->pos = 0;
 	buf->size = 0;
-	for (struct iovec *iov = buf->iov; iov->iov_len != 0; iov++) {
-		assert(iov < buf->iov + IOBUF_IOV_MAX);
-		iov->iov_len = 0;
-	}
+	obuf_unref(buf, 0);
 }
 
 /** Add data to the output buffer. Copies the data. */
@@ -199,6 +235,38 @@ obuf_dup(struct obuf *buf, const void *data, size_t size)
 	assert(iov->iov_len <= buf->capacity[buf->pos]);
 }
 
+bool
+obuf_ref(struct obuf *buf, const void *data, size_t size,
+	 void (*unref)(void *arg), void *arg)
+{
+	/* Refer to the data from the vector after the used ones. */
+	size_t pos = buf->iov[buf->pos].iov_len > 0 ? buf->pos + 1 : buf->pos;
+	size_t end = pos;
+	while (buf->capacity[end] != 0)
+		end++;
+	if (end + 1 + IOBUF_IOV_RESERVE > IOBUF_IOV_MAX)
+		return false;
+	/*
+	 * Allocated empty buffers are reused after a reset, so
+	 * don't overwrite them but move them along.
+	 */
+	memmove(buf->iov + pos + 1, buf->iov + pos,
+		(end - pos) * sizeof(*buf->iov));
+	memmove(buf->capacity + pos + 1, buf->capacity + pos,
+		(end - pos) * sizeof(*buf->capacity));
+	obuf_init_pos(buf, end + 1);
+
+	buf->iov[pos].iov_base = (void *) data;
+	buf->iov[pos].iov_len = size;
+	buf->capacity[pos] = 0;
+	buf->ref[pos].unref = unref;
+	buf->ref[pos].arg = arg;
+	/* Never write to the vector, continue after it. */
+	buf->pos = pos + 1;
+	buf->size += size;
+	return true;
+}
+
 /** Book a few bytes in the output buffer. */
 struct obuf_svp
 obuf_book(struct obuf *buf, size_t size)
@@ -234,21 +302,19 @@ obuf_book(struct obuf *buf, size_t size)
 void
 obuf_rollback_to_svp(struct obuf *buf, struct obuf_svp *svp)
 {
-	bool is_last_pos = buf->pos == svp->pos;
+	/*
+	 * A savepoint at an unallocated vector is at the end of
+	 * data, unless obuf_ref() has put a reference into the
+	 * vector since.
+	 */
+	if (buf->capacity[svp->pos] != 0)
+		obuf_unref(buf, svp->pos + 1);
+	else if (buf->iov[svp->pos].iov_len != 0)
+		obuf_unref(buf, svp->pos);
 
 	buf->pos = svp->pos;
 	buf->iov[buf->pos].iov_len = svp->iov_len;
 	buf->size = svp->size;
-	/**
-	 * We need this check to ensure the following
-	 * loop doesn't run away.
-	 */
-	if (is_last_pos)
-		return;
-	for (struct iovec *iov = buf->iov + buf->pos + 1; iov->iov_len != 0; iov++) {
-		assert(iov < buf->iov + IOBUF_IOV_MAX);
-		iov->iov_len = 0;
-	}
 }
 
 /* struct obuf }}} */
@@ -292,9 +358,10 @@ void
 iobuf_delete(struct iobuf *iobuf)
 {
 	struct palloc_pool *pool = iobuf->in.pool;
+	/* Release the referenced data. */
+	obuf_reset(&iobuf->out);
 	if (palloc_allocated(pool) < iobuf_max_pool_size()) {
 		ibuf_reset(&iobuf->in);
-		obuf_reset(&iobuf->out);
 	} else {
 		prelease(pool);
 		ibuf_create(&iobuf->in, pool);
@@ -31,6 +31,16 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/uio.h>
+
+#include "config.h"
+#if defined(TARGET_OS_LINUX)
+#include <sys/epoll.h>
+#endif
 
 #include "tarantool.h"
 #include "exception.h"
@@ -44,7 +54,10 @@
 #include "box/request.h"
 #include "iobuf.h"
 #include "evio.h"
+#include "sio.h"
 #include "session.h"
+#include "tarantool_pthread.h"
+#include "third_party/queue.h"
 
 enum {
 	/** Maximal iproto package body length (2GiB) */
@@ -132,6 +145,20 @@ port_iproto_eof(struct port *ptr)
 	}
 }
 
+enum {
+	/**
+	 * Tuples of this size and bigger are not copied to the
+	 * output buffer, the buffer refers to them instead.
+	 */
+	PORT_IPROTO_REF_MIN = 1024
+};
+
+static void
+port_iproto_unref_tuple(void *tuple)
+{
+	tuple_ref(tuple, -1);
+}
+
 static void
 port_iproto_add_tuple(struct port *ptr, struct tuple *tuple, u32 flags)
 {
@@ -141,7 +168,20 @@ port_iproto_add_tuple(struct port *ptr, struct tuple *tuple, u32 flags)
 		port->svp = obuf_book(port->buf, sizeof(port->reply));
 	}
 	if (flags & BOX_RETURN_TUPLE) {
-		obuf_dup(port->buf, &tuple->bsize, tuple_len(tuple));
+		size_t len = tuple_len(tuple);
+		/*
+		 * Hold a big tuple until the reply is written.
+		 * Leave plenty of room in the reference counter
+		 * for the transactions which change the tuple.
+		 */
+		if (len >= PORT_IPROTO_REF_MIN &&
+		    tuple->refs < UINT16_MAX / 2 &&
+		    obuf_ref(port->buf, &tuple->bsize, len,
+			     port_iproto_unref_tuple, tuple)) {
+			tuple_ref(tuple, 1);
+		} else {
+			obuf_dup(port->buf, &tuple->bsize, len);
+		}
 	}
 }
 
@@ -212,6 +252,7 @@ enum {
 };
 
 struct iproto_session;
+struct iproto_net_msg;
 
 typedef void (*iproto_request_f)(struct iproto_request *);
 
@@ -227,6 +268,8 @@ struct iproto_request
 	/* Position of the request in the input buffer. */
 	struct iproto_header *header;
 	iproto_request_f process;
+	/** A batch read by a network thread, or NULL. */
+	struct iproto_net_msg *msg;
 };
 
 /**
@@ -249,30 +292,38 @@ iproto_queue_is_empty(struct iproto_queue *i_queue)
 	return i_queue->begin == i_queue->end;
 }
 
-static inline void
-iproto_enqueue_request(struct iproto_queue *i_queue,
-		       struct iproto_session *session,
-		       struct iobuf *iobuf,
-		       struct iproto_header *header,
-		       iproto_request_f process)
+/** Add a request to the tail of the queue, to be filled in. */
+static inline struct iproto_request *
+iproto_queue_push(struct iproto_queue *i_queue)
 {
 	/* If the queue is full, invoke the handler to work it off. */
 	if (i_queue->end == i_queue->size)
 		ev_invoke(&i_queue->watcher, EV_CUSTOM);
 	assert(i_queue->end < i_queue->size);
 	bool was_empty = iproto_queue_is_empty(i_queue);
-	struct iproto_request *request = i_queue->queue + i_queue->end++;
-
-	request->session = session;
-	request->iobuf = iobuf;
-	request->header = header;
-	request->process = process;
 	/*
 	 * There were some queued requests, ensure they are
 	 * handled.
 	 */
 	if (was_empty)
 		ev_feed_event(&request_queue.watcher, EV_CUSTOM);
+	return i_queue->queue + i_queue->end++;
+}
+
+static inline void
+iproto_enqueue_request(struct iproto_queue *i_queue,
+		       struct iproto_session *session,
+		       struct iobuf *iobuf,
+		       struct iproto_header *header,
+		       iproto_request_f process)
+{
+	struct iproto_request *request = iproto_queue_push(i_queue);
+
+	request->session = session;
+	request->iobuf = iobuf;
+	request->header = header;
+	request->process = process;
+	request->msg = NULL;
 }
 
 static inline bool
@@ -812,6 +863,613 @@ iproto_process_disconnect(struct iproto_request *request)
 /** }}} */
 
 
+/* {{{ iproto_net: network threads */
+
+#if defined(TARGET_OS_LINUX)
+
+/**
+ * With iproto_net_threads set, connection sockets are served by
+ * network threads rather than by the event loop of the request
+ * processor (the TX thread). A network thread reads input,
+ * validates and splits it into requests and writes the replies.
+ * The TX thread only executes requests.
+ *
+ * A network thread polls its connections with epoll(7), since
+ * libev is built for a single event loop. Requests are passed
+ * around in batches: all complete requests read from a
+ * connection make up a batch, which travels to the TX thread
+ * and back with the replies. A connection has at most one batch
+ * in flight, which keeps the replies in order. Only the TX
+ * thread uses palloc: network threads allocate input buffers
+ * with malloc(), and write replies from an iobuf of the TX
+ * thread without changing it.
+ */
+
+struct iproto_net_conn;
+
+enum iproto_net_msg_type {
+	/** TX -> net: start serving a connection. */
+	IPROTO_NET_ATTACH,
+	/** net -> TX: requests read from a connection. */
+	IPROTO_NET_BATCH,
+	/** TX -> net: replies to the requests of a batch. */
+	IPROTO_NET_REPLY,
+	/** net -> TX: the replies are sent, free the iobuf. */
+	IPROTO_NET_DONE,
+	/** net -> TX: the connection is closed. */
+	IPROTO_NET_DETACH,
+};
+
+struct iproto_net_msg
+{
+	STAILQ_ENTRY(iproto_net_msg) next;
+	enum iproto_net_msg_type type;
+	struct iproto_net_conn *conn;
+	/** Complete requests, malloc()ed by the network thread. */
+	char *data;
+	size_t size;
+	/** The number of requests which are not processed yet. */
+	int pending;
+	/** Replies, allocated by the TX thread. */
+	struct iobuf *iobuf;
+	/** The position of the replies sent so far. */
+	struct obuf_svp write_pos;
+};
+
+STAILQ_HEAD(iproto_net_fifo, iproto_net_msg);
+
+/** A mailbox of a thread. */
+struct iproto_net_inbox
+{
+	pthread_mutex_t mutex;
+	struct iproto_net_fifo fifo;
+};
+
+struct iproto_net_thread
+{
+	pthread_t thread;
+	int epfd;
+	/** A pipe to wake the thread up when its inbox is filled. */
+	int wakeup[2];
+	struct iproto_net_inbox inbox;
+};
+
+struct iproto_net_conn
+{
+	int fd;
+	struct iproto_net_thread *thread;
+	/** Used to attach and detach the connection. */
+	struct iproto_net_msg ctl;
+	/* Accessed only by the TX thread. */
+	box_process_func *handler;
+	uint32_t sid;
+	/* Accessed only by the network thread. */
+	char *rbuf;
+	size_t rsize, rcapacity;
+	/** The batch which is at the TX thread or being written. */
+	struct iproto_net_msg *in_flight;
+	/** Events the socket is polled for. */
+	uint32_t events;
+	bool is_closed;
+};
+
+enum { IPROTO_NET_EVENTS = 256 };
+
+static struct iproto_net_thread *net_threads;
+static int net_thread_count;
+/** The thread to hand the next connection to. */
+static int net_thread_next;
+/** cfg_readahead, as it was at start: it is changed in TX. */
+static size_t net_readahead;
+
+/** The mailbox of the TX thread, drained in tx_event. */
+static struct iproto_net_inbox tx_inbox;
+static struct ev_async tx_event;
+
+static void
+iproto_net_inbox_init(struct iproto_net_inbox *inbox)
+{
+	(void) tt_pthread_mutex_init(&inbox->mutex, NULL);
+	STAILQ_INIT(&inbox->fifo);
+}
+
+/**
+ * Append messages to an inbox.
+ * @return true if the inbox was empty, i.e. the receiver
+ * needs to be woken up.
+ */
+static bool
+iproto_net_inbox_put(struct iproto_net_inbox *inbox,
+		     struct iproto_net_fifo *fifo)
+{
+	(void) tt_pthread_mutex_lock(&inbox->mutex);
+	bool was_empty = STAILQ_EMPTY(&inbox->fifo);
+	STAILQ_CONCAT(&inbox->fifo, fifo);
+	(void) tt_pthread_mutex_unlock(&inbox->mutex);
+	return was_empty;
+}
+
+static void
+iproto_net_inbox_get(struct iproto_net_inbox *inbox,
+		     struct iproto_net_fifo *fifo)
+{
+	(void) tt_pthread_mutex_lock(&inbox->mutex);
+	STAILQ_CONCAT(fifo, &inbox->fifo);
+	(void) tt_pthread_mutex_unlock(&inbox->mutex);
+}
+
+/** Send a message from the TX thread to a network thread. */
+static void
+iproto_net_post(struct iproto_net_thread *thread, struct iproto_net_msg *msg)
+{
+	struct iproto_net_fifo fifo = STAILQ_HEAD_INITIALIZER(fifo);
+	STAILQ_INSERT_TAIL(&fifo, msg, next);
+	if (iproto_net_inbox_put(&thread->inbox, &fifo)) {
+		/* A full pipe will wake the thread up anyway. */
+		char c = 0;
+		(void) write(thread->wakeup[1], &c, 1);
+	}
+}
+
+/** Send messages from a network thread to the TX thread. */
+static void
+iproto_tx_post(struct iproto_net_fifo *fifo)
+{
+	if (STAILQ_EMPTY(fifo))
+		return;
+	iproto_net_inbox_put(&tx_inbox, fifo);
+	ev_async_send(&tx_event);
+}
+
+/** Update the events the connection socket is polled for. */
+static void
+iproto_net_poll(struct iproto_net_conn *conn)
+{
+	uint32_t events = 0;
+	/* Stop reading if requests pile up behind a batch. */
+	if (conn->in_flight == NULL || conn->rsize < net_readahead)
+		events |= EPOLLIN;
+	if (conn->in_flight != NULL &&
+	    conn->in_flight->type == IPROTO_NET_REPLY)
+		events |= EPOLLOUT;
+	if (events == conn->events)
+		return;
+	struct epoll_event ev = { .events = events, .data.ptr = conn };
+	if (epoll_ctl(conn->thread->epfd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+		say_syserror("epoll_ctl");
+	conn->events = events;
+}
+
+/** Let the TX thread destroy the session and free the connection. */
+static void
+iproto_net_detach(struct iproto_net_conn *conn, struct iproto_net_fifo *output)
+{
+	conn->ctl.type = IPROTO_NET_DETACH;
+	STAILQ_INSERT_TAIL(output, &conn->ctl, next);
+}
+
+static void
+iproto_net_close(struct iproto_net_conn *conn, struct iproto_net_fifo *output)
+{
+	if (conn->is_closed)
+		return;
+	conn->is_closed = true;
+	(void) epoll_ctl(conn->thread->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	free(conn->rbuf);
+	conn->rbuf = NULL;
+	conn->rsize = conn->rcapacity = 0;
+	/*
+	 * The batch in flight refers to the connection, so
+	 * detach it only when the batch is back.
+	 */
+	if (conn->in_flight == NULL)
+		iproto_net_detach(conn, output);
+}
+
+/**
+ * Pass all complete requests in the input buffer to the TX
+ * thread and move the incomplete tail to a new buffer.
+ */
+static void
+iproto_net_dispatch(struct iproto_net_conn *conn, struct iproto_net_fifo *output)
+{
+	if (conn->in_flight != NULL || conn->is_closed)
+		return;
+
+	size_t parsed = 0;
+	int count = 0;
+	while (conn->rsize - parsed >= sizeof(struct iproto_header)) {
+		struct iproto_header *header = iproto(conn->rbuf + parsed);
+		if (header->len > IPROTO_BODY_LEN_MAX) {
+			say_error("received package is too big: %llu",
+				  (unsigned long long) header->len);
+			iproto_net_close(conn, output);
+			return;
+		}
+		if (conn->rsize - parsed < sizeof(*header) + header->len)
+			break;
+		parsed += sizeof(*header) + header->len;
+		count++;
+	}
+	if (count == 0)
+		return;
+
+	size_t tail = conn->rsize - parsed;
+	size_t capacity = MAX(net_readahead, tail);
+	struct iproto_net_msg *msg = malloc(sizeof(*msg));
+	char *rbuf = malloc(capacity);
+	if (msg == NULL || rbuf == NULL) {
+		say_syserror("malloc");
+		free(msg);
+		free(rbuf);
+		iproto_net_close(conn, output);
+		return;
+	}
+	memcpy(rbuf, conn->rbuf + parsed, tail);
+
+	msg->type = IPROTO_NET_BATCH;
+	msg->conn = conn;
+	msg->data = conn->rbuf;
+	msg->size = parsed;
+	msg->pending = count;
+	msg->iobuf = NULL;
+	STAILQ_INSERT_TAIL(output, msg, next);
+
+	conn->in_flight = msg;
+	conn->rbuf = rbuf;
+	conn->rsize = tail;
+	conn->rcapacity = capacity;
+}
+
+static void
+iproto_net_read(struct iproto_net_conn *conn, struct iproto_net_fifo *output)
+{
+	if (conn->rsize == conn->rcapacity) {
+		/* Wait for the batch in flight to make room. */
+		if (conn->in_flight != NULL)
+			return;
+		/*
+		 * Nothing is dispatched from a full buffer, so it
+		 * holds a part of a single big request.
+		 */
+		size_t capacity = conn->rcapacity * 2;
+		if (conn->rsize >= sizeof(struct iproto_header)) {
+			struct iproto_header *header = iproto(conn->rbuf);
+			capacity = MAX(capacity, sizeof(*header) + header->len);
+		}
+		char *rbuf = realloc(conn->rbuf, capacity);
+		if (rbuf == NULL) {
+			say_syserror("realloc");
+			iproto_net_close(conn, output);
+			return;
+		}
+		conn->rbuf = rbuf;
+		conn->rcapacity = capacity;
+	}
+	ssize_t nrd = read(conn->fd, conn->rbuf + conn->rsize,
+			   conn->rcapacity - conn->rsize);
+	if (nrd < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return;
+		say_syserror("read");
+		iproto_net_close(conn, output);
+		return;
+	}
+	if (nrd == 0) {                 /* EOF */
+		iproto_net_close(conn, output);
+		return;
+	}
+	conn->rsize += nrd;
+	iproto_net_dispatch(conn, output);
+	if (! conn->is_closed)
+		iproto_net_poll(conn);
+}
+
+/** writev() the replies to the batch in flight. */
+static void
+iproto_net_write(struct iproto_net_conn *conn, struct iproto_net_fifo *output)
+{
+	struct iproto_net_msg *msg = conn->in_flight;
+	struct obuf *out = &msg->iobuf->out;
+	struct obuf_svp *svp = &msg->write_pos;
+
+	while (svp->size < obuf_size(out)) {
+		struct iovec *iov = out->iov + svp->pos;
+		int iovcnt = obuf_iovcnt(out) - svp->pos;
+		sio_add_to_iov(iov, -svp->iov_len);
+		ssize_t nwr = writev(conn->fd, iov, iovcnt);
+		sio_add_to_iov(iov, svp->iov_len);
+		if (nwr < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK ||
+			    errno == EINTR) {
+				iproto_net_poll(conn);
+				return;
+			}
+			say_syserror("writev");
+			break;
+		}
+		svp->size += nwr;
+		svp->pos += sio_move_iov(iov, nwr, &svp->iov_len);
+	}
+	/* Return the batch to the TX thread to free the iobuf. */
+	msg->type = IPROTO_NET_DONE;
+	STAILQ_INSERT_TAIL(output, msg, next);
+	conn->in_flight = NULL;
+
+	if (svp->size < obuf_size(out)) {
+		iproto_net_close(conn, output);
+		return;
+	}
+	/* Requests might have been read behind the batch. */
+	iproto_net_dispatch(conn, output);
+	if (! conn->is_closed)
+		iproto_net_poll(conn);
+}
+
+/** Handle messages from the TX thread. */
+static void
+iproto_net_process_inbox(struct iproto_net_thread *thread,
+			 struct iproto_net_fifo *output)
+{
+	char buf[64];
+	while (read(thread->wakeup[0], buf, sizeof(buf)) > 0)
+		;
+	struct iproto_net_fifo input = STAILQ_HEAD_INITIALIZER(input);
+	iproto_net_inbox_get(&thread->inbox, &input);
+
+	struct iproto_net_msg *msg, *tmp;
+	STAILQ_FOREACH_SAFE(msg, &input, next, tmp) {
+		struct iproto_net_conn *conn = msg->conn;
+		if (msg->type == IPROTO_NET_ATTACH) {
+			struct epoll_event ev = {
+				.events = EPOLLIN, .data.ptr = conn
+			};
+			conn->events = EPOLLIN;
+			if (epoll_ctl(thread->epfd, EPOLL_CTL_ADD,
+				      conn->fd, &ev) < 0) {
+				say_syserror("epoll_ctl");
+				iproto_net_close(conn, output);
+			}
+			continue;
+		}
+		assert(msg->type == IPROTO_NET_REPLY &&
+		       msg == conn->in_flight);
+		if (! conn->is_closed) {
+			iproto_net_write(conn, output);
+		} else {
+			msg->type = IPROTO_NET_DONE;
+			STAILQ_INSERT_TAIL(output, msg, next);
+			conn->in_flight = NULL;
+			iproto_net_detach(conn, output);
+		}
+	}
+}
+
+/** The main loop of a network thread. */
+static void *
+iproto_net_thread_f(void *arg)
+{
+	struct iproto_net_thread *thread = arg;
+	struct epoll_event events[IPROTO_NET_EVENTS];
+
+	/* Signals are handled by the TX thread. */
+	sigset_t sigset;
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+	while (true) {
+		int n = epoll_wait(thread->epfd, events, nelem(events), -1);
+		if (n < 0 && errno != EINTR)
+			panic_syserror("epoll_wait");
+
+		struct iproto_net_fifo output = STAILQ_HEAD_INITIALIZER(output);
+		for (int i = 0; i < n; i++) {
+			struct iproto_net_conn *conn = events[i].data.ptr;
+			if (conn == NULL) {
+				iproto_net_process_inbox(thread, &output);
+				continue;
+			}
+			if (! conn->is_closed && events[i].events & EPOLLOUT)
+				iproto_net_write(conn, &output);
+			if (! conn->is_closed && events[i].events & EPOLLIN)
+				iproto_net_read(conn, &output);
+			/*
+			 * HUP and ERR are reported regardless of the
+			 * events polled for, and a connection which
+			 * doesn't read would get them over and over.
+			 */
+			if (! conn->is_closed && events[i].events &
+			    (EPOLLHUP | EPOLLERR))
+				iproto_net_close(conn, &output);
+		}
+		/*
+		 * Closed connections are freed once the TX thread
+		 * gets their detach messages, so post them only
+		 * after all events are handled.
+		 */
+		iproto_tx_post(&output);
+	}
+	return NULL;
+}
+
+/** Execute a request of a batch, in the TX thread. */
+static void
+iproto_net_process_request(struct iproto_request *request)
+{
+	struct iproto_net_msg *msg = request->msg;
+	struct iproto_net_conn *conn = msg->conn;
+	struct port_iproto port;
+	@try {
+		fiber_set_sid(fiber, conn->sid);
+		iproto_reply(&port, *conn->handler,
+			     &request->iobuf->out, request->header);
+	} @finally {
+		if (--msg->pending == 0) {
+			free(msg->data);
+			msg->data = NULL;
+			msg->type = IPROTO_NET_REPLY;
+			iproto_net_post(conn->thread, msg);
+		}
+	}
+}
+
+/** Close a connection which is not handed to a network thread. */
+static void
+iproto_net_conn_delete(struct iproto_net_conn *conn)
+{
+	close(conn->fd);
+	free(conn->rbuf);
+	free(conn);
+}
+
+/**
+ * Handshake a connection in the TX thread and hand it to
+ * a network thread. See iproto_process_connect().
+ */
+static void
+iproto_net_process_connect(struct iproto_request *request)
+{
+	struct iproto_net_conn *conn = request->msg->conn;
+	@try {
+		conn->sid = session_create(conn->fd);
+	} @catch (ClientError *e) {
+		struct obuf out;
+		obuf_create(&out, fiber->gc_pool);
+		iproto_reply_error(&out, request->header, e);
+		(void) writev(conn->fd, out.iov, obuf_iovcnt(&out));
+		iproto_net_conn_delete(conn);
+		return;
+	} @catch (tnt_Exception *e) {
+		[e log];
+		assert(conn->sid == 0);
+		iproto_net_conn_delete(conn);
+		return;
+	}
+	conn->ctl.type = IPROTO_NET_ATTACH;
+	iproto_net_post(conn->thread, &conn->ctl);
+}
+
+static void
+iproto_net_process_disconnect(struct iproto_request *request)
+{
+	struct iproto_net_conn *conn = request->msg->conn;
+	fiber_set_sid(fiber, conn->sid);
+	/* Runs the trigger, which may yield. */
+	session_destroy(conn->sid);
+	free(conn);
+}
+
+/** Queue a request which refers to a network thread message. */
+static void
+iproto_net_enqueue_request(struct iproto_net_msg *msg,
+			   struct iproto_header *header,
+			   iproto_request_f process)
+{
+	struct iproto_request *request = iproto_queue_push(&request_queue);
+	request->session = NULL;
+	request->iobuf = msg->iobuf;
+	request->header = header;
+	request->process = process;
+	request->msg = msg;
+}
+
+/** Handle messages from network threads. */
+static void
+iproto_tx_schedule(struct ev_async *watcher __attribute__((unused)),
+		   int events __attribute__((unused)))
+{
+	struct iproto_net_fifo input = STAILQ_HEAD_INITIALIZER(input);
+	iproto_net_inbox_get(&tx_inbox, &input);
+
+	struct iproto_net_msg *msg, *tmp;
+	STAILQ_FOREACH_SAFE(msg, &input, next, tmp) {
+		switch (msg->type) {
+		case IPROTO_NET_BATCH:
+			msg->iobuf = iobuf_new("iproto_net");
+			msg->write_pos = obuf_create_svp(&msg->iobuf->out);
+			for (char *pos = msg->data; pos < msg->data + msg->size;) {
+				struct iproto_header *header = iproto(pos);
+				pos += sizeof(*header) + header->len;
+				iproto_net_enqueue_request(msg, header,
+					iproto_net_process_request);
+			}
+			break;
+		case IPROTO_NET_DONE:
+			iobuf_delete(msg->iobuf);
+			free(msg);
+			break;
+		case IPROTO_NET_DETACH:
+			iproto_net_enqueue_request(msg, &dummy_header,
+				iproto_net_process_disconnect);
+			break;
+		default:
+			assert(false);
+		}
+	}
+}
+
+/** Hand an accepted connection to a network thread. */
+static void
+iproto_net_on_accept(struct evio_service *service, int fd,
+		     struct sockaddr_in *addr __attribute__((unused)))
+{
+	struct iproto_net_conn *conn = calloc(1, sizeof(*conn));
+	if (conn == NULL) {
+		tnt_raise(LoggedError, :ER_MEMORY_ISSUE, sizeof(*conn),
+			  "iproto", "connection");
+	}
+	conn->fd = fd;
+	conn->thread = &net_threads[net_thread_next++ % net_thread_count];
+	conn->handler = service->on_accept_param;
+	conn->rcapacity = net_readahead;
+	conn->rbuf = malloc(conn->rcapacity);
+	if (conn->rbuf == NULL) {
+		free(conn);
+		tnt_raise(LoggedError, :ER_MEMORY_ISSUE, net_readahead,
+			  "iproto", "input buffer");
+	}
+	conn->ctl.conn = conn;
+	iproto_net_enqueue_request(&conn->ctl, &dummy_header,
+				   iproto_net_process_connect);
+}
+
+/** Start network threads. */
+static void
+iproto_net_init(int thread_count)
+{
+	net_readahead = cfg_readahead;
+	net_thread_count = thread_count;
+	net_threads = calloc(thread_count, sizeof(*net_threads));
+	if (net_threads == NULL)
+		panic_syserror("calloc");
+
+	iproto_net_inbox_init(&tx_inbox);
+	ev_async_init(&tx_event, iproto_tx_schedule);
+	ev_async_start(&tx_event);
+
+	for (int i = 0; i < thread_count; i++) {
+		struct iproto_net_thread *thread = &net_threads[i];
+		iproto_net_inbox_init(&thread->inbox);
+		thread->epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (thread->epfd < 0 || pipe(thread->wakeup) < 0)
+			panic_syserror("iproto: can't start a network thread");
+		sio_setfl(thread->wakeup[0], O_NONBLOCK, 1);
+		sio_setfl(thread->wakeup[1], O_NONBLOCK, 1);
+		struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+		if (epoll_ctl(thread->epfd, EPOLL_CTL_ADD,
+			      thread->wakeup[0], &ev) < 0 ||
+		    tt_pthread_create(&thread->thread, NULL,
+				      iproto_net_thread_f, thread) != 0)
+			panic_syserror("iproto: can't start a network thread");
+	}
+	say_info("iproto: started %i network threads", thread_count);
+}
+
+#endif /* defined(TARGET_OS_LINUX) */
+
+/* }}} */
+
 /**
  * Create a session context and start input.
  */
@@ -835,14 +1493,25 @@ iproto_on_accept(struct evio_service *service, int fd,
  */
 void
 iproto_init(const char *bind_ipaddr, int primary_port,
-	    int secondary_port)
+	    int secondary_port, int net_threads)
 {
+	void (*on_accept)(struct evio_service *, int, struct sockaddr_in *) =
+		iproto_on_accept;
+#if defined(TARGET_OS_LINUX)
+	if (net_threads > 0) {
+		iproto_net_init(net_threads);
+		on_accept = iproto_net_on_accept;
+	}
+#else
+	assert(net_threads == 0);
+#endif
+
 	/* Run a primary server. */
 	if (primary_port != 0) {
 		static struct evio_service primary;
 		evio_service_init(&primary, "primary",
 				  bind_ipaddr, primary_port,
-				  iproto_on_accept, &box_process);
+				  on_accept, &box_process);
 		evio_service_on_bind(&primary,
 				     box_leave_local_standby_mode, NULL);
 		evio_service_start(&primary);
@@ -853,7 +1522,7 @@ iproto_init(const char *bind_ipaddr, int primary_port,
 		static struct evio_service secondary;
 		evio_service_init(&secondary, "secondary",
 				  bind_ipaddr, secondary_port,
-				  iproto_on_accept, &box_process_ro);
+				  on_accept, &box_process_ro);
 		evio_service_start(&secondary);
 	}
 	iproto_queue_init(&request_queue, IPROTO_REQUEST_QUEUE_SIZE,
@@ -74,7 +74,89 @@ bitset_test(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	return bit_test(bitset_page_data(page), pos - page->first_pos);
+	return bitset_page_test(page, pos - page->first_pos);
+}
+
+/**
+ * @brief Grow a full array page or convert it to a bitmap page
+ * if it has reached BITSET_PAGE_ARRAY_MAX elements.
+ * @return the new page or NULL on memory error
+ */
+static struct bitset_page *
+bitset_page_array_grow(struct bitset *bitset, struct bitset_page *page)
+{
+	assert(page->type == BITSET_PAGE_ARRAY);
+	assert(page->cardinality == page->capacity);
+
+	struct bitset_page *new_page;
+	if (page->capacity < BITSET_PAGE_ARRAY_MAX) {
+		/* The page is moved by realloc, so reinsert it */
+		size_t capacity = page->capacity * 2;
+		bitset_pages_remove(&bitset->pages, page);
+		new_page = bitset->realloc(page,
+				bitset_page_array_alloc_size(capacity));
+		if (new_page == NULL) {
+			bitset_pages_insert(&bitset->pages, page);
+			return NULL;
+		}
+		new_page->capacity = capacity;
+		bitset_pages_insert(&bitset->pages, new_page);
+		return new_page;
+	}
+
+	new_page = bitset->realloc(NULL,
+				   bitset_page_alloc_size(bitset->realloc));
+	if (new_page == NULL)
+		return NULL;
+
+	bitset_page_create(new_page);
+	new_page->first_pos = page->first_pos;
+	new_page->cardinality = page->cardinality;
+	void *data = bitset_page_data(new_page);
+	const uint16_t *array = bitset_page_array(page);
+	for (size_t i = 0; i < page->cardinality; i++) {
+		bit_set(data, array[i]);
+	}
+
+	bitset_pages_remove(&bitset->pages, page);
+	bitset_pages_insert(&bitset->pages, new_page);
+	bitset_page_destroy(page);
+	bitset->realloc(page, 0);
+	return new_page;
+}
+
+/**
+ * @brief Convert a bitmap page which has become sparse to an
+ * array page. The page is left as is if there is no memory.
+ */
+static void
+bitset_page_bitmap_shrink(struct bitset *bitset, struct bitset_page *page)
+{
+	assert(page->type == BITSET_PAGE_BITMAP);
+	assert(page->cardinality <= BITSET_PAGE_ARRAY_MAX / 2);
+
+	size_t capacity = BITSET_PAGE_ARRAY_MAX / 2;
+	struct bitset_page *new_page =
+		bitset->realloc(NULL, bitset_page_array_alloc_size(capacity));
+	if (new_page == NULL)
+		return;
+
+	bitset_page_array_create(new_page, capacity);
+	new_page->first_pos = page->first_pos;
+	uint16_t *array = bitset_page_array(new_page);
+	struct bit_iterator it;
+	bit_iterator_init(&it, bitset_page_data(page),
+			  BITSET_PAGE_DATA_SIZE, true);
+	size_t pos;
+	while ((pos = bit_iterator_next(&it)) != SIZE_MAX) {
+		array[new_page->cardinality++] = pos;
+	}
+	assert(new_page->cardinality == page->cardinality);
+
+	bitset_pages_remove(&bitset->pages, page);
+	bitset_pages_insert(&bitset->pages, new_page);
+	bitset_page_destroy(page);
+	bitset->realloc(page, 0);
 }
 
 int
@@ -86,13 +168,14 @@ bitset_set(struct bitset *bitset, size_t pos)
 	/* Find a page in pages tree */
 	struct bitset_page *page = bitset_pages_search(&bitset->pages, &key);
 	if (page == NULL) {
-		/* Allocate a new page */
-		size_t size = bitset_page_alloc_size(bitset->realloc);
+		/* Allocate a new page, it is sparse for now */
+		size_t size = bitset_page_array_alloc_size(
+			BITSET_PAGE_ARRAY_MIN);
 		page = bitset->realloc(NULL, size);
 		if (page == NULL)
 			return -1;
 
-		bitset_page_create(page);
+		bitset_page_array_create(page, BITSET_PAGE_ARRAY_MIN);
 		page->first_pos = key.first_pos;
 
 		/* Insert the page into pages tree */
@@ -101,8 +184,29 @@ bitset_set(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	bool prev = bit_set(bitset_page_data(page), pos - page->first_pos);
-	if (prev) {
+	size_t offset = pos - page->first_pos;
+	if (page->type == BITSET_PAGE_ARRAY) {
+		size_t i = bitset_page_array_lower_bound(page, offset);
+		if (i < page->cardinality &&
+		    bitset_page_array(page)[i] == offset) {
+			/* Value has not changed */
+			return 1;
+		}
+
+		if (page->cardinality == page->capacity) {
+			page = bitset_page_array_grow(bitset, page);
+			if (page == NULL)
+				return -1;
+		}
+	}
+
+	if (page->type == BITSET_PAGE_ARRAY) {
+		size_t i = bitset_page_array_lower_bound(page, offset);
+		uint16_t *array = bitset_page_array(page);
+		memmove(array + i + 1, array + i,
+			(page->cardinality - i) * sizeof(*array));
+		array[i] = offset;
+	} else if (bit_set(bitset_page_data(page), offset)) {
 		/* Value has not changed */
 		return 1;
 	}
@@ -126,8 +230,16 @@ bitset_clear(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	bool prev = bit_clear(bitset_page_data(page), pos - page->first_pos);
-	if (!prev) {
+	size_t offset = pos - page->first_pos;
+	if (page->type == BITSET_PAGE_ARRAY) {
+		size_t i = bitset_page_array_lower_bound(page, offset);
+		uint16_t *array = bitset_page_array(page);
+		if (i >= page->cardinality || array[i] != offset)
+			return 0;
+
+		memmove(array + i, array + i + 1,
+			(page->cardinality - i - 1) * sizeof(*array));
+	} else if (!bit_clear(bitset_page_data(page), offset)) {
 		return 0;
 	}
 
@@ -142,6 +254,10 @@ bitset_clear(struct bitset *bitset, size_t pos)
 		/* Free the page */
 		bitset_page_destroy(page);
 		bitset->realloc(page, 0);
+	} else if (page->type == BITSET_PAGE_BITMAP &&
+		   page->cardinality == BITSET_PAGE_ARRAY_MAX / 2) {
+		/* The page has become sparse */
+		bitset_page_bitmap_shrink(bitset, page);
 	}
 
 	return 1;
@@ -162,10 +278,15 @@ bitset_info(struct bitset *bitset, struct bitset_info *info)
 	struct bitset_page *page = bitset_pages_first(&bitset->pages);
 	while (page != NULL) {
 		info->pages++;
+		if (page->type == BITSET_PAGE_ARRAY)
+			info->array_pages++;
+		info->mem_used += bitset_page_size(page, bitset->realloc);
 		cardinality_check += page->cardinality;
 		page = bitset_pages_next(&bitset->pages, page);
 	}
 
+	info->mem_saved = info->pages * info->page_total_size -
+			  info->mem_used;
 	assert(bitset_cardinality(bitset) == cardinality_check);
 }
 
@@ -184,6 +305,7 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		info.page_data_size, info.page_total_size);
 	fprintf(stream, "    " "page_bit    = %zu\n", PAGE_BIT);
 	fprintf(stream, "    " "pages       = %zu\n", info.pages);
+	fprintf(stream, "    " "array_pages = %zu\n", info.array_pages);
 
 
 	size_t cardinality = bitset_cardinality(bitset);
@@ -202,12 +324,12 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		fprintf(stream, "    "
 			"utilization = undefined\n");
 	}
-	size_t mem_data  = info.page_data_size * info.pages;
-	size_t mem_total = info.page_total_size * info.pages;
+	size_t mem_total = info.mem_used;
 
-	fprintf(stream, "    " "mem_data    = %zu bytes\n", mem_data);
 	fprintf(stream, "    " "mem_total   = %zu bytes "
 		"/* data + padding + tree */\n", mem_total);
+	fprintf(stream, "    " "mem_saved   = %zu bytes "
+		"/* by array pages */\n", info.mem_saved);
 	if (cardinality > 0) {
 		fprintf(stream, "    "
 			"density     = %-8.4f bytes per value\n",
@@ -232,9 +354,10 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		fprintf(stream, "        " "[%zu, %zu) ",
 			page->first_pos, page_last_pos);
 
-		fprintf(stream, "utilization = %8.4f%% (%zu/%zu)",
+		fprintf(stream, "%s utilization = %8.4f%% (%zu/%zu)",
+			page->type == BITSET_PAGE_ARRAY ? "array " : "bitmap",
 			(float) page->cardinality * 1e2 / PAGE_BIT,
-			page->cardinality, PAGE_BIT);
+			(size_t) page->cardinality, PAGE_BIT);
 
 		if (verbose < 2) {
 			fprintf(stream, "\n");
@@ -244,11 +367,9 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 
 		fprintf(stream, "vals = {");
 
-		size_t pos = 0;
-		struct bit_iterator it;
-		bit_iterator_init(&it, bitset_page_data(page),
-			      BITSET_PAGE_DATA_SIZE, true);
-		while ( (pos = bit_iterator_next(&it)) != SIZE_MAX) {
+		for (size_t pos = 0; pos < PAGE_BIT; pos++) {
+			if (!bitset_page_test(page, pos))
+				continue;
 			fprintf(stream, "%zu, ", page->first_pos + pos);
 		}
 
@@ -84,11 +84,6 @@ bitset_iterator_destroy(struct bitset_iterator *it)
 		it->realloc(it->page, 0);
 	}
 
-	if (it->page != NULL) {
-		bitset_page_destroy(it->page_tmp);
-		it->realloc(it->page_tmp, 0);
-	}
-
 	memset(it, 0, sizeof(*it));
 }
 
@@ -188,17 +183,10 @@ bitset_iterator_init(struct bitset_iterator *it, struct bitset_expr *expr,
 		it->page = it->realloc(NULL, page_alloc_size);
 	}
 
-	bitset_page_create(it->page);
-
-	if (it->page_tmp != NULL) {
-		bitset_page_destroy(it->page_tmp);
-	} else {
-		it->page_tmp = it->realloc(NULL, page_alloc_size);
-		if (it->page_tmp == NULL)
-			return -1;
-	}
+	if (it->page == NULL)
+		return -1;
 
-	bitset_page_create(it->page_tmp);
+	bitset_page_create(it->page);
 
 	if (bitset_iterator_reserve(it, expr->size) != 0)
 		return -1;
@@ -294,39 +282,6 @@ bitset_iterator_conj_cmp(const void *p1, const void *p2)
 	}
 }
 
-static void
-bitset_iterator_conj_prepare_page(struct bitset_iterator_conj *conj,
-				  struct bitset_page *dst)
-{
-	assert(conj != NULL);
-	assert(dst != NULL);
-	assert(conj->size > 0);
-	assert(conj->page_first_pos != SIZE_MAX);
-
-	bitset_page_set_ones(dst);
-	for (size_t b = 0; b < conj->size; b++) {
-		if (!conj->pre_nots[b]) {
-			/* conj->pages[b] is rewinded to conj->page_first_pos */
-			assert(conj->pages[b]->first_pos == conj->page_first_pos);
-			bitset_page_and(dst, conj->pages[b]);
-		} else {
-			/*
-			 * If page is NULL or its position is not equal
-			 * to conj->page_first_pos then conj->bitset[b]
-			 * does not have page with the required position and
-			 * all bits in this page are considered to be zeros.
-			 * Since NAND(a, zeros) => a, we can simple skip this
-			 * bitset here.
-			 */
-			if (conj->pages[b] == NULL ||
-			    conj->pages[b]->first_pos != conj->page_first_pos)
-				continue;
-
-			bitset_page_nand(dst, conj->pages[b]);
-		}
-	}
-}
-
 static void
 bitset_iterator_prepare_page(struct bitset_iterator *it)
 {
@@ -346,13 +301,14 @@ bitset_iterator_prepare_page(struct bitset_iterator *it)
 
 	/* For each conj where conj->page_first_pos == pos */
 	for (size_t c = 0; c < it->size; c++) {
-		if (it->conjs[c].page_first_pos > it->page->first_pos)
+		struct bitset_iterator_conj *conj = &it->conjs[c];
+		if (conj->page_first_pos > it->page->first_pos)
 			break;
 
-		/* Get result from conj */
-		bitset_iterator_conj_prepare_page(&it->conjs[c], it->page_tmp);
-		/* OR page from conjunction with it->page */
-		bitset_page_or(it->page, it->page_tmp);
+		/* AND pages of conj and OR the result with it->page */
+		assert(conj->size > 0);
+		bitset_page_conj_or(it->page, conj->pages, conj->pre_nots,
+				    conj->size);
 	}
 
 	/* Init the bit iterator on it->page */
@@ -367,6 +323,7 @@ bitset_iterator_first_page(struct bitset_iterator *it)
 
 	/* Rewind all conjunctions to first positions */
 	for (size_t c = 0; c < it->size; c++) {
+		it->conjs[c].page_first_pos = 0;
 		bitset_iterator_conj_rewind(&it->conjs[c], 0);
 	}
 
@@ -423,3 +380,17 @@ bitset_iterator_next(struct bitset_iterator *it)
 		bitset_iterator_next_page(it);
 	}
 }
+
+size_t
+bitset_iterator_count(struct bitset_iterator *it)
+{
+	assert(it != NULL);
+
+	size_t count = 0;
+	for (bitset_iterator_first_page(it); it->page->first_pos != SIZE_MAX;
+	     bitset_iterator_next_page(it)) {
+		count += bitset_page_count(it->page);
+	}
+
+	return count;
+}
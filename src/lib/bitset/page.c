@@ -39,6 +39,25 @@ bitset_page_data(struct bitset_page *page);
 extern inline void
 bitset_page_create(struct bitset_page *page);
 
+extern inline size_t
+bitset_page_array_alloc_size(size_t capacity);
+
+extern inline void
+bitset_page_array_create(struct bitset_page *page, size_t capacity);
+
+extern inline uint16_t *
+bitset_page_array(struct bitset_page *page);
+
+extern inline size_t
+bitset_page_array_lower_bound(struct bitset_page *page, size_t offset);
+
+extern inline bool
+bitset_page_test(struct bitset_page *page, size_t offset);
+
+extern inline size_t
+bitset_page_size(struct bitset_page *page,
+		 void *(*realloc_arg)(void *ptr, size_t size));
+
 extern inline void
 bitset_page_destroy(struct bitset_page *page);
 
@@ -60,11 +79,343 @@ bitset_page_nand(struct bitset_page *dst, struct bitset_page *src);
 extern inline void
 bitset_page_or(struct bitset_page *dst, struct bitset_page *src);
 
+extern inline size_t
+bitset_page_count(struct bitset_page *page);
+
+enum { BITSET_PAGE_WORDS = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t) };
+
+static void
+page_and_generic(void *dst, const void *src)
+{
+	bitset_word_t *d = (bitset_word_t *) dst;
+	const bitset_word_t *s = (const bitset_word_t *) src;
+
+	assert (BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
+	for (int i = 0; i < BITSET_PAGE_WORDS; i++) {
+		*d++ &= *s++;
+	}
+}
+
+static void
+page_nand_generic(void *dst, const void *src)
+{
+	bitset_word_t *d = (bitset_word_t *) dst;
+	const bitset_word_t *s = (const bitset_word_t *) src;
+
+	assert (BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
+	for (int i = 0; i < BITSET_PAGE_WORDS; i++) {
+		*d++ &= ~*s++;
+	}
+}
+
+static void
+page_or_generic(void *dst, const void *src)
+{
+	bitset_word_t *d = (bitset_word_t *) dst;
+	const bitset_word_t *s = (const bitset_word_t *) src;
+
+	assert (BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
+	for (int i = 0; i < BITSET_PAGE_WORDS; i++) {
+		*d++ |= *s++;
+	}
+}
+
+/**
+ * Returns true if the page of a negated term must be skipped,
+ * see bitset_page_kernels.conj_or
+ */
+static inline bool
+page_conj_skip(const struct bitset_page *dst, const struct bitset_page *page,
+	       bool not)
+{
+	if (!not) {
+		/* Non-negated pages are rewinded to dst->first_pos */
+		assert(page != NULL && page->first_pos == dst->first_pos);
+		return false;
+	}
+
+	/*
+	 * If page is NULL or its position is not equal to
+	 * dst->first_pos then the bitset does not have a page with
+	 * the required position and all bits in this page are
+	 * considered to be zeros. Since NAND(a, zeros) => a, the
+	 * page can be simply skipped.
+	 */
+	return page == NULL || page->first_pos != dst->first_pos;
+}
+
+static void
+page_conj_or_generic(struct bitset_page *dst, struct bitset_page *const *pages,
+		     const bool *nots, size_t size)
+{
+	bitset_word_t acc[BITSET_PAGE_WORDS];
+	memset(acc, -1, sizeof(acc));
+
+	for (size_t b = 0; b < size; b++) {
+		if (page_conj_skip(dst, pages[b], nots[b]))
+			continue;
+
+		const bitset_word_t *s = (const bitset_word_t *)
+				bitset_page_data(pages[b]);
+		bitset_word_t mask = nots[b] ? ~((bitset_word_t) 0) : 0;
+		for (int i = 0; i < BITSET_PAGE_WORDS; i++) {
+			acc[i] &= s[i] ^ mask;
+		}
+	}
+
+	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
+	for (int i = 0; i < BITSET_PAGE_WORDS; i++) {
+		d[i] |= acc[i];
+	}
+}
+
+static size_t
+page_count_generic(const void *data)
+{
+	const uint32_t *d = (const uint32_t *) data;
+	size_t count = 0;
+	for (size_t i = 0; i < BITSET_PAGE_DATA_SIZE / sizeof(*d); i++) {
+		count += bit_count_u32(d[i]);
+	}
+	return count;
+}
+
+#if defined(__x86_64__) && (defined(__clang__) || \
+	(__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+/*
+ * Kernels for modern x86_64 CPUs. They are compiled for the
+ * respective instruction set regardless of the build flags
+ * and are only installed by bitset_init_kernels() when the CPU
+ * supports them.
+ */
+#include <immintrin.h>
+
+#define BITSET_PAGE_KERNELS_X86 1
+
+enum { BITSET_PAGE_YMMS = BITSET_PAGE_DATA_SIZE / sizeof(__m256i) };
+
+__attribute__((target("popcnt")))
+static size_t
+page_count_popcnt(const void *data)
+{
+	const uint64_t *d = (const uint64_t *) data;
+	size_t count = 0;
+	for (size_t i = 0; i < BITSET_PAGE_DATA_SIZE / sizeof(*d); i++) {
+		count += __builtin_popcountll(d[i]);
+	}
+	return count;
+}
+
+__attribute__((target("avx2")))
+static void
+page_and_avx2(void *dst, const void *src)
+{
+	__m256i *d = (__m256i *) dst;
+	const __m256i *s = (const __m256i *) src;
+
+	for (int i = 0; i < BITSET_PAGE_YMMS; i++) {
+		__m256i r = _mm256_and_si256(_mm256_loadu_si256(d + i),
+					     _mm256_loadu_si256(s + i));
+		_mm256_storeu_si256(d + i, r);
+	}
+}
+
+__attribute__((target("avx2")))
+static void
+page_nand_avx2(void *dst, const void *src)
+{
+	__m256i *d = (__m256i *) dst;
+	const __m256i *s = (const __m256i *) src;
+
+	for (int i = 0; i < BITSET_PAGE_YMMS; i++) {
+		/* _mm256_andnot_si256(a, b) is ~a & b */
+		__m256i r = _mm256_andnot_si256(_mm256_loadu_si256(s + i),
+						_mm256_loadu_si256(d + i));
+		_mm256_storeu_si256(d + i, r);
+	}
+}
+
+__attribute__((target("avx2")))
+static void
+page_or_avx2(void *dst, const void *src)
+{
+	__m256i *d = (__m256i *) dst;
+	const __m256i *s = (const __m256i *) src;
+
+	for (int i = 0; i < BITSET_PAGE_YMMS; i++) {
+		__m256i r = _mm256_or_si256(_mm256_loadu_si256(d + i),
+					    _mm256_loadu_si256(s + i));
+		_mm256_storeu_si256(d + i, r);
+	}
+}
+
+__attribute__((target("avx2")))
+static void
+page_conj_or_avx2(struct bitset_page *dst, struct bitset_page *const *pages,
+		  const bool *nots, size_t size)
+{
+	/* The whole page fits into registers */
+	__m256i acc[BITSET_PAGE_YMMS];
+	for (int i = 0; i < BITSET_PAGE_YMMS; i++) {
+		acc[i] = _mm256_set1_epi32(-1);
+	}
+
+	for (size_t b = 0; b < size; b++) {
+		if (page_conj_skip(dst, pages[b], nots[b]))
+			continue;
+
+		const __m256i *s = (const __m256i *)
+				bitset_page_data(pages[b]);
+		if (nots[b]) {
+			for (int i = 0; i < BITSET_PAGE_YMMS; i++) {
+				acc[i] = _mm256_andnot_si256(
+					_mm256_loadu_si256(s + i), acc[i]);
+			}
+		} else {
+			for (int i = 0; i < BITSET_PAGE_YMMS; i++) {
+				acc[i] = _mm256_and_si256(
+					_mm256_loadu_si256(s + i), acc[i]);
+			}
+		}
+	}
+
+	__m256i *d = (__m256i *) bitset_page_data(dst);
+	for (int i = 0; i < BITSET_PAGE_YMMS; i++) {
+		_mm256_storeu_si256(d + i, _mm256_or_si256(
+			_mm256_loadu_si256(d + i), acc[i]));
+	}
+}
+#endif /* x86_64 */
+
+struct bitset_page_kernels bitset_page_kernels = {
+	.and = page_and_generic,
+	.nand = page_nand_generic,
+	.or = page_or_generic,
+	.conj_or = page_conj_or_generic,
+	.count = page_count_generic,
+};
+
+void
+bitset_init_kernels(unsigned features)
+{
+	bitset_page_kernels.and = page_and_generic;
+	bitset_page_kernels.nand = page_nand_generic;
+	bitset_page_kernels.or = page_or_generic;
+	bitset_page_kernels.conj_or = page_conj_or_generic;
+	bitset_page_kernels.count = page_count_generic;
+
+#if defined(BITSET_PAGE_KERNELS_X86)
+	if (features & BITSET_CPU_POPCNT) {
+		bitset_page_kernels.count = page_count_popcnt;
+	}
+
+	if (features & BITSET_CPU_AVX2) {
+		bitset_page_kernels.and = page_and_avx2;
+		bitset_page_kernels.nand = page_nand_avx2;
+		bitset_page_kernels.or = page_or_avx2;
+		bitset_page_kernels.conj_or = page_conj_or_avx2;
+	}
+#else
+	(void) features;
+#endif /* defined(BITSET_PAGE_KERNELS_X86) */
+}
+
+void
+bitset_page_conj_or(struct bitset_page *dst, struct bitset_page *const *pages,
+		    const bool *nots, size_t size)
+{
+	assert(dst->type == BITSET_PAGE_BITMAP);
+
+	/* Find the smallest non-negated array page */
+	bool has_arrays = false;
+	size_t driver = SIZE_MAX;
+	for (size_t b = 0; b < size; b++) {
+		if (page_conj_skip(dst, pages[b], nots[b]) ||
+		    pages[b]->type != BITSET_PAGE_ARRAY)
+			continue;
+
+		has_arrays = true;
+		if (!nots[b] && (driver == SIZE_MAX ||
+		    pages[b]->cardinality < pages[driver]->cardinality))
+			driver = b;
+	}
+
+	if (!has_arrays) {
+		bitset_page_kernels.conj_or(dst, pages, nots, size);
+		return;
+	}
+
+	void *d = bitset_page_data(dst);
+	if (driver != SIZE_MAX) {
+		/*
+		 * The result is a subset of the driver array,
+		 * so test its elements against other pages.
+		 */
+		const uint16_t *array = bitset_page_array(pages[driver]);
+		for (size_t i = 0; i < pages[driver]->cardinality; i++) {
+			size_t b;
+			for (b = 0; b < size; b++) {
+				if (b == driver ||
+				    page_conj_skip(dst, pages[b], nots[b]))
+					continue;
+				if (bitset_page_test(pages[b], array[i]) ==
+				    nots[b])
+					break;
+			}
+
+			if (b == size)
+				bit_set(d, array[i]);
+		}
+		return;
+	}
+
+	/*
+	 * Only negated pages are arrays: AND bitmap pages, then
+	 * clear bits of the arrays.
+	 */
+	bitset_word_t acc[BITSET_PAGE_WORDS];
+	memset(acc, -1, sizeof(acc));
+	for (size_t b = 0; b < size; b++) {
+		if (page_conj_skip(dst, pages[b], nots[b]) ||
+		    pages[b]->type != BITSET_PAGE_BITMAP)
+			continue;
+
+		if (nots[b]) {
+			bitset_page_kernels.nand(acc,
+						 bitset_page_data(pages[b]));
+		} else {
+			bitset_page_kernels.and(acc,
+						bitset_page_data(pages[b]));
+		}
+	}
+
+	for (size_t b = 0; b < size; b++) {
+		if (page_conj_skip(dst, pages[b], nots[b]) ||
+		    pages[b]->type != BITSET_PAGE_ARRAY)
+			continue;
+
+		const uint16_t *array = bitset_page_array(pages[b]);
+		for (size_t i = 0; i < pages[b]->cardinality; i++) {
+			bit_clear(acc, array[i]);
+		}
+	}
+
+	bitset_page_kernels.or(d, acc);
+}
+
 #if defined(DEBUG)
 void
 bitset_page_dump(struct bitset_page *page, FILE *stream)
 {
 	fprintf(stream, "Page %zu:\n", page->first_pos);
+	if (page->type == BITSET_PAGE_ARRAY) {
+		const uint16_t *array = bitset_page_array(page);
+		for (size_t i = 0; i < page->cardinality; i++) {
+			fprintf(stream, "%u ", (unsigned) array[i]);
+		}
+		fprintf(stream, "\n--\n");
+		return;
+	}
 	char *d = bitset_page_data(page);
 	for (int i = 0; i < BITSET_PAGE_DATA_SIZE; i++) {
 		fprintf(stream, "%x ", *d);
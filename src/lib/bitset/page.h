@@ -49,16 +49,22 @@
 
 enum {
 	/** How many bytes to store in one page */
-	BITSET_PAGE_DATA_SIZE = 160
+	BITSET_PAGE_DATA_SIZE = 160,
+	/** The initial capacity of an array page (in elements) */
+	BITSET_PAGE_ARRAY_MIN = 4,
+	/**
+	 * The maximal capacity of an array page (in elements).
+	 * A full array is still smaller than a bitmap, an array page
+	 * that outgrows it is converted to a bitmap page.
+	 */
+	BITSET_PAGE_ARRAY_MAX = 64
 };
 
-#if defined(ENABLE_AVX)
-typedef __m256i bitset_word_t;
-#define BITSET_PAGE_DATA_ALIGNMENT 32
-#elif defined(ENABLE_SSE2)
-typedef __m128i bitset_word_t;
-#define BITSET_PAGE_DATA_ALIGNMENT 16
-#elif defined(__x86_64__)
+/*
+ * Vector kernels use unaligned loads and are selected at runtime,
+ * see bitset_init_kernels().
+ */
+#if defined(__x86_64__)
 typedef uint64_t bitset_word_t;
 #define BITSET_PAGE_DATA_ALIGNMENT 1
 #else
@@ -115,6 +121,77 @@ bitset_page_create(struct bitset_page *page)
 	memset(page, 0, size);
 }
 
+inline size_t
+bitset_page_array_alloc_size(size_t capacity)
+{
+	return sizeof(struct bitset_page) + capacity * sizeof(uint16_t);
+}
+
+inline void
+bitset_page_array_create(struct bitset_page *page, size_t capacity)
+{
+	assert(capacity <= BITSET_PAGE_ARRAY_MAX);
+	memset(page, 0, sizeof(*page));
+	page->type = BITSET_PAGE_ARRAY;
+	page->capacity = capacity;
+}
+
+inline uint16_t *
+bitset_page_array(struct bitset_page *page)
+{
+	assert(page->type == BITSET_PAGE_ARRAY);
+	return (uint16_t *) page->data;
+}
+
+/**
+ * @brief Return the index of the first element of an array page
+ * which is not less than @a offset
+ */
+inline size_t
+bitset_page_array_lower_bound(struct bitset_page *page, size_t offset)
+{
+	const uint16_t *array = bitset_page_array(page);
+	size_t begin = 0;
+	size_t end = page->cardinality;
+	while (begin < end) {
+		size_t mid = begin + (end - begin) / 2;
+		if (array[mid] < offset) {
+			begin = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+
+	return begin;
+}
+
+/**
+ * @brief Test bit @a offset of a page of any type
+ */
+inline bool
+bitset_page_test(struct bitset_page *page, size_t offset)
+{
+	assert(offset < BITSET_PAGE_DATA_SIZE * CHAR_BIT);
+	if (page->type == BITSET_PAGE_BITMAP)
+		return bit_test(bitset_page_data(page), offset);
+
+	size_t i = bitset_page_array_lower_bound(page, offset);
+	return i < page->cardinality && bitset_page_array(page)[i] == offset;
+}
+
+/**
+ * @brief Return the allocated size of a page of any type
+ */
+inline size_t
+bitset_page_size(struct bitset_page *page,
+		 void *(*realloc_arg)(void *ptr, size_t size))
+{
+	if (page->type == BITSET_PAGE_BITMAP)
+		return bitset_page_alloc_size(realloc_arg);
+
+	return bitset_page_array_alloc_size(page->capacity);
+}
+
 inline void
 bitset_page_destroy(struct bitset_page *page)
 {
@@ -141,43 +218,72 @@ bitset_page_set_ones(struct bitset_page *page)
 	memset(data, -1, BITSET_PAGE_DATA_SIZE);
 }
 
+/**
+ * @brief Page operation kernels.
+ * Every kernel works on BITSET_PAGE_DATA_SIZE bytes of page data.
+ * The table is filled in by bitset_init_kernels() with the fastest
+ * implementation supported by the host CPU.
+ */
+struct bitset_page_kernels {
+	/** dst &= src */
+	void (*and)(void *dst, const void *src);
+	/** dst &= ~src */
+	void (*nand)(void *dst, const void *src);
+	/** dst |= src */
+	void (*or)(void *dst, const void *src);
+	/**
+	 * dst |= AND(pages[b] or ~pages[b] if nots[b]) over all
+	 * @a size pages. A negated page which is NULL or does not
+	 * start at dst->first_pos is considered to be all zeros
+	 * and is skipped.
+	 */
+	void (*conj_or)(struct bitset_page *dst,
+			struct bitset_page *const *pages,
+			const bool *nots, size_t size);
+	/** The number of bits set */
+	size_t (*count)(const void *data);
+};
+
+extern struct bitset_page_kernels bitset_page_kernels;
+
 inline void
 bitset_page_and(struct bitset_page *dst, struct bitset_page *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
-
-	assert (BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
-	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
-	for (int i = 0; i < cnt; i++) {
-		*d++ &= *s++;
-	}
+	assert(dst->type == BITSET_PAGE_BITMAP);
+	assert(src->type == BITSET_PAGE_BITMAP);
+	bitset_page_kernels.and(bitset_page_data(dst), bitset_page_data(src));
 }
 
 inline void
 bitset_page_nand(struct bitset_page *dst, struct bitset_page *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
-
-	assert (BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
-	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
-	for (int i = 0; i < cnt; i++) {
-		*d++ &= ~*s++;
-	}
+	assert(dst->type == BITSET_PAGE_BITMAP);
+	assert(src->type == BITSET_PAGE_BITMAP);
+	bitset_page_kernels.nand(bitset_page_data(dst), bitset_page_data(src));
 }
 
 inline void
 bitset_page_or(struct bitset_page *dst, struct bitset_page *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
+	assert(dst->type == BITSET_PAGE_BITMAP);
+	assert(src->type == BITSET_PAGE_BITMAP);
+	bitset_page_kernels.or(bitset_page_data(dst), bitset_page_data(src));
+}
 
-	assert (BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
-	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
-	for (int i = 0; i < cnt; i++) {
-		*d++ |= *s++;
-	}
+/**
+ * @brief dst |= AND(pages[b] or ~pages[b] if nots[b]).
+ * @a dst must be a bitmap page, @a pages may be of any type.
+ * @see bitset_page_kernels.conj_or
+ */
+void
+bitset_page_conj_or(struct bitset_page *dst, struct bitset_page *const *pages,
+		    const bool *nots, size_t size);
+
+inline size_t
+bitset_page_count(struct bitset_page *page)
+{
+	assert(page->type == BITSET_PAGE_BITMAP);
+	return bitset_page_kernels.count(bitset_page_data(page));
 }
 
 #if defined(DEBUG)
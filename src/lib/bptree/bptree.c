@@ -0,0 +1,1036 @@
+/*
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <lib/bptree/bptree.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <third_party/qsort_arg.h>
+
+/* {{{ Nodes ******************************************************/
+
+struct bptree_node {
+	uint32_t count;
+	uint32_t is_leaf;
+};
+
+struct bptree_leaf {
+	struct bptree_node header;
+	struct bptree_leaf *prev;
+	struct bptree_leaf *next;
+	char elems[0];
+};
+
+/**
+ * An inner node: inner_capacity child pointers followed by
+ * inner_capacity subtree sizes and inner_capacity keys. Size i
+ * is the number of elements in the subtree of child i, key i is
+ * a copy of the maximal element of that subtree.
+ */
+struct bptree_inner {
+	struct bptree_node header;
+	struct bptree_node *child[0];
+};
+
+/** A step of a root-to-leaf path. */
+struct bptree_path {
+	struct bptree_inner *node;
+	uint32_t pos;
+};
+
+static inline char *
+leaf_elem(const struct bptree *tree, struct bptree_leaf *leaf, uint32_t i)
+{
+	return leaf->elems + i * tree->elem_size;
+}
+
+static inline size_t *
+inner_sizes(const struct bptree *tree, struct bptree_inner *inner)
+{
+	return (size_t *) (inner->child + tree->inner_capacity);
+}
+
+static inline char *
+inner_key(const struct bptree *tree, struct bptree_inner *inner, uint32_t i)
+{
+	return (char *) (inner_sizes(tree, inner) + tree->inner_capacity) +
+		i * tree->elem_size;
+}
+
+/** The maximal element of a subtree. */
+static inline char *
+node_max(const struct bptree *tree, struct bptree_node *node)
+{
+	assert(node->count > 0);
+	if (node->is_leaf)
+		return leaf_elem(tree, (struct bptree_leaf *) node,
+				 node->count - 1);
+	return inner_key(tree, (struct bptree_inner *) node,
+			 node->count - 1);
+}
+
+/** The number of elements in a subtree. */
+static inline size_t
+node_weight(const struct bptree *tree, struct bptree_node *node)
+{
+	if (node->is_leaf)
+		return node->count;
+	size_t *sizes = inner_sizes(tree, (struct bptree_inner *) node);
+	size_t weight = 0;
+	for (uint32_t i = 0; i < node->count; i++)
+		weight += sizes[i];
+	return weight;
+}
+
+static struct bptree_node *
+node_alloc(struct bptree *tree)
+{
+	void *ptr;
+	if (posix_memalign(&ptr, BPTREE_NODE_ALIGN, tree->node_size) != 0)
+		return NULL;
+	return (struct bptree_node *) ptr;
+}
+
+static struct bptree_leaf *
+leaf_init(struct bptree *tree, struct bptree_node *node)
+{
+	struct bptree_leaf *leaf = (struct bptree_leaf *) node;
+	leaf->header.count = 0;
+	leaf->header.is_leaf = true;
+	leaf->prev = leaf->next = NULL;
+	tree->leaf_count++;
+	return leaf;
+}
+
+static struct bptree_inner *
+inner_init(struct bptree *tree, struct bptree_node *node)
+{
+	struct bptree_inner *inner = (struct bptree_inner *) node;
+	inner->header.count = 0;
+	inner->header.is_leaf = false;
+	tree->inner_count++;
+	return inner;
+}
+
+static void
+node_free(struct bptree *tree, struct bptree_node *node)
+{
+	if (node->is_leaf)
+		tree->leaf_count--;
+	else
+		tree->inner_count--;
+	free(node);
+}
+
+/**
+ * Return the first position i in an array of count elements
+ * such that cmp(key, elem[i]) < 0 if strict, or <= 0 otherwise.
+ */
+static inline uint32_t
+bound(const char *base, size_t elem_size, uint32_t count,
+      const void *key, bptree_cmp_t cmp, void *arg, bool strict)
+{
+	uint32_t lo = 0, hi = count;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		int r = cmp(key, base + mid * elem_size, arg);
+		if (r > 0 || (strict && r == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/**
+ * Find the first element e such that cmp(key, e) < 0 if strict,
+ * or <= 0 otherwise. Sets *leaf to NULL if there is no such
+ * element. If rank is not NULL, stores the number of elements
+ * preceding the found one (the tree size if none) in it.
+ */
+static void
+bptree_search(struct bptree *tree, const void *key, bptree_cmp_t cmp,
+	      bool strict, struct bptree_leaf **leaf, uint32_t *pos,
+	      size_t *rank)
+{
+	struct bptree_node *node = tree->root;
+	size_t preceding = 0;
+	*leaf = NULL;
+	*pos = 0;
+	if (rank)
+		*rank = tree->size;
+	if (node == NULL)
+		return;
+	while (!node->is_leaf) {
+		struct bptree_inner *inner = (struct bptree_inner *) node;
+		uint32_t i = bound(inner_key(tree, inner, 0), tree->elem_size,
+				   node->count, key, cmp, tree->arg, strict);
+		if (i == node->count)
+			return;
+		if (rank) {
+			size_t *sizes = inner_sizes(tree, inner);
+			for (uint32_t j = 0; j < i; j++)
+				preceding += sizes[j];
+		}
+		node = inner->child[i];
+	}
+	struct bptree_leaf *l = (struct bptree_leaf *) node;
+	uint32_t i = bound(l->elems, tree->elem_size, node->count,
+			   key, cmp, tree->arg, strict);
+	if (i == node->count) {
+		/*
+		 * Keys in inner nodes are exact maxima of their
+		 * subtrees, so only a root leaf may get here.
+		 */
+		assert(node == tree->root);
+		return;
+	}
+	*leaf = l;
+	*pos = i;
+	if (rank)
+		*rank = preceding + i;
+}
+
+/**
+ * Find the element which is preceded by exactly rank elements.
+ * Sets *leaf to NULL if rank is out of range.
+ */
+static void
+bptree_locate(struct bptree *tree, size_t rank,
+	      struct bptree_leaf **leaf, uint32_t *pos)
+{
+	*leaf = NULL;
+	*pos = 0;
+	if (rank >= tree->size)
+		return;
+	struct bptree_node *node = tree->root;
+	while (!node->is_leaf) {
+		struct bptree_inner *inner = (struct bptree_inner *) node;
+		size_t *sizes = inner_sizes(tree, inner);
+		uint32_t i = 0;
+		while (rank >= sizes[i])
+			rank -= sizes[i++];
+		assert(i < node->count);
+		node = inner->child[i];
+	}
+	assert(rank < node->count);
+	*leaf = (struct bptree_leaf *) node;
+	*pos = rank;
+}
+
+/* }}} */
+
+/* {{{ Tree *******************************************************/
+
+void
+bptree_create(struct bptree *tree, size_t elem_size,
+	      bptree_cmp_t key_cmp, bptree_cmp_t elem_cmp, void *arg)
+{
+	memset(tree, 0, sizeof(*tree));
+	tree->elem_size = elem_size;
+	tree->key_cmp = key_cmp != NULL ? key_cmp : elem_cmp;
+	tree->elem_cmp = elem_cmp != NULL ? elem_cmp : key_cmp;
+	tree->arg = arg;
+
+	/* Make sure that each node fits at least 4 elements. */
+	size_t leaf_min = sizeof(struct bptree_leaf) + 4 * elem_size;
+	size_t inner_min = sizeof(struct bptree_inner) +
+		4 * (sizeof(struct bptree_node *) + sizeof(size_t) + elem_size);
+	size_t node_size = leaf_min > inner_min ? leaf_min : inner_min;
+	if (node_size < BPTREE_NODE_SIZE)
+		node_size = BPTREE_NODE_SIZE;
+	node_size = (node_size + BPTREE_NODE_ALIGN - 1) &
+		~((size_t) BPTREE_NODE_ALIGN - 1);
+
+	tree->node_size = node_size;
+	tree->leaf_capacity = (node_size - sizeof(struct bptree_leaf)) /
+		elem_size;
+	tree->inner_capacity = (node_size - sizeof(struct bptree_inner)) /
+		(sizeof(struct bptree_node *) + sizeof(size_t) + elem_size);
+}
+
+static void
+bptree_destroy_node(struct bptree *tree, struct bptree_node *node)
+{
+	if (!node->is_leaf) {
+		struct bptree_inner *inner = (struct bptree_inner *) node;
+		for (uint32_t i = 0; i < node->count; i++)
+			bptree_destroy_node(tree, inner->child[i]);
+	}
+	node_free(tree, node);
+}
+
+void
+bptree_destroy(struct bptree *tree)
+{
+	if (tree->root != NULL)
+		bptree_destroy_node(tree, tree->root);
+	tree->root = NULL;
+	tree->first = tree->last = NULL;
+	tree->size = 0;
+	tree->depth = 0;
+	tree->version++;
+}
+
+int
+bptree_build(struct bptree *tree, void *array, size_t count)
+{
+	assert(tree->root == NULL);
+	if (count == 0)
+		return 0;
+
+	qsort_arg(array, count, tree->elem_size, tree->elem_cmp, tree->arg);
+
+	/* Count nodes on every level to allocate them at once. */
+	size_t total = 0;
+	uint32_t depth = 0;
+	size_t n = count;
+	size_t capacity = tree->leaf_capacity;
+	do {
+		n = (n + capacity - 1) / capacity;
+		capacity = tree->inner_capacity;
+		total += n;
+		depth++;
+	} while (n > 1);
+
+	assert(depth <= BPTREE_MAX_DEPTH);
+	struct bptree_node **nodes = malloc(total * sizeof(*nodes));
+	if (nodes == NULL)
+		return -1;
+	for (size_t i = 0; i < total; i++) {
+		nodes[i] = node_alloc(tree);
+		if (nodes[i] == NULL) {
+			while (i-- > 0)
+				free(nodes[i]);
+			free(nodes);
+			return -1;
+		}
+	}
+
+	/*
+	 * Distribute elements evenly among leaves so that
+	 * every leaf is at least half full.
+	 */
+	struct bptree_node **level = nodes;
+	n = (count + tree->leaf_capacity - 1) / tree->leaf_capacity;
+	const char *src = array;
+	struct bptree_leaf *prev = NULL;
+	for (size_t i = 0; i < n; i++) {
+		struct bptree_leaf *leaf = leaf_init(tree, level[i]);
+		leaf->header.count = count / n + (i < count % n);
+		memcpy(leaf->elems, src, leaf->header.count * tree->elem_size);
+		src += leaf->header.count * tree->elem_size;
+		leaf->prev = prev;
+		if (prev != NULL)
+			prev->next = leaf;
+		prev = leaf;
+	}
+	tree->first = (struct bptree_leaf *) level[0];
+	tree->last = prev;
+
+	/* Build inner levels bottom up. */
+	while (n > 1) {
+		struct bptree_node **parents = level + n;
+		size_t n_parents = (n + tree->inner_capacity - 1) /
+			tree->inner_capacity;
+		size_t c = 0;
+		for (size_t i = 0; i < n_parents; i++) {
+			struct bptree_inner *inner =
+				inner_init(tree, parents[i]);
+			inner->header.count = n / n_parents +
+				(i < n % n_parents);
+			for (uint32_t j = 0; j < inner->header.count; j++) {
+				struct bptree_node *child = level[c++];
+				inner->child[j] = child;
+				inner_sizes(tree, inner)[j] =
+					node_weight(tree, child);
+				memcpy(inner_key(tree, inner, j),
+				       node_max(tree, child), tree->elem_size);
+			}
+		}
+		level = parents;
+		n = n_parents;
+	}
+
+	tree->root = level[0];
+	tree->depth = depth;
+	tree->size = count;
+	tree->version++;
+	free(nodes);
+	return 0;
+}
+
+extern inline size_t
+bptree_size(const struct bptree *tree);
+
+void *
+bptree_find(struct bptree *tree, const void *key)
+{
+	struct bptree_leaf *leaf;
+	uint32_t pos;
+	bptree_search(tree, key, tree->key_cmp, false, &leaf, &pos, NULL);
+	if (leaf == NULL)
+		return NULL;
+	char *elem = leaf_elem(tree, leaf, pos);
+	if (tree->key_cmp(key, elem, tree->arg) != 0)
+		return NULL;
+	return elem;
+}
+
+size_t
+bptree_rank(struct bptree *tree, const void *key)
+{
+	struct bptree_leaf *leaf;
+	uint32_t pos;
+	size_t rank;
+	bptree_search(tree, key, tree->key_cmp, false, &leaf, &pos, &rank);
+	return rank;
+}
+
+size_t
+bptree_rank_elem(struct bptree *tree, const void *elem)
+{
+	struct bptree_leaf *leaf;
+	uint32_t pos;
+	size_t rank;
+	bptree_search(tree, elem, tree->elem_cmp, false, &leaf, &pos, &rank);
+	return rank;
+}
+
+size_t
+bptree_count(struct bptree *tree, const void *key)
+{
+	struct bptree_leaf *leaf;
+	uint32_t pos;
+	size_t begin, end;
+	bptree_search(tree, key, tree->key_cmp, false, &leaf, &pos, &begin);
+	if (leaf == NULL ||
+	    tree->key_cmp(key, leaf_elem(tree, leaf, pos), tree->arg) != 0)
+		return 0;
+	bptree_search(tree, key, tree->key_cmp, true, &leaf, &pos, &end);
+	return end - begin;
+}
+
+void *
+bptree_first(struct bptree *tree)
+{
+	if (tree->first == NULL)
+		return NULL;
+	return leaf_elem(tree, tree->first, 0);
+}
+
+void *
+bptree_last(struct bptree *tree)
+{
+	if (tree->last == NULL)
+		return NULL;
+	return leaf_elem(tree, tree->last, tree->last->header.count - 1);
+}
+
+/**
+ * Insert (child, size, key) at position pos of a non-full inner
+ * node.
+ */
+static void
+inner_insert(struct bptree *tree, struct bptree_inner *inner, uint32_t pos,
+	     struct bptree_node *child, size_t size, const void *key)
+{
+	uint32_t count = inner->header.count;
+	size_t *sizes = inner_sizes(tree, inner);
+	assert(count < tree->inner_capacity);
+	memmove(inner->child + pos + 1, inner->child + pos,
+		(count - pos) * sizeof(inner->child[0]));
+	memmove(sizes + pos + 1, sizes + pos, (count - pos) * sizeof(*sizes));
+	memmove(inner_key(tree, inner, pos + 1), inner_key(tree, inner, pos),
+		(count - pos) * tree->elem_size);
+	inner->child[pos] = child;
+	sizes[pos] = size;
+	memcpy(inner_key(tree, inner, pos), key, tree->elem_size);
+	inner->header.count++;
+}
+
+/**
+ * Move count entries of inner node src starting at src_pos to
+ * position dst_pos of inner node dst. Does not update counters.
+ */
+static inline void
+inner_move(struct bptree *tree, struct bptree_inner *dst, uint32_t dst_pos,
+	   struct bptree_inner *src, uint32_t src_pos, uint32_t count)
+{
+	memmove(dst->child + dst_pos, src->child + src_pos,
+		count * sizeof(src->child[0]));
+	memmove(inner_sizes(tree, dst) + dst_pos,
+		inner_sizes(tree, src) + src_pos, count * sizeof(size_t));
+	memmove(inner_key(tree, dst, dst_pos), inner_key(tree, src, src_pos),
+		count * tree->elem_size);
+}
+
+static inline void
+leaf_move(struct bptree *tree, struct bptree_leaf *dst, uint32_t dst_pos,
+	  struct bptree_leaf *src, uint32_t src_pos, uint32_t count)
+{
+	memmove(leaf_elem(tree, dst, dst_pos), leaf_elem(tree, src, src_pos),
+		count * tree->elem_size);
+}
+
+/**
+ * Insert elem into a full leaf at position pos, moving the upper
+ * half of elements into the new leaf right.
+ */
+static void
+leaf_split_insert(struct bptree *tree, struct bptree_leaf *leaf,
+		  struct bptree_leaf *right, uint32_t pos, const void *elem)
+{
+	uint32_t capacity = tree->leaf_capacity;
+	uint32_t split = (capacity + 1) / 2;
+
+	right->next = leaf->next;
+	right->prev = leaf;
+	if (leaf->next != NULL)
+		leaf->next->prev = right;
+	else
+		tree->last = right;
+	leaf->next = right;
+
+	struct bptree_leaf *target;
+	if (pos < split) {
+		leaf_move(tree, right, 0, leaf, split - 1, capacity - split + 1);
+		right->header.count = capacity - split + 1;
+		leaf->header.count = split - 1;
+		target = leaf;
+	} else {
+		leaf_move(tree, right, 0, leaf, split, capacity - split);
+		right->header.count = capacity - split;
+		leaf->header.count = split;
+		target = right;
+		pos -= split;
+	}
+	leaf_move(tree, target, pos + 1, target, pos,
+		  target->header.count - pos);
+	memcpy(leaf_elem(tree, target, pos), elem, tree->elem_size);
+	target->header.count++;
+}
+
+/**
+ * Same as inner_insert() for a full node, moving the upper half
+ * of entries into the new node right.
+ */
+static void
+inner_split_insert(struct bptree *tree, struct bptree_inner *inner,
+		   struct bptree_inner *right, uint32_t pos,
+		   struct bptree_node *child, size_t size, const void *key)
+{
+	uint32_t capacity = tree->inner_capacity;
+	uint32_t split = (capacity + 1) / 2;
+
+	if (pos < split) {
+		inner_move(tree, right, 0, inner, split - 1,
+			   capacity - split + 1);
+		right->header.count = capacity - split + 1;
+		inner->header.count = split - 1;
+		inner_insert(tree, inner, pos, child, size, key);
+	} else {
+		inner_move(tree, right, 0, inner, split, capacity - split);
+		right->header.count = capacity - split;
+		inner->header.count = split;
+		inner_insert(tree, right, pos - split, child, size, key);
+	}
+}
+
+int
+bptree_replace(struct bptree *tree, const void *elem, void **p_old)
+{
+	if (tree->root == NULL) {
+		struct bptree_node *node = node_alloc(tree);
+		if (node == NULL)
+			return -1;
+		struct bptree_leaf *leaf = leaf_init(tree, node);
+		memcpy(leaf->elems, elem, tree->elem_size);
+		leaf->header.count = 1;
+		tree->root = node;
+		tree->first = tree->last = leaf;
+		tree->depth = 1;
+		tree->size = 1;
+		tree->version++;
+		if (p_old)
+			*p_old = NULL;
+		return 0;
+	}
+
+	struct bptree_path path[BPTREE_MAX_DEPTH];
+	uint32_t level = 0;
+	struct bptree_node *node = tree->root;
+	while (!node->is_leaf) {
+		struct bptree_inner *inner = (struct bptree_inner *) node;
+		uint32_t i = bound(inner_key(tree, inner, 0), tree->elem_size,
+				   node->count, elem, tree->elem_cmp,
+				   tree->arg, false);
+		/* A new maximum goes to the rightmost subtree. */
+		if (i == node->count)
+			i--;
+		path[level].node = inner;
+		path[level].pos = i;
+		level++;
+		node = inner->child[i];
+	}
+	struct bptree_leaf *leaf = (struct bptree_leaf *) node;
+	uint32_t pos = bound(leaf->elems, tree->elem_size, node->count,
+			     elem, tree->elem_cmp, tree->arg, false);
+
+	bool found = pos < node->count &&
+		tree->elem_cmp(elem, leaf_elem(tree, leaf, pos), tree->arg) == 0;
+
+	/*
+	 * Allocate all nodes needed for splits in advance, so that
+	 * a memory error leaves the tree intact.
+	 */
+	struct bptree_node *spare[BPTREE_MAX_DEPTH + 1];
+	uint32_t n_spare = 0;
+	if (!found && node->count == tree->leaf_capacity) {
+		n_spare = 1;
+		int l = level - 1;
+		while (l >= 0 &&
+		       path[l].node->header.count == tree->inner_capacity) {
+			n_spare++;
+			l--;
+		}
+		/* The root splits too. */
+		if (l < 0)
+			n_spare++;
+		for (uint32_t i = 0; i < n_spare; i++) {
+			spare[i] = node_alloc(tree);
+			if (spare[i] == NULL) {
+				while (i-- > 0)
+					free(spare[i]);
+				return -1;
+			}
+		}
+	}
+
+	/*
+	 * Update copies of subtree maxima on the path: the new
+	 * element either replaces one of them or becomes greater.
+	 */
+	for (int l = level - 1; l >= 0; l--) {
+		char *key = inner_key(tree, path[l].node, path[l].pos);
+		if (tree->elem_cmp(elem, key, tree->arg) < 0)
+			break;
+		memcpy(key, elem, tree->elem_size);
+	}
+
+	tree->version++;
+	if (found) {
+		char *old = leaf_elem(tree, leaf, pos);
+		if (p_old)
+			memcpy(*p_old, old, tree->elem_size);
+		memcpy(old, elem, tree->elem_size);
+		return 0;
+	}
+	if (p_old)
+		*p_old = NULL;
+	tree->size++;
+	for (uint32_t l = 0; l < level; l++)
+		inner_sizes(tree, path[l].node)[path[l].pos]++;
+
+	if (node->count < tree->leaf_capacity) {
+		leaf_move(tree, leaf, pos + 1, leaf, pos, node->count - pos);
+		memcpy(leaf_elem(tree, leaf, pos), elem, tree->elem_size);
+		node->count++;
+		return 0;
+	}
+
+	uint32_t next_spare = 0;
+	struct bptree_leaf *right_leaf =
+		leaf_init(tree, spare[next_spare++]);
+	leaf_split_insert(tree, leaf, right_leaf, pos, elem);
+
+	/*
+	 * Propagate the split up: the parent's key and size for the
+	 * split node become the ones of its right half.
+	 */
+	struct bptree_node *left = node;
+	struct bptree_node *right = (struct bptree_node *) right_leaf;
+	for (int l = level - 1; l >= 0; l--) {
+		struct bptree_inner *parent = path[l].node;
+		uint32_t p = path[l].pos;
+		size_t left_size = node_weight(tree, left);
+		parent->child[p] = right;
+		inner_sizes(tree, parent)[p] -= left_size;
+		if (parent->header.count < tree->inner_capacity) {
+			inner_insert(tree, parent, p, left, left_size,
+				     node_max(tree, left));
+			assert(next_spare == n_spare);
+			return 0;
+		}
+		struct bptree_inner *right_inner =
+			inner_init(tree, spare[next_spare++]);
+		inner_split_insert(tree, parent, right_inner, p, left,
+				   left_size, node_max(tree, left));
+		left = (struct bptree_node *) parent;
+		right = (struct bptree_node *) right_inner;
+	}
+
+	/* Grow a new root. */
+	assert(next_spare == n_spare - 1);
+	struct bptree_inner *root = inner_init(tree, spare[next_spare++]);
+	root->child[0] = left;
+	root->child[1] = right;
+	inner_sizes(tree, root)[0] = node_weight(tree, left);
+	inner_sizes(tree, root)[1] = node_weight(tree, right);
+	memcpy(inner_key(tree, root, 0), node_max(tree, left),
+	       tree->elem_size);
+	memcpy(inner_key(tree, root, 1), node_max(tree, right),
+	       tree->elem_size);
+	root->header.count = 2;
+	tree->root = (struct bptree_node *) root;
+	tree->depth++;
+	assert(tree->depth <= BPTREE_MAX_DEPTH);
+	return 0;
+}
+
+/**
+ * Merge two adjacent siblings or move entries between them so
+ * that they both are at least half full. Returns true if the
+ * nodes have been merged and the right one has been freed.
+ */
+static bool
+bptree_rebalance_pair(struct bptree *tree, struct bptree_inner *parent,
+		      uint32_t li)
+{
+	struct bptree_node *left = parent->child[li];
+	struct bptree_node *right = parent->child[li + 1];
+	uint32_t capacity = left->is_leaf ?
+		tree->leaf_capacity : tree->inner_capacity;
+	uint32_t total = left->count + right->count;
+	size_t *sizes = inner_sizes(tree, parent);
+
+	if (total <= capacity) {
+		if (left->is_leaf) {
+			struct bptree_leaf *l = (struct bptree_leaf *) left;
+			struct bptree_leaf *r = (struct bptree_leaf *) right;
+			leaf_move(tree, l, left->count, r, 0, right->count);
+			l->next = r->next;
+			if (r->next != NULL)
+				r->next->prev = l;
+			else
+				tree->last = l;
+		} else {
+			inner_move(tree, (struct bptree_inner *) left,
+				   left->count, (struct bptree_inner *) right,
+				   0, right->count);
+		}
+		left->count = total;
+		sizes[li] += sizes[li + 1];
+		/* The merged node inherits the right node's maximum. */
+		memcpy(inner_key(tree, parent, li),
+		       inner_key(tree, parent, li + 1), tree->elem_size);
+		inner_move(tree, parent, li + 1, parent, li + 2,
+			   parent->header.count - li - 2);
+		parent->header.count--;
+		node_free(tree, right);
+		return true;
+	}
+
+	uint32_t new_left = total / 2;
+	if (left->is_leaf) {
+		struct bptree_leaf *l = (struct bptree_leaf *) left;
+		struct bptree_leaf *r = (struct bptree_leaf *) right;
+		if (left->count > new_left) {
+			uint32_t n = left->count - new_left;
+			leaf_move(tree, r, n, r, 0, right->count);
+			leaf_move(tree, r, 0, l, new_left, n);
+		} else {
+			uint32_t n = new_left - left->count;
+			leaf_move(tree, l, left->count, r, 0, n);
+			leaf_move(tree, r, 0, r, n, right->count - n);
+		}
+	} else {
+		struct bptree_inner *l = (struct bptree_inner *) left;
+		struct bptree_inner *r = (struct bptree_inner *) right;
+		if (left->count > new_left) {
+			uint32_t n = left->count - new_left;
+			inner_move(tree, r, n, r, 0, right->count);
+			inner_move(tree, r, 0, l, new_left, n);
+		} else {
+			uint32_t n = new_left - left->count;
+			inner_move(tree, l, left->count, r, 0, n);
+			inner_move(tree, r, 0, r, n, right->count - n);
+		}
+	}
+	left->count = new_left;
+	right->count = total - new_left;
+	size_t weight = sizes[li] + sizes[li + 1];
+	sizes[li] = node_weight(tree, left);
+	sizes[li + 1] = weight - sizes[li];
+	memcpy(inner_key(tree, parent, li), node_max(tree, left),
+	       tree->elem_size);
+	return false;
+}
+
+bool
+bptree_delete(struct bptree *tree, const void *elem)
+{
+	if (tree->root == NULL)
+		return false;
+
+	struct bptree_path path[BPTREE_MAX_DEPTH];
+	uint32_t level = 0;
+	struct bptree_node *node = tree->root;
+	while (!node->is_leaf) {
+		struct bptree_inner *inner = (struct bptree_inner *) node;
+		uint32_t i = bound(inner_key(tree, inner, 0), tree->elem_size,
+				   node->count, elem, tree->elem_cmp,
+				   tree->arg, false);
+		if (i == node->count)
+			return false;
+		path[level].node = inner;
+		path[level].pos = i;
+		level++;
+		node = inner->child[i];
+	}
+	struct bptree_leaf *leaf = (struct bptree_leaf *) node;
+	uint32_t pos = bound(leaf->elems, tree->elem_size, node->count,
+			     elem, tree->elem_cmp, tree->arg, false);
+	if (pos == node->count ||
+	    tree->elem_cmp(elem, leaf_elem(tree, leaf, pos), tree->arg) != 0)
+		return false;
+
+	leaf_move(tree, leaf, pos, leaf, pos + 1, node->count - pos - 1);
+	node->count--;
+	tree->size--;
+	tree->version++;
+	for (uint32_t l = 0; l < level; l++)
+		inner_sizes(tree, path[l].node)[path[l].pos]--;
+
+	if (node->count == 0) {
+		/* Only the root leaf may become empty. */
+		assert(level == 0);
+		node_free(tree, node);
+		tree->root = NULL;
+		tree->first = tree->last = NULL;
+		tree->depth = 0;
+		return true;
+	}
+
+	if (pos == node->count) {
+		/* The maximum has been deleted, update its copies. */
+		const char *max = leaf_elem(tree, leaf, node->count - 1);
+		for (int l = level - 1; l >= 0; l--) {
+			memcpy(inner_key(tree, path[l].node, path[l].pos),
+			       max, tree->elem_size);
+			if (path[l].pos != path[l].node->header.count - 1)
+				break;
+		}
+	}
+
+	/* Restore the fill factor bottom up. */
+	for (int l = level - 1; l >= 0; l--) {
+		uint32_t capacity = node->is_leaf ?
+			tree->leaf_capacity : tree->inner_capacity;
+		if (node->count >= capacity / 2)
+			break;
+		struct bptree_inner *parent = path[l].node;
+		uint32_t p = path[l].pos;
+		uint32_t li = p > 0 ? p - 1 : 0;
+		if (!bptree_rebalance_pair(tree, parent, li))
+			break;
+		node = (struct bptree_node *) parent;
+	}
+
+	/* Shrink the tree if the root has a single child. */
+	while (!tree->root->is_leaf && tree->root->count == 1) {
+		struct bptree_node *root = tree->root;
+		tree->root = ((struct bptree_inner *) root)->child[0];
+		node_free(tree, root);
+		tree->depth--;
+	}
+	return true;
+}
+
+size_t
+bptree_mem_used(const struct bptree *tree)
+{
+	return (tree->leaf_count + tree->inner_count) * tree->node_size;
+}
+
+/* }}} */
+
+/* {{{ Iterators **************************************************/
+
+struct bptree_iterator *
+bptree_iterator_new(struct bptree *tree)
+{
+	struct bptree_iterator *it = malloc(sizeof(*it) + tree->elem_size);
+	if (it == NULL)
+		return NULL;
+	memset(it, 0, sizeof(*it));
+	it->tree = tree;
+	it->version = tree->version;
+	return it;
+}
+
+void
+bptree_iterator_delete(struct bptree_iterator *it)
+{
+	free(it);
+}
+
+/** Step the iterator position one element forward. */
+static inline void
+bptree_iterator_step(struct bptree_iterator *it)
+{
+	if (++it->pos == it->leaf->header.count) {
+		it->leaf = it->leaf->next;
+		it->pos = 0;
+	}
+}
+
+/** Step the iterator position one element back. */
+static inline void
+bptree_iterator_step_back(struct bptree_iterator *it)
+{
+	if (it->leaf == NULL) {
+		it->leaf = it->tree->last;
+		it->pos = it->leaf ? it->leaf->header.count - 1 : 0;
+	} else if (it->pos > 0) {
+		it->pos--;
+	} else {
+		it->leaf = it->leaf->prev;
+		it->pos = it->leaf ? it->leaf->header.count - 1 : 0;
+	}
+}
+
+/**
+ * Find the iterator position in the tree. Returns the number of
+ * elements which precede the position in ascending order, or,
+ * for a reverse iterator, the number of elements which remain.
+ */
+static size_t
+bptree_iterator_seek(struct bptree_iterator *it)
+{
+	struct bptree *tree = it->tree;
+	size_t rank;
+	it->version = tree->version;
+	if (it->has_last) {
+		/* Continue after (before) the last returned element. */
+		bptree_search(tree, it->last, tree->elem_cmp, !it->reverse,
+			      &it->leaf, &it->pos, &rank);
+	} else if (it->key != NULL) {
+		bptree_search(tree, it->key, tree->key_cmp, it->reverse,
+			      &it->leaf, &it->pos, &rank);
+	} else {
+		it->leaf = it->reverse ? NULL : tree->first;
+		it->pos = 0;
+		rank = it->reverse ? tree->size : 0;
+	}
+	if (it->reverse)
+		bptree_iterator_step_back(it);
+	return rank;
+}
+
+void
+bptree_iterator_init_set(struct bptree_iterator *it, const void *key)
+{
+	it->key = key;
+	it->has_last = false;
+	it->reverse = false;
+	bptree_iterator_seek(it);
+}
+
+void
+bptree_iterator_reverse_init_set(struct bptree_iterator *it,
+				 const void *key)
+{
+	it->key = key;
+	it->has_last = false;
+	it->reverse = true;
+	bptree_iterator_seek(it);
+}
+
+void *
+bptree_iterator_next(struct bptree_iterator *it)
+{
+	assert(!it->reverse);
+	struct bptree *tree = it->tree;
+	if (it->version != tree->version)
+		bptree_iterator_seek(it);
+	if (it->leaf == NULL)
+		return NULL;
+
+	char *elem = leaf_elem(tree, it->leaf, it->pos);
+	memcpy(it->last, elem, tree->elem_size);
+	it->has_last = true;
+	bptree_iterator_step(it);
+	return elem;
+}
+
+void *
+bptree_iterator_reverse_next(struct bptree_iterator *it)
+{
+	assert(it->reverse);
+	struct bptree *tree = it->tree;
+	if (it->version != tree->version)
+		bptree_iterator_seek(it);
+	if (it->leaf == NULL)
+		return NULL;
+
+	char *elem = leaf_elem(tree, it->leaf, it->pos);
+	memcpy(it->last, elem, tree->elem_size);
+	it->has_last = true;
+	bptree_iterator_step_back(it);
+	return elem;
+}
+
+void *
+bptree_iterator_skip(struct bptree_iterator *it, size_t *count)
+{
+	struct bptree *tree = it->tree;
+	size_t rank = bptree_iterator_seek(it);
+	size_t remaining = it->reverse ? rank : tree->size - rank;
+	if (*count > remaining)
+		*count = remaining;
+	if (*count == 0)
+		return NULL;
+
+	/* Jump straight to the last skipped element. */
+	size_t last = it->reverse ? rank - *count : rank + *count - 1;
+	bptree_locate(tree, last, &it->leaf, &it->pos);
+	char *elem = leaf_elem(tree, it->leaf, it->pos);
+	memcpy(it->last, elem, tree->elem_size);
+	it->has_last = true;
+	if (it->reverse)
+		bptree_iterator_step_back(it);
+	else
+		bptree_iterator_step(it);
+	return elem;
+}
+
+/* }}} */
@@ -40,6 +40,7 @@ const log_magic_t row_marker_v11 = 0xba0babed;
 const log_magic_t eof_marker_v11 = 0x10adab1e;
 const char inprogress_suffix[] = ".inprogress";
 const char v11[] = "0.11\n";
+const char segments_header[] = "Segments: ";
 
 void
 header_v11_sign(struct header_v11 *header)
@@ -69,12 +70,14 @@ row_v11_fill(struct row_v11 *row, u64 lsn, u16 tag, u64 cookie,
 
 struct log_dir snap_dir = {
 	.filetype = "SNAP\n",
-	.filename_ext = ".snap"
+	.filename_ext = ".snap",
+	.spare_fd = -1
 };
 
 struct log_dir wal_dir = {
 	.filetype = "XLOG\n",
-	.filename_ext = ".xlog"
+	.filename_ext = ".xlog",
+	.spare_fd = -1
 };
 
 static int
@@ -208,48 +211,186 @@ format_filename(struct log_dir *dir, i64 lsn, enum log_suffix suffix)
 	return filename;
 }
 
+char *
+format_segment_filename(struct log_dir *dir, i64 lsn, int segment,
+			enum log_suffix suffix)
+{
+	static __thread char filename[PATH_MAX + 1];
+	const char *suffix_str = suffix == INPROGRESS ? inprogress_suffix : "";
+	snprintf(filename, PATH_MAX, "%s/%020lld%s.%d%s",
+		 dir->dirname, (long long)lsn, dir->filename_ext, segment,
+		 suffix_str);
+	return filename;
+}
+
+/**
+ * The spare file is not a valid log file until it is renamed,
+ * scan_dir() skips it.
+ */
+static char *
+format_spare_filename(struct log_dir *dir)
+{
+	static __thread char filename[PATH_MAX + 1];
+	snprintf(filename, PATH_MAX, "%s/spare%s.spare",
+		 dir->dirname, dir->filename_ext);
+	return filename;
+}
+
+void
+log_dir_prealloc(struct log_dir *dir)
+{
+	/*
+	 * Keep every step short: a request which arrives
+	 * meanwhile waits for the step to end.
+	 */
+	enum {
+		PREALLOC_CHUNK = 64 * 1024,
+		PREALLOC_SYNC_CHUNK = 256 * 1024,
+	};
+	static const char zeros[PREALLOC_CHUNK];
+
+	if (dir->spare_size == dir->prealloc_size)
+		return;
+	if (dir->spare_fd < 0) {
+		/* Fill an existing spare file anew: it may be partial. */
+		char *filename = format_spare_filename(dir);
+		dir->spare_fd = open(filename, O_WRONLY | O_CREAT, 0664);
+		if (dir->spare_fd < 0)
+			goto error;
+		dir->spare_size = dir->spare_written = 0;
+	}
+	if (dir->spare_written == dir->prealloc_size) {
+		/* Make sure the blocks are allocated on disk. */
+		if (fio_truncate(dir->spare_fd, dir->prealloc_size) != 0 ||
+		    fsync(dir->spare_fd) != 0)
+			goto error;
+		dir->spare_size = dir->prealloc_size;
+		return;
+	}
+	if (dir->spare_written - dir->spare_size >= PREALLOC_SYNC_CHUNK) {
+		/*
+		 * Flush a few chunks at a time, in a step of its
+		 * own, so that the final sync doesn't stall the
+		 * caller for long.
+		 */
+#if defined(HAVE_FDATASYNC)
+		if (fdatasync(dir->spare_fd) != 0)
+			goto error;
+#endif
+		dir->spare_size = dir->spare_written;
+		return;
+	}
+	size_t chunk = MIN(PREALLOC_CHUNK,
+			   dir->prealloc_size - dir->spare_written);
+	if (fio_write(dir->spare_fd, zeros, chunk) != (ssize_t) chunk)
+		goto error;
+	dir->spare_written += chunk;
+	return;
+error:
+	say_syserror("can't preallocate `%s'", format_spare_filename(dir));
+	/* Don't retry until the next file is opened. */
+	if (dir->spare_fd >= 0)
+		close(dir->spare_fd);
+	dir->spare_fd = -1;
+	dir->spare_size = dir->prealloc_size;
+}
+
+/**
+ * Open the spare file as a new file to write, if it's ready.
+ * Returns -1 otherwise.
+ */
+static int
+log_dir_open_spare(struct log_dir *dir, const char *filename)
+{
+	if (dir->spare_fd < 0) {
+		/* Failed, retry for the next file. */
+		dir->spare_size = 0;
+		return -1;
+	}
+	if (dir->spare_size < dir->prealloc_size)
+		return -1;
+	close(dir->spare_fd);
+	dir->spare_fd = -1;
+	dir->spare_size = 0;
+	char *spare_filename = format_spare_filename(dir);
+	/* Unlike rename(), link() doesn't overwrite files. */
+	if (link(spare_filename, filename) != 0) {
+		say_syserror("can't link `%s' to `%s'",
+			     spare_filename, filename);
+		return -1;
+	}
+	unlink(spare_filename);
+	int fd = open(filename, O_WRONLY | dir->open_wflags);
+	if (fd < 0)
+		say_syserror("can't open `%s'", filename);
+	return fd;
+}
+
+/** Allocate space for a new file to write, if it's not spare. */
+static void
+log_dir_fallocate(struct log_dir *dir, int fd, const char *filename)
+{
+#if defined(HAVE_POSIX_FALLOCATE)
+	int rc = posix_fallocate(fd, 0, dir->prealloc_size);
+	if (rc != 0) {
+		errno = rc;
+		say_syserror("can't preallocate `%s'", filename);
+	}
+#else
+	(void) dir;
+	(void) fd;
+	(void) filename;
+#endif
+}
+
 /* }}} */
 
 /* {{{ struct log_io_cursor */
 
 #define ROW_EOF (void *)1
+#define ROW_NOMEM (void *)2
 
-static struct tbuf *
-row_reader_v11(FILE *f, struct palloc_pool *pool)
+/**
+ * Read a row, its marker already read, into the memory given
+ * by alloc().
+ *
+ * @return the row, NULL if it's corrupt, ROW_EOF at the end
+ * of file, ROW_NOMEM if alloc() failed.
+ */
+static void *
+row_reader_v11(FILE *f, log_io_row_alloc_f alloc, void *ctx)
 {
-	struct tbuf *m = tbuf_new(pool);
-
+	struct header_v11 header;
 	u32 header_crc, data_crc;
 
-	tbuf_ensure(m, sizeof(struct header_v11));
-	if (fread(m->data, sizeof(struct header_v11), 1, f) != 1)
+	if (fread(&header, sizeof(header), 1, f) != 1)
 		return ROW_EOF;
 
-	m->size = sizeof(struct header_v11);
-
 	/* header crc32c calculated on <lsn, tm, len, data_crc32c> */
-	header_crc = crc32_calc(0, m->data + offsetof(struct header_v11, lsn),
-				sizeof(struct header_v11) - offsetof(struct header_v11, lsn));
+	header_crc = crc32_calc(0, (void *) &header +
+				offsetof(struct header_v11, lsn),
+				sizeof(header) - offsetof(struct header_v11, lsn));
 
-	if (header_v11(m)->header_crc32c != header_crc) {
+	if (header.header_crc32c != header_crc) {
 		say_error("header crc32c mismatch");
 		return NULL;
 	}
 
-	tbuf_ensure(m, m->size + header_v11(m)->len);
-	if (fread(m->data + sizeof(struct header_v11), header_v11(m)->len, 1, f) != 1)
+	void *row = alloc(ctx, sizeof(header) + header.len);
+	if (row == NULL)
+		return ROW_NOMEM;
+	memcpy(row, &header, sizeof(header));
+	if (fread(row + sizeof(header), header.len, 1, f) != 1)
 		return ROW_EOF;
 
-	m->size += header_v11(m)->len;
-
-	data_crc = crc32_calc(0, m->data + sizeof(struct header_v11), header_v11(m)->len);
-	if (header_v11(m)->data_crc32c != data_crc) {
+	data_crc = crc32_calc(0, row + sizeof(header), header.len);
+	if (header.data_crc32c != data_crc) {
 		say_error("data crc32c mismatch");
 		return NULL;
 	}
 
-	say_debug("read row v11 success lsn:%lld", (long long)header_v11(m)->lsn);
-	return m;
+	say_debug("read row v11 success lsn:%lld", (long long) header.lsn);
+	return row;
 }
 
 void
@@ -276,6 +417,16 @@ log_io_cursor_close(struct log_io_cursor *i)
 	prelease(fiber->gc_pool);
 }
 
+static void *
+log_io_cursor_alloc_tbuf(void *ctx, size_t size)
+{
+	struct tbuf **row = ctx;
+	*row = tbuf_new(fiber->gc_pool);
+	tbuf_ensure(*row, size);
+	(*row)->size = size;
+	return (*row)->data;
+}
+
 /**
  * Read logfile contents using designated format, panic if
  * the log is corrupted/unreadable.
@@ -285,6 +436,23 @@ log_io_cursor_close(struct log_io_cursor *i)
  */
 struct tbuf *
 log_io_cursor_next(struct log_io_cursor *i)
+{
+	/*
+	 * Don't let gc pool grow too much. Yet to
+	 * it before reading the next row, to make
+	 * sure it's not freed along here.
+	 */
+	prelease_after(fiber->gc_pool, 128 * 1024);
+
+	struct tbuf *row;
+	if (log_io_cursor_read(i, log_io_cursor_alloc_tbuf, &row) == NULL)
+		return NULL;
+	return row;
+}
+
+void *
+log_io_cursor_read(struct log_io_cursor *i, log_io_row_alloc_f alloc,
+		   void *ctx)
 {
 	struct log_io *l = i->log;
 	log_magic_t magic;
@@ -295,19 +463,18 @@ log_io_cursor_next(struct log_io_cursor *i)
 	say_debug("log_io_cursor_next: marker:0x%016X/%zu",
 		  row_marker_v11, sizeof(row_marker_v11));
 
-	/*
-	 * Don't let gc pool grow too much. Yet to
-	 * it before reading the next row, to make
-	 * sure it's not freed along here.
-	 */
-	prelease_after(fiber->gc_pool, 128 * 1024);
-
 restart:
 	if (marker_offset > 0)
 		fseeko(l->f, marker_offset + 1, SEEK_SET);
 
 	if (fread(&magic, sizeof(magic), 1, l->f) != 1)
 		goto eof;
+	/*
+	 * Zeros instead of a row: the space preallocated for the
+	 * rows yet to be written. Come back for them later.
+	 */
+	if (magic == 0 && l->dir->prealloc_size > 0)
+		return NULL;
 
 	while (magic != row_marker_v11) {
 		int c = fgetc(l->f);
@@ -317,6 +484,13 @@ restart:
 		}
 		magic = magic >> 8 |
 			((log_magic_t) c & 0xff) << (sizeof(magic)*8 - 8);
+		/*
+		 * Don't look for a row past the end of the rows
+		 * written to a preallocated file: a row can
+		 * appear there while we're looking.
+		 */
+		if (magic == 0 && l->dir->prealloc_size > 0)
+			return NULL;
 	}
 	marker_offset = ftello(l->f) - sizeof(row_marker_v11);
 	if (i->good_offset != marker_offset)
@@ -325,9 +499,11 @@ restart:
 			(uintmax_t)i->good_offset);
 	say_debug("magic found at 0x%08jx", (uintmax_t)marker_offset);
 
-	struct tbuf *row = row_reader_v11(l->f, fiber->gc_pool);
+	void *row = row_reader_v11(l->f, alloc, ctx);
 	if (row == ROW_EOF)
 		goto eof;
+	if (row == ROW_NOMEM)
+		return NULL;
 
 	if (row == NULL) {
 		if (l->dir->panic_if_error)
@@ -435,6 +611,12 @@ log_io_close(struct log_io **lptr)
 
 	if (l->mode == LOG_WRITE) {
 		fio_write(fileno(l->f), &eof_marker_v11, sizeof(log_magic_t));
+		/* Cut off the preallocated space left. */
+		if (l->dir->prealloc_size > 0) {
+			off_t end = fio_lseek(fileno(l->f), 0, SEEK_CUR);
+			if (end >= 0)
+				fio_truncate(fileno(l->f), end);
+		}
 		/*
 		 * Sync the file before closing, since
 		 * otherwise we can end up with a partially
@@ -478,17 +660,32 @@ log_io_atfork(struct log_io **lptr)
 int
 log_io_sync(struct log_io *l)
 {
+	/*
+	 * Only the file size may change along with the data,
+	 * and not even it if the file is preallocated.
+	 */
+#if defined(HAVE_FDATASYNC)
+	if (fdatasync(fileno(l->f)) < 0) {
+		say_syserror("%s: fdatasync failed", l->filename);
+		return -1;
+	}
+#else
 	if (fsync(fileno(l->f)) < 0) {
 		say_syserror("%s: fsync failed", l->filename);
 		return -1;
 	}
+#endif
 	return 0;
 }
 
 static int
 log_io_write_header(struct log_io *l)
 {
-	int ret = fprintf(l->f, "%s%s\n", l->dir->filetype, v11);
+	int ret = fprintf(l->f, "%s%s", l->dir->filetype, v11);
+	if (ret >= 0 && l->segments > 0)
+		ret = fprintf(l->f, "%s%d\n", segments_header, l->segments);
+	if (ret >= 0)
+		ret = fprintf(l->f, "\n");
 
 	return ret < 0 ? -1 : 0;
 }
@@ -529,6 +726,21 @@ log_io_verify_meta(struct log_io *l, const char **errmsg)
 		}
 		if (strcmp(buf, "\n") == 0 || strcmp(buf, "\r\n") == 0)
 			break;
+		if (strncmp(buf, segments_header,
+			    strlen(segments_header)) == 0) {
+			const char *value = buf + strlen(segments_header);
+			char *end;
+			errno = 0;
+			long segments = strtol(value, &end, 10);
+			/* The number sizes arrays on stack in recovery. */
+			if (errno != 0 || end == value ||
+			    (strcmp(end, "\n") != 0 && strcmp(end, "\r\n") != 0) ||
+			    segments <= 0 || segments > LOG_SEGMENTS_MAX) {
+				*errmsg = "invalid number of segments";
+				goto error;
+			}
+			l->segments = segments;
+		}
 	}
 	return 0;
 error:
@@ -563,10 +775,8 @@ log_io_open(struct log_dir *dir, enum log_mode mode,
 	if (mode == LOG_READ) {
 		if (log_io_verify_meta(l, &errmsg) != 0)
 			goto error;
-	} else { /* LOG_WRITE */
+	} else { /* LOG_WRITE, the header is written by log_io_create() */
 		setvbuf(l->f, NULL, _IONBF, 0);
-		if (log_io_write_header(l) != 0)
-			goto error;
 	}
 	return l;
 error:
@@ -590,12 +800,47 @@ log_io_open_for_read(struct log_dir *dir, i64 lsn, enum log_suffix suffix)
 	return log_io_open(dir, LOG_READ, filename, suffix, f);
 }
 
+struct log_io *
+log_io_open_segment_for_read(struct log_dir *dir, i64 lsn, int segment)
+{
+	assert(lsn != 0);
+
+	const char *filename = format_segment_filename(dir, lsn, segment,
+						       NONE);
+	FILE *f = fopen(filename, "r");
+	return log_io_open(dir, LOG_READ, filename, NONE, f);
+}
+
 /**
- * In case of error, writes a message to the server log
- * and sets errno.
+ * Make a log_io of a new file open for write and write the
+ * file header. Closes the file in case of error.
  */
-struct log_io *
-log_io_open_for_write(struct log_dir *dir, i64 lsn, enum log_suffix suffix)
+static struct log_io *
+log_io_create(struct log_dir *dir, int fd, const char *filename,
+	      enum log_suffix suffix, int segments)
+{
+	say_info("creating `%s'", filename);
+	FILE *f = fdopen(fd, "w");
+	if (f == NULL)
+		close(fd);
+	struct log_io *l = log_io_open(dir, LOG_WRITE, filename, suffix, f);
+	if (l == NULL)
+		return NULL;
+	l->segments = segments;
+	if (log_io_write_header(l) != 0) {
+		int save_errno = errno;
+		say_syserror("%s: failed to write the header of `%s'",
+			     __func__, filename);
+		log_io_atfork(&l);
+		errno = save_errno;
+		return NULL;
+	}
+	return l;
+}
+
+static struct log_io *
+log_io_open_lsn_for_write(struct log_dir *dir, i64 lsn,
+			  enum log_suffix suffix, int segments)
 {
 	char *filename;
 
@@ -613,20 +858,63 @@ log_io_open_for_write(struct log_dir *dir, i64 lsn, enum log_suffix suffix)
 		}
 	}
 	filename = format_filename(dir, lsn, suffix);
+	int fd = -1;
+	if (dir->prealloc_size > 0)
+		fd = log_dir_open_spare(dir, filename);
+	if (fd < 0) {
+		/*
+		 * Open the <lsn>.<suffix>.inprogress file. If it
+		 * exists, open will fail.
+		 */
+		fd = open(filename,
+			  O_WRONLY | O_CREAT | O_EXCL | dir->open_wflags, 0664);
+		if (fd < 0)
+			goto error;
+		if (dir->prealloc_size > 0)
+			log_dir_fallocate(dir, fd, filename);
+	}
+	return log_io_create(dir, fd, filename, suffix, segments);
+error:
+	say_syserror("%s: failed to open `%s'", __func__, filename);
+	return NULL;
+}
+
+/**
+ * In case of error, writes a message to the server log
+ * and sets errno.
+ */
+struct log_io *
+log_io_open_for_write(struct log_dir *dir, i64 lsn, enum log_suffix suffix)
+{
+	return log_io_open_lsn_for_write(dir, lsn, suffix, 0);
+}
+
+struct log_io *
+log_io_open_manifest_for_write(struct log_dir *dir, i64 lsn, int segments)
+{
+	assert(segments > 0);
+	return log_io_open_lsn_for_write(dir, lsn, INPROGRESS, segments);
+}
+
+struct log_io *
+log_io_open_segment_for_write(struct log_dir *dir, i64 lsn, int segment)
+{
 	/*
-	 * Open the <lsn>.<suffix>.inprogress file. If it exists,
-	 * open will fail.
+	 * The manifest is open exclusively, so a segment file
+	 * with the same name can only be left by a snapshot
+	 * that failed.
 	 */
+	unlink(format_segment_filename(dir, lsn, segment, NONE));
+	char *filename = format_segment_filename(dir, lsn, segment,
+						 INPROGRESS);
+	unlink(filename);
 	int fd = open(filename,
 		      O_WRONLY | O_CREAT | O_EXCL | dir->open_wflags, 0664);
-	if (fd < 0)
-		goto error;
-	say_info("creating `%s'", filename);
-	FILE *f = fdopen(fd, "w");
-	return log_io_open(dir, LOG_WRITE, filename, suffix, f);
-error:
-	say_syserror("%s: failed to open `%s'", __func__, filename);
-	return NULL;
+	if (fd < 0) {
+		say_syserror("%s: failed to open `%s'", __func__, filename);
+		return NULL;
+	}
+	return log_io_create(dir, fd, filename, INPROGRESS, 0);
 }
 
 /* }}} */
@@ -89,6 +89,37 @@ lbox_info_snapshot_pid(struct lua_State *L)
 	return 1;
 }
 
+/** box.info.wal: WAL writer batch and fsync statistics. */
+static int
+lbox_info_wal(struct lua_State *L)
+{
+	struct wal_stat stat;
+	recovery_wal_stat(recovery_state, &stat);
+
+	lua_newtable(L);
+
+	lua_pushstring(L, "batches");
+	lua_pushnumber(L, stat.batches);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "batch_size");
+	lua_pushnumber(L, stat.batch_size);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "syncs");
+	lua_pushnumber(L, stat.syncs);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "sync_time");
+	lua_pushnumber(L, stat.sync_time);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "sync_time_max");
+	lua_pushnumber(L, stat.sync_time_max);
+	lua_settable(L, -3);
+	return 1;
+}
+
 static const struct luaL_reg
 lbox_info_dynamic_meta [] =
 {
@@ -98,6 +129,7 @@ lbox_info_dynamic_meta [] =
 	{"status", lbox_info_status},
 	{"uptime", lbox_info_uptime},
 	{"snapshot_pid", lbox_info_snapshot_pid},
+	{"wal", lbox_info_wal},
 	{NULL, NULL}
 };
 
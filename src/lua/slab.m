@@ -62,6 +62,10 @@ salloc_stat_lua_cb(const struct slab_cache_stats *cstat, void *cb_ctx)
 	luaL_pushnumber64(L, cstat->bytes_free);
 	lua_settable(L, -3);
 
+	lua_pushstring(L, "bytes_waste");
+	luaL_pushnumber64(L, cstat->bytes_waste);
+	lua_settable(L, -3);
+
 	lua_pushstring(L, "item_size");
 	luaL_pushnumber64(L, cstat->item_size);
 	lua_settable(L, -3);
@@ -97,6 +101,30 @@ lbox_slab_arena_size(struct lua_State *L)
 	return 1;
 }
 
+static int
+lbox_slab_arena_pages(struct lua_State *L)
+{
+	struct slab_arena_stats astat;
+	salloc_stat(NULL, &astat, NULL);
+	lua_pushstring(L, slab_arena_pages_strs[astat.pages]);
+	return 1;
+}
+
+static int
+lbox_slab_huge_pages_used(struct lua_State *L)
+{
+	luaL_pushnumber64(L, salloc_huge_pages_used());
+	return 1;
+}
+
+/** Add size classes fitting the sizes allocated so far. */
+static int
+lbox_slab_adapt(struct lua_State *L)
+{
+	lua_pushnumber(L, salloc_adapt());
+	return 1;
+}
+
 static int
 lbox_slab_call(struct lua_State *L)
 {
@@ -123,6 +151,8 @@ static const struct luaL_reg lbox_slab_dynamic_meta [] = {
 	{"slabs", lbox_slab_slabs},
 	{"arena_used", lbox_slab_arena_used},
 	{"arena_size", lbox_slab_arena_size},
+	{"arena_pages", lbox_slab_arena_pages},
+	{"huge_pages_used", lbox_slab_huge_pages_used},
 	{NULL, NULL}
 };
 
@@ -150,6 +180,9 @@ tarantool_lua_slab_init(struct lua_State *L)
 
 	lua_pushstring(L, "slab");
 	lua_newtable(L);		/* box.slab */
+	lua_pushstring(L, "adapt");
+	lua_pushcfunction(L, lbox_slab_adapt);
+	lua_settable(L, -3);
 
 	lua_newtable(L);
 	lua_pushstring(L, "__call");
@@ -93,6 +93,46 @@ lbox_stat_call(struct lua_State *L)
 	return 1;
 }
 
+static void
+set_latency_field(struct lua_State *L, const char *name, u64 value)
+{
+	lua_pushstring(L, name);
+	lua_pushnumber(L, value);
+	lua_settable(L, -3);
+}
+
+static int
+set_latency_item(const char *name, const struct histogram *hist,
+		 void *cb_ctx)
+{
+	struct lua_State *L = cb_ctx;
+
+	lua_pushstring(L, name);
+	lua_newtable(L);
+
+	set_latency_field(L, "count", hist->count);
+	set_latency_field(L, "p50", histogram_percentile(hist, 0.5));
+	set_latency_field(L, "p99", histogram_percentile(hist, 0.99));
+	set_latency_field(L, "p999", histogram_percentile(hist, 0.999));
+	set_latency_field(L, "max", hist->max);
+
+	lua_settable(L, -3);
+
+	return 0;
+}
+
+/**
+ * box.stat.latency(): latencies in microseconds, e.g.
+ * box.stat.latency().SELECT.p99.
+ */
+static int
+lbox_stat_latency(struct lua_State *L)
+{
+	lua_newtable(L);
+	stat_foreach_latency(set_latency_item, L);
+	return 1;
+}
+
 static const struct luaL_reg lbox_stat_meta [] = {
 	{"__index", lbox_stat_index},
 	{"__call",  lbox_stat_call},
@@ -108,6 +148,10 @@ tarantool_lua_stat_init(struct lua_State *L)
 	lua_pushstring(L, "stat");
 	lua_newtable(L);
 
+	lua_pushstring(L, "latency");
+	lua_pushcfunction(L, lbox_stat_latency);
+	lua_settable(L, -3);
+
 	lua_newtable(L);
 	luaL_register(L, NULL, lbox_stat_meta);
 	lua_setmetatable(L, -2);
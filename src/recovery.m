@@ -29,12 +29,14 @@
 #include "recovery.h"
 
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "log_io.h"
 #include "fiber.h"
 #include "tarantool_pthread.h"
 #include "fio.h"
 #include "errinj.h"
+#include "coeio.h"
 
 /*
  * Recovery subsystem
@@ -102,7 +104,8 @@ struct recovery_state *recovery_state;
 
 static const u64 snapshot_cookie = 0;
 
-const char *wal_mode_STRS[] = { "none", "write", "fsync", "fsync_delay", NULL };
+const char *wal_mode_STRS[] = { "none", "write", "fsync", "fsync_delay",
+				"fsync_group", NULL };
 
 /* {{{ LSN API */
 
@@ -276,6 +279,334 @@ recovery_setup_panic(struct recovery_state *r, bool on_snap_error, bool on_wal_e
 	r->snap_dir->panic_if_error = on_snap_error;
 }
 
+void
+recovery_setup_wal_prealloc(struct recovery_state *r, size_t size)
+{
+	r->wal_dir->prealloc_size = size;
+}
+
+
+/* {{{ Read-ahead of log files */
+
+/**
+ * Rows read ahead from a log file, header and body each, as
+ * returned by log_io_cursor_next().
+ */
+struct read_ahead_batch {
+	STAILQ_ENTRY(read_ahead_batch) next;
+	size_t size;
+	size_t capacity;
+	char data[];
+};
+
+enum {
+	READ_AHEAD_BATCH_SIZE = 1024 * 1024,
+	/** Batches read ahead per file, at most. */
+	READ_AHEAD_BATCHES = 4,
+	/** Read smaller files in the main thread. */
+	READ_AHEAD_MIN = 4 * READ_AHEAD_BATCH_SIZE
+};
+
+/**
+ * Log files read by a thread each: the reads, the row framing
+ * and the checksums are done there, ahead of the main thread,
+ * which only applies the rows.
+ */
+struct read_ahead {
+	/** Cursors of the files to read. */
+	struct log_io_cursor *cursors;
+	int count;
+	/** The next file to read, advanced atomically. */
+	int next;
+	pthread_mutex_t mutex;
+	/** Signalled when a batch is ready or a file is done. */
+	pthread_cond_t ready_cond;
+	/** Signalled when a batch is applied. */
+	pthread_cond_t free_cond;
+	STAILQ_HEAD(, read_ahead_batch) ready;
+	/** Batches read and not applied yet. */
+	int batches;
+	/** The number of files read up. */
+	int done;
+	/** Out of memory, not all rows are read. */
+	bool is_error;
+	/** The rows aren't needed anymore, stop reading. */
+	bool is_stopped;
+};
+
+/** A file being read ahead, and the batch it's read into. */
+struct read_ahead_file {
+	struct read_ahead *ra;
+	struct read_ahead_batch *batch;
+};
+
+/**
+ * Get memory for a batch, waiting for the main thread to apply
+ * the batches read ahead. NULL if the reading is stopped or
+ * there is no memory.
+ */
+static struct read_ahead_batch *
+read_ahead_get(struct read_ahead *ra, size_t capacity)
+{
+	tt_pthread_mutex_lock(&ra->mutex);
+	while (ra->batches >= ra->count * READ_AHEAD_BATCHES &&
+	       ! ra->is_stopped)
+		tt_pthread_cond_wait(&ra->free_cond, &ra->mutex);
+	bool is_stopped = ra->is_stopped;
+	if (! is_stopped)
+		ra->batches++;
+	tt_pthread_mutex_unlock(&ra->mutex);
+	if (is_stopped)
+		return NULL;
+
+	struct read_ahead_batch *batch = malloc(sizeof(*batch) + capacity);
+	if (batch == NULL) {
+		say_error("can't allocate %zu bytes to read rows",
+			  sizeof(*batch) + capacity);
+		tt_pthread_mutex_lock(&ra->mutex);
+		ra->batches--;
+		ra->is_error = true;
+		tt_pthread_mutex_unlock(&ra->mutex);
+		return NULL;
+	}
+	batch->size = 0;
+	batch->capacity = capacity;
+	return batch;
+}
+
+static void
+read_ahead_put(struct read_ahead *ra, struct read_ahead_batch *batch)
+{
+	free(batch);
+	tt_pthread_mutex_lock(&ra->mutex);
+	ra->batches--;
+	tt_pthread_cond_signal(&ra->free_cond);
+	tt_pthread_mutex_unlock(&ra->mutex);
+}
+
+static void
+read_ahead_push(struct read_ahead *ra, struct read_ahead_batch *batch)
+{
+	tt_pthread_mutex_lock(&ra->mutex);
+	STAILQ_INSERT_TAIL(&ra->ready, batch, next);
+	tt_pthread_cond_signal(&ra->ready_cond);
+	tt_pthread_mutex_unlock(&ra->mutex);
+}
+
+/**
+ * Give memory for the next row at the end of the batch. A row
+ * is added to the batch only when it's read and checked.
+ */
+static void *
+read_ahead_alloc(void *ctx, size_t size)
+{
+	struct read_ahead_file *file = ctx;
+	struct read_ahead_batch *batch = file->batch;
+	if (batch != NULL && batch->size + size <= batch->capacity)
+		return batch->data + batch->size;
+	if (batch != NULL) {
+		if (batch->size > 0)
+			read_ahead_push(file->ra, batch);
+		else
+			read_ahead_put(file->ra, batch);
+	}
+	file->batch = read_ahead_get(file->ra,
+				     MAX(READ_AHEAD_BATCH_SIZE, size));
+	return file->batch != NULL ? file->batch->data : NULL;
+}
+
+static void *
+read_ahead_run(void *arg)
+{
+	struct read_ahead *ra = arg;
+	int i;
+	while ((i = __sync_fetch_and_add(&ra->next, 1)) < ra->count) {
+		struct read_ahead_file file = { .ra = ra, .batch = NULL };
+		struct header_v11 *row;
+		while ((row = log_io_cursor_read(&ra->cursors[i],
+						 read_ahead_alloc, &file)))
+			file.batch->size += sizeof(*row) + row->len;
+		if (file.batch != NULL && file.batch->size > 0)
+			read_ahead_push(ra, file.batch);
+		else if (file.batch != NULL)
+			read_ahead_put(ra, file.batch);
+
+		tt_pthread_mutex_lock(&ra->mutex);
+		ra->done++;
+		tt_pthread_cond_signal(&ra->ready_cond);
+		tt_pthread_mutex_unlock(&ra->mutex);
+	}
+	return NULL;
+}
+
+/**
+ * Take the next batch of rows read.
+ * @return NULL if all files are read up.
+ */
+static struct read_ahead_batch *
+read_ahead_pop(struct read_ahead *ra)
+{
+	tt_pthread_mutex_lock(&ra->mutex);
+	while (STAILQ_EMPTY(&ra->ready) && ra->done < ra->count)
+		tt_pthread_cond_wait(&ra->ready_cond, &ra->mutex);
+	struct read_ahead_batch *batch = STAILQ_FIRST(&ra->ready);
+	if (batch != NULL)
+		STAILQ_REMOVE_HEAD(&ra->ready, next);
+	tt_pthread_mutex_unlock(&ra->mutex);
+	return batch;
+}
+
+/** Make the readers drop the rest of rows. */
+static void
+read_ahead_stop(struct read_ahead *ra)
+{
+	tt_pthread_mutex_lock(&ra->mutex);
+	ra->is_stopped = true;
+	tt_pthread_cond_broadcast(&ra->free_cond);
+	tt_pthread_mutex_unlock(&ra->mutex);
+}
+
+/** Apply a row, @return -1 to stop. */
+typedef int (*apply_row_f)(struct recovery_state *r, struct tbuf *row);
+
+/**
+ * Read the files open by the cursors ahead, in a thread each,
+ * and apply the rows in this thread.
+ *
+ * @return 0 on success, -1 if apply() has stopped the recovery,
+ * or there is no memory to read ahead.
+ */
+static int
+read_ahead_apply(struct recovery_state *r, struct log_io_cursor *cursors,
+		 int count, apply_row_f apply)
+{
+	struct read_ahead ra = { .cursors = cursors, .count = count };
+	tt_pthread_mutex_init(&ra.mutex, NULL);
+	tt_pthread_cond_init(&ra.ready_cond, NULL);
+	tt_pthread_cond_init(&ra.free_cond, NULL);
+	STAILQ_INIT(&ra.ready);
+
+	pthread_t threads[count];
+	int n_started = 0;
+	while (n_started < count &&
+	       tt_pthread_create(&threads[n_started], NULL,
+				 read_ahead_run, &ra) == 0)
+		n_started++;
+	if (n_started == 0) {
+		say_error("can't start threads to read ahead");
+		ra.is_error = true;
+		ra.done = count;
+	}
+
+	int rc = 0;
+	struct read_ahead_batch *batch;
+	while ((batch = read_ahead_pop(&ra)) != NULL) {
+		char *row = batch->data;
+		char *end = batch->data + batch->size;
+		while (rc == 0 && row < end) {
+			struct header_v11 *header = (struct header_v11 *) row;
+			u32 row_size = sizeof(*header) + header->len;
+			struct tbuf t = {
+				.size = row_size, .capacity = row_size,
+				.data = row, .pool = fiber->gc_pool
+			};
+			row += row_size;
+			if (apply(r, &t) < 0) {
+				rc = -1;
+				read_ahead_stop(&ra);
+			}
+			prelease_after(fiber->gc_pool, 128 * 1024);
+		}
+		read_ahead_put(&ra, batch);
+	}
+	for (int t = 0; t < n_started; t++)
+		tt_pthread_join(threads[t], NULL);
+
+	tt_pthread_cond_destroy(&ra.free_cond);
+	tt_pthread_cond_destroy(&ra.ready_cond);
+	tt_pthread_mutex_destroy(&ra.mutex);
+	return ra.is_error ? -1 : rc;
+}
+
+/**
+ * Apply the rows of the files open by the cursors. Read them
+ * ahead in other threads, unless there is only one small file
+ * to read, such as a WAL in hot standby mode.
+ *
+ * @return 0 on success, -1 if apply() has stopped the recovery.
+ */
+static int
+recover_rows(struct recovery_state *r, struct log_io_cursor *cursors,
+	     int count, apply_row_f apply)
+{
+	if (count == 1) {
+		struct log_io_cursor *i = &cursors[0];
+		struct stat st;
+		if (fstat(fileno(i->log->f), &st) != 0 ||
+		    st.st_size - i->good_offset < READ_AHEAD_MIN) {
+			struct tbuf *row;
+			while ((row = log_io_cursor_next(i)))
+				if (apply(r, row) < 0)
+					return -1;
+			return 0;
+		}
+	}
+	return read_ahead_apply(r, cursors, count, apply);
+}
+
+/* }}} */
+
+static int
+snap_apply_row(struct recovery_state *r, struct tbuf *row)
+{
+	if (r->row_handler(r->row_handler_param, row) < 0) {
+		say_error("can't apply row");
+		if (r->snap_dir->panic_if_error)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * Apply the rows of a snapshot file, or of its segments if
+ * it's a manifest (see log_io::segments).
+ *
+ * @return true on success.
+ */
+static bool
+recover_snap_rows(struct recovery_state *r, struct log_io *snap, i64 lsn)
+{
+	int count = MAX(snap->segments, 1);
+	/* Checked when the header is read. */
+	assert(count <= LOG_SEGMENTS_MAX);
+	struct log_io_cursor cursors[count];
+	int n_open = 0;
+	if (snap->segments == 0)
+		log_io_cursor_open(&cursors[n_open++], snap);
+	while (n_open < snap->segments) {
+		struct log_io *l = log_io_open_segment_for_read(r->snap_dir,
+								lsn, n_open);
+		if (l == NULL)
+			break;
+		log_io_cursor_open(&cursors[n_open++], l);
+	}
+	bool is_ok = n_open == count &&
+		recover_rows(r, cursors, n_open, snap_apply_row) == 0;
+
+	for (int k = 0; k < n_open; k++) {
+		struct log_io *l = cursors[k].log;
+		/* Unlike a snapshot file, a segment must be complete. */
+		if (is_ok && snap->segments > 0 && ! cursors[k].eof_read) {
+			say_error("`%s' has no EOF marker", l->filename);
+			if (r->snap_dir->panic_if_error)
+				is_ok = false;
+		}
+		log_io_cursor_close(&cursors[k]);
+		if (l != snap)
+			log_io_close(&l);
+	}
+	return is_ok;
+}
 
 /**
  * Read a snapshot and call row_handler for every snapshot row.
@@ -302,22 +633,10 @@ recover_snap(struct recovery_state *r)
 		goto error;
 	}
 	say_info("recover from `%s'", snap->filename);
-	struct log_io_cursor i;
-
-	log_io_cursor_open(&i, snap);
-
-	struct tbuf *row;
-	while ((row = log_io_cursor_next(&i))) {
-		if (r->row_handler(r->row_handler_param, row) < 0) {
-			say_error("can't apply row");
-			if (snap->dir->panic_if_error)
-				break;
-		}
-	}
-	log_io_cursor_close(&i);
+	bool is_ok = recover_snap_rows(r, snap, lsn);
 	log_io_close(&snap);
 
-	if (row == NULL) {
+	if (is_ok) {
 		r->lsn = r->confirmed_lsn = lsn;
 		say_info("snapshot recovered, confirmed lsn: %"
 			 PRIi64, r->confirmed_lsn);
@@ -338,6 +657,27 @@ error:
  * @retval 0 EOF
  * @retval 1 ok, maybe read something
  */
+static int
+wal_apply_row(struct recovery_state *r, struct tbuf *row)
+{
+	i64 lsn = header_v11(row)->lsn;
+	if (lsn <= r->confirmed_lsn) {
+		say_debug("skipping too young row");
+		return 0;
+	}
+	/*
+	 * After handler(row) returned, row may be
+	 * modified, do not use it.
+	 */
+	if (r->row_handler(r->row_handler_param, row) < 0) {
+		say_error("can't apply row");
+		if (r->wal_dir->panic_if_error)
+			return -1;
+	}
+	set_lsn(r, lsn);
+	return 0;
+}
+
 static int
 recover_wal(struct recovery_state *r, struct log_io *l)
 {
@@ -346,26 +686,9 @@ recover_wal(struct recovery_state *r, struct log_io *l)
 
 	log_io_cursor_open(&i, l);
 
-	struct tbuf *row = NULL;
-	while ((row = log_io_cursor_next(&i))) {
-		i64 lsn = header_v11(row)->lsn;
-		if (lsn <= r->confirmed_lsn) {
-			say_debug("skipping too young row");
-			continue;
-		}
-		/*
-		 * After handler(row) returned, row may be
-		 * modified, do not use it.
-		 */
-		if (r->row_handler(r->row_handler_param, row) < 0) {
-			say_error("can't apply row");
-			if (l->dir->panic_if_error)
-				goto end;
-		}
-		set_lsn(r, lsn);
-	}
-	res = i.eof_read ? LOG_EOF : 1;
-end:
+	if (recover_rows(r, &i, 1, wal_apply_row) == 0)
+		res = i.eof_read ? LOG_EOF : 1;
+
 	log_io_cursor_close(&i);
 	/* Sic: we don't close the log here. */
 	return res;
@@ -699,6 +1022,21 @@ struct wal_writer
 	pthread_cond_t cond;
 	ev_async write_event;
 	struct fio_batch *batch;
+	/**
+	 * Asynchronous I/O, NULL if not supported: the batch
+	 * being written is swapped with spare_batch, which is
+	 * filled in the meanwhile.
+	 */
+	struct fio_ring *ring;
+	struct fio_batch *spare_batch;
+	/**
+	 * Statistics, and the moving averages which size the
+	 * group of writes in fsync_group mode. Protected by
+	 * the mutex.
+	 */
+	struct wal_stat stat;
+	/** Moving average of time to write a batch, seconds. */
+	double write_time;
 	bool is_shutdown;
 	bool is_rollback;
 };
@@ -720,6 +1058,12 @@ wal_writer_child()
 		free(wal_writer.batch);
 		wal_writer.batch = NULL;
 	}
+	if (wal_writer.ring) {
+		fio_ring_atfork(wal_writer.ring);
+		wal_writer.ring = NULL;
+		free(wal_writer.spare_batch);
+		wal_writer.spare_batch = NULL;
+	}
 	/*
 	 * Make sure that atexit() handlers in the child do
 	 * not try to stop the non-existent thread.
@@ -818,6 +1162,9 @@ wal_writer_init(struct wal_writer *writer)
 	STAILQ_INIT(&writer->input);
 	STAILQ_INIT(&writer->commit);
 
+	memset(&writer->stat, 0, sizeof(writer->stat));
+	writer->write_time = 0;
+
 	ev_async_init(&writer->write_event, (void *)wal_schedule);
 	writer->write_event.data = writer;
 
@@ -827,6 +1174,18 @@ wal_writer_init(struct wal_writer *writer)
 
 	if (writer->batch == NULL)
 		panic_syserror("fio_batch_alloc");
+
+	/* A batch write and an fdatasync() are in flight at most. */
+	writer->ring = fio_ring_new(2);
+	if (writer->ring == NULL) {
+		say_info("WAL writer: io_uring is not available (%s),"
+			 " using writev()", strerror(errno));
+		return;
+	}
+	writer->spare_batch = fio_batch_alloc(sysconf(_SC_IOV_MAX));
+
+	if (writer->spare_batch == NULL)
+		panic_syserror("fio_batch_alloc");
 }
 
 /** Destroy a WAL writer structure. */
@@ -836,6 +1195,10 @@ wal_writer_destroy(struct wal_writer *writer)
 	(void) tt_pthread_mutex_destroy(&writer->mutex);
 	(void) tt_pthread_cond_destroy(&writer->cond);
 	free(writer->batch);
+	fio_ring_delete(writer->ring);
+	writer->ring = NULL;
+	free(writer->spare_batch);
+	writer->spare_batch = NULL;
 }
 
 /** WAL writer thread routine. */
@@ -909,7 +1272,8 @@ wal_writer_stop(struct recovery_state *r)
  * do. Loop in case of a spurious wakeup.
  */
 void
-wal_writer_pop(struct wal_writer *writer, struct wal_fifo *input)
+wal_writer_pop(struct recovery_state *r, struct wal_writer *writer,
+	       struct wal_fifo *input)
 {
 	while (! writer->is_shutdown)
 	{
@@ -917,6 +1281,13 @@ wal_writer_pop(struct wal_writer *writer, struct wal_fifo *input)
 			STAILQ_CONCAT(input, &writer->input);
 			break;
 		}
+		/* Prepare the next WAL while there is nothing to write. */
+		if (r->wal_dir->spare_size < r->wal_dir->prealloc_size) {
+			(void) tt_pthread_mutex_unlock(&writer->mutex);
+			log_dir_prealloc(r->wal_dir);
+			(void) tt_pthread_mutex_lock(&writer->mutex);
+			continue;
+		}
 		(void) tt_pthread_cond_wait(&writer->cond, &writer->mutex);
 	}
 }
@@ -982,19 +1353,30 @@ wal_opt_rotate(struct log_io **wal, int rows_per_wal, struct log_dir *dir, u64 l
 	return l ? 0 : -1;
 }
 
-static void
-wal_opt_sync(struct log_io *wal, double sync_delay)
+/** Check if it is time to sync the WAL, and if so, restart the timer. */
+static bool
+wal_sync_is_due(struct recovery_state *r)
 {
 	static ev_tstamp last_sync = 0;
 
-	if (sync_delay > 0 && ev_now() - last_sync >= sync_delay) {
+	if (r->wal_mode == WAL_FSYNC_DELAY && r->wal_fsync_delay > 0 &&
+	    ev_now() - last_sync >= r->wal_fsync_delay) {
+		last_sync = ev_now();
+		return true;
+	}
+	return false;
+}
+
+static void
+wal_opt_sync(struct log_io *wal, struct recovery_state *r)
+{
+	if (wal_sync_is_due(r)) {
 		/*
 		 * XXX: in case of error, we don't really know how
 		 * many records were not written to disk: probably
 		 * way more than the last one.
 		 */
 		(void) log_io_sync(wal);
-		last_sync = ev_now();
 	}
 }
 
@@ -1015,11 +1397,12 @@ wal_fill_batch(struct log_io *wal, struct fio_batch *batch, int rows_per_wal,
 	return req;
 }
 
+/** Mark the first rows_written requests of a batch as written. */
 static struct wal_write_request *
-wal_write_batch(struct log_io *wal, struct fio_batch *batch,
-		struct wal_write_request *req, struct wal_write_request *end)
+wal_batch_complete(struct log_io *wal, int rows_written,
+		   struct wal_write_request *req,
+		   struct wal_write_request *end)
 {
-	int rows_written = fio_batch_write(batch, fileno(wal->f));
 	wal->rows += rows_written;
 	while (req != end && rows_written-- != 0)  {
 		req->res = 0;
@@ -1028,6 +1411,122 @@ wal_write_batch(struct log_io *wal, struct fio_batch *batch,
 	return req;
 }
 
+static struct wal_write_request *
+wal_write_batch(struct log_io *wal, struct fio_batch *batch,
+		struct wal_write_request *req, struct wal_write_request *end)
+{
+	int rows_written = fio_batch_write(batch, fileno(wal->f));
+	return wal_batch_complete(wal, rows_written, req, end);
+}
+
+/**
+ * Whether a batch starting with the given LSN can go to the
+ * current WAL right away, while 'inflight' rows are still
+ * being written to it, i.e. wal_opt_rotate() would have
+ * nothing to do.
+ */
+static bool
+wal_can_append(struct log_io *wal, int rows_per_wal, int inflight, u64 lsn)
+{
+	return ! wal->is_inprogress && wal->rows + inflight < rows_per_wal &&
+		lsn % rows_per_wal != 0;
+}
+
+/** fio_ring_submit(), with error injections for tests. */
+static int
+wal_ring_submit(struct fio_ring *ring, struct fio_batch *batch,
+		int fd, off_t offset, bool sync)
+{
+	ERROR_INJECT_RETURN(ERRINJ_WAL_RING_SUBMIT);
+	/*
+	 * Make the kernel write a half of the last row: the
+	 * iovec is copied on submit, so restore it right away.
+	 */
+	struct iovec *last = &batch->iov[batch->rows - 1];
+	size_t len = last->iov_len;
+	ERROR_INJECT(ERRINJ_WAL_WRITE_PARTIAL, last->iov_len /= 2);
+	int rc = fio_ring_submit(ring, batch, fd, offset, sync);
+	last->iov_len = len;
+	return rc;
+}
+
+/**
+ * Same as wal_write_to_disk(), but with io_uring: submit the
+ * write of a batch, along with an fdatasync() if it's time
+ * for one, and fill and sign the next batch while the
+ * kernel writes the previous one.
+ */
+static void
+wal_ring_write_to_disk(struct recovery_state *r, struct wal_writer *writer,
+		       struct wal_fifo *input, struct wal_fifo *commit,
+		       struct wal_fifo *rollback)
+{
+	struct log_io **wal = &r->current_wal;
+	struct fio_ring *ring = writer->ring;
+	struct fio_batch *batch = writer->batch;
+	struct fio_batch *spare_batch = writer->spare_batch;
+
+	struct wal_write_request *req = STAILQ_FIRST(input);
+	struct wal_write_request *write_end = req;
+	/* Requests [write_end, inflight_end) are being written. */
+	struct wal_write_request *inflight_end = req;
+	int inflight = 0;
+	off_t offset = 0;
+
+	while (req) {
+		if (inflight != 0 &&
+		    ! wal_can_append(*wal, r->rows_per_wal, inflight,
+				     req->row.header.lsn)) {
+			inflight = 0;
+			write_end = wal_batch_complete(*wal, fio_ring_wait(ring),
+						       write_end, inflight_end);
+			if (write_end != inflight_end)
+				break;
+		}
+		if (inflight == 0) {
+			if (wal_opt_rotate(wal, r->rows_per_wal, r->wal_dir,
+					   req->row.header.lsn) != 0)
+				break;
+			offset = fio_lseek(fileno((*wal)->f), 0, SEEK_CUR);
+			if (offset < 0)
+				break;
+		}
+		struct wal_write_request *batch_end;
+		batch_end = wal_fill_batch(*wal, batch,
+					   r->rows_per_wal - inflight, req);
+		if (inflight != 0) {
+			inflight = 0;
+			write_end = wal_batch_complete(*wal, fio_ring_wait(ring),
+						       write_end, inflight_end);
+			if (write_end != inflight_end)
+				break;
+		}
+		bool sync = wal_sync_is_due(r);
+		if (wal_ring_submit(ring, batch, fileno((*wal)->f),
+				    offset, sync) != 0) {
+			/* Fall back to a synchronous write. */
+			write_end = wal_write_batch(*wal, batch, req, batch_end);
+			if (batch_end != write_end)
+				break;
+			if (sync)
+				(void) log_io_sync(*wal);
+		} else {
+			inflight = batch->rows;
+			inflight_end = batch_end;
+			offset += batch->bytes;
+			struct fio_batch *tmp = batch;
+			batch = spare_batch;
+			spare_batch = tmp;
+		}
+		req = batch_end;
+	}
+	if (inflight != 0)
+		write_end = wal_batch_complete(*wal, fio_ring_wait(ring),
+					       write_end, inflight_end);
+	STAILQ_SPLICE(input, write_end, wal_fifo_entry, rollback);
+	STAILQ_CONCAT(commit, input);
+}
+
 static void
 wal_write_to_disk(struct recovery_state *r, struct wal_writer *writer,
 		  struct wal_fifo *input, struct wal_fifo *commit,
@@ -1048,13 +1547,66 @@ wal_write_to_disk(struct recovery_state *r, struct wal_writer *writer,
 		write_end = wal_write_batch(*wal, batch, req, batch_end);
 		if (batch_end != write_end)
 			break;
-		wal_opt_sync(*wal, r->wal_fsync_delay);
+		wal_opt_sync(*wal, r);
 		req = write_end;
 	}
 	STAILQ_SPLICE(input, write_end, wal_fifo_entry, rollback);
 	STAILQ_CONCAT(commit, input);
 }
 
+/** A moving average which follows recent values closely enough. */
+static inline double
+wal_stat_avg(double avg, double value)
+{
+	return avg + (value - avg) / 8;
+}
+
+/**
+ * In fsync_group mode, decide whether to sync the group of
+ * writes done since the last sync now, or to write one more
+ * batch first. Sync right away if there is nothing else to
+ * write. Otherwise let the group grow while its oldest write
+ * can still complete within wal_fsync_delay, given how long
+ * a write and a sync take these days.
+ */
+static bool
+wal_group_sync_is_due(struct recovery_state *r, struct wal_writer *writer,
+		      ev_tstamp group_start)
+{
+	if (r->wal_mode != WAL_FSYNC_GROUP)
+		return true;
+
+	(void) tt_pthread_mutex_lock(&writer->mutex);
+	bool is_idle = STAILQ_EMPTY(&writer->input) || writer->is_shutdown;
+	double expected = writer->write_time + writer->stat.sync_time;
+	(void) tt_pthread_mutex_unlock(&writer->mutex);
+
+	return is_idle ||
+		ev_time() - group_start + expected >= r->wal_fsync_delay;
+}
+
+/**
+ * Sync the current WAL, so that the group of writes done
+ * since the last sync can commit. The WALs closed
+ * meanwhile have been synced on close.
+ *
+ * @return sync time, in seconds.
+ */
+static double
+wal_group_sync(struct recovery_state *r)
+{
+	ev_tstamp start = ev_time();
+	/*
+	 * XXX: in case of error, the rows are on disk
+	 * already, and there is no way to take them
+	 * back. Commit them all the same, like
+	 * wal_opt_sync() does.
+	 */
+	if (r->current_wal != NULL)
+		(void) log_io_sync(r->current_wal);
+	return ev_time() - start;
+}
+
 /** WAL writer thread main loop.  */
 static void *
 wal_writer_thread(void *worker_args)
@@ -1064,15 +1616,68 @@ wal_writer_thread(void *worker_args)
 	struct wal_fifo input = STAILQ_HEAD_INITIALIZER(input);
 	struct wal_fifo commit = STAILQ_HEAD_INITIALIZER(commit);
 	struct wal_fifo rollback = STAILQ_HEAD_INITIALIZER(rollback);
+	/*
+	 * In fsync_group mode, requests which are written but
+	 * not synced yet, and when the first of them was written.
+	 */
+	struct wal_fifo unsynced = STAILQ_HEAD_INITIALIZER(unsynced);
+	ev_tstamp group_start = 0;
 
 	(void) tt_pthread_mutex_lock(&writer->mutex);
 	while (! writer->is_shutdown) {
-		wal_writer_pop(writer, &input);
+		/*
+		 * Doesn't block while there are unsynced
+		 * requests: they are only left when there
+		 * is more input.
+		 */
+		wal_writer_pop(r, writer, &input);
 		(void) tt_pthread_mutex_unlock(&writer->mutex);
 
-		wal_write_to_disk(r, writer, &input, &commit, &rollback);
+		ev_tstamp start = ev_time();
+		if (STAILQ_EMPTY(&unsynced))
+			group_start = start;
+		struct wal_fifo *written = &commit;
+		if (r->wal_mode == WAL_FSYNC_GROUP)
+			written = &unsynced;
+		if (writer->ring != NULL)
+			wal_ring_write_to_disk(r, writer, &input,
+					       written, &rollback);
+		else
+			wal_write_to_disk(r, writer, &input,
+					  written, &rollback);
+		double write_time = ev_time() - start;
+		double sync_time = -1;
+		if (! STAILQ_EMPTY(&unsynced) &&
+		    (! STAILQ_EMPTY(&rollback) ||
+		     wal_group_sync_is_due(r, writer, group_start))) {
+			sync_time = wal_group_sync(r);
+			/*
+			 * Keep the LSN order if the mode has
+			 * changed and 'commit' isn't empty.
+			 */
+			STAILQ_CONCAT(&unsynced, &commit);
+			STAILQ_CONCAT(&commit, &unsynced);
+		}
+		int rows = 0;
+		struct wal_write_request *req;
+		STAILQ_FOREACH(req, &commit, wal_fifo_entry)
+			rows++;
 
 		(void) tt_pthread_mutex_lock(&writer->mutex);
+		struct wal_stat *stat = &writer->stat;
+		writer->write_time = wal_stat_avg(writer->write_time,
+						  write_time);
+		if (sync_time >= 0) {
+			stat->syncs++;
+			stat->sync_time = wal_stat_avg(stat->sync_time,
+						       sync_time);
+			if (sync_time > stat->sync_time_max)
+				stat->sync_time_max = sync_time;
+		}
+		if (rows > 0) {
+			stat->batches++;
+			stat->batch_size = wal_stat_avg(stat->batch_size, rows);
+		}
 		STAILQ_CONCAT(&writer->commit, &commit);
 		if (! STAILQ_EMPTY(&rollback)) {
 			/*
@@ -1085,11 +1690,18 @@ wal_writer_thread(void *worker_args)
 			STAILQ_CONCAT(&rollback, &writer->input);
 			STAILQ_CONCAT(&writer->input, &rollback);
 		}
-		ev_async_send(&writer->write_event);
+		if (! STAILQ_EMPTY(&writer->commit) || writer->is_rollback)
+			ev_async_send(&writer->write_event);
 	}
 	(void) tt_pthread_mutex_unlock(&writer->mutex);
+	/* Closing the WAL syncs it. */
 	if (r->current_wal != NULL)
 		log_io_close(&r->current_wal);
+	if (! STAILQ_EMPTY(&unsynced)) {
+		(void) tt_pthread_mutex_lock(&writer->mutex);
+		STAILQ_CONCAT(&writer->commit, &unsynced);
+		(void) tt_pthread_mutex_unlock(&writer->mutex);
+	}
 	return NULL;
 }
 
@@ -1102,6 +1714,9 @@ wal_write(struct recovery_state *r, i64 lsn, u64 cookie,
 	  u16 op, struct tbuf *row)
 {
 	say_debug("wal_write lsn=%" PRIi64, lsn);
+	/* Hold the request as if the disk were slow. */
+	ERROR_INJECT(ERRINJ_WAL_DELAY,
+		     while (errinj_get(ERRINJ_WAL_DELAY)) fiber_sleep(0.01));
 	ERROR_INJECT_RETURN(ERRINJ_WAL_IO);
 
 	if (r->wal_mode == WAL_NONE)
@@ -1133,10 +1748,45 @@ wal_write(struct recovery_state *r, i64 lsn, u64 cookie,
 	return req->res;
 }
 
+void
+recovery_wal_stat(struct recovery_state *r, struct wal_stat *stat)
+{
+	struct wal_writer *writer = r->writer;
+	if (writer == NULL) {
+		memset(stat, 0, sizeof(*stat));
+		return;
+	}
+	(void) tt_pthread_mutex_lock(&writer->mutex);
+	*stat = writer->stat;
+	(void) tt_pthread_mutex_unlock(&writer->mutex);
+}
+
 /* }}} */
 
 /* {{{ SAVE SNAPSHOT and tarantool_box --cat */
 
+enum { SNAP_BUF_SIZE = 128 * 1024 };
+
+/**
+ * The snapshot file being written by this thread. It's written
+ * either by a forked child, with rows allocated on the fiber
+ * pool, or by a thread other than the main one, with rows
+ * stored in 'buf'.
+ */
+static __thread struct {
+	int rows;
+	int bytes;
+	ev_tstamp last;
+	/** The number of files written at once, sharing the I/O rate. */
+	int writers;
+	/** Rows of the current batch, NULL in a forked child. */
+	char *buf;
+	size_t buf_size;
+	size_t buf_used;
+	/** errno of a failed write in the thread, 0 if none. */
+	int error;
+} snap_writer;
+
 static void
 snap_write_batch(struct fio_batch *batch, int fd)
 {
@@ -1144,23 +1794,65 @@ snap_write_batch(struct fio_batch *batch, int fd)
 	if (rows_written != batch->rows) {
 		say_error("partial write: %d out of %d rows",
 			  rows_written, batch->rows);
-		panic_syserror("fio_batch_write");
+		if (snap_writer.buf == NULL)
+			panic_syserror("fio_batch_write");
+		/* Can't panic in the thread: give up the snapshot. */
+		say_syserror("fio_batch_write");
+		snap_writer.error = errno ? errno : EIO;
 	}
 }
 
+static void
+snap_flush_batch(struct log_io *l, struct fio_batch *batch)
+{
+	snap_write_batch(batch, fileno(l->f));
+	fio_batch_start(batch, INT_MAX);
+	if (snap_writer.buf == NULL)
+		prelease_after(fiber->gc_pool, SNAP_BUF_SIZE);
+	else
+		snap_writer.buf_used = 0;
+}
+
+static struct row_v11 *
+snap_alloc_row(struct log_io *l, struct fio_batch *batch, size_t size)
+{
+	if (snap_writer.buf == NULL)
+		return palloc(fiber->gc_pool, size);
+
+	if (snap_writer.buf_used + size > snap_writer.buf_size) {
+		if (batch->rows)
+			snap_flush_batch(l, batch);
+		if (size > snap_writer.buf_size) {
+			char *buf = realloc(snap_writer.buf, size);
+			if (buf == NULL) {
+				snap_writer.error = ENOMEM;
+				return NULL;
+			}
+			snap_writer.buf = buf;
+			snap_writer.buf_size = size;
+		}
+	}
+	struct row_v11 *row = (struct row_v11 *)
+		(snap_writer.buf + snap_writer.buf_used);
+	snap_writer.buf_used += size;
+	return row;
+}
+
 void
 snapshot_write_row(struct log_io *l, struct fio_batch *batch,
 		   const void *metadata, size_t metadata_len,
 		   const void *data, size_t data_len)
 {
-	static int rows;
-	static int bytes;
 	ev_tstamp elapsed;
-	static ev_tstamp last = 0;
 
-	struct row_v11 *row = palloc(fiber->gc_pool,
-				     sizeof(struct row_v11) +
-				     data_len + metadata_len);
+	if (snap_writer.error)
+		return;
+
+	struct row_v11 *row = snap_alloc_row(l, batch,
+					     sizeof(struct row_v11) +
+					     data_len + metadata_len);
+	if (row == NULL)
+		return;
 
 	row_v11_fill(row, 0, SNAP, snapshot_cookie,
 		     metadata, metadata_len, data, data_len);
@@ -1168,31 +1860,27 @@ snapshot_write_row(struct log_io *l, struct fio_batch *batch,
 
 	fio_batch_add(batch, row, row_v11_size(row));
 
-	if (++rows % 100000 == 0)
-		say_crit("%.1fM rows written", rows / 1000000.);
+	if (++snap_writer.rows % 100000 == 0)
+		say_crit("%.1fM rows written", snap_writer.rows / 1000000.);
 
-	if (fio_batch_is_full(batch)) {
-		snap_write_batch(batch, fileno(l->f));
-		fio_batch_start(batch, INT_MAX);
-		prelease_after(fiber->gc_pool, 128 * 1024);
-	}
+	if (fio_batch_is_full(batch))
+		snap_flush_batch(l, batch);
 
-	if (recovery_state->snap_io_rate_limit > 0) {
-		if (last == 0) {
-			ev_now_update();
-			last = ev_now();
-		}
-		bytes += row_v11_size(row);
-		while (bytes >= recovery_state->snap_io_rate_limit) {
+	int rate_limit = recovery_state->snap_io_rate_limit /
+		MAX(snap_writer.writers, 1);
+	if (rate_limit > 0) {
+		/* ev_now() is not available in a thread. */
+		if (snap_writer.last == 0)
+			snap_writer.last = ev_time();
+		snap_writer.bytes += row_v11_size(row);
+		while (snap_writer.bytes >= rate_limit) {
 
-			ev_now_update();
-			elapsed = ev_now() - last;
+			elapsed = ev_time() - snap_writer.last;
 			if (elapsed < 1)
 				usleep(((1 - elapsed) * 1000000));
 
-			ev_now_update();
-			last = ev_now();
-			bytes -= recovery_state->snap_io_rate_limit;
+			snap_writer.last = ev_time();
+			snap_writer.bytes -= rate_limit;
 		}
 	}
 }
@@ -1202,6 +1890,7 @@ snapshot_save(struct recovery_state *r,
 	      void (*f) (struct log_io *, struct fio_batch *))
 {
 	struct log_io *snap;
+	memset(&snap_writer, 0, sizeof(snap_writer));
 	snap = log_io_open_for_write(r->snap_dir, r->confirmed_lsn,
 				     INPROGRESS);
 	if (snap == NULL)
@@ -1229,9 +1918,207 @@ snapshot_save(struct recovery_state *r,
 	say_info("done");
 }
 
+/**
+ * Write the rows of a snapshot file, or of a segment of it,
+ * in a thread other than the main one. Leaves the file open.
+ *
+ * @return 0 on success, errno value otherwise.
+ */
+static int
+snapshot_write_file(struct log_io *l, snapshot_segment_f f,
+		    int segment, int segments)
+{
+	memset(&snap_writer, 0, sizeof(snap_writer));
+	snap_writer.writers = segments;
+	snap_writer.buf_size = SNAP_BUF_SIZE;
+	snap_writer.buf = malloc(snap_writer.buf_size);
+	struct fio_batch *batch = fio_batch_alloc(sysconf(_SC_IOV_MAX));
+	if (snap_writer.buf == NULL || batch == NULL) {
+		snap_writer.error = ENOMEM;
+	} else {
+		fio_batch_start(batch, INT_MAX);
+		f(l, batch, segment, segments);
+		if (batch->rows && snap_writer.error == 0)
+			snap_write_batch(batch, fileno(l->f));
+	}
+	free(batch);
+	free(snap_writer.buf);
+	snap_writer.buf = NULL;
+	return snap_writer.error;
+}
+
+/** Segments of a snapshot, shared by the threads writing them. */
+struct snap_segments {
+	struct log_dir *dir;
+	i64 lsn;
+	int count;
+	snapshot_segment_f f;
+	/** The next segment to write, advanced atomically. */
+	int next;
+	/** errno of the first segment failed, the rest are dropped. */
+	int error;
+};
+
+static void *
+snap_segments_run(void *arg)
+{
+	struct snap_segments *s = arg;
+	int i;
+	while (s->error == 0 &&
+	       (i = __sync_fetch_and_add(&s->next, 1)) < s->count) {
+		struct log_io *l = log_io_open_segment_for_write(s->dir,
+								 s->lsn, i);
+		int error = l == NULL ? errno :
+			snapshot_write_file(l, s->f, i, s->count);
+		if (error == 0) {
+			/* Syncs and renames the segment. */
+			log_io_close(&l);
+			continue;
+		}
+		if (l != NULL) {
+			inprogress_log_unlink(l->filename);
+			log_io_atfork(&l);
+		}
+		__sync_bool_compare_and_swap(&s->error, 0, error);
+		break;
+	}
+	return NULL;
+}
+
+/**
+ * Write the segments of a snapshot in a pool of threads, the
+ * calling thread included, and then close the manifest, which
+ * makes the snapshot complete. Removes the segments written in
+ * case of error.
+ *
+ * @return 0 on success, errno value otherwise.
+ */
+static int
+snapshot_write_segments(struct log_io *manifest, i64 lsn,
+			snapshot_segment_f f)
+{
+	struct snap_segments s = {
+		.dir = manifest->dir, .lsn = lsn,
+		.count = manifest->segments, .f = f
+	};
+
+	pthread_t threads[s.count];
+	int n_started = 0;
+	while (n_started < s.count - 1 &&
+	       tt_pthread_create(&threads[n_started], NULL,
+				 snap_segments_run, &s) == 0)
+		n_started++;
+	snap_segments_run(&s);
+	for (int t = 0; t < n_started; t++)
+		tt_pthread_join(threads[t], NULL);
+
+	if (s.error == 0) {
+		log_io_close(&manifest);
+		return 0;
+	}
+	for (int i = 0; i < s.count; i++)
+		unlink(format_segment_filename(s.dir, lsn, i, NONE));
+	inprogress_log_unlink(manifest->filename);
+	log_io_atfork(&manifest);
+	return s.error;
+}
+
+int
+snapshot_save_segments(struct recovery_state *r, int segments,
+		       snapshot_segment_f f)
+{
+	i64 lsn = r->confirmed_lsn;
+	struct log_io *manifest =
+		log_io_open_manifest_for_write(r->snap_dir, lsn, segments);
+	if (manifest == NULL)
+		return -1;
+
+	say_info("saving snapshot `%s' in %d segments",
+		 format_filename(r->snap_dir, lsn, NONE), segments);
+	int error = snapshot_write_segments(manifest, lsn, f);
+	if (error != 0) {
+		errno = error;
+		say_syserror("Failed to save snapshot");
+		return -1;
+	}
+	say_info("done");
+	return 0;
+}
+
+static ssize_t
+snapshot_save_read_view_cb(va_list ap)
+{
+	struct log_io *snap = va_arg(ap, struct log_io *);
+	i64 lsn = va_arg(ap, i64);
+	snapshot_segment_f f = va_arg(ap, snapshot_segment_f);
+	int *error = va_arg(ap, int *);
+
+	if (snap->segments > 0) {
+		*error = snapshot_write_segments(snap, lsn, f);
+	} else {
+		*error = snapshot_write_file(snap, f, 0, 1);
+		if (*error == 0) {
+			/* Syncs the file, so let it happen in the thread too. */
+			log_io_close(&snap);
+		} else {
+			inprogress_log_unlink(snap->filename);
+			log_io_atfork(&snap);
+		}
+	}
+	return *error == 0 ? 0 : -1;
+}
+
+int
+snapshot_save_read_view(struct recovery_state *r, int segments,
+			snapshot_segment_f f)
+{
+	i64 lsn = r->confirmed_lsn;
+	struct log_io *snap;
+	if (segments > 1)
+		snap = log_io_open_manifest_for_write(r->snap_dir, lsn,
+						      segments);
+	else
+		snap = log_io_open_for_write(r->snap_dir, lsn, INPROGRESS);
+	if (snap == NULL)
+		return -1;
+
+	say_info("saving snapshot `%s' from a read view",
+		 format_filename(r->snap_dir, lsn, NONE));
+	int error = 0;
+	if (coeio_custom(snapshot_save_read_view_cb, TIMEOUT_INFINITY,
+			 snap, lsn, f, &error) == -1) {
+		if (error == 0) {
+			/* The callback hasn't run. */
+			error = errno;
+			inprogress_log_unlink(snap->filename);
+			log_io_atfork(&snap);
+		}
+		errno = error;
+		say_syserror("Failed to save snapshot");
+		return -1;
+	}
+	say_info("done");
+	return 0;
+}
+
+/** Invoke a callback on every record of an open log file. */
+static void
+read_log_rows(struct log_io *l, row_handler *h, void *param)
+{
+	struct log_io_cursor i;
+
+	log_io_cursor_open(&i, l);
+	struct tbuf *row;
+	while ((row = log_io_cursor_next(&i)))
+		h(param, row);
+
+	log_io_cursor_close(&i);
+}
+
 /**
  * Read WAL/SNAPSHOT and invoke a callback on every record (used
- * for --cat command line option).
+ * for --cat command line option). The records of a snapshot
+ * saved in segments are read from its segment files in turn.
  * @retval 0  success
  * @retval -1 error
  */
@@ -1257,15 +2144,24 @@ read_log(const char *filename,
 
 	FILE *f = fopen(filename, "r");
 	struct log_io *l = log_io_open(dir, LOG_READ, filename, NONE, f);
-	struct log_io_cursor i;
-
-	log_io_cursor_open(&i, l);
-	struct tbuf *row;
-	while ((row = log_io_cursor_next(&i)))
-		h(param, row);
-
-	log_io_cursor_close(&i);
+	if (l == NULL)
+		return -1;
+	int segments = l->segments;
+	read_log_rows(l, h, param);
 	log_io_close(&l);
+
+	for (int segment = 0; segment < segments; segment++) {
+		/* Segment files lie next to the manifest. */
+		char segment_filename[PATH_MAX + 1];
+		snprintf(segment_filename, sizeof(segment_filename),
+			 "%s.%d", filename, segment);
+		f = fopen(segment_filename, "r");
+		l = log_io_open(dir, LOG_READ, segment_filename, NONE, f);
+		if (l == NULL)
+			return -1;
+		read_log_rows(l, h, param);
+		log_io_close(&l);
+	}
 	return 0;
 }
 
@@ -647,6 +647,8 @@ replication_relay_loop(int client_sock)
 	recovery_init(cfg.snap_dir, cfg.wal_dir,
 		      replication_relay_send_row, (void *)(intptr_t) client_sock,
 		      INT32_MAX, RECOVER_READONLY);
+	/* The current WAL may have preallocated space at the end. */
+	recovery_setup_wal_prealloc(recovery_state, cfg.wal_prealloc_size);
 	/*
 	 * Note that recovery starts with lsn _NEXT_ to
 	 * the confirmed one.
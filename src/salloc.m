@@ -33,7 +33,9 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/mman.h>
 
 #include "third_party/valgrind/memcheck.h"
@@ -55,6 +57,8 @@ uint8_t red_zone[0] = { };
 static const uint32_t SLAB_MAGIC = 0x51abface;
 static const size_t SLAB_SIZE = 1 << 22;
 static const size_t MAX_SLAB_ITEM = 1 << 20;
+/** Allocations up to this size are counted in size_hist. */
+#define SLAB_HIST_MAX 4096
 
 struct slab_item {
 	struct slab_item *next;
@@ -71,6 +75,8 @@ struct slab {
 	SLIST_ENTRY(slab) free_link;
 	TAILQ_ENTRY(slab) cache_free_link;
 	TAILQ_ENTRY(slab) cache_link;
+	/** The last defragmentation round which visited the slab. */
+	uint32_t defrag_round;
 };
 
 SLIST_HEAD(slab_slist_head, slab);
@@ -79,6 +85,9 @@ TAILQ_HEAD(slab_tailq_head, slab);
 struct slab_cache {
 	size_t item_size;
 	struct slab_tailq_head slabs, free_slabs;
+	/** Allocations from the cache and bytes they asked for. */
+	u64 allocs;
+	u64 requested;
 };
 
 struct arena {
@@ -88,13 +97,43 @@ struct arena {
 	void *base;
 	size_t size;
 	size_t used;
+	enum slab_arena_pages pages;
 	struct slab_slist_head slabs, free_slabs;
 };
 
+STRS(slab_arena_pages, SLAB_ARENA_PAGES);
+
 static uint32_t slab_active_caches;
 static struct slab_cache slab_caches[256];
+/**
+ * Caches sorted by item size. Classes added by salloc_adapt()
+ * are appended to slab_caches, since slabs point to their cache.
+ */
+static struct slab_cache *slab_cache_order[256];
+/**
+ * The number of allocations of every size, in units of item
+ * alignment, including the red zone.
+ */
+static u64 size_hist[SLAB_HIST_MAX / sizeof(void *) + 1];
 static struct arena arena;
 
+char *salloc_ref_base;
+int salloc_ref_shift;
+
+/** The state of slab defragmentation, see salloc_defrag_begin(). */
+static struct {
+	/** The slab being evacuated, NULL when it's empty. */
+	struct slab *slab;
+	/** A bitmap of free items of the slab. */
+	uint8_t *free_map;
+	/** The number of formatted items of the slab. */
+	size_t n_items;
+	/** The number of the next item to return. */
+	size_t item_no;
+	/** Every slab is tried at most once per round. */
+	uint32_t round;
+} defrag = { .round = 1 };
+
 static struct slab *
 slab_header(void *ptr)
 {
@@ -108,28 +147,71 @@ slab_caches_init(size_t minimal, double factor)
 {
 	uint32_t i;
 	size_t size;
-	const size_t ptr_size = sizeof(void *);
+	/* Keep all items aligned for salloc_ptr_to_ref(). */
+	const size_t align = (size_t) 1 << salloc_ref_shift;
 
-	for (i = 0, size = minimal; i < nelem(slab_caches) && size <= MAX_SLAB_ITEM; i++) {
+	for (i = 0, size = TYPEALIGN(align, minimal);
+	     i < nelem(slab_caches) && size <= MAX_SLAB_ITEM; i++) {
+		memset(&slab_caches[i], 0, sizeof(slab_caches[i]));
 		slab_caches[i].item_size = size - sizeof(red_zone);
+		TAILQ_INIT(&slab_caches[i].slabs);
 		TAILQ_INIT(&slab_caches[i].free_slabs);
+		slab_cache_order[i] = &slab_caches[i];
 
-		size = MAX((size_t)(size * factor) & ~(ptr_size - 1),
-			   (size + ptr_size) & ~(ptr_size - 1));
+		size = MAX((size_t)(size * factor) & ~(align - 1),
+			   (size + align) & ~(align - 1));
 	}
 
 	slab_active_caches = i;
+	memset(size_hist, 0, sizeof(size_hist));
+}
+
+/**
+ * Map the arena memory. With @a huge_pages, try explicit huge
+ * pages first: they need to be reserved in vm.nr_hugepages, so
+ * fall back to regular pages which the kernel may collapse into
+ * transparent huge pages.
+ */
+static void *
+arena_mmap(struct arena *arena, bool huge_pages)
+{
+	void *ptr;
+	arena->pages = NORMAL;
+#ifdef MAP_HUGETLB
+	if (huge_pages) {
+		ptr = mmap(NULL, arena->mmap_size, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED) {
+			arena->pages = HUGETLB;
+			return ptr;
+		}
+		say_syserror("mmap(MAP_HUGETLB), falling back to "
+			     "transparent huge pages");
+	}
+#endif
+	ptr = mmap(NULL, arena->mmap_size,
+		   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED || !huge_pages)
+		return ptr;
+#ifdef MADV_HUGEPAGE
+	if (madvise(ptr, arena->mmap_size, MADV_HUGEPAGE) == 0)
+		arena->pages = TRANSPARENT;
+	else
+		say_syserror("madvise(MADV_HUGEPAGE)");
+#else
+	say_warn("huge pages are not supported on this platform");
+#endif
+	return ptr;
 }
 
 static bool
-arena_init(struct arena *arena, size_t size)
+arena_init(struct arena *arena, size_t size, bool huge_pages)
 {
 	arena->used = 0;
 	arena->size = size - size % SLAB_SIZE;
 	arena->mmap_size = size - size % SLAB_SIZE + SLAB_SIZE;	/* spend SLAB_SIZE bytes on align :-( */
 
-	arena->mmap_base = mmap(NULL, arena->mmap_size,
-				PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	arena->mmap_base = arena_mmap(arena, huge_pages);
 	if (arena->mmap_base == MAP_FAILED) {
 		say_syserror("mmap");
 		return false;
@@ -157,14 +239,23 @@ arena_alloc(struct arena *arena)
 }
 
 bool
-salloc_init(size_t size, size_t minimal, double factor)
+salloc_init(size_t size, size_t minimal, double factor, bool huge_pages)
 {
 	if (size < SLAB_SIZE * 2)
 		return false;
 
-	if (!arena_init(&arena, size))
+	if (!arena_init(&arena, size, huge_pages))
 		return false;
 
+	/*
+	 * Choose the alignment of items so that an offset of any
+	 * item in the arena fits in a 32-bit reference.
+	 */
+	salloc_ref_base = arena.base;
+	salloc_ref_shift = __builtin_ctz(sizeof(void *));
+	while ((arena.size >> salloc_ref_shift) > UINT32_MAX)
+		salloc_ref_shift++;
+
 	slab_caches_init(MAX(sizeof(void *), minimal), factor);
 	return true;
 }
@@ -176,6 +267,15 @@ salloc_free(void)
 		munmap(arena.mmap_base, arena.mmap_size);
 
 	memset(&arena, 0, sizeof(struct arena));
+	salloc_ref_base = NULL;
+}
+
+/** The first item of a slab. */
+static void *
+slab_items(struct slab *slab)
+{
+	void *items = (void *)CACHEALIGN((void *)slab + sizeof(struct slab));
+	return (void *)TYPEALIGN((size_t) 1 << salloc_ref_shift, items);
 }
 
 static void
@@ -188,7 +288,8 @@ format_slab(struct slab_cache *cache, struct slab *slab)
 	slab->cache = cache;
 	slab->items = 0;
 	slab->used = 0;
-	slab->brk = (void *)CACHEALIGN((void *)slab + sizeof(struct slab));
+	slab->brk = slab_items(slab);
+	slab->defrag_round = 0;
 
 	TAILQ_INSERT_HEAD(&cache->slabs, slab, cache_link);
 	TAILQ_INSERT_HEAD(&cache->free_slabs, slab, cache_free_link);
@@ -218,8 +319,8 @@ static struct slab_cache *
 cache_for(size_t size)
 {
 	for (uint32_t i = 0; i < slab_active_caches; i++)
-		if (slab_caches[i].item_size >= size)
-			return &slab_caches[i];
+		if (slab_cache_order[i]->item_size >= size)
+			return slab_cache_order[i];
 
 	return NULL;
 }
@@ -295,6 +396,13 @@ salloc(size_t size, const char *what)
 	slab->used += cache->item_size + sizeof(red_zone);
 	slab->items += 1;
 
+	cache->allocs++;
+	cache->requested += size;
+	size_t stride = TYPEALIGN((size_t) 1 << salloc_ref_shift,
+				  size + sizeof(red_zone));
+	if (stride <= SLAB_HIST_MAX)
+		size_hist[stride >> salloc_ref_shift]++;
+
 	VALGRIND_MALLOCLIKE_BLOCK(item, cache->item_size, sizeof(red_zone), 0);
 	return (void *)item;
 }
@@ -308,19 +416,30 @@ sfree(void *ptr)
 	struct slab_cache *cache = slab->cache;
 	struct slab_item *item = ptr;
 
-	if (fully_formatted(slab) && slab->free == NULL)
+	/* The slab being defragmented is hidden from salloc(). */
+	bool hidden = slab == defrag.slab;
+	if (fully_formatted(slab) && slab->free == NULL && !hidden)
 		TAILQ_INSERT_TAIL(&cache->free_slabs, slab, cache_free_link);
 
 	assert(valid_item(slab, item));
 	assert(slab->free == NULL || valid_item(slab, slab->free));
 
+	if (hidden) {
+		size_t item_no = ((void *)item - slab_items(slab)) /
+			(cache->item_size + sizeof(red_zone));
+		defrag.free_map[item_no / CHAR_BIT] |= 1 << item_no % CHAR_BIT;
+	}
+
 	item->next = slab->free;
 	slab->free = item;
 	slab->used -= cache->item_size + sizeof(red_zone);
 	slab->items -= 1;
 
 	if (slab->items == 0) {
-		TAILQ_REMOVE(&cache->free_slabs, slab, cache_free_link);
+		if (hidden)
+			defrag.slab = NULL;
+		else
+			TAILQ_REMOVE(&cache->free_slabs, slab, cache_free_link);
 		TAILQ_REMOVE(&cache->slabs, slab, cache_link);
 		SLIST_INSERT_HEAD(&arena.free_slabs, slab, free_link);
 	}
@@ -328,6 +447,199 @@ sfree(void *ptr)
 	VALGRIND_FREELIKE_BLOCK(item, sizeof(red_zone));
 }
 
+/*
+ * An item is numbered by its slab in the arena and its position
+ * in the slab. Items are at least sizeof(void *) long, which
+ * bounds the number of items in a slab.
+ */
+size_t
+salloc_ptr_to_index(void *ptr)
+{
+	struct slab *slab = slab_header(ptr);
+	struct slab_cache *cache = slab->cache;
+	assert(valid_item(slab, ptr));
+
+	size_t item_no = (ptr - slab_items(slab)) /
+		(cache->item_size + sizeof(red_zone));
+	size_t slab_no = ((void *)slab - arena.base) / SLAB_SIZE;
+	size_t index = slab_no * (SLAB_SIZE / sizeof(void *)) + item_no;
+
+	assert(salloc_ptr_from_index(index) == ptr);
+	return index;
+}
+
+void *
+salloc_ptr_from_index(size_t index)
+{
+	size_t slab_no = index / (SLAB_SIZE / sizeof(void *));
+	size_t item_no = index % (SLAB_SIZE / sizeof(void *));
+
+	struct slab *slab = slab_header(arena.base + slab_no * SLAB_SIZE);
+	struct slab_cache *cache = slab->cache;
+	void *item = slab_items(slab) +
+		item_no * (cache->item_size + sizeof(red_zone));
+	assert(valid_item(slab, item));
+	return item;
+}
+
+/** The number of items a slab of its size class can hold. */
+static size_t
+slab_capacity(struct slab *slab)
+{
+	return ((void *)slab + SLAB_SIZE - slab_items(slab)) /
+		(slab->cache->item_size + sizeof(red_zone));
+}
+
+/*
+ * Pick the least used slab among the slabs which are used less
+ * than the threshold and not visited in this round yet. Moving
+ * its items out must not take new slabs: the other slabs of the
+ * size class must have room for them.
+ */
+bool
+salloc_defrag_begin(double threshold)
+{
+	assert(defrag.slab == NULL && defrag.free_map == NULL);
+	struct slab *victim = NULL;
+	double victim_usage = threshold;
+
+	for (uint32_t i = 0; i < slab_active_caches; i++) {
+		struct slab_cache *cache = &slab_caches[i];
+		struct slab *slab, *least = NULL;
+		size_t slabs = 0, items = 0;
+
+		TAILQ_FOREACH(slab, &cache->slabs, cache_link) {
+			slabs++;
+			items += slab->items;
+			if (slab->defrag_round != defrag.round &&
+			    (least == NULL || slab->items < least->items))
+				least = slab;
+		}
+		if (least == NULL)
+			continue;
+		size_t capacity = slab_capacity(least);
+		double usage = (double) least->items / capacity;
+		size_t room = (slabs - 1) * capacity - (items - least->items);
+		if (usage < victim_usage && room >= least->items) {
+			victim = least;
+			victim_usage = usage;
+		}
+	}
+	if (victim == NULL) {
+		/* Everything is visited, start a new round. */
+		defrag.round++;
+		return false;
+	}
+
+	size_t stride = victim->cache->item_size + sizeof(red_zone);
+	defrag.n_items = (victim->brk - slab_items(victim)) / stride;
+	defrag.free_map = calloc(defrag.n_items / CHAR_BIT + 1, 1);
+	if (defrag.free_map == NULL)
+		return false;
+
+	struct slab_item *item = victim->free;
+	while (item != NULL) {
+		size_t item_no = ((void *)item - slab_items(victim)) / stride;
+		defrag.free_map[item_no / CHAR_BIT] |= 1 << item_no % CHAR_BIT;
+		(void) VALGRIND_MAKE_MEM_DEFINED(item, sizeof(void *));
+		struct slab_item *next = item->next;
+		(void) VALGRIND_MAKE_MEM_UNDEFINED(item, sizeof(void *));
+		item = next;
+	}
+
+	victim->defrag_round = defrag.round;
+	defrag.item_no = 0;
+	defrag.slab = victim;
+	/*
+	 * A sparse slab always has free items, and so is in the
+	 * list of slabs to allocate from: hide it from salloc().
+	 */
+	assert(!fully_formatted(victim) || victim->free != NULL);
+	TAILQ_REMOVE(&victim->cache->free_slabs, victim, cache_free_link);
+	return true;
+}
+
+void *
+salloc_defrag_next(void)
+{
+	struct slab *slab = defrag.slab;
+	if (slab == NULL)
+		return NULL;
+
+	while (defrag.item_no < defrag.n_items) {
+		size_t item_no = defrag.item_no++;
+		if (defrag.free_map[item_no / CHAR_BIT] &
+		    (1 << item_no % CHAR_BIT))
+			continue;
+		return slab_items(slab) + item_no *
+			(slab->cache->item_size + sizeof(red_zone));
+	}
+	return NULL;
+}
+
+bool
+salloc_defrag_end(void)
+{
+	struct slab *slab = defrag.slab;
+	/* Put a slab which still has items back in use. */
+	if (slab != NULL)
+		TAILQ_INSERT_TAIL(&slab->cache->free_slabs, slab,
+				  cache_free_link);
+	bool released = slab == NULL && defrag.free_map != NULL;
+	free(defrag.free_map);
+	defrag.free_map = NULL;
+	defrag.slab = NULL;
+	return released;
+}
+
+/*
+ * A size is given its own class if at least 1/SLAB_ADAPT_SHARE
+ * of allocations ask for it and the best fitting class wastes
+ * more than 1/SLAB_ADAPT_WASTE of its items on it.
+ */
+enum { SLAB_ADAPT_SHARE = 64, SLAB_ADAPT_WASTE = 8 };
+
+/** Add a size class and keep slab_cache_order sorted. */
+static void
+slab_cache_add(size_t item_size)
+{
+	assert(slab_active_caches < nelem(slab_caches));
+	struct slab_cache *cache = &slab_caches[slab_active_caches];
+	memset(cache, 0, sizeof(*cache));
+	cache->item_size = item_size;
+	TAILQ_INIT(&cache->slabs);
+	TAILQ_INIT(&cache->free_slabs);
+
+	uint32_t i = slab_active_caches++;
+	for (; i > 0 && slab_cache_order[i - 1]->item_size > item_size; i--)
+		slab_cache_order[i] = slab_cache_order[i - 1];
+	slab_cache_order[i] = cache;
+}
+
+int
+salloc_adapt(void)
+{
+	u64 total = 0;
+	for (size_t i = 0; i < nelem(size_hist); i++)
+		total += size_hist[i];
+
+	int added = 0;
+	for (size_t i = 1; i < nelem(size_hist) &&
+	     slab_active_caches < nelem(slab_caches); i++) {
+		if (size_hist[i] == 0 || size_hist[i] * SLAB_ADAPT_SHARE < total)
+			continue;
+		size_t item_size = (i << salloc_ref_shift) - sizeof(red_zone);
+		struct slab_cache *cache = cache_for(item_size);
+		if (cache != NULL && (cache->item_size - item_size) *
+		    SLAB_ADAPT_WASTE <= cache->item_size)
+			continue;
+		slab_cache_add(item_size);
+		added++;
+	}
+	if (added > 0)
+		say_info("salloc: added %i size classes", added);
+	return added;
+}
 
 /**
  * Collect slab allocator statistics.
@@ -343,6 +655,7 @@ salloc_stat(salloc_stat_cb cb, struct slab_arena_stats *astat, void *cb_ctx)
 	if (astat) {
 		astat->used = arena.used;
 		astat->size = arena.size;
+		astat->pages = arena.pages;
 	}
 
 	if (cb) {
@@ -350,8 +663,9 @@ salloc_stat(salloc_stat_cb cb, struct slab_arena_stats *astat, void *cb_ctx)
 		struct slab_cache_stats st;
 
 		for (int i = 0; i < slab_active_caches; i++) {
+			struct slab_cache *cache = slab_cache_order[i];
 			memset(&st, 0, sizeof(st));
-			TAILQ_FOREACH(slab, &slab_caches[i].slabs, cache_link)
+			TAILQ_FOREACH(slab, &cache->slabs, cache_link)
 			{
 				st.slabs++;
 				st.items += slab->items;
@@ -361,7 +675,12 @@ salloc_stat(salloc_stat_cb cb, struct slab_arena_stats *astat, void *cb_ctx)
 				st.bytes_used += sizeof(struct slab);
 				st.bytes_used += slab->used;
 			}
-			st.item_size = slab_caches[i].item_size;
+			st.item_size = cache->item_size;
+			/* Estimated from the average requested size. */
+			if (cache->allocs != 0)
+				st.bytes_waste = st.items *
+					(cache->item_size - (double)
+					 cache->requested / cache->allocs);
 
 			if (st.slabs == 0)
 				continue;
@@ -372,3 +691,62 @@ salloc_stat(salloc_stat_cb cb, struct slab_arena_stats *astat, void *cb_ctx)
 	}
 	return 0;
 }
+
+/** Sum up a "Key:  N kB" field over /proc/self/smaps entries of the arena. */
+static size_t
+arena_smaps_kb(const char *key)
+{
+	FILE *f = fopen("/proc/self/smaps", "r");
+	if (f == NULL)
+		return 0;
+
+	uintptr_t lo = (uintptr_t) arena.mmap_base;
+	uintptr_t hi = lo + arena.mmap_size;
+	size_t key_len = strlen(key);
+	bool in_arena = false;
+	size_t total = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		unsigned long start, end;
+		size_t kb;
+		if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+			in_arena = start >= lo && end <= hi;
+		else if (in_arena && strncmp(line, key, key_len) == 0 &&
+			 line[key_len] == ':' &&
+			 sscanf(line + key_len + 1, "%zu kB", &kb) == 1)
+			total += kb;
+	}
+	fclose(f);
+	return total;
+}
+
+/** The size of a huge page in kilobytes, as in /proc/meminfo. */
+static size_t
+huge_page_kb(void)
+{
+	size_t kb = 2048;
+	FILE *f = fopen("/proc/meminfo", "r");
+	if (f == NULL)
+		return kb;
+	char line[256];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1)
+			break;
+	}
+	fclose(f);
+	return kb;
+}
+
+size_t
+salloc_huge_pages_used(void)
+{
+	switch (arena.pages) {
+	case HUGETLB:
+		/* Reserved for the whole mapping at mmap(). */
+		return arena.mmap_size / (huge_page_kb() * 1024);
+	case TRANSPARENT:
+		return arena_smaps_kb("AnonHugePages") / huge_page_kb();
+	default:
+		return 0;
+	}
+}
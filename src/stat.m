@@ -47,6 +47,12 @@ static int stats_max = 0;
 static int base = 0;
 int stat_max_name_len = 0;
 
+static struct {
+	char *name;
+	struct histogram *hist;
+} *latencies = NULL;
+static int latencies_size = 0;
+
 static void
 stat_recalc_max_name_len()
 {
@@ -56,6 +62,9 @@ stat_recalc_max_name_len()
 			stat_max_name_len = MAX(stat_max_name_len,
 						strlen(stats[i].name));
 	}
+	for (int i = 0; i < latencies_size; i++)
+		stat_max_name_len = MAX(stat_max_name_len,
+					strlen(latencies[i].name));
 }
 
 int
@@ -115,6 +124,43 @@ stat_foreach(stat_cb cb, void *cb_ctx)
 
 }
 
+struct histogram *
+stat_register_latency(const char *name)
+{
+	latencies = realloc(latencies,
+			    sizeof(*latencies) * (latencies_size + 1));
+	if (latencies == NULL)
+		abort();
+	struct histogram *hist = malloc(sizeof(*hist));
+	char *copy = strdup(name);
+	if (hist == NULL || copy == NULL)
+		abort();
+	histogram_reset(hist);
+	latencies[latencies_size].name = copy;
+	latencies[latencies_size].hist = hist;
+	latencies_size++;
+	stat_max_name_len = MAX(stat_max_name_len, strlen(name));
+	return hist;
+}
+
+void
+stat_cleanup_latency(void)
+{
+	for (int i = 0; i < latencies_size; i++)
+		histogram_reset(latencies[i].hist);
+}
+
+int
+stat_foreach_latency(stat_latency_cb cb, void *cb_ctx)
+{
+	for (int i = 0; i < latencies_size; i++) {
+		int res = cb(latencies[i].name, latencies[i].hist, cb_ctx);
+		if (res != 0)
+			return res;
+	}
+	return 0;
+}
+
 void
 stat_age(ev_timer *timer, int events __attribute__((unused)))
 {
@@ -147,6 +193,13 @@ stat_free(void)
 	ev_timer_stop(&timer);
 	if (stats)
 		free(stats);
+	for (int i = 0; i < latencies_size; i++) {
+		free(latencies[i].name);
+		free(latencies[i].hist);
+	}
+	free(latencies);
+	latencies = NULL;
+	latencies_size = 0;
 }
 
 void
@@ -52,7 +52,10 @@
 #include <iproto.h>
 #include <latch.h>
 #include <recovery.h>
+#include <log_io.h>
 #include <crc32.h>
+#include <cpu_feature.h>
+#include <lib/bitset/bitset.h>
 #include <palloc.h>
 #include <salloc.h>
 #include <say.h>
@@ -93,6 +96,26 @@ core_check_config(struct tarantool_cfg *conf)
 		out_warning(0, "wal_mode %s is not recognized", conf->wal_mode);
 		return -1;
 	}
+	if (conf->wal_prealloc_size < 0) {
+		out_warning(0, "wal_prealloc_size can't be negative");
+		return -1;
+	}
+	if (conf->snap_segments < 1 ||
+	    conf->snap_segments > LOG_SEGMENTS_MAX) {
+		out_warning(0, "snap_segments must be in range [1, %d]",
+			    LOG_SEGMENTS_MAX);
+		return -1;
+	}
+	if (conf->iproto_net_threads < 0 || conf->iproto_net_threads > 64) {
+		out_warning(0, "iproto_net_threads must be in range [0, 64]");
+		return -1;
+	}
+#if !defined(TARGET_OS_LINUX)
+	if (conf->iproto_net_threads != 0) {
+		out_warning(0, "iproto_net_threads is supported on Linux only");
+		return -1;
+	}
+#endif
 	return 0;
 }
 
@@ -190,9 +213,11 @@ core_reload_config(const struct tarantool_cfg *old_conf,
 	}
 
 	/*
-	 * Unless wal_mode=fsync_delay, wal_fsync_delay is irrelevant and must be 0.
+	 * Unless wal_mode=fsync_delay or fsync_group, wal_fsync_delay
+	 * is irrelevant and must be 0.
 	 */
-	if (strcasecmp(new_conf->wal_mode, "fsync_delay") != 0)
+	if (strcasecmp(new_conf->wal_mode, "fsync_delay") != 0 &&
+	    strcasecmp(new_conf->wal_mode, "fsync_group") != 0)
 		new_delay = 0.0;
 
 	if (old_conf->wal_fsync_delay != new_delay)
@@ -315,12 +340,54 @@ tarantool_uptime(void)
 	return ev_now() - start_time;
 }
 
+/** True while a snapshot is saved from a read view. */
+static bool snapshot_is_in_progress = false;
+
+/**
+ * Save a snapshot without a fork (snap_fork = false).
+ *
+ * @return 0 on success, errno value otherwise.
+ */
+static int
+snapshot_read_view(void)
+{
+	/* Yields only after the read view is made. */
+	if (box_read_view_open() != 0) {
+		say_syserror("can't make a read view");
+		return errno;
+	}
+	snapshot_is_in_progress = true;
+	int rc = snapshot_save_read_view(recovery_state, cfg.snap_segments,
+					 box_read_view_snapshot);
+	int save_errno = errno;
+	box_read_view_close();
+	snapshot_is_in_progress = false;
+	return rc == 0 ? 0 : save_errno;
+}
+
+static void
+snapshot_read_view_f(va_list ap __attribute__((unused)))
+{
+	(void) snapshot_read_view();
+}
+
 int
 snapshot(void *ev, int events __attribute__((unused)))
 {
-	if (snapshot_pid)
+	if (snapshot_pid || snapshot_is_in_progress)
 		return EINPROGRESS;
 
+	if (! cfg.snap_fork) {
+		if (ev == NULL)
+			return snapshot_read_view();
+		/*
+		 * Called from a signal handler: no one waits
+		 * for the result, save the snapshot in a fiber.
+		 */
+		fiber_call(fiber_new("dumper", snapshot_read_view_f));
+		return 0;
+	}
+
 	pid_t p = fork();
 	if (p < 0) {
 		say_syserror("fork");
@@ -357,7 +424,19 @@ snapshot(void *ev, int events __attribute__((unused)))
 	 * parent stdio buffers at exit().
 	 */
 	close_all_xcpt(1, sayfd);
-	snapshot_save(recovery_state, box_snapshot);
+	if (cfg.snap_segments > 1) {
+		/*
+		 * Iterators aren't thread-safe: let the threads
+		 * writing the segments share a read view.
+		 */
+		if (box_read_view_open() != 0)
+			panic_status(errno, "Failed to save snapshot: can't make a read view");
+		if (snapshot_save_segments(recovery_state, cfg.snap_segments,
+					   box_read_view_snapshot) != 0)
+			panic_status(errno, "Failed to save snapshot");
+	} else {
+		snapshot_save(recovery_state, box_snapshot);
+	}
 
 	exit(EXIT_SUCCESS);
 	return 0;
@@ -607,9 +686,11 @@ tarantool_free(void)
 }
 
 static void
-initialize(double slab_alloc_arena, int slab_alloc_minimal, double slab_alloc_factor)
+initialize(double slab_alloc_arena, int slab_alloc_minimal, double slab_alloc_factor,
+	   bool slab_alloc_huge_pages)
 {
-	if (!salloc_init(slab_alloc_arena * (1 << 30), slab_alloc_minimal, slab_alloc_factor))
+	if (!salloc_init(slab_alloc_arena * (1 << 30), slab_alloc_minimal,
+			 slab_alloc_factor, slab_alloc_huge_pages))
 		panic_syserror("can't initialize slab allocator");
 	fiber_init();
 	coeio_init();
@@ -618,7 +699,7 @@ initialize(double slab_alloc_arena, int slab_alloc_minimal, double slab_alloc_fa
 static void
 initialize_minimal()
 {
-	initialize(0.1, 4, 2);
+	initialize(0.1, 4, 2, false);
 }
 
 int
@@ -639,6 +720,8 @@ main(int argc, char **argv)
 #endif
 
 	crc32_init();
+	bitset_init_kernels((popcnt_enabled_cpu() ? BITSET_CPU_POPCNT : 0) |
+			    (avx2_enabled_cpu() ? BITSET_CPU_AVX2 : 0));
 	stat_init();
 	palloc_init();
 
@@ -856,7 +939,8 @@ main(int argc, char **argv)
 	atexit(tarantool_free);
 
 	ev_default_loop(EVFLAG_AUTO);
-	initialize(cfg.slab_alloc_arena, cfg.slab_alloc_minimal, cfg.slab_alloc_factor);
+	initialize(cfg.slab_alloc_arena, cfg.slab_alloc_minimal, cfg.slab_alloc_factor,
+		   cfg.slab_alloc_huge_pages);
 	replication_prefork();
 
 	signal_init();
@@ -877,7 +961,7 @@ main(int argc, char **argv)
 		 * only after memcached is initialized.
 		 */
 		iproto_init(cfg.bind_ipaddr, cfg.primary_port,
-			    cfg.secondary_port);
+			    cfg.secondary_port, cfg.iproto_net_threads);
 		admin_init(cfg.bind_ipaddr, cfg.admin_port);
 		replication_init(cfg.bind_ipaddr, cfg.replication_port);
 		session_init();
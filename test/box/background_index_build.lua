@@ -0,0 +1,15 @@
+-- start-up script of background_index_build.test
+
+--
+-- The script runs before the first event loop iteration,
+-- so the secondary keys are not built yet.
+--
+
+select_status, select_error = pcall(box.select, 1, 1, 'a')
+insert_status, insert_error = pcall(box.insert, 1, 1, 'a')
+
+--
+-- Spaces without secondary keys can be changed.
+--
+
+box.insert(0, 1, 'no secondary keys')
@@ -241,6 +241,22 @@ class Server(object):
         self.is_started = False
         self.process = None
 
+    def kill(self):
+        """Kill server instance with SIGKILL, leaving its files
+        as they are at the moment, like a crash does."""
+        if not self.is_started:
+            return
+
+        os.kill(self.read_pidfile(), signal.SIGKILL)
+        self.process.expect(pexpect.EOF)
+        self.process.close()
+        # a killed server doesn't remove its pid file
+        os.unlink(self.pidfile)
+
+        self.wait_until_stopped()
+        self.is_started = False
+        self.process = None
+
     def deploy(self, config=None, binary=None, vardir=None,
                mem=None, start_and_exit=None, gdb=None, valgrind=None,
                valgrind_sup=None, init_lua=None, silent=True, need_init=True):
@@ -30,7 +30,7 @@ ER = {
     2: "ER_ILLEGAL_PARAMS"      ,
     3: "ER_SECONDARY"           ,
     4: "ER_TUPLE_IS_RO"         ,
-    5: "ER_UNUSED5"             ,
+    5: "ER_INDEX_NOT_READY"     ,
     6: "ER_UNUSED6"             ,
     7: "ER_MEMORY_ISSUE"        ,
     8: "ER_UNUSED8"             ,
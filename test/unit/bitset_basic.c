@@ -182,11 +182,60 @@ void test_get_set()
 	footer();
 }
 
+static
+void test_containers()
+{
+	header();
+
+	struct bitset bm;
+	bitset_create(&bm, realloc);
+	struct bitset_info info;
+
+	/* One bit per page: all pages are sparse */
+	enum { PAGES = 100, PAGE_BIT = 1280 };
+	for (size_t p = 0; p < PAGES; p++) {
+		fail_if(bitset_set(&bm, p * PAGE_BIT + p) < 0);
+	}
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == PAGES);
+	fail_unless(info.array_pages == PAGES);
+	fail_unless(info.mem_used + info.mem_saved ==
+		    info.pages * info.page_total_size);
+	fail_unless(info.mem_saved > info.mem_used);
+
+	/* Fill the first page: it is converted to a bitmap */
+	for (size_t i = 0; i < PAGE_BIT; i += 2) {
+		fail_if(bitset_set(&bm, i) < 0);
+	}
+	bitset_info(&bm, &info);
+	fail_unless(info.array_pages == PAGES - 1);
+	for (size_t i = 0; i < PAGE_BIT; i++) {
+		fail_unless(bitset_test(&bm, i) == (i % 2 == 0));
+	}
+
+	/* Clear most of it: it is converted back to an array */
+	for (size_t i = 0; i < PAGE_BIT - 40; i += 2) {
+		fail_unless(bitset_clear(&bm, i) == 1);
+	}
+	bitset_info(&bm, &info);
+	fail_unless(info.array_pages == PAGES);
+	for (size_t i = 0; i < PAGE_BIT; i++) {
+		fail_unless(bitset_test(&bm, i) ==
+			    (i % 2 == 0 && i >= PAGE_BIT - 40));
+	}
+	fail_unless(bitset_cardinality(&bm) == PAGES - 1 + 20);
+
+	bitset_destroy(&bm);
+
+	footer();
+}
+
 int main(int argc, char *argv[])
 {
 	setbuf(stdout, NULL);
 	test_cardinality();
 	test_get_set();
+	test_containers();
 
 	return 0;
 }
@@ -0,0 +1,165 @@
+/*
+ * A micro benchmark of bitset page kernels (lib/bitset/page.c).
+ * Evaluates conjunctions and disjunctions of bitsets over dense and
+ * sparse pages, first with the portable kernels and then with the
+ * kernels selected for the host CPU. It's not a part of the test
+ * suite since the output is timing dependent.
+ * Usage: bitset_bench [number of bits]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include <lib/bitset/iterator.h>
+
+enum { BITSETS_SIZE = 8, REPEAT = 20 };
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned
+cpu_features()
+{
+	unsigned features = 0;
+#if defined(__x86_64__) && (defined(__clang__) || (__GNUC__ > 4) || \
+	(__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt"))
+		features |= BITSET_CPU_POPCNT;
+	if (__builtin_cpu_supports("avx2"))
+		features |= BITSET_CPU_AVX2;
+#endif
+	return features;
+}
+
+/** Set every bit with probability 1 / @a rarity. */
+static void
+bitsets_fill(struct bitset *bitsets, size_t bits, unsigned rarity)
+{
+	for (size_t b = 0; b < BITSETS_SIZE; b++) {
+		bitset_create(&bitsets[b], realloc);
+		for (size_t pos = 0; pos < bits; pos++) {
+			if (rand() % rarity == 0)
+				bitset_set(&bitsets[b], pos);
+		}
+	}
+}
+
+/** b0 & b1 & b2 & b3 & ~b4 & ~b5 */
+static void
+expr_conj(struct bitset_expr *expr)
+{
+	bitset_expr_add_conj(expr);
+	for (size_t b = 0; b < 6; b++)
+		bitset_expr_add_param(expr, b, b >= 4);
+}
+
+/** b0 | b1 | ... | b7 */
+static void
+expr_disj(struct bitset_expr *expr)
+{
+	for (size_t b = 0; b < BITSETS_SIZE; b++) {
+		bitset_expr_add_conj(expr);
+		bitset_expr_add_param(expr, b, false);
+	}
+}
+
+static void
+print_info(const char *pages, struct bitset *bitsets)
+{
+	size_t pages_total = 0, array_pages = 0, mem_used = 0, mem_saved = 0;
+	for (size_t b = 0; b < BITSETS_SIZE; b++) {
+		struct bitset_info info;
+		bitset_info(&bitsets[b], &info);
+		pages_total += info.pages;
+		array_pages += info.array_pages;
+		mem_used += info.mem_used;
+		mem_saved += info.mem_saved;
+	}
+	printf("%-7s %8zu pages %8zu arrays %10zu bytes used %10zu saved\n",
+	       pages, pages_total, array_pages, mem_used, mem_saved);
+}
+
+static void
+bench(const char *kernels, const char *pages, const char *name,
+      void (*expr_fill)(struct bitset_expr *), struct bitset *bitsets,
+      size_t bits)
+{
+	struct bitset *p_bitsets[BITSETS_SIZE];
+	for (size_t b = 0; b < BITSETS_SIZE; b++)
+		p_bitsets[b] = &bitsets[b];
+
+	struct bitset_expr expr;
+	bitset_expr_create(&expr, realloc);
+	expr_fill(&expr);
+	struct bitset_iterator it;
+	bitset_iterator_create(&it, realloc);
+	if (bitset_iterator_init(&it, &expr, p_bitsets, BITSETS_SIZE) != 0)
+		abort();
+	bitset_expr_destroy(&expr);
+
+	size_t count = 0;
+	double start = now();
+	for (int i = 0; i < REPEAT; i++)
+		count += bitset_iterator_count(&it);
+	double count_time = now() - start;
+
+	size_t found = 0;
+	start = now();
+	for (int i = 0; i < REPEAT; i++) {
+		bitset_iterator_rewind(&it);
+		while (bitset_iterator_next(&it) != SIZE_MAX)
+			found++;
+	}
+	double next_time = now() - start;
+	if (found != count)
+		abort();
+
+	bitset_iterator_destroy(&it);
+
+	double gbits = (double) bits * REPEAT / 1e9;
+	printf("%-9s %-7s %-5s %10zu found  count %7.2f Gbit/sec"
+	       "  next %7.2f Gbit/sec\n", kernels, pages, name,
+	       count / REPEAT, gbits / count_time, gbits / next_time);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t bits = argc > 1 ? strtoul(argv[1], NULL, 10) : 1 << 22;
+	unsigned features = cpu_features();
+	printf("%zu bits, popcnt: %s, avx2: %s\n", bits,
+	       features & BITSET_CPU_POPCNT ? "yes" : "no",
+	       features & BITSET_CPU_AVX2 ? "yes" : "no");
+
+	struct bitset dense[BITSETS_SIZE];
+	struct bitset sparse[BITSETS_SIZE];
+	srand(0);
+	bitsets_fill(dense, bits, 2);
+	bitsets_fill(sparse, bits, 256);
+	print_info("dense", dense);
+	print_info("sparse", sparse);
+
+	for (int k = 0; k < 2; k++) {
+		const char *kernels = k == 0 ? "portable" : "host";
+		bitset_init_kernels(k == 0 ? 0 : features);
+		bench(kernels, "dense", "and", expr_conj, dense, bits);
+		bench(kernels, "dense", "or", expr_disj, dense, bits);
+		bench(kernels, "sparse", "and", expr_conj, sparse, bits);
+		bench(kernels, "sparse", "or", expr_disj, sparse, bits);
+	}
+
+	for (size_t b = 0; b < BITSETS_SIZE; b++) {
+		bitset_destroy(&dense[b]);
+		bitset_destroy(&sparse[b]);
+	}
+
+	return 0;
+}
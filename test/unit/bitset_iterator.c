@@ -474,11 +474,163 @@ void test_disjunction()
 	footer();
 }
 
-int main(void)
+static
+void test_count()
 {
-	setbuf(stdout, NULL);
-	nums_fill(NUMS, NUMS_SIZE);
+	header();
+
+	enum { BITSETS_SIZE = 8 };
+
+	struct bitset **bitsets = bitsets_create(BITSETS_SIZE);
+
+	nums_shuffle(NUMS, NUMS_SIZE);
+	for (size_t i = 0; i < NUMS_SIZE; i++) {
+		bitset_set(bitsets[i % BITSETS_SIZE], NUMS[i]);
+		if (i % 3 == 0)
+			bitset_set(bitsets[(i + 1) % BITSETS_SIZE], NUMS[i]);
+	}
+
+	/* (b0 & ~b1) | (b2 & b3 & ~b4) | b5 */
+	struct bitset_expr expr;
+	bitset_expr_create(&expr, realloc);
+	fail_unless(bitset_expr_add_conj(&expr) == 0);
+	fail_unless(bitset_expr_add_param(&expr, 0, false) == 0);
+	fail_unless(bitset_expr_add_param(&expr, 1, true) == 0);
+	fail_unless(bitset_expr_add_conj(&expr) == 0);
+	fail_unless(bitset_expr_add_param(&expr, 2, false) == 0);
+	fail_unless(bitset_expr_add_param(&expr, 3, false) == 0);
+	fail_unless(bitset_expr_add_param(&expr, 4, true) == 0);
+	fail_unless(bitset_expr_add_conj(&expr) == 0);
+	fail_unless(bitset_expr_add_param(&expr, 5, false) == 0);
+
+	struct bitset_iterator it;
+	bitset_iterator_create(&it, realloc);
+	fail_unless(bitset_iterator_init(&it, &expr, bitsets, BITSETS_SIZE) == 0);
+	bitset_expr_destroy(&expr);
+
+	size_t expected = 0;
+	size_t prev = 0;
+	size_t pos;
+	while ((pos = bitset_iterator_next(&it)) != SIZE_MAX) {
+		fail_unless(expected == 0 || pos > prev);
+		bool b[6];
+		for (size_t i = 0; i < 6; i++)
+			b[i] = bitset_test(bitsets[i], pos);
+		fail_unless((b[0] && !b[1]) || (b[2] && b[3] && !b[4]) || b[5]);
+		prev = pos;
+		expected++;
+	}
+
+	fail_unless(expected > 0);
+	fail_unless(bitset_iterator_count(&it) == expected);
+	fail_unless(bitset_iterator_next(&it) == SIZE_MAX);
+
+	bitset_iterator_rewind(&it);
+	fail_unless(bitset_iterator_next(&it) != SIZE_MAX);
+	fail_unless(bitset_iterator_count(&it) == expected);
+
+	bitset_iterator_destroy(&it);
+	bitsets_destroy(bitsets, BITSETS_SIZE);
+
+	footer();
+}
+
+static
+void test_containers()
+{
+	header();
+
+	enum { BITSETS_SIZE = 4, PAGE_BIT = 1280, PAGES = 32 };
+
+	/*
+	 * b0 is dense, b1 is sparse, b2 is dense in even pages and
+	 * sparse in odd ones, b3 is the other way round.
+	 */
+	struct bitset **bitsets = bitsets_create(BITSETS_SIZE);
+	for (size_t pos = 0; pos < PAGES * PAGE_BIT; pos++) {
+		size_t page = pos / PAGE_BIT;
+		if (pos % 3 == 0)
+			bitset_set(bitsets[0], pos);
+		if (pos % 97 == 0)
+			bitset_set(bitsets[1], pos);
+		if (pos % (page % 2 == 0 ? 2 : 101) == 0)
+			bitset_set(bitsets[2], pos);
+		if (pos % (page % 2 == 0 ? 103 : 5) == 0)
+			bitset_set(bitsets[3], pos);
+	}
 
+	/*
+	 * Combinations of two and three terms with negations.
+	 * A conjunction of negations only is unbounded, so the
+	 * third term is not negated if the first two are.
+	 */
+	for (unsigned mask = 0; mask < 64; mask++) {
+		size_t terms[3] = { mask % 4, (mask / 4) % 4, 0 };
+		bool nots[3] = { mask & 16, mask & 32, false };
+		size_t size = mask % 3 == 0 ? 3 : 2;
+		terms[2] = (terms[0] + 1) % BITSETS_SIZE;
+		if (nots[0] && nots[1]) {
+			size = 3;
+		} else {
+			nots[2] = true;
+		}
+
+		struct bitset_expr expr;
+		bitset_expr_create(&expr, realloc);
+		fail_unless(bitset_expr_add_conj(&expr) == 0);
+		for (size_t t = 0; t < size; t++) {
+			fail_unless(bitset_expr_add_param(&expr, terms[t],
+							  nots[t]) == 0);
+		}
+
+		struct bitset_iterator it;
+		bitset_iterator_create(&it, realloc);
+		fail_unless(bitset_iterator_init(&it, &expr, bitsets,
+						 BITSETS_SIZE) == 0);
+		bitset_expr_destroy(&expr);
+
+		size_t next = bitset_iterator_next(&it);
+		for (size_t pos = 0; pos < PAGES * PAGE_BIT; pos++) {
+			bool match = true;
+			for (size_t t = 0; t < size; t++) {
+				if (bitset_test(bitsets[terms[t]], pos) ==
+				    nots[t])
+					match = false;
+			}
+			if (!match)
+				continue;
+			fail_unless(next == pos);
+			next = bitset_iterator_next(&it);
+		}
+		fail_unless(next == SIZE_MAX);
+
+		bitset_iterator_destroy(&it);
+	}
+
+	bitsets_destroy(bitsets, BITSETS_SIZE);
+
+	footer();
+}
+
+/** CPU features for bitset_init_kernels() */
+static unsigned
+cpu_features()
+{
+	unsigned features = 0;
+#if defined(__x86_64__) && (defined(__clang__) || (__GNUC__ > 4) || \
+	(__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt"))
+		features |= BITSET_CPU_POPCNT;
+	if (__builtin_cpu_supports("avx2"))
+		features |= BITSET_CPU_AVX2;
+#endif
+	return features;
+}
+
+static void
+run_tests()
+{
 	test_empty_expr();
 	test_empty_expr_conj1();
 	test_empty_expr_conj2();
@@ -489,6 +641,20 @@ int main(void)
 	test_not_empty();
 	test_not_last();
 	test_disjunction();
+	test_count();
+	test_containers();
+}
+
+int main(void)
+{
+	setbuf(stdout, NULL);
+	nums_fill(NUMS, NUMS_SIZE);
+
+	/* Portable kernels */
+	run_tests();
+	/* Kernels for the host CPU */
+	bitset_init_kernels(cpu_features());
+	run_tests();
 
 	return 0;
 }
@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <lib/bptree/bptree.h>
+
+#include "unit.h"
+
+struct elem {
+	uint32_t key;
+	uint32_t val;
+} __attribute__((packed));
+
+static int
+key_cmp(const void *a, const void *b, void *arg)
+{
+	(void) arg;
+	uint32_t ka = *(const uint32_t *) a;
+	uint32_t kb = ((const struct elem *) b)->key;
+	return ka < kb ? -1 : (ka > kb);
+}
+
+static int
+elem_cmp(const void *a, const void *b, void *arg)
+{
+	return key_cmp(&((const struct elem *) a)->key, b, arg);
+}
+
+static void
+shuffle(uint32_t *arr, size_t size)
+{
+	for (size_t i = 0; i + 1 < size; i++) {
+		size_t j = i + rand() / (RAND_MAX / (size - i) + 1);
+		uint32_t tmp = arr[i];
+		arr[i] = arr[j];
+		arr[j] = tmp;
+	}
+}
+
+/** Check tree contents against a set of present keys. */
+static void
+check_tree(struct bptree *tree, const bool *present, uint32_t max_key)
+{
+	size_t count = 0;
+	for (uint32_t k = 0; k < max_key; k++) {
+		struct elem *e = bptree_find(tree, &k);
+		if (present[k]) {
+			fail_unless(e != NULL && e->key == k && e->val == ~k);
+			count++;
+		} else {
+			fail_unless(e == NULL);
+		}
+	}
+	fail_unless(bptree_size(tree) == count);
+
+	struct bptree_iterator *it = bptree_iterator_new(tree);
+	bptree_iterator_init_set(it, NULL);
+	uint32_t k = 0;
+	struct elem *e;
+	while ((e = bptree_iterator_next(it)) != NULL) {
+		while (!present[k])
+			k++;
+		fail_unless(e->key == k);
+		k++;
+		count--;
+	}
+	fail_unless(count == 0);
+	bptree_iterator_delete(it);
+}
+
+static void
+test_basic()
+{
+	header();
+
+	struct bptree tree;
+	bptree_create(&tree, sizeof(struct elem), key_cmp, elem_cmp, NULL);
+	fail_unless(bptree_size(&tree) == 0);
+	fail_unless(bptree_first(&tree) == NULL);
+	fail_unless(bptree_last(&tree) == NULL);
+
+	struct elem e = { .key = 1, .val = 1 };
+	struct elem old;
+	void *p_old = &old;
+	fail_unless(bptree_replace(&tree, &e, &p_old) == 0);
+	fail_unless(p_old == NULL);
+
+	e.val = 2;
+	p_old = &old;
+	fail_unless(bptree_replace(&tree, &e, &p_old) == 0);
+	fail_unless(p_old == &old && old.key == 1 && old.val == 1);
+	fail_unless(bptree_size(&tree) == 1);
+	fail_unless(((struct elem *) bptree_first(&tree))->val == 2);
+
+	fail_unless(bptree_delete(&tree, &e));
+	fail_unless(!bptree_delete(&tree, &e));
+	fail_unless(bptree_size(&tree) == 0);
+	fail_unless(bptree_mem_used(&tree) == 0);
+
+	bptree_destroy(&tree);
+
+	footer();
+}
+
+static void
+test_random(uint32_t max_key)
+{
+	header();
+
+	struct bptree tree;
+	bptree_create(&tree, sizeof(struct elem), key_cmp, elem_cmp, NULL);
+
+	bool *present = calloc(max_key, sizeof(bool));
+	uint32_t *keys = malloc(max_key * sizeof(uint32_t));
+	for (uint32_t i = 0; i < max_key; i++)
+		keys[i] = i;
+	shuffle(keys, max_key);
+
+	printf("Inserting... ");
+	for (uint32_t i = 0; i < max_key; i++) {
+		struct elem e = { .key = keys[i], .val = ~keys[i] };
+		fail_unless(bptree_replace(&tree, &e, NULL) == 0);
+		present[keys[i]] = true;
+	}
+	check_tree(&tree, present, max_key);
+	fail_unless(((struct elem *) bptree_first(&tree))->key == 0);
+	fail_unless(((struct elem *) bptree_last(&tree))->key == max_key - 1);
+	printf("ok\n");
+
+	printf("Deleting half... ");
+	shuffle(keys, max_key);
+	for (uint32_t i = 0; i < max_key / 2; i++) {
+		struct elem e = { .key = keys[i] };
+		fail_unless(bptree_delete(&tree, &e));
+		present[keys[i]] = false;
+	}
+	check_tree(&tree, present, max_key);
+	printf("ok\n");
+
+	printf("Mixed workload... ");
+	for (uint32_t i = 0; i < max_key * 4; i++) {
+		uint32_t k = rand() % max_key;
+		struct elem e = { .key = k, .val = ~k };
+		if (present[k]) {
+			fail_unless(bptree_delete(&tree, &e));
+			present[k] = false;
+		} else {
+			fail_unless(bptree_replace(&tree, &e, NULL) == 0);
+			present[k] = true;
+		}
+	}
+	check_tree(&tree, present, max_key);
+	printf("ok\n");
+
+	printf("Deleting all... ");
+	for (uint32_t k = 0; k < max_key; k++) {
+		struct elem e = { .key = k };
+		fail_unless(bptree_delete(&tree, &e) == present[k]);
+		present[k] = false;
+	}
+	check_tree(&tree, present, max_key);
+	fail_unless(bptree_mem_used(&tree) == 0);
+	printf("ok\n");
+
+	bptree_destroy(&tree);
+	free(keys);
+	free(present);
+
+	footer();
+}
+
+static void
+test_build()
+{
+	header();
+
+	const uint32_t count = 50000;
+	struct elem *array = malloc(count * sizeof(*array));
+	bool *present = calloc(count * 2, sizeof(bool));
+	for (uint32_t i = 0; i < count; i++) {
+		/* Even keys only, descending order. */
+		array[i].key = (count - i - 1) * 2;
+		array[i].val = ~array[i].key;
+		present[array[i].key] = true;
+	}
+
+	struct bptree tree;
+	bptree_create(&tree, sizeof(struct elem), key_cmp, elem_cmp, NULL);
+	fail_unless(bptree_build(&tree, array, count) == 0);
+	free(array);
+	check_tree(&tree, present, count * 2);
+
+	/* Fill in the odd keys. */
+	for (uint32_t k = 1; k < count * 2; k += 2) {
+		struct elem e = { .key = k, .val = ~k };
+		fail_unless(bptree_replace(&tree, &e, NULL) == 0);
+		present[k] = true;
+	}
+	check_tree(&tree, present, count * 2);
+
+	bptree_destroy(&tree);
+	free(present);
+
+	footer();
+}
+
+static void
+test_iterator()
+{
+	header();
+
+	struct bptree tree;
+	bptree_create(&tree, sizeof(struct elem), key_cmp, elem_cmp, NULL);
+	for (uint32_t k = 0; k < 1000; k += 10) {
+		struct elem e = { .key = k, .val = ~k };
+		fail_unless(bptree_replace(&tree, &e, NULL) == 0);
+	}
+
+	struct bptree_iterator *it = bptree_iterator_new(&tree);
+	struct elem *e;
+
+	/* Lower bound. */
+	uint32_t key = 15;
+	bptree_iterator_init_set(it, &key);
+	fail_unless((e = bptree_iterator_next(it)) != NULL && e->key == 20);
+
+	/* Reverse from an existing key. */
+	key = 500;
+	bptree_iterator_reverse_init_set(it, &key);
+	fail_unless((e = bptree_iterator_reverse_next(it)) && e->key == 500);
+	fail_unless((e = bptree_iterator_reverse_next(it)) && e->key == 490);
+
+	/* Out of range. */
+	key = 1000;
+	bptree_iterator_init_set(it, &key);
+	fail_unless(bptree_iterator_next(it) == NULL);
+	bptree_iterator_reverse_init_set(it, &key);
+	fail_unless((e = bptree_iterator_reverse_next(it)) && e->key == 990);
+
+	/* Modification of the tree during iteration. */
+	key = 0;
+	bptree_iterator_init_set(it, &key);
+	fail_unless((e = bptree_iterator_next(it)) && e->key == 0);
+	for (uint32_t k = 0; k < 1000; k += 10) {
+		struct elem d = { .key = k };
+		if (k != 0 && k % 20 == 0)
+			fail_unless(bptree_delete(&tree, &d));
+	}
+	struct elem n = { .key = 5, .val = ~5 };
+	fail_unless(bptree_replace(&tree, &n, NULL) == 0);
+	uint32_t expected = 5;
+	while ((e = bptree_iterator_next(it)) != NULL) {
+		fail_unless(e->key == expected);
+		expected = expected == 5 ? 10 : expected + 20;
+	}
+	fail_unless(expected == 1010);
+
+	/* Same for reverse iteration. */
+	bptree_iterator_reverse_init_set(it, NULL);
+	fail_unless((e = bptree_iterator_reverse_next(it)) && e->key == 990);
+	n.key = 970;
+	fail_unless(bptree_delete(&tree, &n));
+	fail_unless((e = bptree_iterator_reverse_next(it)) && e->key == 950);
+
+	bptree_iterator_delete(it);
+	bptree_destroy(&tree);
+
+	footer();
+}
+
+static void
+test_rank()
+{
+	header();
+
+	struct bptree tree;
+	bptree_create(&tree, sizeof(struct elem), key_cmp, elem_cmp, NULL);
+	const uint32_t count = 20000;
+	uint32_t *keys = malloc(count * sizeof(uint32_t));
+	for (uint32_t i = 0; i < count; i++)
+		keys[i] = i;
+	shuffle(keys, count);
+	/* Odd keys only, so that every key has a gap before it. */
+	for (uint32_t i = 0; i < count; i++) {
+		struct elem e = { .key = keys[i] * 2 + 1, .val = 0 };
+		fail_unless(bptree_replace(&tree, &e, NULL) == 0);
+	}
+	for (uint32_t k = 0; k < count * 2 + 2; k++) {
+		size_t rank = k / 2 < count ? k / 2 : count;
+		fail_unless(bptree_rank(&tree, &k) == rank);
+		fail_unless(bptree_count(&tree, &k) == (k < count * 2 && k % 2));
+		struct elem e = { .key = k, .val = 0 };
+		fail_unless(bptree_rank_elem(&tree, &e) == rank);
+	}
+
+	struct bptree_iterator *it = bptree_iterator_new(&tree);
+	struct elem *e;
+	size_t n;
+	for (uint32_t k = 0; k < count * 2; k += 997) {
+		/* Skip 100 elements starting from key k. */
+		bptree_iterator_init_set(it, &k);
+		n = 100;
+		e = bptree_iterator_skip(it, &n);
+		uint32_t last = (k / 2 + 99) * 2 + 1;
+		if (last < count * 2) {
+			fail_unless(n == 100 && e != NULL && e->key == last);
+			e = bptree_iterator_next(it);
+			fail_unless(e == NULL || e->key == last + 2);
+		} else {
+			fail_unless(n == count - k / 2);
+			fail_unless(bptree_iterator_next(it) == NULL);
+		}
+
+		/* Same in descending order. */
+		bptree_iterator_reverse_init_set(it, &k);
+		n = 100;
+		e = bptree_iterator_skip(it, &n);
+		uint32_t not_greater = (k + 1) / 2;
+		fail_unless(n == (not_greater < 100 ? not_greater : 100));
+		if (n == 100) {
+			last = (not_greater - 100) * 2 + 1;
+			fail_unless(e != NULL && e->key == last);
+		}
+	}
+
+	/* Skipping continues from the last returned element. */
+	bptree_iterator_init_set(it, NULL);
+	fail_unless((e = bptree_iterator_next(it)) && e->key == 1);
+	struct elem d = { .key = 3 };
+	fail_unless(bptree_delete(&tree, &d));
+	n = 2;
+	fail_unless((e = bptree_iterator_skip(it, &n)) && e->key == 7);
+	fail_unless((e = bptree_iterator_next(it)) && e->key == 9);
+	n = count;
+	bptree_iterator_skip(it, &n);
+	fail_unless(n == count - 5);
+	fail_unless(bptree_iterator_next(it) == NULL);
+
+	bptree_iterator_delete(it);
+	bptree_destroy(&tree);
+	free(keys);
+
+	footer();
+}
+
+int
+main(void)
+{
+	setbuf(stdout, NULL);
+	srand(0);
+	test_basic();
+	test_random(1000);
+	test_random(100000);
+	test_build();
+	test_iterator();
+	test_rank();
+	return 0;
+}
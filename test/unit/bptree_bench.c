@@ -0,0 +1,177 @@
+/*
+ * A micro benchmark comparing the B+tree (lib/bptree) with the
+ * AVL tree (third_party/sptree.h) on the operations used by
+ * TREE indexes. It's not a part of the test suite since the output
+ * is timing dependent. Usage: bptree_bench [number of elements]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <lib/bptree/bptree.h>
+#include <third_party/sptree.h>
+
+/** Mimics num32_node of tree_index.m. */
+struct elem {
+	void *tuple;
+	uint32_t value;
+} __attribute__((packed));
+
+static int
+key_cmp(const void *a, const void *b, void *arg)
+{
+	(void) arg;
+	uint32_t ka = *(const uint32_t *) a;
+	uint32_t kb = ((const struct elem *) b)->value;
+	return ka < kb ? -1 : (ka > kb);
+}
+
+static int
+elem_cmp(const void *a, const void *b, void *arg)
+{
+	return key_cmp(&((const struct elem *) a)->value, b, arg);
+}
+
+SPTREE_DEF(bench, realloc);
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *engine, const char *op, size_t count, double start)
+{
+	double elapsed = now() - start;
+	printf("%-7s %-10s %8.3f sec %8.1f Mops/sec\n", engine, op, elapsed,
+	       count / elapsed / 1e6);
+}
+
+static uint32_t *
+random_keys(size_t count)
+{
+	uint32_t *keys = malloc(count * sizeof(*keys));
+	for (size_t i = 0; i < count; i++)
+		keys[i] = i * 2;
+	for (size_t i = 0; i + 1 < count; i++) {
+		size_t j = i + rand() % (count - i);
+		uint32_t tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+	return keys;
+}
+
+/** The number of elements read by each range scan. */
+enum { SCAN_LENGTH = 100 };
+
+static void
+bench_sptree(const uint32_t *keys, size_t count)
+{
+	sptree_bench tree;
+	sptree_bench_init(&tree, sizeof(struct elem), NULL, 0, 0,
+			  key_cmp, elem_cmp, NULL);
+
+	double start = now();
+	for (size_t i = 0; i < count; i++) {
+		struct elem e = { .tuple = NULL, .value = keys[i] };
+		sptree_bench_replace(&tree, &e, NULL);
+	}
+	report("sptree", "insert", count, start);
+
+	start = now();
+	for (size_t i = 0; i < count; i++) {
+		if (sptree_bench_find(&tree, (void *) &keys[i]) == NULL)
+			abort();
+	}
+	report("sptree", "find", count, start);
+
+	start = now();
+	sptree_bench_iterator *it = NULL;
+	size_t scans = count / SCAN_LENGTH;
+	for (size_t i = 0; i < scans; i++) {
+		sptree_bench_iterator_init_set(&tree, &it, (void *) &keys[i]);
+		for (int j = 0; j < SCAN_LENGTH; j++)
+			sptree_bench_iterator_next(it);
+	}
+	sptree_bench_iterator_free(it);
+	report("sptree", "scan", scans * SCAN_LENGTH, start);
+
+	printf("%-7s %-10s %8zu bytes\n", "sptree", "memory",
+	       (size_t) tree.ntotal *
+	       (sizeof(struct elem) + sizeof(sptree_node_pointers)));
+
+	start = now();
+	for (size_t i = 0; i < count; i++) {
+		struct elem e = { .tuple = NULL, .value = keys[i] };
+		sptree_bench_delete(&tree, &e);
+	}
+	report("sptree", "delete", count, start);
+
+	sptree_bench_destroy(&tree);
+}
+
+static void
+bench_bptree(const uint32_t *keys, size_t count)
+{
+	struct bptree tree;
+	bptree_create(&tree, sizeof(struct elem), key_cmp, elem_cmp, NULL);
+
+	double start = now();
+	for (size_t i = 0; i < count; i++) {
+		struct elem e = { .tuple = NULL, .value = keys[i] };
+		if (bptree_replace(&tree, &e, NULL) != 0)
+			abort();
+	}
+	report("bptree", "insert", count, start);
+
+	start = now();
+	for (size_t i = 0; i < count; i++) {
+		if (bptree_find(&tree, &keys[i]) == NULL)
+			abort();
+	}
+	report("bptree", "find", count, start);
+
+	start = now();
+	struct bptree_iterator *it = bptree_iterator_new(&tree);
+	size_t scans = count / SCAN_LENGTH;
+	for (size_t i = 0; i < scans; i++) {
+		bptree_iterator_init_set(it, &keys[i]);
+		for (int j = 0; j < SCAN_LENGTH; j++)
+			bptree_iterator_next(it);
+	}
+	bptree_iterator_delete(it);
+	report("bptree", "scan", scans * SCAN_LENGTH, start);
+
+	printf("%-7s %-10s %8zu bytes\n", "bptree", "memory",
+	       bptree_mem_used(&tree));
+
+	start = now();
+	for (size_t i = 0; i < count; i++) {
+		struct elem e = { .tuple = NULL, .value = keys[i] };
+		if (!bptree_delete(&tree, &e))
+			abort();
+	}
+	report("bptree", "delete", count, start);
+
+	bptree_destroy(&tree);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	srand(time(NULL));
+	uint32_t *keys = random_keys(count);
+	printf("%zu elements of %zu bytes\n", count, sizeof(struct elem));
+	bench_sptree(keys, count);
+	bench_bptree(keys, count);
+	free(keys);
+	return 0;
+}
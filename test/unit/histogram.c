@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit.h"
+#include "histogram.h"
+
+/* Copied from src/histogram.c, it's static there. */
+static uint64_t
+bucket_max(int bucket)
+{
+	if (bucket < HISTOGRAM_SUB)
+		return bucket;
+	int shift = bucket / HISTOGRAM_SUB - 1;
+	uint64_t sub = HISTOGRAM_SUB + bucket % HISTOGRAM_SUB;
+	return ((sub + 1) << shift) - 1;
+}
+
+static void
+histogram_bucket_test()
+{
+	header();
+
+	/* Buckets are consecutive and cover all values. */
+	uint64_t value = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		fail_unless(histogram_bucket(value) == i);
+		value = bucket_max(i);
+		fail_unless(histogram_bucket(value) == i);
+		value++;
+	}
+	fail_unless(value == 1ULL << HISTOGRAM_VALUE_BITS);
+	fail_unless(histogram_bucket(value) == HISTOGRAM_BUCKETS - 1);
+	fail_unless(histogram_bucket(UINT64_MAX) == HISTOGRAM_BUCKETS - 1);
+
+	footer();
+}
+
+static void
+histogram_percentile_test()
+{
+	header();
+
+	struct histogram hist;
+	histogram_reset(&hist);
+	fail_unless(histogram_percentile(&hist, 0.5) == 0);
+
+	for (uint64_t i = 1; i <= 100000; i++)
+		histogram_collect(&hist, i);
+	fail_unless(hist.count == 100000);
+	fail_unless(hist.max == 100000);
+
+	double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+	for (int i = 0; i < 4; i++) {
+		uint64_t exact = fractions[i] * 100000;
+		uint64_t value = histogram_percentile(&hist, fractions[i]);
+		fail_unless(value >= exact);
+		fail_unless(value - exact <= exact / HISTOGRAM_SUB);
+	}
+	fail_unless(histogram_percentile(&hist, 1) == 100000);
+	fail_unless(histogram_percentile(&hist, 0) == 1);
+
+	/* A single value. */
+	histogram_reset(&hist);
+	histogram_collect(&hist, 1000);
+	fail_unless(histogram_percentile(&hist, 0.5) == 1000);
+	fail_unless(histogram_percentile(&hist, 0.999) == 1000);
+
+	footer();
+}
+
+int
+main(void)
+{
+	histogram_bucket_test();
+	histogram_percentile_test();
+	return 0;
+}
@@ -0,0 +1,205 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "unit.h"
+
+#define SH_SOURCE 1
+
+#define sh_name _i32
+struct sh_i32_node_t {
+	int32_t key;
+	int32_t val;
+};
+#define sh_node_t struct sh_i32_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((a)->key)
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->key == (b)->key)
+#include "shash.h"
+
+#define sh_name _i32_collision
+struct sh_i32_collision_node_t {
+	int32_t key;
+	int32_t val;
+};
+#define sh_node_t struct sh_i32_collision_node_t
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) 42
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->key == (b)->key)
+#include "shash.h"
+
+#undef SH_SOURCE
+
+#define get(x) ({							\
+	const struct sh_i32_node_t _node = { .key = (x) };		\
+	sh_i32_get(h, &_node, NULL, NULL);				\
+})
+#define set(x) ({							\
+	const struct sh_i32_node_t _node = { .key = (x), .val = (x) << 1 };\
+	sh_i32_replace(h, &_node, NULL, NULL, NULL);			\
+})
+#define rm(x) sh_i32_del(h, get(x), NULL, NULL)
+#define tst(x) ({							\
+	sh_int_t k = get((x));						\
+	fail_unless(k != sh_end(h));					\
+	fail_unless(sh_i32_node(h, k)->val == ((x) << 1));		\
+})
+#define clr(x) fail_unless(get(x) == sh_end(h))
+
+static void
+shash_int32_basic_test()
+{
+	header();
+
+	struct sh_i32_t *h = sh_i32_new();
+	clr(1);
+	set(1);
+	set(2);
+	set(3);
+	tst(1);
+	tst(2);
+	tst(3);
+	fail_unless(sh_size(h) == 3);
+
+	/* delete non existing entry */
+	sh_i32_del(h, get(4), NULL, NULL);
+	sh_i32_del(h, sh_end(h) + 1, NULL, NULL);
+	fail_unless(sh_size(h) == 3);
+
+	/* replace returns the old node */
+	struct sh_i32_node_t node = { .key = 2, .val = 0 }, old;
+	struct sh_i32_node_t *p_old = &old;
+	sh_i32_replace(h, &node, &p_old, NULL, NULL);
+	fail_unless(p_old == &old && old.key == 2 && old.val == 4);
+	set(2);
+	node.key = 5;
+	p_old = &old;
+	sh_i32_replace(h, &node, &p_old, NULL, NULL);
+	fail_unless(p_old == NULL);
+	rm(5);
+
+	/* there are rehashes here, verify the nodes are in place */
+	for (int i = 0; i < 100; i++)
+		set(i);
+	for (int i = 0; i < 100; i++)
+		tst(i);
+	fail_unless(sh_size(h) == 100);
+
+	int count = 0;
+	sh_int_t k;
+	sh_foreach(h, k)
+		count++;
+	fail_unless(count == 100);
+
+	sh_i32_clear(h);
+	fail_unless(sh_size(h) == 0);
+	for (int i = 0; i < 100; i++)
+		clr(i);
+
+	/* verify reuse of deleted slots */
+	set(1);
+	sh_int_t k1 = get(1);
+	rm(1);
+	clr(1);
+	set(1);
+	fail_unless(get(1) == k1);
+
+	sh_i32_delete(h);
+
+	footer();
+}
+
+static void
+shash_int32_random_test()
+{
+	header();
+
+	enum { MAX_KEY = 10000 };
+	bool present[MAX_KEY] = { false };
+	struct sh_i32_t *h = sh_i32_new();
+	fail_unless(sh_i32_reserve(h, MAX_KEY / 2, NULL, NULL) == 0);
+	sh_int_t capacity = sh_capacity(h);
+
+	/*
+	 * Lots of deletes fill the table with deleted slots,
+	 * lookups must still stop and the table must not grow
+	 * beyond the reserved size.
+	 */
+	for (int i = 0; i < MAX_KEY * 50; i++) {
+		int x = rand() % MAX_KEY;
+		if (present[x]) {
+			rm(x);
+			clr(x);
+			present[x] = false;
+		} else if (sh_size(h) < MAX_KEY / 2) {
+			set(x);
+			present[x] = true;
+		}
+	}
+	fail_unless(sh_capacity(h) == capacity);
+	int count = 0;
+	for (int i = 0; i < MAX_KEY; i++) {
+		if (present[i]) {
+			tst(i);
+			count++;
+		} else {
+			clr(i);
+		}
+	}
+	fail_unless((int) sh_size(h) == count);
+
+	sh_i32_delete(h);
+
+	footer();
+}
+
+#undef get
+#undef set
+#undef rm
+#undef tst
+#undef clr
+
+static void
+shash_int32_collision_test()
+{
+	header();
+
+	struct sh_i32_collision_t *h = sh_i32_collision_new();
+#define get(x) ({							\
+	const struct sh_i32_collision_node_t _node = { .key = (x) };	\
+	sh_i32_collision_get(h, &_node, NULL, NULL);			\
+})
+#define set(x) ({							\
+	const struct sh_i32_collision_node_t _node =			\
+		{ .key = (x), .val = (x) << 1 };			\
+	sh_i32_collision_replace(h, &_node, NULL, NULL, NULL);		\
+})
+	/* all nodes share a single probe sequence */
+	for (int i = 0; i < 1000; i++)
+		set(i);
+	for (int i = 0; i < 1000; i++) {
+		sh_int_t k = get(i);
+		fail_unless(k != sh_end(h));
+		fail_unless(sh_i32_collision_node(h, k)->val == i << 1);
+	}
+	for (int i = 0; i < 1000; i += 2)
+		sh_i32_collision_del(h, get(i), NULL, NULL);
+	for (int i = 0; i < 1000; i++)
+		fail_unless((get(i) != sh_end(h)) == (i % 2));
+	fail_unless(sh_size(h) == 500);
+#undef get
+#undef set
+
+	sh_i32_collision_delete(h);
+
+	footer();
+}
+
+int main(void)
+{
+	shash_int32_basic_test();
+	shash_int32_random_test();
+	shash_int32_collision_test();
+	return 0;
+}
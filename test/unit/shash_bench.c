@@ -0,0 +1,228 @@
+/*
+ * A micro benchmark comparing the Swiss table (shash.h) with
+ * mhash.h on the operations used by HASH indexes. It's not a part
+ * of the test suite since the output is timing dependent.
+ * Usage: shash_bench [number of elements]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <third_party/PMurHash.h>
+
+/** Mimics mh_i32ptr_node_t of assoc.h. */
+struct i32_node {
+	uint32_t key;
+	void *val;
+};
+
+/**
+ * Mimics mh_lstrptr_node_t: the key points into a tuple, its
+ * hash is cached in the node.
+ */
+struct str_node {
+	const char *key;
+	void *val;
+	uint32_t hash;
+};
+
+static inline uint32_t
+str_hash(const char *key)
+{
+	return PMurHash32(13, key, strlen(key));
+}
+
+#define MH_SOURCE 1
+#define SH_SOURCE 1
+
+#define mh_name _i32
+#define mh_node_t struct i32_node
+#define mh_hash_arg_t void *
+#define mh_hash(a, arg) ((a)->key)
+#define mh_eq_arg_t void *
+#define mh_eq(a, b, arg) ((a)->key == (b)->key)
+#include <mhash.h>
+
+#define mh_name _str
+#define mh_node_t struct str_node
+#define mh_hash_arg_t void *
+#define mh_hash(a, arg) ((a)->hash)
+#define mh_eq_arg_t void *
+#define mh_eq(a, b, arg) ((a)->hash == (b)->hash && \
+			  strcmp((a)->key, (b)->key) == 0)
+#include <mhash.h>
+
+#define sh_name _i32
+#define sh_node_t struct i32_node
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((a)->key)
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->key == (b)->key)
+#include <shash.h>
+
+#define sh_name _str
+#define sh_node_t struct str_node
+#define sh_hash_arg_t void *
+#define sh_hash(a, arg) ((a)->hash)
+#define sh_eq_arg_t void *
+#define sh_eq(a, b, arg) ((a)->hash == (b)->hash && \
+			  strcmp((a)->key, (b)->key) == 0)
+#include <shash.h>
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *engine, const char *op, size_t count, double start)
+{
+	double elapsed = now() - start;
+	printf("%-10s %-10s %8.3f sec %8.1f Mops/sec\n", engine, op, elapsed,
+	       count / elapsed / 1e6);
+}
+
+/** Even keys are inserted, odd ones are used for misses. */
+static uint32_t *
+random_keys(size_t count)
+{
+	uint32_t *keys = malloc(count * sizeof(*keys));
+	for (size_t i = 0; i < count; i++)
+		keys[i] = i * 2;
+	for (size_t i = 0; i + 1 < count; i++) {
+		size_t j = i + rand() % (count - i);
+		uint32_t tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+	return keys;
+}
+
+static char **
+random_strings(const uint32_t *keys, size_t count)
+{
+	char **strs = malloc(count * sizeof(*strs));
+	for (size_t i = 0; i < count; i++) {
+		strs[i] = malloc(32);
+		snprintf(strs[i], 32, "session:%08x", keys[i]);
+	}
+	return strs;
+}
+
+/*
+ * The same benchmark for both tables and both node types:
+ * insert all, find all, find missing, a mix of 50% finds,
+ * 25% deletes and 25% inserts, delete all.
+ */
+#define BENCH(engine, name, node_t, node_init, end)			\
+static void								\
+bench_##engine##name(const uint32_t *keys, char **strs, size_t count)	\
+{									\
+	(void) keys; (void) strs;					\
+	const char *title = #engine #name;				\
+	struct engine##name##_t *h = engine##name##_new();		\
+	node_t node;							\
+	double start = now();						\
+	for (size_t i = 0; i < count; i++) {				\
+		node_init(node, i, 0);					\
+		engine##name##_replace(h, &node, NULL, NULL, NULL);	\
+	}								\
+	report(title, "insert", count, start);				\
+									\
+	start = now();							\
+	for (size_t i = 0; i < count; i++) {				\
+		node_init(node, i, 0);					\
+		if (engine##name##_get(h, &node, NULL, NULL) == end(h))	\
+			abort();					\
+	}								\
+	report(title, "find", count, start);				\
+									\
+	start = now();							\
+	for (size_t i = 0; i < count; i++) {				\
+		node_init(node, i, 1);					\
+		if (engine##name##_get(h, &node, NULL, NULL) != end(h))	\
+			abort();					\
+	}								\
+	report(title, "miss", count, start);				\
+									\
+	start = now();							\
+	for (size_t i = 0; i < count; i++) {				\
+		size_t j = (i * 7) % count;				\
+		switch (i % 4) {					\
+		case 0:							\
+		case 1:							\
+			node_init(node, j, 0);				\
+			engine##name##_get(h, &node, NULL, NULL);	\
+			break;						\
+		case 2:							\
+			node_init(node, j, 0);				\
+			engine##name##_remove(h, &node, NULL, NULL);	\
+			break;						\
+		case 3:							\
+			node_init(node, i - 1, 0);			\
+			engine##name##_replace(h, &node, NULL,		\
+					       NULL, NULL);		\
+			break;						\
+		}							\
+	}								\
+	report(title, "mixed", count, start);				\
+									\
+	start = now();							\
+	for (size_t i = 0; i < count; i++) {				\
+		node_init(node, i, 0);					\
+		engine##name##_remove(h, &node, NULL, NULL);		\
+	}								\
+	report(title, "delete", count, start);				\
+	engine##name##_delete(h);					\
+}
+
+#define i32_init(node, i, miss) ({					\
+	node.key = keys[i] + (miss);					\
+	node.val = NULL;						\
+})
+
+/* A miss differs from the key in the last char. */
+#define str_init(node, i, miss) ({					\
+	static char buf[32];						\
+	node.key = strs[i];						\
+	if (miss) {							\
+		strcpy(buf, strs[i]);					\
+		buf[strlen(buf) - 1] = 'x';				\
+		node.key = buf;						\
+	}								\
+	node.val = NULL;						\
+	node.hash = str_hash(node.key);					\
+})
+
+#define mh_end_(h) mh_end(h)
+#define sh_end_(h) sh_end(h)
+
+BENCH(mh, _i32, struct i32_node, i32_init, mh_end_)
+BENCH(sh, _i32, struct i32_node, i32_init, sh_end_)
+BENCH(mh, _str, struct str_node, str_init, mh_end_)
+BENCH(sh, _str, struct str_node, str_init, sh_end_)
+
+int
+main(int argc, char *argv[])
+{
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	srand(time(NULL));
+	uint32_t *keys = random_keys(count);
+	char **strs = random_strings(keys, count);
+	printf("%zu elements\n", count);
+	bench_mh_i32(keys, strs, count);
+	bench_sh_i32(keys, strs, count);
+	bench_mh_str(keys, strs, count);
+	bench_sh_str(keys, strs, count);
+	for (size_t i = 0; i < count; i++)
+		free(strs[i]);
+	free(strs);
+	free(keys);
+	return 0;
+}
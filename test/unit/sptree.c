@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <third_party/sptree.h>
+
+#include "unit.h"
+
+static int
+key_cmp(const void *a, const void *b, void *arg)
+{
+	(void) arg;
+	uint32_t ka = *(const uint32_t *) a;
+	uint32_t kb = *(const uint32_t *) b;
+	return ka < kb ? -1 : (ka > kb);
+}
+
+SPTREE_DEF(test, realloc);
+
+/**
+ * Check the order of keys and the balance of a subtree.
+ * @return the height of the subtree.
+ */
+static int
+check_node(sptree_test *t, spnode_t node, const uint32_t *min,
+	   const uint32_t *max, size_t *count)
+{
+	if (node == SPNIL)
+		return 0;
+	uint32_t key = *(uint32_t *) ITHELEM(t, node);
+	size_t before = *count;
+	fail_unless(min == NULL || key > *min);
+	fail_unless(max == NULL || key < *max);
+	int hl = check_node(t, _GET_SPNODE_LEFT(node), min, &key, count);
+	int hr = check_node(t, _GET_SPNODE_RIGHT(node), &key, max, count);
+	fail_unless(hl - hr <= 1 && hr - hl <= 1);
+	int height = 1 + (hl > hr ? hl : hr);
+	fail_unless(t->heights[node] == height);
+	(*count)++;
+	fail_unless(t->sizes[node] == *count - before);
+	return height;
+}
+
+/** Check tree contents against a set of present keys. */
+static void
+check_tree(sptree_test *t, const bool *present, uint32_t max_key)
+{
+	size_t count = 0;
+	int height = check_node(t, t->root, NULL, NULL, &count);
+	fail_unless(height <= (int) t->max_depth);
+	fail_unless(count == t->size);
+
+	size_t n_present = 0;
+	for (uint32_t k = 0; k < max_key; k++) {
+		fail_unless((sptree_test_find(t, &k) != NULL) == present[k]);
+		n_present += present[k];
+	}
+	fail_unless(n_present == count);
+
+	sptree_test_iterator *it = NULL;
+	uint32_t k = 0;
+	sptree_test_iterator_init_set(t, &it, &k);
+	uint32_t *e;
+	while ((e = sptree_test_iterator_next(it)) != NULL) {
+		while (!present[k])
+			k++;
+		fail_unless(*e == k);
+		k++;
+	}
+	while (k < max_key)
+		fail_unless(!present[k++]);
+	sptree_test_iterator_free(it);
+}
+
+static void
+test_sequential()
+{
+	header();
+
+	enum { COUNT = 100000 };
+	sptree_test tree;
+	sptree_test_init(&tree, sizeof(uint32_t), NULL, 0, 0,
+			 key_cmp, key_cmp, NULL);
+	for (uint32_t k = 0; k < COUNT; k++)
+		sptree_test_replace(&tree, &k, NULL);
+	/* An AVL tree of 100000 nodes is 24 levels deep at most. */
+	size_t count = 0;
+	fail_unless(check_node(&tree, tree.root, NULL, NULL, &count) <= 24);
+	fail_unless(count == COUNT);
+	for (uint32_t k = 0; k < COUNT; k += 2)
+		sptree_test_delete(&tree, &k);
+	count = 0;
+	fail_unless(check_node(&tree, tree.root, NULL, NULL, &count) <= 23);
+	fail_unless(count == COUNT / 2);
+	sptree_test_destroy(&tree);
+
+	footer();
+}
+
+static void
+test_random()
+{
+	header();
+
+	enum { MAX_KEY = 5000, OPS = 200000 };
+	bool *present = calloc(MAX_KEY, sizeof(bool));
+	sptree_test tree;
+	sptree_test_init(&tree, sizeof(uint32_t), NULL, 0, 0,
+			 key_cmp, key_cmp, NULL);
+	for (int i = 0; i < OPS; i++) {
+		uint32_t k = rand() % MAX_KEY;
+		/* Grow the tree in the first half, shrink in the second. */
+		if (rand() % 3 < (i < OPS / 2 ? 2 : 1)) {
+			sptree_test_replace(&tree, &k, NULL);
+			present[k] = true;
+		} else {
+			sptree_test_delete(&tree, &k);
+			present[k] = false;
+		}
+		if (i % 1000 == 0)
+			check_tree(&tree, present, MAX_KEY);
+	}
+	check_tree(&tree, present, MAX_KEY);
+	sptree_test_destroy(&tree);
+	free(present);
+
+	footer();
+}
+
+static void
+test_build()
+{
+	header();
+
+	enum { COUNT = 1000 };
+	bool present[COUNT];
+	uint32_t *keys = malloc(COUNT * sizeof(uint32_t));
+	for (uint32_t i = 0; i < COUNT; i++) {
+		keys[i] = i * 7 % COUNT;
+		present[i] = true;
+	}
+	sptree_test tree;
+	sptree_test_init(&tree, sizeof(uint32_t), keys, COUNT, COUNT,
+			 key_cmp, key_cmp, NULL);
+	check_tree(&tree, present, COUNT);
+	for (uint32_t k = 0; k < COUNT; k += 3) {
+		sptree_test_delete(&tree, &k);
+		present[k] = false;
+	}
+	check_tree(&tree, present, COUNT);
+	sptree_test_destroy(&tree);
+
+	footer();
+}
+
+static void
+test_rank()
+{
+	header();
+
+	enum { COUNT = 1000 };
+	sptree_test tree;
+	sptree_test_init(&tree, sizeof(uint32_t), NULL, 0, 0,
+			 key_cmp, key_cmp, NULL);
+	/* Odd keys from 1 to 2 * COUNT - 1. */
+	for (uint32_t k = 0; k < COUNT; k++) {
+		uint32_t e = (k * 7 % COUNT) * 2 + 1;
+		sptree_test_replace(&tree, &e, NULL);
+	}
+	for (uint32_t k = 0; k <= COUNT * 2; k++) {
+		fail_unless(sptree_test_rank(&tree, &k) == k / 2);
+		fail_unless(sptree_test_rank_elem(&tree, &k) == k / 2);
+		fail_unless(sptree_test_count(&tree, &k) ==
+			    (k < COUNT * 2 && k % 2));
+	}
+
+	sptree_test_iterator *it = NULL;
+	for (uint32_t start = 0; start < COUNT * 2; start += 77) {
+		for (spnode_t step = 1; step < COUNT; step *= 3) {
+			/* Forward: skip, then continue from the next one. */
+			uint32_t k = start;
+			sptree_test_iterator_init_set(&tree, &it, &k);
+			spnode_t n = step;
+			uint32_t *e = sptree_test_iterator_skip(&it, &n);
+			spnode_t rank = k / 2;
+			spnode_t expect = step < COUNT - rank ?
+				step : COUNT - rank;
+			fail_unless(n == expect);
+			fail_unless(e != NULL && *e == (rank + n - 1) * 2 + 1);
+			e = sptree_test_iterator_next(it);
+			if (rank + n < COUNT) {
+				fail_unless(e != NULL &&
+					    *e == (rank + n) * 2 + 1);
+			} else {
+				fail_unless(e == NULL);
+			}
+
+			/* Reverse: the last key not greater than start. */
+			sptree_test_iterator_reverse_init_set(&tree, &it, &k);
+			n = step;
+			e = sptree_test_iterator_reverse_skip(&it, &n);
+			spnode_t below = (k + 1) / 2;
+			expect = step < below ? step : below;
+			fail_unless(n == expect);
+			if (below == 0) {
+				fail_unless(e == NULL);
+				continue;
+			}
+			fail_unless(e != NULL &&
+				    *e == (below - n) * 2 + 1);
+			e = sptree_test_iterator_reverse_next(it);
+			if (below > n) {
+				fail_unless(e != NULL &&
+					    *e == (below - n - 1) * 2 + 1);
+			} else {
+				fail_unless(e == NULL);
+			}
+		}
+	}
+	/* Nothing to skip at the end. */
+	uint32_t k = COUNT * 2;
+	sptree_test_iterator_init_set(&tree, &it, &k);
+	spnode_t n = 10;
+	fail_unless(sptree_test_iterator_skip(&it, &n) == NULL && n == 0);
+	sptree_test_iterator_free(it);
+	sptree_test_destroy(&tree);
+
+	footer();
+}
+
+int
+main(void)
+{
+	srand(1);
+	test_sequential();
+	test_random();
+	test_build();
+	test_rank();
+	return 0;
+}
@@ -53,11 +53,6 @@ typedef struct sptree_node_pointers {
 
 #endif /* SPTREE_NODE_SELF */
 
-#ifndef alpha
-#define    alpha                       ((double)0.75)
-#endif
-#define    COUNTALPHA(size)            floor(log((double)(size))/log((double)1.0/alpha))
-
 #define    _GET_SPNODE_LEFT(n)         GET_SPNODE_LEFT( t->lrpointers + (n) )
 #define    _SET_SPNODE_LEFT(n, v)      SET_SPNODE_LEFT( t->lrpointers + (n), (v) )
 #define    _GET_SPNODE_RIGHT(n)        GET_SPNODE_RIGHT( t->lrpointers + (n) )
@@ -80,6 +75,9 @@ typedef struct sptree_node_pointers {
  *   void sptree_NAME_replace(sptree_NAME *tree, void *value, void **p_oldvalue)
  *   void sptree_NAME_delete(sptree_NAME *tree, void *value)
  *   void* sptree_NAME_find(sptree_NAME *tree, void *key)
+ *   spnode_t sptree_NAME_rank(sptree_NAME *tree, void *key)
+ *   spnode_t sptree_NAME_rank_elem(sptree_NAME *tree, void *value)
+ *   spnode_t sptree_NAME_count(sptree_NAME *tree, void *key)
  *
  *   spnode_t sptree_NAME_walk(sptree_NAME *t, void* array, spnode_t limit, spnode_t offset)
  *   void sptree_NAME_walk_cb(sptree_NAME *t, int (*cb)(void* cb_arg, void* elem), void *cb_arg)
@@ -92,12 +90,18 @@ typedef struct sptree_node_pointers {
  *
  *   void* sptree_NAME_iterator_next(sptree_NAME_iterator *i)
  *   void* sptree_NAME_iterator_reverse_next(sptree_NAME_iterator *i)
+ *   void* sptree_NAME_iterator_skip(sptree_NAME_iterator **i, spnode_t *count)
+ *   void* sptree_NAME_iterator_reverse_skip(sptree_NAME_iterator **i, spnode_t *count)
  */
 
 #define SPTREE_DEF(name, realloc)                                                         \
 typedef struct sptree_##name {                                                            \
     void                    *members;                                                     \
     sptree_node_pointers    *lrpointers;                                                  \
+    /* Heights of the subtrees, a leaf has 1 */                                           \
+    unsigned char           *heights;                                                     \
+    /* Numbers of nodes in the subtrees, a leaf has 1 */                                  \
+    spnode_t                *sizes;                                                       \
                                                                                           \
     spnode_t                nmember;                                                      \
     spnode_t                ntotal;                                                       \
@@ -114,6 +118,30 @@ typedef struct sptree_##name {
     spnode_t                max_depth;                                                    \
 } sptree_##name;                                                                          \
                                                                                           \
+static inline int                                                                         \
+sptree_##name##_height(sptree_##name *t, spnode_t node) {                                 \
+    return node == SPNIL ? 0 : t->heights[node];                                          \
+}                                                                                         \
+                                                                                          \
+static inline spnode_t                                                                    \
+sptree_##name##_subtree_size(sptree_##name *t, spnode_t node) {                           \
+    return node == SPNIL ? 0 : t->sizes[node];                                            \
+}                                                                                         \
+                                                                                          \
+static inline void                                                                        \
+sptree_##name##_fix_size(sptree_##name *t, spnode_t node) {                               \
+    t->sizes[node] = 1 + sptree_##name##_subtree_size(t, _GET_SPNODE_LEFT(node)) +        \
+                     sptree_##name##_subtree_size(t, _GET_SPNODE_RIGHT(node));            \
+}                                                                                         \
+                                                                                          \
+/* Recompute the height and the size of a node from its subtrees. */                      \
+static inline void                                                                        \
+sptree_##name##_fix_height(sptree_##name *t, spnode_t node) {                             \
+    int hl = sptree_##name##_height(t, _GET_SPNODE_LEFT(node));                           \
+    int hr = sptree_##name##_height(t, _GET_SPNODE_RIGHT(node));                          \
+    t->heights[node] = 1 + (hl > hr ? hl : hr);                                           \
+    sptree_##name##_fix_size(t, node);                                                    \
+}                                                                                         \
 static spnode_t                                                                           \
 sptree_##name##_mktree(sptree_##name *t, spnode_t depth, spnode_t start, spnode_t end) {  \
     spnode_t    half = ( (end + start) >> 1 ), tmp;                                       \
@@ -130,6 +158,7 @@ sptree_##name##_mktree(sptree_##name *t, spnode_t depth, spnode_t start, spnode_
         _SET_SPNODE_RIGHT(half, SPNIL);                                                   \
     else                                                                                  \
         _SET_SPNODE_RIGHT(half, tmp);                                                     \
+    sptree_##name##_fix_height(t, half);                                                  \
                                                                                           \
     return half;                                                                          \
 }                                                                                         \
@@ -160,11 +189,16 @@ sptree_##name##_init(sptree_##name *t, size_t elemsize, void *m,
             t->members = realloc(NULL, elemsize * t->ntotal);                             \
     }                                                                                     \
     t->lrpointers = realloc(NULL, sizeof(sptree_node_pointers) * t->ntotal);              \
+    t->heights = realloc(NULL, t->ntotal);                                                \
+    t->sizes = realloc(NULL, sizeof(spnode_t) * t->ntotal);                               \
                                                                                           \
     if (t->nmember == 1) {                                                                \
         t->root = 0;                                                                      \
         _SET_SPNODE_RIGHT(0, SPNIL);                                                      \
         _SET_SPNODE_LEFT(0, SPNIL);                                                       \
+        t->heights[0] = 1;                                                                \
+        t->sizes[0] = 1;                                                                  \
+        t->max_depth = 1;                                                                 \
     } else if (t->nmember > 1)    {                                                       \
         qsort_arg(t->members, t->nmember, elemsize, t->elemcompare, t->arg);              \
         /* create tree */                                                                 \
@@ -177,6 +211,8 @@ sptree_##name##_destroy(sptree_##name *t) {
         if (t == NULL)    return;                                                         \
     free(t->members);                                                                     \
     free(t->lrpointers);                                                                  \
+    free(t->heights);                                                                     \
+    free(t->sizes);                                                                       \
 }                                                                                         \
                                                                                           \
 static inline void*                                                                       \
@@ -221,13 +257,41 @@ sptree_##name##_last(sptree_##name *t) {
     return NULL;                                                                          \
 }                                                                                         \
                                                                                           \
+/*                                                                                        \
+ * Count the elements less than k by cmp, or not greater                                  \
+ * than k if upper is set. Takes O(log(size)) time thanks                                 \
+ * to the subtree sizes.                                                                  \
+ */                                                                                       \
 static inline spnode_t                                                                    \
-sptree_##name##_size_of_subtree(sptree_##name *t, spnode_t node) {                        \
-    if (node == SPNIL)                                                                    \
-        return 0;                                                                         \
-    return 1 +                                                                            \
-        sptree_##name##_size_of_subtree(t, _GET_SPNODE_LEFT(node)) +                      \
-        sptree_##name##_size_of_subtree(t, _GET_SPNODE_RIGHT(node));                      \
+sptree_##name##_rank_by(sptree_##name *t, void *k,                                        \
+                        int (*cmp)(const void *, const void *, void *), bool upper) {     \
+    spnode_t    node = t->root, rank = 0;                                                 \
+    while (node != SPNIL) {                                                               \
+        int r = cmp(k, ITHELEM(t, node), t->arg);                                         \
+        if (r > 0 || (upper && r == 0)) {                                                 \
+            rank += sptree_##name##_subtree_size(t, _GET_SPNODE_LEFT(node)) + 1;          \
+            node = _GET_SPNODE_RIGHT(node);                                               \
+        } else {                                                                          \
+            node = _GET_SPNODE_LEFT(node);                                                \
+        }                                                                                 \
+    }                                                                                     \
+    return rank;                                                                          \
+}                                                                                         \
+                                                                                          \
+static inline spnode_t                                                                    \
+sptree_##name##_rank(sptree_##name *t, void *k) {                                         \
+    return sptree_##name##_rank_by(t, k, t->compare, false);                              \
+}                                                                                         \
+                                                                                          \
+static inline spnode_t                                                                    \
+sptree_##name##_rank_elem(sptree_##name *t, void *v) {                                    \
+    return sptree_##name##_rank_by(t, v, t->elemcompare, false);                          \
+}                                                                                         \
+                                                                                          \
+static inline spnode_t                                                                    \
+sptree_##name##_count(sptree_##name *t, void *k) {                                        \
+    return sptree_##name##_rank_by(t, k, t->compare, true) -                              \
+           sptree_##name##_rank_by(t, k, t->compare, false);                              \
 }                                                                                         \
                                                                                           \
 static inline spnode_t                                                                    \
@@ -242,6 +306,8 @@ sptree_##name##_get_place(sptree_##name *t) {
             t->members = realloc(t->members, t->ntotal * t->elemsize);                    \
             t->lrpointers = realloc(t->lrpointers,                                        \
                                     t->ntotal * sizeof(sptree_node_pointers));            \
+            t->heights = realloc(t->heights, t->ntotal);                                  \
+            t->sizes = realloc(t->sizes, t->ntotal * sizeof(spnode_t));                   \
         }                                                                                 \
                                                                                           \
         node = t->nmember;                                                                \
@@ -249,54 +315,90 @@ sptree_##name##_get_place(sptree_##name *t) {
     }                                                                                     \
     _SET_SPNODE_LEFT(node, SPNIL);                                                        \
     _SET_SPNODE_RIGHT(node, SPNIL);                                                       \
+    t->heights[node] = 1;                                                                 \
+    t->sizes[node] = 1;                                                                   \
     return node;                                                                          \
 }                                                                                         \
                                                                                           \
 static inline spnode_t                                                                    \
-sptree_##name##_flatten_tree(sptree_##name *t, spnode_t root, spnode_t head) {            \
-    spnode_t    node;                                                                     \
-    if (root == SPNIL)                                                                    \
-        return head;                                                                      \
-    node = sptree_##name##_flatten_tree(t, _GET_SPNODE_RIGHT(root), head);                \
-    _SET_SPNODE_RIGHT(root, node);                                                        \
-    return sptree_##name##_flatten_tree(t, _GET_SPNODE_LEFT(root), root);                 \
+sptree_##name##_rotate_left(sptree_##name *t, spnode_t node) {                            \
+    spnode_t    right = _GET_SPNODE_RIGHT(node);                                          \
+    _SET_SPNODE_RIGHT(node, _GET_SPNODE_LEFT(right));                                     \
+    _SET_SPNODE_LEFT(right, node);                                                        \
+    sptree_##name##_fix_height(t, node);                                                  \
+    sptree_##name##_fix_height(t, right);                                                 \
+    return right;                                                                         \
 }                                                                                         \
                                                                                           \
 static inline spnode_t                                                                    \
-sptree_##name##_build_tree(sptree_##name *t, spnode_t node, spnode_t size) {              \
-    spnode_t    tmp;                                                                      \
-    if (size == 0) {                                                                      \
-        _SET_SPNODE_LEFT(node, SPNIL);                                                    \
-        return node;                                                                      \
-    }                                                                                     \
-    spnode_t root = sptree_##name##_build_tree(t,                                         \
-                node, ceil(((double)size-1.0)/2.0));                                      \
-    spnode_t list = sptree_##name##_build_tree(t,                                         \
-                _GET_SPNODE_RIGHT(root), floor(((double)size-1.0)/2.0));                  \
-    tmp = _GET_SPNODE_LEFT(list);                                                         \
-    _SET_SPNODE_RIGHT(root, tmp);                                                         \
-    _SET_SPNODE_LEFT(list, root);                                                         \
-                                                                                          \
-    return list;                                                                          \
+sptree_##name##_rotate_right(sptree_##name *t, spnode_t node) {                           \
+    spnode_t    left = _GET_SPNODE_LEFT(node);                                            \
+    _SET_SPNODE_LEFT(node, _GET_SPNODE_RIGHT(left));                                      \
+    _SET_SPNODE_RIGHT(left, node);                                                        \
+    sptree_##name##_fix_height(t, node);                                                  \
+    sptree_##name##_fix_height(t, left);                                                  \
+    return left;                                                                          \
 }                                                                                         \
                                                                                           \
+/*                                                                                        \
+ * The tree is kept AVL-balanced: heights of the subtrees of a                            \
+ * node differ by 1 at most. An update restores the balance with                          \
+ * a few rotations on its path, so that no single replace() or                            \
+ * delete() takes more than O(log(size)) time, unlike rebuilding                          \
+ * an unbalanced subtree as a whole.                                                      \
+ *                                                                                        \
+ * Rebalance a node whose subtrees differ in height by 2 at most,                         \
+ * return the new root of the subtree.                                                    \
+ */                                                                                       \
 static inline spnode_t                                                                    \
-sptree_##name##_balance(sptree_##name *t, spnode_t node, spnode_t size) {                 \
-    spnode_t fake = sptree_##name##_get_place(t);                                         \
-    spnode_t z;                                                                           \
-                                                                                          \
-    z = sptree_##name##_flatten_tree(t, node, fake);                                      \
-    sptree_##name##_build_tree(t, z, size);                                               \
+sptree_##name##_rebalance(sptree_##name *t, spnode_t node) {                              \
+    spnode_t    left = _GET_SPNODE_LEFT(node);                                            \
+    spnode_t    right = _GET_SPNODE_RIGHT(node);                                          \
+    int         hl = sptree_##name##_height(t, left);                                     \
+    int         hr = sptree_##name##_height(t, right);                                    \
+                                                                                          \
+    if (hl > hr + 1) {                                                                    \
+        if (sptree_##name##_height(t, _GET_SPNODE_LEFT(left)) <                           \
+            sptree_##name##_height(t, _GET_SPNODE_RIGHT(left)))                           \
+            _SET_SPNODE_LEFT(node, sptree_##name##_rotate_left(t, left));                 \
+        return sptree_##name##_rotate_right(t, node);                                     \
+    }                                                                                     \
+    if (hr > hl + 1) {                                                                    \
+        if (sptree_##name##_height(t, _GET_SPNODE_RIGHT(right)) <                         \
+            sptree_##name##_height(t, _GET_SPNODE_LEFT(right)))                           \
+            _SET_SPNODE_RIGHT(node, sptree_##name##_rotate_right(t, right));              \
+        return sptree_##name##_rotate_left(t, node);                                      \
+    }                                                                                     \
+    sptree_##name##_fix_height(t, node);                                                  \
+    return node;                                                                          \
+}                                                                                         \
                                                                                           \
-    z = _GET_SPNODE_LEFT(fake);                                                           \
-    _SET_SPNODE_LEFT(fake, t->garbage_head);                                              \
-    /*                                                                                    \
-     * Loop back on the right link indicates that the node                                \
-     * is in the garbage list.                                                            \
-     */                                                                                   \
-    _SET_SPNODE_RIGHT(fake, fake);                                                        \
-    t->garbage_head = fake;                                                               \
-    return z;                                                                             \
+/*                                                                                        \
+ * Rebalance the nodes on the path to a changed subtree bottom up,                        \
+ * path[depth - 1] is the parent of the subtree.                                          \
+ */                                                                                       \
+static inline void                                                                        \
+sptree_##name##_rebalance_path(sptree_##name *t, spnode_t *path, spnode_t depth) {        \
+    while (depth > 0) {                                                                   \
+        spnode_t    node = path[--depth];                                                 \
+        int         height = t->heights[node];                                            \
+        spnode_t    top = sptree_##name##_rebalance(t, node);                             \
+                                                                                          \
+        if (depth == 0)                                                                   \
+            t->root = top;                                                                \
+        else if (_GET_SPNODE_LEFT(path[depth - 1]) == node)                               \
+            _SET_SPNODE_LEFT(path[depth - 1], top);                                       \
+        else                                                                              \
+            _SET_SPNODE_RIGHT(path[depth - 1], top);                                      \
+        if (top == node && t->heights[node] == height) {                                  \
+            /* No need to rebalance above the node, only to fix the sizes. */             \
+            while (depth > 0)                                                             \
+                sptree_##name##_fix_size(t, path[--depth]);                               \
+            break;                                                                        \
+        }                                                                                 \
+    }                                                                                     \
+    if (t->root != SPNIL && t->heights[t->root] > t->max_depth)                           \
+        t->max_depth = t->heights[t->root];                                               \
 }                                                                                         \
                                                                                           \
 static inline void                                                                        \
@@ -308,10 +410,14 @@ sptree_##name##_replace(sptree_##name *t, void *v, void **p_old) {
         _SET_SPNODE_LEFT(0, SPNIL);                                                       \
         _SET_SPNODE_RIGHT(0, SPNIL);                                                      \
         memcpy(t->members, v, t->elemsize);                                               \
+        t->heights[0] = 1;                                                                \
+        t->sizes[0] = 1;                                                                  \
         t->root = 0;                                                                      \
         t->garbage_head = SPNIL;                                                          \
         t->nmember = 1;                                                                   \
         t->size=1;                                                                        \
+        if (t->max_depth < 1)                                                             \
+            t->max_depth = 1;                                                             \
         if (p_old)                                                                        \
             *p_old = NULL;                                                                \
         return;                                                                           \
@@ -349,117 +455,64 @@ sptree_##name##_replace(sptree_##name *t, void *v, void **p_old) {
             }                                                                             \
         }                                                                                 \
     }                                                                                     \
-    if (p_old)                                                                        \
-        *p_old = NULL;                                                                \
+    if (p_old)                                                                            \
+        *p_old = NULL;                                                                    \
                                                                                           \
     t->size++;                                                                            \
     if ( t->size > t->max_size )                                                          \
         t->max_size = t->size;                                                            \
-    if ( depth > t->max_depth )                                                           \
-        t->max_depth = depth;                                                             \
-                                                                                          \
-    if ( (double)depth > COUNTALPHA(t->size)) {                                           \
-        spnode_t    parent;                                                               \
-        spnode_t    i, size = 1 ;                                                         \
-                                                                                          \
-        path[depth] = node;                                                               \
-                                                                                          \
-        for (i = 1; ; i++) {                                                              \
-            if (i < depth) {                                                              \
-                parent = path[ depth - i ];                                               \
-                size += 1 + sptree_##name##_size_of_subtree( t,                           \
-                    _GET_SPNODE_RIGHT(parent) == path[depth - i + 1] ?                    \
-                        _GET_SPNODE_LEFT(parent) :  _GET_SPNODE_RIGHT(parent));           \
-                if ((double)i > COUNTALPHA(size)) {                                       \
-                    spnode_t n = sptree_##name##_balance(t, parent, size);                \
-                    spnode_t pp = path[  depth - i - 1 ];                                 \
-                    if (_GET_SPNODE_LEFT(pp) == parent)                                   \
-                        _SET_SPNODE_LEFT(pp, n);                                          \
-                    else                                                                  \
-                        _SET_SPNODE_RIGHT(pp, n);                                         \
-                    break;                                                                \
-                }                                                                         \
-            } else {                                                                      \
-                t->root = sptree_##name##_balance(t, t->root, t->size);                   \
-                t->max_size = t->size;                                                    \
-                break;                                                                    \
-            }                                                                             \
-        }                                                                                 \
-    }                                                                                     \
+                                                                                          \
+    sptree_##name##_rebalance_path(t, path, depth);                                       \
 }                                                                                         \
                                                                                           \
 static inline void                                                                        \
 sptree_##name##_delete(sptree_##name *t, void *k) {                                       \
-    spnode_t    node = t->root;                                                           \
-    spnode_t    parent = SPNIL;                                                           \
-    int            lr = 0;                                                                \
+    spnode_t    node = t->root, child, depth = 0;                                         \
+    spnode_t    path[ t->max_depth + 1];                                                  \
+                                                                                          \
     while(node != SPNIL) {                                                                \
         int r = t->elemcompare(k, ITHELEM(t, node), t->arg);                              \
-        if (r > 0) {                                                                      \
-            parent = node;                                                                \
-            node = _GET_SPNODE_RIGHT(node);                                               \
-            lr = +1;                                                                      \
-        } else if (r < 0) {                                                               \
-            parent = node;                                                                \
-            node = _GET_SPNODE_LEFT(node);                                                \
-            lr = -1;                                                                      \
-        } else {/* found */                                                               \
-            if (_GET_SPNODE_LEFT(node) == SPNIL && _GET_SPNODE_RIGHT(node) == SPNIL) {    \
-                if ( parent == SPNIL )                                                    \
-                    t->root = SPNIL;                                                      \
-                else if (lr <0)                                                           \
-                    _SET_SPNODE_LEFT(parent, SPNIL);                                      \
-                else                                                                      \
-                    _SET_SPNODE_RIGHT(parent, SPNIL);                                     \
-            } else if (_GET_SPNODE_LEFT(node) == SPNIL) {                                 \
-                spnode_t    child = _GET_SPNODE_RIGHT(node);                              \
-                if (parent == SPNIL) t->root = child;                                     \
-                else if (lr <0) _SET_SPNODE_LEFT(parent, child);                          \
-                else _SET_SPNODE_RIGHT(parent, child);                                    \
-            } else if (_GET_SPNODE_RIGHT(node) == SPNIL) {                                \
-                spnode_t    child = _GET_SPNODE_LEFT(node);                               \
-                if (parent == SPNIL) t->root = child;                                     \
-                else if (lr <0) _SET_SPNODE_LEFT(parent, child);                          \
-                else _SET_SPNODE_RIGHT(parent, child);                                    \
-            } else {                                                                      \
-                spnode_t    todel = _GET_SPNODE_LEFT(node);                               \
-                                                                                          \
-                parent = SPNIL;                                                           \
-                for(;;) {                                                                 \
-                    if ( _GET_SPNODE_RIGHT(todel) != SPNIL ) {                            \
-                        parent = todel;                                                   \
-                        todel = _GET_SPNODE_RIGHT(todel);                                 \
-                    } else                                                                \
-                        break;                                                            \
-                }                                                                         \
-                memcpy(ITHELEM(t, node), ITHELEM(t, todel), t->elemsize);                 \
-                if (parent != SPNIL)                                                      \
-                    _SET_SPNODE_RIGHT(parent, _GET_SPNODE_LEFT(todel));                   \
-                else                                                                      \
-                    _SET_SPNODE_LEFT(node, _GET_SPNODE_LEFT(todel));                      \
-                node = todel; /* node to delete */                                        \
-            }                                                                             \
-                                                                                          \
-            _SET_SPNODE_LEFT(node, t->garbage_head);                                      \
-            /*                                                                            \
-             * Loop back on the right link indicates that the node                        \
-             * is in the garbage list.                                                    \
-             */                                                                           \
-            _SET_SPNODE_RIGHT(node, node);                                                \
-            t->garbage_head = node;                                                       \
-                                                                                          \
+        if (r == 0)                                                                       \
             break;                                                                        \
-        }                                                                                 \
+        path[depth++] = node;                                                             \
+        node = r > 0 ? _GET_SPNODE_RIGHT(node) : _GET_SPNODE_LEFT(node);                  \
     }                                                                                     \
                                                                                           \
     if (node == SPNIL) /* not found */                                                    \
         return;                                                                           \
                                                                                           \
-    t->size --;                                                                           \
-    if ( t->size > 0 && (double)t->size < alpha * t->max_size ) {                         \
-        t->root = sptree_##name##_balance(t, t->root, t->size);                           \
-        t->max_size = t->size;                                                            \
+    if (_GET_SPNODE_LEFT(node) != SPNIL && _GET_SPNODE_RIGHT(node) != SPNIL) {            \
+        /* Move the previous element here, delete its node instead. */                    \
+        spnode_t    todel = _GET_SPNODE_LEFT(node);                                       \
+                                                                                          \
+        path[depth++] = node;                                                             \
+        while (_GET_SPNODE_RIGHT(todel) != SPNIL) {                                       \
+            path[depth++] = todel;                                                        \
+            todel = _GET_SPNODE_RIGHT(todel);                                             \
+        }                                                                                 \
+        memcpy(ITHELEM(t, node), ITHELEM(t, todel), t->elemsize);                         \
+        node = todel; /* node to delete */                                                \
     }                                                                                     \
+                                                                                          \
+    child = _GET_SPNODE_LEFT(node) != SPNIL ?                                             \
+        _GET_SPNODE_LEFT(node) : _GET_SPNODE_RIGHT(node);                                 \
+    if (depth == 0)                                                                       \
+        t->root = child;                                                                  \
+    else if (_GET_SPNODE_LEFT(path[depth - 1]) == node)                                   \
+        _SET_SPNODE_LEFT(path[depth - 1], child);                                         \
+    else                                                                                  \
+        _SET_SPNODE_RIGHT(path[depth - 1], child);                                        \
+                                                                                          \
+    _SET_SPNODE_LEFT(node, t->garbage_head);                                              \
+    /*                                                                                    \
+     * Loop back on the right link indicates that the node                                \
+     * is in the garbage list.                                                            \
+     */                                                                                   \
+    _SET_SPNODE_RIGHT(node, node);                                                        \
+    t->garbage_head = node;                                                               \
+                                                                                          \
+    t->size --;                                                                           \
+    sptree_##name##_rebalance_path(t, path, depth);                                       \
 }                                                                                         \
                                                                                           \
 static inline spnode_t                                                                    \
@@ -564,7 +617,7 @@ sptree_##name##_iterator_init_set(sptree_##name *t, sptree_##name##_iterator **i
     int      lastLevelEq = -1, cmp;                                                       \
                                                                                           \
     if ((*i) == NULL || t->max_depth > (*i)->max_depth)                                   \
-        *i = realloc(*i, sizeof(**i) + sizeof(spnode_t) * (t->max_depth + 31));            \
+        *i = realloc(*i, sizeof(**i) + sizeof(spnode_t) * (t->max_depth + 31));           \
                                                                                           \
     (*i)->t = t;                                                                          \
     (*i)->level = -1;                                                                     \
@@ -621,7 +674,7 @@ sptree_##name##_iterator_reverse_init_set(sptree_##name *t, sptree_##name##_iter
     int      lastLevelEq = -1, cmp;                                                       \
                                                                                           \
     if ((*i) == NULL || t->max_depth > (*i)->max_depth)                                   \
-        *i = realloc(*i, sizeof(**i) + sizeof(spnode_t) * (t->max_depth + 31));            \
+        *i = realloc(*i, sizeof(**i) + sizeof(spnode_t) * (t->max_depth + 31));           \
                                                                                           \
     (*i)->t = t;                                                                          \
     (*i)->level = -1;                                                                     \
@@ -720,6 +773,86 @@ sptree_##name##_iterator_reverse_next(sptree_##name##_iterator *i) {
         node = _GET_SPNODE_RIGHT(i->stack[i->level]);                                     \
     }                                                                                     \
     return ITHELEM(t, returnNode);                                                        \
+}                                                                                         \
+                                                                                          \
+/*                                                                                        \
+ * Position an iterator on the element with the given rank,                               \
+ * the iterator goes backwards from it if reverse is set.                                 \
+ */                                                                                       \
+static inline void                                                                        \
+sptree_##name##_iterator_init_rank(sptree_##name *t, sptree_##name##_iterator **i,        \
+                                   spnode_t rank, bool reverse) {                         \
+    spnode_t node;                                                                        \
+                                                                                          \
+    if ((*i) == NULL || t->max_depth > (*i)->max_depth)                                   \
+        *i = realloc(*i, sizeof(**i) + sizeof(spnode_t) * (t->max_depth + 31));           \
+                                                                                          \
+    (*i)->t = t;                                                                          \
+    (*i)->level = -1;                                                                     \
+    (*i)->max_depth = t->max_depth;                                                       \
+                                                                                          \
+    node = t->root;                                                                       \
+    while (node != SPNIL) {                                                               \
+        spnode_t nleft = sptree_##name##_subtree_size(t, _GET_SPNODE_LEFT(node));         \
+        /* Keep on the path the nodes which are still to be visited. */                   \
+        if (rank == nleft || (rank < nleft) != reverse)                                   \
+            (*i)->stack[++(*i)->level] = node;                                            \
+        if (rank == nleft)                                                                \
+            break;                                                                        \
+        if (rank < nleft) {                                                               \
+            node = _GET_SPNODE_LEFT(node);                                                \
+        } else {                                                                          \
+            rank -= nleft + 1;                                                            \
+            node = _GET_SPNODE_RIGHT(node);                                               \
+        }                                                                                 \
+    }                                                                                     \
+}                                                                                         \
+                                                                                          \
+/*                                                                                        \
+ * Skip up to *count elements in O(log(size)) time, return the                            \
+ * last skipped one and set *count to the number of skipped ones.                         \
+ */                                                                                       \
+static inline void*                                                                       \
+sptree_##name##_iterator_skip_dir(sptree_##name##_iterator **i, spnode_t *count,          \
+                                  bool reverse) {                                         \
+    if (*i == NULL) {                                                                     \
+        *count = 0;                                                                       \
+        return NULL;                                                                      \
+    }                                                                                     \
+                                                                                          \
+    sptree_##name *t = (*i)->t;                                                           \
+    spnode_t node = sptree_##name##_iterator_next_node(*i);                               \
+    if (node == SPNIL) {                                                                  \
+        *count = 0;                                                                       \
+        return NULL;                                                                      \
+    }                                                                                     \
+                                                                                          \
+    spnode_t rank = sptree_##name##_rank_elem(t, ITHELEM(t, node));                       \
+    spnode_t remaining = reverse ? rank + 1 : t->size - rank;                             \
+    if (*count > remaining)                                                               \
+        *count = remaining;                                                               \
+    if (*count == 0) {                                                                    \
+        /* Put the next node back. */                                                     \
+        (*i)->level++;                                                                    \
+        return NULL;                                                                      \
+    }                                                                                     \
+                                                                                          \
+    if (reverse) {                                                                        \
+        sptree_##name##_iterator_init_rank(t, i, rank - *count + 1, true);                \
+        return sptree_##name##_iterator_reverse_next(*i);                                 \
+    }                                                                                     \
+    sptree_##name##_iterator_init_rank(t, i, rank + *count - 1, false);                   \
+    return sptree_##name##_iterator_next(*i);                                             \
+}                                                                                         \
+                                                                                          \
+static inline void*                                                                       \
+sptree_##name##_iterator_skip(sptree_##name##_iterator **i, spnode_t *count) {            \
+    return sptree_##name##_iterator_skip_dir(i, count, false);                            \
+}                                                                                         \
+                                                                                          \
+static inline void*                                                                       \
+sptree_##name##_iterator_reverse_skip(sptree_##name##_iterator **i, spnode_t *count) {    \
+    return sptree_##name##_iterator_skip_dir(i, count, true);                             \
 }
 /*
  * vim: ts=4 sts=4 et